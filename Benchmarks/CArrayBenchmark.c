@@ -0,0 +1,226 @@
+/*
+    CArrayBenchmark.c
+
+    Copyright (C) 2026 The Etoile Project
+
+    Date:  October 2026
+    License:  Modified BSD (see COPYING)
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <EtoileFoundation/ETCArray.h>
+
+/*
+ * Measures ETCArray used as a queue, a stack and a random access array.
+ *
+ * The queue benchmark is compared to a contiguous array whose front removal
+ * shifts all the elements with memmove(), which is what ETCArray used to do.
+ * The other benchmarks cover bulk appends, middle insertions and removals,
+ * and an ETCValueArray queue of 16-byte structs.
+ *
+ * Build it with "make benchmark=yes" in EtoileFoundation, then run:
+ *
+ *     CArrayBenchmark [elements] [runs]
+ *
+ * The defaults are 100000 elements and 5 runs, the best run being reported.
+ */
+
+typedef struct
+{
+    uint64_t identifier;
+    double weight;
+} Item;
+
+static double now(void)
+{
+    struct timespec time;
+
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec * 1e-9;
+}
+
+typedef size_t (*BenchmarkFunction)(size_t);
+
+/* Keeps half of the elements queued while pushing and popping all of them */
+static size_t runContiguousQueue(size_t count)
+{
+    void **elements = malloc(count * sizeof(void*));
+    size_t length = 0;
+    size_t sum = 0;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        elements[length++] = (void *)(i + 1);
+        if (length > count / 2)
+        {
+            sum += (uintptr_t)elements[0];
+            length--;
+            memmove(elements, elements + 1, length * sizeof(void*));
+        }
+    }
+    free(elements);
+    return sum;
+}
+
+static size_t runQueue(size_t count)
+{
+    ETCArray array = ETCArrayNew();
+    size_t sum = 0;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        ETCArrayAdd(array, (void *)(i + 1));
+        if (ETCArrayCount(array) > count / 2)
+        {
+            sum += (uintptr_t)ETCArrayFirstObject(array);
+            ETCArrayRemoveFirstObject(array);
+        }
+    }
+    ETCArrayFree(array);
+    return sum;
+}
+
+static size_t runStack(size_t count)
+{
+    ETCArray array = ETCArrayNew();
+    size_t sum = 0;
+
+    for (int round = 0; round < 10; round++)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            ETCArrayAdd(array, (void *)(i + 1));
+        }
+        while (ETCArrayCount(array) > 0)
+        {
+            sum += (uintptr_t)ETCArrayLastObject(array);
+            ETCArrayRemoveLastObject(array);
+        }
+    }
+    ETCArrayFree(array);
+    return sum;
+}
+
+static size_t runRandomAccess(size_t count)
+{
+    ETCArray array = ETCArrayNewWithInitialSize(count);
+    size_t sum = 0;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        ETCArrayAddFirst(array, (void *)(i + 1));
+    }
+    for (int round = 0; round < 10; round++)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            sum += (uintptr_t)ETCArrayObjectAtIndex(array, (i * 7919) % count);
+        }
+    }
+    ETCArrayFree(array);
+    return sum;
+}
+
+static size_t runBulkAppend(size_t count)
+{
+    void *chunk[256];
+    ETCArray array = ETCArrayNew();
+    size_t result;
+
+    for (size_t i = 0; i < 256; i++)
+    {
+        chunk[i] = (void *)(i + 1);
+    }
+    for (size_t i = 0; i < count; i += 256)
+    {
+        ETCArrayAddObjects(array, chunk, 256);
+    }
+    result = ETCArrayCount(array);
+    ETCArrayFree(array);
+    return result;
+}
+
+static size_t runMiddleEdits(size_t count)
+{
+    ETCArray array = ETCArrayNew();
+    size_t edits = count / 100;
+    size_t result;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        ETCArrayAdd(array, (void *)(i + 1));
+    }
+    for (size_t i = 0; i < edits; i++)
+    {
+        size_t anIndex = (i * 7919) % ETCArrayCount(array);
+
+        ETCArrayAddAtIndex(array, (void *)i, anIndex);
+        ETCArrayRemoveObjectAtIndex(array, (anIndex * 31) % ETCArrayCount(array));
+    }
+    result = ETCArrayCount(array);
+    ETCArrayFree(array);
+    return result;
+}
+
+static size_t runValueQueue(size_t count)
+{
+    ETCValueArray array = ETCValueArrayNew(sizeof(Item));
+    size_t sum = 0;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        Item item = { i + 1, 1.0 };
+
+        ETCValueArrayAdd(array, &item);
+        if (ETCValueArrayCount(array) > count / 2)
+        {
+            ETCValueArrayRemoveFirstElement(array, &item);
+            sum += item.identifier;
+        }
+    }
+    ETCValueArrayFree(array);
+    return sum;
+}
+
+/**
+ * Returns the best time of aFunction over the given number of runs.
+ */
+static double measure(BenchmarkFunction aFunction, size_t count, int runs)
+{
+    double best = 0;
+
+    for (int i=0 ; i<runs ; i++)
+    {
+        double begin = now();
+        volatile size_t result = aFunction(count);
+        double elapsed = now() - begin;
+
+        (void)result;
+        best = (0 == i || elapsed < best) ? elapsed : best;
+    }
+    return best;
+}
+
+int main(int argc, char **argv)
+{
+    size_t count = (argc > 1) ? strtoul(argv[1], NULL, 10) : 100000;
+    int runs = (argc > 2) ? atoi(argv[2]) : 5;
+
+    double contiguousQueue = measure(runContiguousQueue, count, runs);
+    double queue = measure(runQueue, count, runs);
+
+    printf("%lu elements, best of %d runs\n", (unsigned long)count, runs);
+    printf("memmove queue            %8.2f ms\n", contiguousQueue * 1e3);
+    printf("ETCArray queue           %8.2f ms  (%.1fx)\n",
+           queue * 1e3, contiguousQueue / queue);
+    printf("ETCArray stack (x10)     %8.2f ms\n", measure(runStack, count, runs) * 1e3);
+    printf("ETCArray random (x10)    %8.2f ms\n", measure(runRandomAccess, count, runs) * 1e3);
+    printf("ETCArray bulk append     %8.2f ms\n", measure(runBulkAppend, count, runs) * 1e3);
+    printf("ETCArray middle edits    %8.2f ms\n", measure(runMiddleEdits, count, runs) * 1e3);
+    printf("ETCValueArray queue      %8.2f ms\n", measure(runValueQueue, count, runs) * 1e3);
+    return 0;
+}
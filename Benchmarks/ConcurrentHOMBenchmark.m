@@ -0,0 +1,137 @@
+/*
+    ConcurrentHOMBenchmark.m
+
+    Copyright (C) 2026 The Etoile Project
+
+    Date:  October 2026
+    License:  Modified BSD (see COPYING)
+ */
+
+#import <Foundation/Foundation.h>
+#import <EtoileFoundation/EtoileFoundation.h>
+#include <math.h>
+#include <stdlib.h>
+
+/*
+ * Measures how the concurrent higher-order methods scale from 1 to N threads.
+ *
+ * An array of numbers is mapped, filtered and reduced with blocks doing a
+ * configurable amount of arithmetic per element, with the thread count set by
+ * ETSetConcurrentHOMThreadCount() doubling from 1 up to the maximum.  The
+ * benchmark reports the best time of each operation and its speedup over one
+ * thread.
+ *
+ * Build it with "make benchmark=yes" in EtoileFoundation, then run:
+ *
+ *     ConcurrentHOMBenchmark [max threads] [elements] [work per element] [runs]
+ *
+ * The defaults are the number of processors, 1000000 elements, 100 iterations
+ * of work per element and 5 runs.
+ */
+
+static NSUInteger work;
+
+static double now(void)
+{
+    return [NSDate timeIntervalSinceReferenceDate];
+}
+
+static double compute(double value)
+{
+    for (NSUInteger i=0 ; i<work ; i++)
+    {
+        value = sqrt(value + i);
+    }
+    return value;
+}
+
+typedef void (^BenchmarkBlock)(NSArray *);
+
+/**
+ * Returns the best time of aBlock over the given number of runs.
+ */
+static double measure(BenchmarkBlock aBlock, NSArray *numbers, int runs)
+{
+    double best = 0;
+
+    for (int i=0 ; i<runs ; i++)
+    {
+        NSAutoreleasePool *pool = [NSAutoreleasePool new];
+        double begin = now();
+        aBlock(numbers);
+        double elapsed = now() - begin;
+
+        best = (0 == i || elapsed < best) ? elapsed : best;
+        [pool release];
+    }
+    return best;
+}
+
+int main(int argc, char **argv)
+{
+    NSAutoreleasePool *pool = [NSAutoreleasePool new];
+    NSUInteger maxThreads = (argc > 1) ? strtoul(argv[1], NULL, 10)
+        : [[NSProcessInfo processInfo] activeProcessorCount];
+    NSUInteger count = (argc > 2) ? strtoul(argv[2], NULL, 10) : 1000000;
+    int runs = (argc > 4) ? atoi(argv[4]) : 5;
+    NSMutableArray *numbers = [NSMutableArray arrayWithCapacity: count];
+
+    work = (argc > 3) ? strtoul(argv[3], NULL, 10) : 100;
+    for (NSUInteger i=0 ; i<count ; i++)
+    {
+        [numbers addObject: [NSNumber numberWithDouble: i]];
+    }
+
+    BenchmarkBlock map = ^(NSArray *objects)
+    {
+        [objects concurrentMappedCollectionWithBlock: ^(id number)
+        {
+            return (id)[NSNumber numberWithDouble: compute([number doubleValue])];
+        }];
+    };
+    BenchmarkBlock filter = ^(NSArray *objects)
+    {
+        [objects concurrentFilteredCollectionWithBlock: ^(id number)
+        {
+            return (BOOL)(compute([number doubleValue]) > 10);
+        }];
+    };
+    id (^sum)(id, id) = ^(id x, id y)
+    {
+        return (id)[NSNumber numberWithDouble: [x doubleValue] + compute([y doubleValue])];
+    };
+    id (^combine)(id, id) = ^(id x, id y)
+    {
+        return (id)[NSNumber numberWithDouble: [x doubleValue] + [y doubleValue]];
+    };
+    BenchmarkBlock reduce = ^(NSArray *objects)
+    {
+        [objects reduceWithInitialValue: [NSNumber numberWithDouble: 0]
+                              intoBlock: sum
+                               combiner: combine];
+    };
+
+    printf("%lu elements, %lu iterations per element, best of %d runs\n",
+           (unsigned long)count, (unsigned long)work, runs);
+    printf("threads        map (ms)          filter (ms)          reduce (ms)\n");
+
+    double baseline[3] = { 0, 0, 0 };
+    for (NSUInteger threads=1 ; threads<=maxThreads ; threads*=2)
+    {
+        ETSetConcurrentHOMThreadCount(threads);
+
+        double times[3] = { measure(map, numbers, runs),
+                            measure(filter, numbers, runs),
+                            measure(reduce, numbers, runs) };
+
+        printf("%7lu", (unsigned long)threads);
+        for (int i=0 ; i<3 ; i++)
+        {
+            baseline[i] = (1 == threads) ? times[i] : baseline[i];
+            printf("  %9.1f (%4.1fx)", times[i] * 1e3, baseline[i] / times[i]);
+        }
+        printf("\n");
+    }
+    [pool release];
+    return 0;
+}
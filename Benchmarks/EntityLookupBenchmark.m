@@ -0,0 +1,207 @@
+/*
+    EntityLookupBenchmark.m
+
+    Copyright (C) 2026 The Etoile Project
+
+    Date:  October 2026
+    License:  Modified BSD (see COPYING)
+ */
+
+#import <Foundation/Foundation.h>
+#import <EtoileFoundation/EtoileFoundation.h>
+#include <objc/runtime.h>
+#include <pthread.h>
+#include <stdlib.h>
+
+/*
+ * Measures -entityDescriptionForClass: on deep class hierarchies.
+ *
+ * The benchmark creates chains of classes at runtime, none of them bound to an
+ * entity description, so each class inherits the NSObject entity description.
+ * It compares the superclass walk through an NSMapTable, which is what the
+ * model description repository used to do on every lookup, to the repository
+ * lookups once resolved, and right after the resolved lookups have been
+ * discarded.  The resolved lookups are also measured from several threads at
+ * the same time.
+ *
+ * Build it with "make benchmark=yes" in EtoileFoundation, then run:
+ *
+ *     EntityLookupBenchmark [depth] [chains] [threads] [runs]
+ *
+ * The defaults are a depth of 32 classes, 16 chains, 4 threads and 5 runs,
+ * the best run being reported.  Each run looks up every class 1000 times.
+ */
+
+#define LOOKUPS_PER_CLASS 1000
+
+static ETModelDescriptionRepository *repo = nil;
+static NSMapTable *entityDescriptionsByClass = nil;
+static Class *classes = NULL;
+static NSUInteger classCount = 0;
+
+static double now(void)
+{
+    return [NSDate timeIntervalSinceReferenceDate];
+}
+
+typedef NSUInteger (*BenchmarkFunction)(void);
+
+static Class *makeClassChains(NSUInteger depth, NSUInteger chains)
+{
+    Class *newClasses = malloc(depth * chains * sizeof(Class));
+
+    for (NSUInteger i = 0; i < chains; i++)
+    {
+        Class superclass = [NSObject class];
+
+        for (NSUInteger j = 0; j < depth; j++)
+        {
+            const char *name = [[NSString stringWithFormat:
+                @"EntityLookupBenchmark_%lu_%lu", (unsigned long)i, (unsigned long)j] UTF8String];
+            Class cls = objc_allocateClassPair(superclass, name, 0);
+
+            objc_registerClassPair(cls);
+            newClasses[i * depth + j] = cls;
+            superclass = cls;
+        }
+    }
+    return newClasses;
+}
+
+static ETEntityDescription *walkedEntityDescriptionForClass(Class aClass)
+{
+    for (Class cls = aClass; cls != Nil; cls = class_getSuperclass(cls))
+    {
+        ETEntityDescription *entityDesc = [entityDescriptionsByClass objectForKey: cls];
+
+        if (entityDesc != nil)
+            return entityDesc;
+    }
+    return nil;
+}
+
+static NSUInteger runWalkedLookup(void)
+{
+    NSUInteger found = 0;
+
+    for (int round = 0; round < LOOKUPS_PER_CLASS; round++)
+    {
+        for (NSUInteger i = 0; i < classCount; i++)
+        {
+            found += (walkedEntityDescriptionForClass(classes[i]) != nil);
+        }
+    }
+    return found;
+}
+
+static NSUInteger runResolvedLookup(void)
+{
+    NSUInteger found = 0;
+
+    for (int round = 0; round < LOOKUPS_PER_CLASS; round++)
+    {
+        for (NSUInteger i = 0; i < classCount; i++)
+        {
+            found += ([repo entityDescriptionForClass: classes[i]] != nil);
+        }
+    }
+    return found;
+}
+
+/* Adding a description discards the resolved lookups, so each class lookup
+   in the first round walks the superclass chain */
+static NSUInteger runDiscardedLookup(void)
+{
+    ETPackageDescription *package =
+        [ETPackageDescription descriptionWithName: @"EntityLookupBenchmark"];
+
+    [repo addDescription: package];
+    [repo removeDescription: package];
+    return runResolvedLookup();
+}
+
+static void *resolvedLookupThread(void *unused)
+{
+    NSAutoreleasePool *pool = [NSAutoreleasePool new];
+
+    runResolvedLookup();
+    [pool release];
+    return NULL;
+}
+
+static int threadCount = 4;
+
+static NSUInteger runConcurrentResolvedLookup(void)
+{
+    pthread_t threads[threadCount];
+
+    for (int i = 0; i < threadCount; i++)
+    {
+        pthread_create(&threads[i], NULL, resolvedLookupThread, NULL);
+    }
+    for (int i = 0; i < threadCount; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+    return classCount * threadCount;
+}
+
+/**
+ * Returns the best time of aFunction over the given number of runs.
+ */
+static double measure(BenchmarkFunction aFunction, int runs)
+{
+    double best = 0;
+
+    for (int i=0 ; i<runs ; i++)
+    {
+        NSAutoreleasePool *pool = [NSAutoreleasePool new];
+        double begin = now();
+        aFunction();
+        double elapsed = now() - begin;
+
+        best = (0 == i || elapsed < best) ? elapsed : best;
+        [pool release];
+    }
+    return best;
+}
+
+static void printResult(const char *label, double elapsed, double reference)
+{
+    printf("%-32s %8.1f ms  (%.1fx)\n", label, elapsed * 1e3, reference / elapsed);
+}
+
+int main(int argc, char **argv)
+{
+    NSAutoreleasePool *pool = [NSAutoreleasePool new];
+    NSUInteger depth = (argc > 1) ? strtoul(argv[1], NULL, 10) : 32;
+    NSUInteger chains = (argc > 2) ? strtoul(argv[2], NULL, 10) : 16;
+    int runs = (argc > 4) ? atoi(argv[4]) : 5;
+
+    threadCount = (argc > 3) ? atoi(argv[3]) : 4;
+    repo = [[ETModelDescriptionRepository alloc] init];
+    classes = makeClassChains(depth, chains);
+    classCount = depth * chains;
+    entityDescriptionsByClass = [[NSMapTable alloc] initWithKeyOptions:
+        NSPointerFunctionsOpaqueMemory | NSPointerFunctionsOpaquePersonality
+                                                          valueOptions: NSPointerFunctionsStrongMemory
+                                                              capacity: 1];
+    [entityDescriptionsByClass setObject: [repo entityDescriptionForClass: [NSObject class]]
+                                  forKey: [NSObject class]];
+
+    double walkedLookup = measure(runWalkedLookup, runs);
+
+    printf("%lu classes (depth %lu), %d lookups per class, best of %d runs\n",
+        (unsigned long)classCount, (unsigned long)depth, LOOKUPS_PER_CLASS, runs);
+    printResult("NSMapTable superclass walk", walkedLookup, walkedLookup);
+    printResult("Repository after invalidation", measure(runDiscardedLookup, runs), walkedLookup);
+    printResult("Repository resolved", measure(runResolvedLookup, runs), walkedLookup);
+    printf("Repository resolved (%d threads) %8.1f ms\n", threadCount,
+        measure(runConcurrentResolvedLookup, runs) * 1e3);
+
+    free(classes);
+    [entityDescriptionsByClass release];
+    [repo release];
+    [pool release];
+    return 0;
+}
@@ -0,0 +1,120 @@
+/*
+    EscapingBenchmark.m
+
+    Copyright (C) 2026 The Etoile Project
+
+    Date:  October 2026
+    License:  Modified BSD (see COPYING)
+ */
+
+#import <Foundation/Foundation.h>
+#import <EtoileXML/ETXMLParserDelegate.h>
+
+/*
+ * Micro-benchmark comparing escapeXMLCData() and unescapeXMLCData() with the
+ * previous implementations, which ran one -replaceOccurrencesOfString: pass
+ * per entity.
+ *
+ * Build it with "make benchmark=yes" in EtoileFoundation, then run it without
+ * arguments.  An optional argument sets the number of iterations.
+ */
+
+static NSMutableString * legacyEscapeXMLCData(NSString *_XMLString)
+{
+    NSMutableString * XMLString = [NSMutableString stringWithString:_XMLString];
+    [XMLString replaceOccurrencesOfString:@"&" withString:@"&amp;" options:0 range:NSMakeRange(0,[XMLString length])];
+    [XMLString replaceOccurrencesOfString:@"<" withString:@"&lt;" options:0 range:NSMakeRange(0,[XMLString length])];
+    [XMLString replaceOccurrencesOfString:@">" withString:@"&gt;" options:0 range:NSMakeRange(0,[XMLString length])];
+    [XMLString replaceOccurrencesOfString:@"'" withString:@"&apos;" options:0 range:NSMakeRange(0,[XMLString length])];
+    [XMLString replaceOccurrencesOfString:@"\"" withString:@"&quot;" options:0 range:NSMakeRange(0,[XMLString length])];
+    return XMLString;
+}
+
+static NSMutableString * legacyUnescapeXMLCData(NSString *_XMLString)
+{
+    NSMutableString * XMLString = [NSMutableString stringWithString:_XMLString];
+    [XMLString replaceOccurrencesOfString:@"&lt;" withString:@"<" options:0 range:NSMakeRange(0,[XMLString length])];
+    [XMLString replaceOccurrencesOfString:@"&gt;" withString:@">" options:0 range:NSMakeRange(0,[XMLString length])];
+    [XMLString replaceOccurrencesOfString:@"&amp;" withString:@"&" options:0 range:NSMakeRange(0,[XMLString length])];
+    [XMLString replaceOccurrencesOfString:@"&apos;" withString:@"'" options:0 range:NSMakeRange(0,[XMLString length])];
+    [XMLString replaceOccurrencesOfString:@"&quot;" withString:@"\"" options:0 range:NSMakeRange(0,[XMLString length])];
+    return XMLString;
+}
+
+typedef NSString *(*ETEscapingFunction)(NSString *);
+
+static NSString *newEscape(NSString *aString) { return escapeXMLCData(aString); }
+static NSString *newUnescape(NSString *aString) { return unescapeXMLCData(aString); }
+static NSString *oldEscape(NSString *aString) { return legacyEscapeXMLCData(aString); }
+static NSString *oldUnescape(NSString *aString) { return legacyUnescapeXMLCData(aString); }
+
+/**
+ * Returns a payload of roughly aLength characters, built by repeating aChunk.
+ */
+static NSString *payload(NSString *aChunk, NSUInteger aLength)
+{
+    NSMutableString *str = [NSMutableString string];
+    while ([str length] < aLength)
+    {
+        [str appendString: aChunk];
+    }
+    return str;
+}
+
+static void measure(NSString *aLabel, ETEscapingFunction oldFunction,
+                    ETEscapingFunction newFunction, NSString *input,
+                    unsigned int iterations)
+{
+    NSCAssert([oldFunction(input) isEqualToString: newFunction(input)],
+              @"Escaping results differ");
+
+    NSTimeInterval times[2];
+    ETEscapingFunction functions[2] = { oldFunction, newFunction };
+
+    for (int f=0 ; f<2 ; f++)
+    {
+        NSDate *start = [NSDate date];
+        for (unsigned int i=0 ; i<iterations ; i++)
+        {
+            NSAutoreleasePool *pool = [NSAutoreleasePool new];
+            functions[f](input);
+            [pool release];
+        }
+        times[f] = -[start timeIntervalSinceNow];
+    }
+    double megabytes = (double)[input length] * iterations / (1024 * 1024);
+    printf("%-32s old %8.1f MB/s   new %8.1f MB/s   speedup %5.1fx\n",
+           [aLabel UTF8String], megabytes / times[0], megabytes / times[1],
+           times[0] / times[1]);
+}
+
+int main(int argc, char **argv)
+{
+    [NSAutoreleasePool new];
+    unsigned int iterations = (argc > 1) ? atoi(argv[1]) : 2000;
+
+    // Message bodies with the odd quote or ampersand.
+    NSString *text = payload(@"The quick brown fox jumps over the lazy dog, "
+                              "doesn't it?  Fish & chips for everyone.  ", 16384);
+    // Plain text that needs no escaping at all.
+    NSString *plain = payload(@"Lorem ipsum dolor sit amet, consectetur "
+                               "adipiscing elit, sed do eiusmod tempor.  ", 16384);
+    // Serialised markup embedded as text.
+    NSString *markup = payload(@"<message to=\"juliet@example.com\" type='chat'>"
+                                "<body>a &lt; b</body></message>", 16384);
+    // Short attribute values, as found in most stanzas.
+    NSString *attribute = @"romeo@example.net/orchard";
+
+    measure(@"escape text-heavy", oldEscape, newEscape, text, iterations);
+    measure(@"escape plain text", oldEscape, newEscape, plain, iterations);
+    measure(@"escape markup-heavy", oldEscape, newEscape, markup, iterations);
+    measure(@"escape attribute", oldEscape, newEscape, attribute, iterations * 500);
+    measure(@"unescape text-heavy", oldUnescape, newUnescape,
+            legacyEscapeXMLCData(text), iterations);
+    measure(@"unescape plain text", oldUnescape, newUnescape, plain, iterations);
+    measure(@"unescape markup-heavy", oldUnescape, newUnescape,
+            legacyEscapeXMLCData(markup), iterations);
+    measure(@"unescape attribute", oldUnescape, newUnescape, attribute,
+            iterations * 500);
+    return 0;
+}
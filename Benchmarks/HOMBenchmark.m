@@ -0,0 +1,173 @@
+/*
+    HOMBenchmark.m
+
+    Copyright (C) 2026 The Etoile Project
+
+    Date:  October 2026
+    License:  Modified BSD (see COPYING)
+ */
+
+#import <Foundation/Foundation.h>
+#import <EtoileFoundation/EtoileFoundation.h>
+#include <stdlib.h>
+
+/*
+ * Measures higher-order messaging over large arrays.
+ *
+ * The benchmark compares mapping -name over an array with an NSInvocation
+ * invoked per element, which is what the HOM proxies used to do, to
+ * -mappedCollection and -filter, which call the method IMP through a compiled
+ * plan.  It also maps an array mixing two classes, whose
+ * elements switch between plans.
+ *
+ * Build it with "make benchmark=yes" in EtoileFoundation, then run:
+ *
+ *     HOMBenchmark [elements] [runs]
+ *
+ * The defaults are 1000000 elements and 5 runs, the best run being reported.
+ */
+
+@interface Person : NSObject
+{
+    NSString *name;
+    BOOL adult;
+}
+- (id) initWithName: (NSString *)aName adult: (BOOL)isAdult;
+- (NSString *) name;
+- (BOOL) isAdult;
+@end
+
+@implementation Person
+- (id) initWithName: (NSString *)aName adult: (BOOL)isAdult
+{
+    SUPERINIT;
+    name = [aName copy];
+    adult = isAdult;
+    return self;
+}
+- (void) dealloc
+{
+    [name release];
+    [super dealloc];
+}
+- (NSString *) name
+{
+    return name;
+}
+- (BOOL) isAdult
+{
+    return adult;
+}
+@end
+
+@interface Pet : Person
+@end
+
+@implementation Pet
+- (NSString *) name
+{
+    return @"Rex";
+}
+@end
+
+static double now(void)
+{
+    return [NSDate timeIntervalSinceReferenceDate];
+}
+
+static NSArray *invocationMap(NSArray *objects)
+{
+    NSMutableArray *result = [NSMutableArray arrayWithCapacity: [objects count]];
+    NSInvocation *inv = [NSInvocation invocationWithMethodSignature:
+        [Person instanceMethodSignatureForSelector: @selector(name)]];
+
+    [inv setSelector: @selector(name)];
+    for (id object in objects)
+    {
+        id mapped = nil;
+
+        [inv invokeWithTarget: object];
+        [inv getReturnValue: &mapped];
+        [result addObject: mapped];
+    }
+    return result;
+}
+
+typedef NSUInteger (*BenchmarkFunction)(NSArray *);
+
+static NSUInteger runInvocationMap(NSArray *objects)
+{
+    return [invocationMap(objects) count];
+}
+
+static NSUInteger runMappedCollection(NSArray *objects)
+{
+    return [(NSArray *)[[objects mappedCollection] name] count];
+}
+
+static NSUInteger runFilter(NSArray *objects)
+{
+    NSMutableArray *copy = [[objects mutableCopy] autorelease];
+
+    [[copy filter] isAdult];
+    return [copy count];
+}
+
+/**
+ * Returns the best time of aFunction over the given number of runs.
+ */
+static double measure(BenchmarkFunction aFunction, NSArray *objects, int runs)
+{
+    double best = 0;
+
+    for (int i=0 ; i<runs ; i++)
+    {
+        NSAutoreleasePool *pool = [NSAutoreleasePool new];
+        double begin = now();
+        aFunction(objects);
+        double elapsed = now() - begin;
+
+        best = (0 == i || elapsed < best) ? elapsed : best;
+        [pool release];
+    }
+    return best;
+}
+
+static NSArray *makeObjects(NSUInteger count, BOOL mixed)
+{
+    NSMutableArray *objects = [NSMutableArray arrayWithCapacity: count];
+
+    for (NSUInteger i=0 ; i<count ; i++)
+    {
+        Class class = (mixed && i % 2) ? [Pet class] : [Person class];
+        Person *object = [[class alloc] initWithName: @"John" adult: i % 3 != 0];
+
+        [objects addObject: object];
+        [object release];
+    }
+    return objects;
+}
+
+int main(int argc, char **argv)
+{
+    NSAutoreleasePool *pool = [NSAutoreleasePool new];
+    NSUInteger count = (argc > 1) ? strtoul(argv[1], NULL, 10) : 1000000;
+    int runs = (argc > 2) ? atoi(argv[2]) : 5;
+    NSArray *people = makeObjects(count, NO);
+    NSArray *mixed = makeObjects(count, YES);
+
+    double invocation = measure(runInvocationMap, people, runs);
+    double mapped = measure(runMappedCollection, people, runs);
+    double mappedMixed = measure(runMappedCollection, mixed, runs);
+    double filtered = measure(runFilter, people, runs);
+
+    printf("%lu elements, best of %d runs\n", (unsigned long)count, runs);
+    printf("NSInvocation per element   %8.1f ms\n", invocation * 1e3);
+    printf("-mappedCollection          %8.1f ms  (%.1fx)\n",
+           mapped * 1e3, invocation / mapped);
+    printf("-mappedCollection (mixed)  %8.1f ms  (%.1fx)\n",
+           mappedMixed * 1e3, invocation / mappedMixed);
+    printf("-filter (on a copy)        %8.1f ms\n", filtered * 1e3);
+    [pool release];
+    return 0;
+}
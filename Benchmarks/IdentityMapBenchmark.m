@@ -0,0 +1,246 @@
+/*
+    IdentityMapBenchmark.m
+
+    Copyright (C) 2026 The Etoile Project
+
+    Date:  October 2026
+    License:  Modified BSD (see COPYING)
+ */
+
+#import <Foundation/Foundation.h>
+#import <EtoileFoundation/EtoileFoundation.h>
+#include <stdlib.h>
+
+/*
+ * Measures pointer-keyed lookups, insertions and iterations.
+ *
+ * The benchmark compares an NSMapTable with opaque keys and object values,
+ * which is what the stack trace recorder, the trait registry and the model
+ * description repository used to do, to ETIdentityMap and to the
+ * ETCIdentityMap C API it wraps.  Lookups are done in a shuffled order, so
+ * they don't follow the insertion order.
+ *
+ * Build it with "make benchmark=yes" in EtoileFoundation, then run:
+ *
+ *     IdentityMapBenchmark [keys] [runs]
+ *
+ * The defaults are 1000000 keys and 5 runs, the best run being reported.
+ */
+
+static double now(void)
+{
+    return [NSDate timeIntervalSinceReferenceDate];
+}
+
+typedef NSUInteger (*BenchmarkFunction)(NSArray *);
+
+static NSMapTable *newMapTable(NSUInteger capacity)
+{
+    NSPointerFunctions *keyFuncs = [NSPointerFunctions pointerFunctionsWithOptions:
+        NSPointerFunctionsOpaqueMemory | NSPointerFunctionsOpaquePersonality];
+    NSPointerFunctions *valueFuncs = [NSPointerFunctions pointerFunctionsWithOptions:
+        NSPointerFunctionsStrongMemory | NSPointerFunctionsObjectPersonality];
+
+    return [[NSMapTable alloc] initWithKeyPointerFunctions: keyFuncs
+                                     valuePointerFunctions: valueFuncs
+                                                  capacity: capacity];
+}
+
+static NSMapTable *mapTable = nil;
+static ETIdentityMap *identityMap = nil;
+static ETCIdentityMap cIdentityMap = NULL;
+
+static NSUInteger runMapTableInsert(NSArray *keys)
+{
+    NSMapTable *map = newMapTable(0);
+
+    for (id key in keys)
+    {
+        [map setObject: key forKey: key];
+    }
+    [map release];
+    return [keys count];
+}
+
+static NSUInteger runIdentityMapInsert(NSArray *keys)
+{
+    ETIdentityMap *map = [[ETIdentityMap alloc] init];
+
+    for (id key in keys)
+    {
+        [map setObject: key forKey: key];
+    }
+    [map release];
+    return [keys count];
+}
+
+static NSUInteger runCIdentityMapInsert(NSArray *keys)
+{
+    ETCIdentityMap map = ETCIdentityMapNew();
+
+    for (id key in keys)
+    {
+        ETCIdentityMapSet(map, key, key);
+    }
+    ETCIdentityMapFree(map);
+    return [keys count];
+}
+
+static NSUInteger runMapTableLookup(NSArray *keys)
+{
+    NSUInteger found = 0;
+
+    for (id key in keys)
+    {
+        found += ([mapTable objectForKey: key] != nil);
+    }
+    return found;
+}
+
+static NSUInteger runIdentityMapLookup(NSArray *keys)
+{
+    NSUInteger found = 0;
+
+    for (id key in keys)
+    {
+        found += ([identityMap objectForKey: key] != nil);
+    }
+    return found;
+}
+
+static NSUInteger runCIdentityMapLookup(NSArray *keys)
+{
+    NSUInteger found = 0;
+
+    for (id key in keys)
+    {
+        found += (ETCIdentityMapGet(cIdentityMap, key) != NULL);
+    }
+    return found;
+}
+
+static NSUInteger runMapTableIteration(NSArray *keys)
+{
+    NSUInteger found = 0;
+
+    for (id value in [mapTable objectEnumerator])
+    {
+        found++;
+    }
+    return found;
+}
+
+static NSUInteger runIdentityMapIteration(NSArray *keys)
+{
+    NSUInteger found = 0;
+
+    for (id value in identityMap)
+    {
+        found++;
+    }
+    return found;
+}
+
+static NSUInteger runCIdentityMapIteration(NSArray *keys)
+{
+    NSUInteger found = 0;
+    size_t cursor = 0;
+    void *value = NULL;
+
+    while (ETCIdentityMapNextEntry(cIdentityMap, &cursor, NULL, &value))
+    {
+        found++;
+    }
+    return found;
+}
+
+/**
+ * Returns the best time of aFunction over the given number of runs.
+ */
+static double measure(BenchmarkFunction aFunction, NSArray *keys, int runs)
+{
+    double best = 0;
+
+    for (int i=0 ; i<runs ; i++)
+    {
+        NSAutoreleasePool *pool = [NSAutoreleasePool new];
+        double begin = now();
+        aFunction(keys);
+        double elapsed = now() - begin;
+
+        best = (0 == i || elapsed < best) ? elapsed : best;
+        [pool release];
+    }
+    return best;
+}
+
+static NSArray *makeKeys(NSUInteger count)
+{
+    NSMutableArray *keys = [NSMutableArray arrayWithCapacity: count];
+
+    for (NSUInteger i=0 ; i<count ; i++)
+    {
+        NSObject *key = [[NSObject alloc] init];
+
+        [keys addObject: key];
+        [key release];
+    }
+    return keys;
+}
+
+static NSArray *shuffledKeys(NSArray *keys)
+{
+    NSMutableArray *shuffled = [NSMutableArray arrayWithArray: keys];
+
+    srandom(1);
+    for (NSUInteger i=[shuffled count] ; i>1 ; i--)
+    {
+        [shuffled exchangeObjectAtIndex: i - 1 withObjectAtIndex: random() % i];
+    }
+    return shuffled;
+}
+
+static void printResult(const char *label, double elapsed, double reference)
+{
+    printf("%-24s %8.1f ms  (%.1fx)\n", label, elapsed * 1e3, reference / elapsed);
+}
+
+int main(int argc, char **argv)
+{
+    NSAutoreleasePool *pool = [NSAutoreleasePool new];
+    NSUInteger count = (argc > 1) ? strtoul(argv[1], NULL, 10) : 1000000;
+    int runs = (argc > 2) ? atoi(argv[2]) : 5;
+    NSArray *keys = makeKeys(count);
+    NSArray *lookedUpKeys = shuffledKeys(keys);
+
+    mapTable = newMapTable(count);
+    identityMap = [[ETIdentityMap alloc] initWithCapacity: count retainsObjects: YES];
+    cIdentityMap = ETCIdentityMapNewWithInitialSize(count);
+    for (id key in keys)
+    {
+        [mapTable setObject: key forKey: key];
+        [identityMap setObject: key forKey: key];
+        ETCIdentityMapSet(cIdentityMap, key, key);
+    }
+
+    double mapTableInsert = measure(runMapTableInsert, keys, runs);
+    double mapTableLookup = measure(runMapTableLookup, lookedUpKeys, runs);
+    double mapTableIteration = measure(runMapTableIteration, keys, runs);
+
+    printf("%lu keys, best of %d runs\n", (unsigned long)count, runs);
+    printResult("NSMapTable insert", mapTableInsert, mapTableInsert);
+    printResult("ETIdentityMap insert", measure(runIdentityMapInsert, keys, runs), mapTableInsert);
+    printResult("ETCIdentityMap insert", measure(runCIdentityMapInsert, keys, runs), mapTableInsert);
+    printResult("NSMapTable lookup", mapTableLookup, mapTableLookup);
+    printResult("ETIdentityMap lookup", measure(runIdentityMapLookup, lookedUpKeys, runs), mapTableLookup);
+    printResult("ETCIdentityMap lookup", measure(runCIdentityMapLookup, lookedUpKeys, runs), mapTableLookup);
+    printResult("NSMapTable iteration", mapTableIteration, mapTableIteration);
+    printResult("ETIdentityMap iteration", measure(runIdentityMapIteration, keys, runs), mapTableIteration);
+    printResult("ETCIdentityMap iteration", measure(runCIdentityMapIteration, keys, runs), mapTableIteration);
+
+    [mapTable release];
+    [identityMap release];
+    ETCIdentityMapFree(cIdentityMap);
+    [pool release];
+    return 0;
+}
@@ -0,0 +1,155 @@
+/*
+    RepositoryStartupBenchmark.m
+
+    Copyright (C) 2026 The Etoile Project
+
+    Date:  October 2026
+    License:  Modified BSD (see COPYING)
+ */
+
+#import <Foundation/Foundation.h>
+#import <EtoileFoundation/EtoileFoundation.h>
+#include <stdlib.h>
+
+/*
+ * Measures how long it takes to set up a model description repository.
+ *
+ * The benchmark collects the entity descriptions for a root class and all its
+ * subclasses in three ways:
+ *
+ * - eagerly, as -collectEntityDescriptionsFromClass:excludedClasses:resolveNow:
+ *   always did, which creates and resolves every entity description upfront
+ * - lazily, then looking up the entity descriptions for a few classes, as an
+ *   application does at launch
+ * - by loading a snapshot written by the eager repository
+ *
+ * The startup statistics are printed for a repository built in each way.
+ *
+ * Build it with "make benchmark=yes" in EtoileFoundation, then run:
+ *
+ *     RepositoryStartupBenchmark [rootClass] [lookups] [runs]
+ *
+ * The defaults are NSObject as the root class, 50 class lookups and 5 runs,
+ * the best run being reported.
+ */
+
+static Class rootClass = Nil;
+static NSArray *lookedUpClasses = nil;
+static NSString *snapshotPath = nil;
+static ETModelDescriptionRepository *lastRepo = nil;
+
+static double now(void)
+{
+    return [NSDate timeIntervalSinceReferenceDate];
+}
+
+typedef void (*BenchmarkFunction)(void);
+
+static ETModelDescriptionRepository *newRepository(void)
+{
+    ASSIGN(lastRepo, AUTORELEASE([[ETModelDescriptionRepository alloc] init]));
+    return lastRepo;
+}
+
+static void runEagerCollection(void)
+{
+    [newRepository() collectEntityDescriptionsFromClass: rootClass
+                                        excludedClasses: [NSSet set]
+                                             resolveNow: YES];
+}
+
+static void runLazyCollection(void)
+{
+    ETModelDescriptionRepository *repo = newRepository();
+
+    [repo setRegistersEntityDescriptionsLazily: YES];
+    [repo collectEntityDescriptionsFromClass: rootClass
+                             excludedClasses: [NSSet set]
+                                  resolveNow: YES];
+
+    for (Class class in lookedUpClasses)
+    {
+        [repo entityDescriptionForClass: class];
+    }
+}
+
+static void runSnapshotLoad(void)
+{
+    if ([newRepository() loadSnapshotFromFile: snapshotPath] == NO)
+    {
+        fprintf(stderr, "Failed to load the snapshot %s\n", [snapshotPath UTF8String]);
+        exit(1);
+    }
+}
+
+/**
+ * Returns the best time of aFunction over the given number of runs.
+ */
+static double measure(BenchmarkFunction aFunction, int runs)
+{
+    double best = 0;
+
+    for (int i=0 ; i<runs ; i++)
+    {
+        NSAutoreleasePool *pool = [NSAutoreleasePool new];
+        double begin = now();
+        aFunction();
+        double elapsed = now() - begin;
+
+        best = (0 == i || elapsed < best) ? elapsed : best;
+        [pool release];
+    }
+    return best;
+}
+
+static void printResult(const char *label, double elapsed, double reference)
+{
+    NSDictionary *statistics = [lastRepo startupStatistics];
+
+    printf("%-24s %8.1f ms  (%.1fx)\n", label, elapsed * 1e3, reference / elapsed);
+    printf("    created %d, creation %.1f ms, resolution %.1f ms, "
+           "from snapshot %d, pending %d\n",
+        [[statistics objectForKey: @"createdEntityDescriptionCount"] intValue],
+        [[statistics objectForKey: @"entityDescriptionCreationTime"] doubleValue] * 1e3,
+        [[statistics objectForKey: @"resolutionTime"] doubleValue] * 1e3,
+        [[statistics objectForKey: @"snapshotEntityDescriptionCount"] intValue],
+        [[statistics objectForKey: @"pendingEntityDescriptionCount"] intValue]);
+}
+
+int main(int argc, char **argv)
+{
+    NSAutoreleasePool *pool = [NSAutoreleasePool new];
+    NSUInteger lookups = (argc > 2) ? strtoul(argv[2], NULL, 10) : 50;
+    int runs = (argc > 3) ? atoi(argv[3]) : 5;
+
+    rootClass = NSClassFromString((argc > 1) ? [NSString stringWithUTF8String: argv[1]] : @"NSObject");
+    if (rootClass == Nil)
+    {
+        fprintf(stderr, "Unknown root class %s\n", argv[1]);
+        return 1;
+    }
+
+    NSArray *subclasses = [rootClass allSubclasses];
+
+    lookedUpClasses = [[subclasses subarrayWithRange:
+        NSMakeRange(0, MIN(lookups, [subclasses count]))] retain];
+    snapshotPath = [[NSTemporaryDirectory()
+        stringByAppendingPathComponent: @"RepositoryStartupBenchmark.snapshot"] retain];
+
+    double eagerCollection = measure(runEagerCollection, runs);
+
+    [lastRepo writeSnapshotToFile: snapshotPath];
+
+    printf("%lu classes, %lu lookups, best of %d runs\n", (unsigned long)[subclasses count] + 1,
+        (unsigned long)[lookedUpClasses count], runs);
+    printResult("Eager collection", eagerCollection, eagerCollection);
+    printResult("Lazy collection", measure(runLazyCollection, runs), eagerCollection);
+    printResult("Snapshot load", measure(runSnapshotLoad, runs), eagerCollection);
+
+    [[NSFileManager defaultManager] removeItemAtPath: snapshotPath error: NULL];
+    [snapshotPath release];
+    [lookedUpClasses release];
+    DESTROY(lastRepo);
+    [pool release];
+    return 0;
+}
@@ -0,0 +1,170 @@
+/*
+    ScalarReturnBenchmark.m
+
+    Copyright (C) 2026 The Etoile Project
+
+    Date:  October 2026
+    License:  Modified BSD (see COPYING)
+ */
+
+#import <Foundation/Foundation.h>
+#import <EtoileThread/NSObject+Threaded.h>
+#include <stdlib.h>
+
+/*
+ * Measures the round trip latency of synchronous calls to a threaded object
+ * method returning an int, from 1 to N concurrent caller threads, for an
+ * object with its own thread and for a pooled one.
+ *
+ * Build it with "make benchmark=yes" in EtoileFoundation, then run:
+ *
+ *     ScalarReturnBenchmark [max callers] [calls per caller]
+ *
+ * The defaults are 4 callers and 100000 calls.
+ */
+
+static double now(void)
+{
+    return [NSDate timeIntervalSinceReferenceDate];
+}
+
+@interface Counter : NSObject
+{
+    int value;
+}
+- (int) increment;
+@end
+
+@implementation Counter
+- (int) increment
+{
+    return ++value;
+}
+@end
+
+/**
+ * Calls -increment repeatedly from a new thread and records the latencies.
+ */
+@interface Caller : NSObject
+{
+    id counter;
+    NSUInteger calls;
+    double *latencies;
+    NSConditionLock *done;
+}
+- (id) initWithCounter: (id)aCounter calls: (NSUInteger)aCount done: (NSConditionLock*)aLock;
+- (void) call: (id)sender;
+- (double*) latencies;
+@end
+
+@implementation Caller
+- (id) initWithCounter: (id)aCounter calls: (NSUInteger)aCount done: (NSConditionLock*)aLock
+{
+    if (nil == (self = [super init]))
+    {
+        return nil;
+    }
+    counter = aCounter;
+    calls = aCount;
+    latencies = malloc(calls * sizeof(double));
+    done = [aLock retain];
+    return self;
+}
+- (void) dealloc
+{
+    free(latencies);
+    [done release];
+    [super dealloc];
+}
+- (void) call: (id)sender
+{
+    NSAutoreleasePool *pool = [NSAutoreleasePool new];
+
+    for (NSUInteger i=0 ; i<calls ; i++)
+    {
+        double start = now();
+        [counter increment];
+        latencies[i] = now() - start;
+        // Forwarding creates an autoreleased invocation for each call.
+        if (i % 1024 == 1023)
+        {
+            [pool release];
+            pool = [NSAutoreleasePool new];
+        }
+    }
+    [done lock];
+    [done unlockWithCondition: [done condition] + 1];
+    [pool release];
+}
+- (double*) latencies
+{
+    return latencies;
+}
+@end
+
+static int compareDoubles(const void *a, const void *b)
+{
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static void run(NSString *aMode, id counter, NSUInteger callerCount, NSUInteger calls)
+{
+    NSConditionLock *done = [[NSConditionLock alloc] initWithCondition: 0];
+    NSMutableArray *callers = [NSMutableArray array];
+    NSUInteger total = callerCount * calls;
+    double *all = malloc(total * sizeof(double));
+
+    double begin = now();
+    for (NSUInteger i=0 ; i<callerCount ; i++)
+    {
+        Caller *caller = [[Caller alloc] initWithCounter: counter 
+                                                   calls: calls
+                                                    done: done];
+        [callers addObject: caller];
+        [NSThread detachNewThreadSelector: @selector(call:)
+                                 toTarget: caller
+                               withObject: nil];
+        [caller release];
+    }
+    [done lockWhenCondition: callerCount];
+    [done unlock];
+    double elapsed = now() - begin;
+
+    for (NSUInteger i=0 ; i<callerCount ; i++)
+    {
+        memcpy(all + i * calls, [[callers objectAtIndex: i] latencies], calls * sizeof(double));
+    }
+    qsort(all, total, sizeof(double), compareDoubles);
+    printf("%-8s %2lu callers  %9.0f calls/s  latency (us): p50 %7.1f  p99 %7.1f  p99.9 %7.1f\n",
+           [aMode UTF8String], (unsigned long)callerCount, total / elapsed,
+           all[total / 2] * 1e6,
+           all[(NSUInteger)(0.99 * (total - 1))] * 1e6,
+           all[(NSUInteger)(0.999 * (total - 1))] * 1e6);
+    free(all);
+    [done release];
+}
+
+int main(int argc, char **argv)
+{
+    NSAutoreleasePool *pool = [NSAutoreleasePool new];
+    NSUInteger maxCallers = (argc > 1) ? strtoul(argv[1], NULL, 10) : 4;
+    NSUInteger calls = (argc > 2) ? strtoul(argv[2], NULL, 10) : 100000;
+
+    id threaded = [Counter threadedNew];
+    id pooled = [Counter pooledNew];
+
+    // Make sure the threads are running before timing.
+    [threaded increment];
+    [pooled increment];
+    for (NSUInteger i=1 ; i<=maxCallers ; i*=2)
+    {
+        NSAutoreleasePool *runPool = [NSAutoreleasePool new];
+        run(@"threaded", threaded, i, calls);
+        run(@"pooled", pooled, i, calls);
+        [runPool release];
+    }
+    [pool release];
+    return 0;
+}
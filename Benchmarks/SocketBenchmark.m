@@ -0,0 +1,238 @@
+/*
+    SocketBenchmark.m
+
+    Copyright (C) 2026 The Etoile Project
+
+    Date:  October 2026
+    License:  Modified BSD (see COPYING)
+ */
+
+#import <Foundation/Foundation.h>
+#import <EtoileFoundation/ETSocket.h>
+#include <stdlib.h>
+
+/*
+ * Loopback benchmark for ETSocket.
+ *
+ * A listening socket echoes everything it receives.  A number of client
+ * connections each send a message, wait for the complete echo, and send the
+ * next one, for a fixed duration.  The benchmark reports the throughput and
+ * the round trip latency percentiles over all messages.
+ *
+ * Build it with "make benchmark=yes" in EtoileFoundation, then run:
+ *
+ *     SocketBenchmark [connections] [message size] [seconds] [port]
+ *
+ * The defaults are 64 connections, 1024 bytes, 5 seconds and port 47321.
+ */
+
+/**
+ * Echoes the data received on the accepted connections.
+ */
+@interface EchoServer : NSObject
+{
+    NSMutableArray *connections;
+}
+@end
+
+@implementation EchoServer
+- (id)init
+{
+    if (nil == (self = [super init]))
+    {
+        return nil;
+    }
+    connections = [NSMutableArray new];
+    return self;
+}
+- (void)dealloc
+{
+    [connections release];
+    [super dealloc];
+}
+- (void)newConnection: (ETSocket*)aSocket
+           fromSocket: (ETSocket*)listenerSocket
+{
+    [connections addObject: aSocket];
+    [aSocket setDelegate: self];
+}
+- (void)receivedData: (NSData*)aData fromSocket: (ETSocket*)aSocket
+{
+    [aSocket sendData: aData];
+}
+@end
+
+/**
+ * Sends messages one at a time and records the round trip latencies.
+ */
+@interface EchoClient : NSObject
+{
+    ETSocket *socket;
+    NSData *message;
+    NSUInteger received;
+    NSTimeInterval sentAt;
+    double *latencies;
+    NSUInteger latencyCount;
+    NSUInteger latencyCapacity;
+}
+- (id)initWithSocket: (ETSocket*)aSocket message: (NSData*)aMessage;
+- (void)start;
+- (double*)latencies;
+- (NSUInteger)latencyCount;
+@end
+
+@implementation EchoClient
+- (id)initWithSocket: (ETSocket*)aSocket message: (NSData*)aMessage
+{
+    if (nil == (self = [super init]))
+    {
+        return nil;
+    }
+    socket = [aSocket retain];
+    message = [aMessage retain];
+    latencyCapacity = 1024;
+    latencies = malloc(latencyCapacity * sizeof(double));
+    [socket setDelegate: self];
+    return self;
+}
+- (void)dealloc
+{
+    [socket setDelegate: nil];
+    [socket release];
+    [message release];
+    free(latencies);
+    [super dealloc];
+}
+- (void)start
+{
+    received = 0;
+    sentAt = [NSDate timeIntervalSinceReferenceDate];
+    [socket sendData: message];
+}
+- (void)receivedData: (NSData*)aData fromSocket: (ETSocket*)aSocket
+{
+    received += [aData length];
+    if (received < [message length])
+    {
+        return;
+    }
+    if (latencyCount == latencyCapacity)
+    {
+        latencyCapacity *= 2;
+        latencies = realloc(latencies, latencyCapacity * sizeof(double));
+    }
+    latencies[latencyCount++] = [NSDate timeIntervalSinceReferenceDate] - sentAt;
+    [self start];
+}
+- (double*)latencies
+{
+    return latencies;
+}
+- (NSUInteger)latencyCount
+{
+    return latencyCount;
+}
+@end
+
+static int compareDoubles(const void *a, const void *b)
+{
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static double percentile(double *sorted, NSUInteger count, double p)
+{
+    if (0 == count)
+    {
+        return 0;
+    }
+    NSUInteger index = (NSUInteger)(p * (count - 1));
+    return sorted[index];
+}
+
+int main(int argc, char **argv)
+{
+    NSAutoreleasePool *pool = [NSAutoreleasePool new];
+    NSUInteger connectionCount = (argc > 1) ? strtoul(argv[1], NULL, 10) : 64;
+    NSUInteger messageSize = (argc > 2) ? strtoul(argv[2], NULL, 10) : 1024;
+    double duration = (argc > 3) ? strtod(argv[3], NULL) : 5;
+    unsigned short port = (argc > 4) ? strtoul(argv[4], NULL, 10) : 47321;
+
+    EchoServer *server = [[EchoServer new] autorelease];
+    ETListenSocket *listener = [ETListenSocket listenSocketForAddress: @"127.0.0.1"
+                                                               onPort: port];
+    if (nil == listener)
+    {
+        fprintf(stderr, "Failed to listen on port %d\n", port);
+        return 1;
+    }
+    [listener setDelegate: server];
+
+    NSMutableData *message = [NSMutableData dataWithLength: messageSize];
+    memset([message mutableBytes], 'x', messageSize);
+
+    NSMutableArray *clients = [NSMutableArray array];
+    NSString *service = [NSString stringWithFormat: @"%d", port];
+    for (NSUInteger i=0 ; i<connectionCount ; i++)
+    {
+        ETSocket *socket = [ETSocket socketConnectedToRemoteHost: @"127.0.0.1"
+                                                      forService: service];
+        if (nil == socket)
+        {
+            fprintf(stderr, "Failed to connect client %d\n", (int)i);
+            return 1;
+        }
+        EchoClient *client = [[EchoClient alloc] initWithSocket: socket
+                                                        message: message];
+        [clients addObject: client];
+        [client release];
+    }
+
+    NSRunLoop *runLoop = [NSRunLoop currentRunLoop];
+    // Let the server accept all the connections before timing.
+    [runLoop runUntilDate: [NSDate dateWithTimeIntervalSinceNow: 0.5]];
+
+    NSTimeInterval start = [NSDate timeIntervalSinceReferenceDate];
+    NSDate *end = [NSDate dateWithTimeIntervalSinceNow: duration];
+    for (EchoClient *client in clients)
+    {
+        [client start];
+    }
+    while ([end timeIntervalSinceNow] > 0)
+    {
+        NSAutoreleasePool *loopPool = [NSAutoreleasePool new];
+        [runLoop runMode: NSDefaultRunLoopMode beforeDate: end];
+        [loopPool release];
+    }
+    NSTimeInterval elapsed = [NSDate timeIntervalSinceReferenceDate] - start;
+
+    NSUInteger total = 0;
+    for (EchoClient *client in clients)
+    {
+        total += [client latencyCount];
+    }
+    double *all = malloc(MAX(total, 1) * sizeof(double));
+    NSUInteger count = 0;
+    for (EchoClient *client in clients)
+    {
+        memcpy(all + count, [client latencies], [client latencyCount] * sizeof(double));
+        count += [client latencyCount];
+    }
+    qsort(all, count, sizeof(double), compareDoubles);
+
+    printf("%d connections, %d byte messages, %.1f s\n",
+           (int)connectionCount, (int)messageSize, elapsed);
+    printf("messages/s: %.0f\n", count / elapsed);
+    printf("throughput: %.2f MB/s (each way)\n",
+           count * (double)messageSize / elapsed / (1024 * 1024));
+    printf("latency (us): p50 %.1f  p99 %.1f  p99.9 %.1f  max %.1f\n",
+           percentile(all, count, 0.5) * 1e6,
+           percentile(all, count, 0.99) * 1e6,
+           percentile(all, count, 0.999) * 1e6,
+           (count > 0 ? all[count - 1] : 0) * 1e6);
+
+    free(all);
+    [pool release];
+    return 0;
+}
@@ -0,0 +1,239 @@
+/*
+    SocketFilterBenchmark.m
+
+    Copyright (C) 2026 The Etoile Project
+
+    Date:  October 2026
+    License:  Modified BSD (see COPYING)
+ */
+
+#import <Foundation/Foundation.h>
+#import <EtoileFoundation/ETSocket.h>
+#import <EtoileFoundation/ETSocketFilters.h>
+#import <EtoileFoundation/Macros.h>
+#include <stdlib.h>
+#include <zlib.h>
+
+/*
+ * Compares the throughput of socket filter chains built on ETSocketFilter,
+ * where each send makes a mutable copy of the data and each filter returns a
+ * new NSMutableData, with chains built on ETSocketSegmentFilter.
+ *
+ * Each chain runs the way ETSocket runs its output filters, and the result is
+ * consumed by summing the segments instead of being written to a socket, so
+ * only the filtering cost is measured.
+ *
+ * Build it with "make benchmark=yes" in EtoileFoundation, then run it without
+ * arguments.  An optional argument sets the number of messages.
+ */
+
+/**
+ * ETSocketFilter that passes the data through.
+ */
+@interface LegacyIdentityFilter : NSObject <ETSocketFilter>
+@end
+
+@implementation LegacyIdentityFilter
+- (NSMutableData*)filterData: (NSMutableData*)aData
+{
+    return aData;
+}
+@end
+
+/**
+ * ETSocketFilter equivalent to ETFrameEncoder.
+ */
+@interface LegacyFrameEncoder : NSObject <ETSocketFilter>
+@end
+
+@implementation LegacyFrameEncoder
+- (NSMutableData*)filterData: (NSMutableData*)aData
+{
+    uint32_t length = NSSwapHostIntToBig([aData length]);
+    NSMutableData *frame = [NSMutableData dataWithCapacity: [aData length] + 4];
+
+    [frame appendBytes: &length length: 4];
+    [frame appendData: aData];
+    return frame;
+}
+@end
+
+/**
+ * ETSocketFilter equivalent to ETDeflateFilter.
+ */
+@interface LegacyDeflateFilter : NSObject <ETSocketFilter>
+{
+    z_stream stream;
+}
+@end
+
+@implementation LegacyDeflateFilter
+- (id)init
+{
+    if (nil == (self = [super init]))
+    {
+        return nil;
+    }
+    deflateInit(&stream, Z_DEFAULT_COMPRESSION);
+    return self;
+}
+- (void)dealloc
+{
+    deflateEnd(&stream);
+    [super dealloc];
+}
+- (NSMutableData*)filterData: (NSMutableData*)aData
+{
+    NSMutableData *compressed =
+        [NSMutableData dataWithLength: deflateBound(&stream, [aData length]) + 16];
+
+    stream.next_in = [aData mutableBytes];
+    stream.avail_in = [aData length];
+    stream.next_out = [compressed mutableBytes];
+    stream.avail_out = [compressed length];
+    deflate(&stream, Z_SYNC_FLUSH);
+    [compressed setLength: [compressed length] - stream.avail_out];
+    return compressed;
+}
+@end
+
+/**
+ * ETSocketSegmentFilter that passes the data through.
+ */
+@interface IdentityFilter : NSObject <ETSocketSegmentFilter>
+@end
+
+@implementation IdentityFilter
+- (void)filterSegments: (ETSegmentBuffer)input into: (ETSegmentBuffer)output
+{
+    ETSegmentBufferAppendBuffer(output, input);
+}
+@end
+
+static unsigned long long consume(const struct iovec *segments, int count)
+{
+    unsigned long long sum = 0;
+    for (int i=0 ; i<count ; i++)
+    {
+        sum += segments[i].iov_len + ((unsigned char*)segments[i].iov_base)[0];
+    }
+    return sum;
+}
+
+/**
+ * Runs the legacy filters over the message count times and returns the
+ * throughput in MB/s.
+ */
+static double runLegacy(NSArray *filters, NSData *message, NSUInteger count)
+{
+    unsigned long long sum = 0;
+    NSDate *start = [NSDate date];
+
+    for (NSUInteger i=0 ; i<count ; i++)
+    {
+        NSAutoreleasePool *pool = [NSAutoreleasePool new];
+        NSMutableData *data = [[message mutableCopy] autorelease];
+        for (id<ETSocketFilter> filter in filters)
+        {
+            data = [filter filterData: data];
+        }
+        struct iovec chunk = { [data mutableBytes], [data length] };
+        sum += consume(&chunk, 1);
+        [pool release];
+    }
+    NSTimeInterval elapsed = -[start timeIntervalSinceNow];
+    return (sum > 0) ? count * [message length] / elapsed / (1024 * 1024) : 0;
+}
+
+/**
+ * Runs the segment filters over the message count times and returns the
+ * throughput in MB/s.
+ */
+static double runSegments(NSArray *filters, NSData *message, NSUInteger count)
+{
+    NSUInteger filterCount = [filters count];
+    ETSegmentBuffer buffers[filterCount + 1];
+    unsigned long long sum = 0;
+
+    for (NSUInteger i=0 ; i<=filterCount ; i++)
+    {
+        buffers[i] = ETSegmentBufferNew();
+    }
+
+    NSDate *start = [NSDate date];
+    for (NSUInteger i=0 ; i<count ; i++)
+    {
+        for (NSUInteger j=0 ; j<=filterCount ; j++)
+        {
+            ETSegmentBufferReset(buffers[j]);
+        }
+        ETSegmentBufferAppend(buffers[0], [message bytes], [message length]);
+        for (NSUInteger j=0 ; j<filterCount ; j++)
+        {
+            [[filters objectAtIndex: j] filterSegments: buffers[j] into: buffers[j + 1]];
+        }
+        sum += consume(ETSegmentBufferSegments(buffers[filterCount]),
+                       ETSegmentBufferCount(buffers[filterCount]));
+    }
+    NSTimeInterval elapsed = -[start timeIntervalSinceNow];
+
+    for (NSUInteger i=0 ; i<=filterCount ; i++)
+    {
+        ETSegmentBufferFree(buffers[i]);
+    }
+    return (sum > 0) ? count * [message length] / elapsed / (1024 * 1024) : 0;
+}
+
+static void compare(NSString *aName, NSArray *legacyFilters, NSArray *segmentFilters,
+                    NSUInteger messageSize, NSUInteger count)
+{
+    NSMutableData *message = [NSMutableData dataWithLength: messageSize];
+    char *bytes = [message mutableBytes];
+
+    // Somewhat compressible text.
+    for (NSUInteger i=0 ; i<messageSize ; i++)
+    {
+        bytes[i] = "<message to='a@b'>hello</message>"[(i * 7) % 33];
+    }
+
+    double legacy = runLegacy(legacyFilters, message, count);
+    double segments = runSegments(segmentFilters, message, count);
+
+    printf("%-22s %7lu B  legacy %9.1f MB/s  segments %9.1f MB/s  x%.2f\n",
+           [aName UTF8String], (unsigned long)messageSize, legacy, segments,
+           segments / legacy);
+}
+
+int main(int argc, char **argv)
+{
+    NSAutoreleasePool *pool = [NSAutoreleasePool new];
+    NSUInteger count = (argc > 1) ? strtoul(argv[1], NULL, 10) : 100000;
+    NSUInteger sizes[] = { 64, 1024, 16384, 262144 };
+
+    for (int i=0 ; i<4 ; i++)
+    {
+        // Keep the amount of data roughly constant across sizes.
+        NSUInteger n = MAX(count * 1024 / sizes[i], 100);
+
+        compare(@"identity x3",
+                A([[LegacyIdentityFilter new] autorelease],
+                  [[LegacyIdentityFilter new] autorelease],
+                  [[LegacyIdentityFilter new] autorelease]),
+                A([[IdentityFilter new] autorelease],
+                  [[IdentityFilter new] autorelease],
+                  [[IdentityFilter new] autorelease]),
+                sizes[i], n);
+        compare(@"framing",
+                A([[LegacyFrameEncoder new] autorelease]),
+                A([[ETFrameEncoder new] autorelease]),
+                sizes[i], n);
+        compare(@"deflate + framing",
+                A([[LegacyDeflateFilter new] autorelease],
+                  [[LegacyFrameEncoder new] autorelease]),
+                A([[ETDeflateFilter new] autorelease],
+                  [[ETFrameEncoder new] autorelease]),
+                sizes[i], n / 10);
+    }
+    [pool release];
+    return 0;
+}
@@ -0,0 +1,212 @@
+/*
+    ThreadedObjectBenchmark.m
+
+    Copyright (C) 2026 The Etoile Project
+
+    Date:  October 2026
+    License:  Modified BSD (see COPYING)
+ */
+
+#import <Foundation/Foundation.h>
+#import <EtoileThread/NSObject+Threaded.h>
+#include <stdlib.h>
+
+/*
+ * Measures the throughput and latency of messages sent to a threaded object by
+ * 1 to N producer threads.
+ *
+ * Each producer sends a fixed number of void messages carrying their send
+ * time.  The threaded object records when each one is executed.  Once all the
+ * producers are done, a message returning a scalar waits for the queue to be
+ * drained, then the benchmark reports the number of messages per second and
+ * the send-to-execution latency percentiles.
+ *
+ * Build it with "make benchmark=yes" in EtoileFoundation, then run:
+ *
+ *     ThreadedObjectBenchmark [max producers] [messages per producer] [queue capacity]
+ *
+ * The defaults are 8 producers, 100000 messages and a capacity of 256.
+ */
+
+static double now(void)
+{
+    return [NSDate timeIntervalSinceReferenceDate];
+}
+
+@interface Receiver : NSObject
+{
+    double *latencies;
+    NSUInteger count;
+    NSUInteger capacity;
+}
+- (id) initWithCapacity: (NSUInteger)aCapacity;
+- (void) receive: (double)sentAt;
+- (NSUInteger) count;
+- (double*) latencies;
+@end
+
+@implementation Receiver
+- (id) initWithCapacity: (NSUInteger)aCapacity
+{
+    if (nil == (self = [super init]))
+    {
+        return nil;
+    }
+    capacity = aCapacity;
+    latencies = malloc(capacity * sizeof(double));
+    return self;
+}
+- (void) dealloc
+{
+    free(latencies);
+    [super dealloc];
+}
+- (void) receive: (double)sentAt
+{
+    if (count < capacity)
+    {
+        latencies[count++] = now() - sentAt;
+    }
+}
+- (NSUInteger) count
+{
+    return count;
+}
+- (double*) latencies
+{
+    return latencies;
+}
+@end
+
+/**
+ * Sends messages to the receiver from a new thread, once started.
+ */
+@interface Producer : NSObject
+{
+    id receiver;
+    NSUInteger messages;
+    NSConditionLock *start;
+    NSConditionLock *done;
+}
+- (id) initWithReceiver: (id)aReceiver
+               messages: (NSUInteger)aCount
+                  start: (NSConditionLock*)startLock
+                   done: (NSConditionLock*)doneLock;
+- (void) produce: (id)sender;
+@end
+
+@implementation Producer
+- (id) initWithReceiver: (id)aReceiver
+               messages: (NSUInteger)aCount
+                  start: (NSConditionLock*)startLock
+                   done: (NSConditionLock*)doneLock
+{
+    if (nil == (self = [super init]))
+    {
+        return nil;
+    }
+    receiver = aReceiver;
+    messages = aCount;
+    start = [startLock retain];
+    done = [doneLock retain];
+    return self;
+}
+- (void) dealloc
+{
+    [start release];
+    [done release];
+    [super dealloc];
+}
+/**
+ * Waits for the start lock's condition to become 1, sends the messages, and
+ * increments the done lock's condition.
+ */
+- (void) produce: (id)sender
+{
+    NSAutoreleasePool *pool = [NSAutoreleasePool new];
+
+    [start lockWhenCondition: 1];
+    [start unlock];
+    for (NSUInteger i=0 ; i<messages ; i++)
+    {
+        // Forwarding creates an autoreleased invocation for each message.
+        if (i % 1024 == 0)
+        {
+            [pool release];
+            pool = [NSAutoreleasePool new];
+        }
+        [receiver receive: now()];
+    }
+    [done lock];
+    [done unlockWithCondition: [done condition] + 1];
+    [pool release];
+}
+@end
+
+static int compareDoubles(const void *a, const void *b)
+{
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static void run(NSUInteger producerCount, NSUInteger messages, NSUInteger queueCapacity)
+{
+    NSUInteger total = producerCount * messages;
+    Receiver *receiver = [[Receiver alloc] initWithCapacity: total];
+    id threaded = [receiver inNewThreadWithQueueCapacity: queueCapacity];
+    NSConditionLock *start = [[NSConditionLock alloc] initWithCondition: 0];
+    NSConditionLock *done = [[NSConditionLock alloc] initWithCondition: 0];
+
+    // Make sure the worker thread is running before timing.
+    [threaded count];
+
+    for (NSUInteger i=0 ; i<producerCount ; i++)
+    {
+        Producer *producer = [[Producer alloc] initWithReceiver: threaded
+                                                       messages: messages
+                                                          start: start
+                                                           done: done];
+        [NSThread detachNewThreadSelector: @selector(produce:)
+                                 toTarget: producer
+                               withObject: nil];
+        [producer release];
+    }
+    double begin = now();
+    [start lock];
+    [start unlockWithCondition: 1];
+    [done lockWhenCondition: producerCount];
+    [done unlock];
+    NSUInteger received = [threaded count];
+    double elapsed = now() - begin;
+    [start release];
+    [done release];
+
+    double *latencies = [receiver latencies];
+    qsort(latencies, received, sizeof(double), compareDoubles);
+    printf("%2lu producers  %9.0f msg/s  latency (us): p50 %8.1f  p99 %8.1f  max %8.1f\n",
+           (unsigned long)producerCount, received / elapsed,
+           latencies[received / 2] * 1e6,
+           latencies[(NSUInteger)(0.99 * (received - 1))] * 1e6,
+           latencies[received - 1] * 1e6);
+    [receiver release];
+}
+
+int main(int argc, char **argv)
+{
+    NSAutoreleasePool *pool = [NSAutoreleasePool new];
+    NSUInteger maxProducers = (argc > 1) ? strtoul(argv[1], NULL, 10) : 8;
+    NSUInteger messages = (argc > 2) ? strtoul(argv[2], NULL, 10) : 100000;
+    NSUInteger queueCapacity = (argc > 3) ? strtoul(argv[3], NULL, 10) : 256;
+
+    printf("%lu messages per producer, queue capacity %lu\n",
+           (unsigned long)messages, (unsigned long)queueCapacity);
+    for (NSUInteger i=1 ; i<=maxProducers ; i*=2)
+    {
+        NSAutoreleasePool *runPool = [NSAutoreleasePool new];
+        run(i, messages, queueCapacity);
+        [runPool release];
+    }
+    [pool release];
+    return 0;
+}
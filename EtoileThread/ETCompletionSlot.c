@@ -0,0 +1,168 @@
+/*
+    ETCompletionSlot.c
+
+    Copyright (C) 2026 The Etoile Project
+
+    Date:  October 2026
+    License:  Modified BSD (see COPYING)
+ */
+
+#define _GNU_SOURCE
+
+#include "ETCompletionSlot.h"
+#include <time.h>
+
+#ifdef __linux__
+#   include <linux/futex.h>
+#   include <sys/syscall.h>
+#   include <unistd.h>
+#endif
+
+/**
+ * Number of times the waiter checks the slot before sleeping.  A call to a
+ * threaded object that is not busy usually completes within this time, and
+ * spinning avoids two context switches.
+ */
+#define SPIN_COUNT 2000
+
+enum
+{
+    PENDING = 0,
+    SIGNALLED = 1,
+    SLEEPING = 2
+};
+
+static inline void cpuRelax(void)
+{
+#if defined(__i386__) || defined(__x86_64__)
+    __asm__ __volatile__("pause");
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+void ETCompletionSlotInit(ETCompletionSlot *slot)
+{
+    slot->state = PENDING;
+#ifndef __linux__
+    pthread_mutex_init(&slot->mutex, NULL);
+    pthread_cond_init(&slot->condition, NULL);
+#endif
+}
+
+void ETCompletionSlotWait(ETCompletionSlot *slot)
+{
+    for (int i=0 ; i<SPIN_COUNT ; i++)
+    {
+        if (SIGNALLED == slot->state)
+        {
+            __sync_synchronize();
+            return;
+        }
+        cpuRelax();
+    }
+    if (!__sync_bool_compare_and_swap(&slot->state, PENDING, SLEEPING))
+    {
+        // Signalled while we were giving up.
+        __sync_synchronize();
+        return;
+    }
+#ifdef __linux__
+    while (SIGNALLED != slot->state)
+    {
+        syscall(SYS_futex, &slot->state, FUTEX_WAIT_PRIVATE, SLEEPING, NULL, NULL, 0);
+    }
+#else
+    pthread_mutex_lock(&slot->mutex);
+    while (SIGNALLED != slot->state)
+    {
+        pthread_cond_wait(&slot->condition, &slot->mutex);
+    }
+    pthread_mutex_unlock(&slot->mutex);
+#endif
+    __sync_synchronize();
+}
+
+int ETCompletionSlotTimedWait(ETCompletionSlot *slot, unsigned long nanoseconds)
+{
+    struct timespec timeout = { nanoseconds / 1000000000, nanoseconds % 1000000000 };
+
+    if (SIGNALLED == slot->state)
+    {
+        __sync_synchronize();
+        return 1;
+    }
+    if (0 == nanoseconds)
+    {
+        return 0;
+    }
+    if (!__sync_bool_compare_and_swap(&slot->state, PENDING, SLEEPING))
+    {
+        __sync_synchronize();
+        return 1;
+    }
+#ifdef __linux__
+    // The futex timeout is relative.
+    syscall(SYS_futex, &slot->state, FUTEX_WAIT_PRIVATE, SLEEPING, &timeout, NULL, 0);
+#else
+    struct timespec until;
+
+    clock_gettime(CLOCK_REALTIME, &until);
+    until.tv_sec += timeout.tv_sec;
+    until.tv_nsec += timeout.tv_nsec;
+    if (until.tv_nsec >= 1000000000)
+    {
+        until.tv_sec++;
+        until.tv_nsec -= 1000000000;
+    }
+    pthread_mutex_lock(&slot->mutex);
+    if (SIGNALLED != slot->state)
+    {
+        pthread_cond_timedwait(&slot->condition, &slot->mutex, &until);
+    }
+    pthread_mutex_unlock(&slot->mutex);
+#endif
+    // Stop sleeping, unless the slot was signalled in the meantime.
+    if (__sync_bool_compare_and_swap(&slot->state, SLEEPING, PENDING))
+    {
+        return 0;
+    }
+    __sync_synchronize();
+    return 1;
+}
+
+void ETCompletionSlotSignal(ETCompletionSlot *slot)
+{
+#ifdef __linux__
+    // Full barrier, so the waiter sees everything written before.
+    if (SLEEPING != __sync_lock_test_and_set(&slot->state, SIGNALLED))
+    {
+        return;
+    }
+    // Waking a futex the waiter has already left is harmless.
+    syscall(SYS_futex, &slot->state, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+#else
+    // The state changes under the mutex, so the waiter can't miss the
+    // signal, and nothing in the slot is touched once the mutex is unlocked.
+    pthread_mutex_lock(&slot->mutex);
+    if (SLEEPING == __sync_lock_test_and_set(&slot->state, SIGNALLED))
+    {
+        pthread_cond_signal(&slot->condition);
+    }
+    pthread_mutex_unlock(&slot->mutex);
+#endif
+}
+
+void ETCompletionSlotDestroy(ETCompletionSlot *slot)
+{
+#ifdef __linux__
+    (void)slot;
+#else
+    // The waiter may have seen the slot signalled without taking the mutex,
+    // so wait until the signalling thread has unlocked it.
+    pthread_mutex_lock(&slot->mutex);
+    pthread_mutex_unlock(&slot->mutex);
+    pthread_mutex_destroy(&slot->mutex);
+    pthread_cond_destroy(&slot->condition);
+#endif
+}
@@ -0,0 +1,59 @@
+/*
+    ETCompletionSlot.h
+
+    Copyright (C) 2026 The Etoile Project
+
+    Date:  October 2026
+    License:  Modified BSD (see COPYING)
+ */
+
+#ifndef __ET_COMPLETION_SLOT_INCLUDED__
+#define __ET_COMPLETION_SLOT_INCLUDED__
+
+#include <pthread.h>
+
+/**
+ * A one-shot event that a thread waits for and another signals, typically
+ * allocated on the waiting thread's stack for a single call.
+ *
+ * The waiter spins for a short while, then sleeps on a futex (on Linux) or a
+ * condition variable.  Signalling is a single atomic exchange unless the
+ * waiter is asleep.
+ */
+typedef struct
+{
+    /** 0 while pending, 1 once signalled, 2 while the waiter sleeps. */
+    volatile int state;
+#ifndef __linux__
+    pthread_mutex_t mutex;
+    pthread_cond_t condition;
+#endif
+} ETCompletionSlot;
+
+/**
+ * Prepares slot for use.
+ */
+void ETCompletionSlotInit(ETCompletionSlot *slot);
+/**
+ * Waits until slot is signalled.  Must only be called by one thread.
+ */
+void ETCompletionSlotWait(ETCompletionSlot *slot);
+/**
+ * Waits until slot is signalled, without spinning, or until nanoseconds have
+ * elapsed.  Returns 1 if the slot was signalled, 0 otherwise.  A timeout of 0
+ * only checks the slot.  Must only be called by one thread.
+ */
+int ETCompletionSlotTimedWait(ETCompletionSlot *slot, unsigned long nanoseconds);
+/**
+ * Wakes up the thread waiting on the slot, or lets its next wait return
+ * immediately.  The slot must not be used by the signalling thread after this
+ * call, since the waiter may have freed it.
+ */
+void ETCompletionSlotSignal(ETCompletionSlot *slot);
+/**
+ * Releases the resources of a slot after it has been waited on.  Must be
+ * called before the memory of the slot is reused, even on Linux where it does
+ * nothing.
+ */
+void ETCompletionSlotDestroy(ETCompletionSlot *slot);
+#endif
@@ -0,0 +1,54 @@
+/*
+    ETExecutor.h
+
+    Copyright (C) 2026 The Etoile Project
+
+    Date:  October 2026
+    License:  Modified BSD (see COPYING)
+ */
+
+#import <Foundation/Foundation.h>
+
+#ifndef __has_feature
+#   define __has_feature(x) 0
+#endif
+
+#if __has_feature(blocks)
+/**
+ * An executor runs blocks on behalf of other objects, for example the
+ * continuations registered on a future (see ETThreadProxyReturn).  It decides
+ * which thread runs them and when.
+ *
+ * ETThreadPool is an executor which runs the blocks on its workers.
+ */
+@protocol ETExecutor <NSObject>
+/**
+ * Runs aBlock, now or later.  The executor copies the block if it runs it
+ * later.
+ */
+- (void) executeBlock: (void(^)(void))aBlock;
+@end
+
+/**
+ * Executor that runs blocks immediately, in the calling thread.
+ *
+ * This is the default executor for continuations, which then run in the
+ * thread completing the future.  They should be short and must not block.
+ */
+@interface ETImmediateExecutor : NSObject <ETExecutor>
+/**
+ * Returns the shared instance.
+ */
++ (id) sharedInstance;
+@end
+
+/**
+ * Executor that runs blocks in the main thread, from its run loop.
+ */
+@interface ETMainThreadExecutor : NSObject <ETExecutor>
+/**
+ * Returns the shared instance.
+ */
++ (id) sharedInstance;
+@end
+#endif
@@ -0,0 +1,68 @@
+/*
+    ETExecutor.m
+
+    Copyright (C) 2026 The Etoile Project
+
+    Date:  October 2026
+    License:  Modified BSD (see COPYING)
+ */
+
+#import "ETExecutor.h"
+
+#if __has_feature(blocks)
+@implementation ETImmediateExecutor
+
++ (id) sharedInstance
+{
+    static ETImmediateExecutor *sharedInstance;
+
+    @synchronized(self)
+    {
+        if (nil == sharedInstance)
+        {
+            sharedInstance = [[self alloc] init];
+        }
+    }
+    return sharedInstance;
+}
+
+- (void) executeBlock: (void(^)(void))aBlock
+{
+    aBlock();
+}
+
+@end
+
+@implementation ETMainThreadExecutor
+
++ (id) sharedInstance
+{
+    static ETMainThreadExecutor *sharedInstance;
+
+    @synchronized(self)
+    {
+        if (nil == sharedInstance)
+        {
+            sharedInstance = [[self alloc] init];
+        }
+    }
+    return sharedInstance;
+}
+
+- (void) runBlock: (id)aBlock
+{
+    ((void(^)(void))aBlock)();
+}
+
+- (void) executeBlock: (void(^)(void))aBlock
+{
+    id block = [aBlock copy];
+
+    [self performSelectorOnMainThread: @selector(runBlock:)
+                           withObject: block
+                        waitUntilDone: NO];
+    [block release];
+}
+
+@end
+#endif
@@ -0,0 +1,315 @@
+/*
+    ETMessageQueue.c
+
+    Copyright (C) 2026 The Etoile Project
+
+    Date:  October 2026
+    License:  Modified BSD (see COPYING)
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <time.h>
+#include "ETMessageQueue.h"
+
+/*
+ * The queue is an array of slots, each with a sequence number, used as
+ * described by Dmitry Vyukov for his bounded MPMC queue:
+ *
+ * - A slot can be written by the producer that claims position pos when its
+ * sequence is pos.  Producers claim positions by incrementing tail with a
+ * compare and swap, so two producers never write the same slot, and the
+ * message and its context are written to the same slot.
+ *
+ * - Once written, the producer publishes the slot by setting its sequence to
+ * pos + 1.  The consumer reads the slot at head when its sequence is head + 1,
+ * and releases it to the producers of the next round by setting it to
+ * head + capacity.
+ *
+ * To sleep, the consumer (or a producer) sets a flag (or counter) under the
+ * mutex, issues a full barrier and checks the queue again before waiting on
+ * its condition variable.  The other side issues a full barrier after
+ * changing the queue, then checks the flag and signals under the mutex.
+ * Either the sleeper sees the change or the other side sees the flag, so no
+ * wakeup is lost.
+ */
+
+#define CACHE_LINE_SIZE 64
+/** Largest capacity whose rounded up slot array size does not overflow. */
+#define MAX_CAPACITY (SIZE_MAX / 2 / sizeof(struct ETMessageSlot))
+
+struct ETMessageSlot
+{
+    size_t sequence;
+    ETMessage message;
+};
+
+struct _ETMessageQueue
+{
+    struct ETMessageSlot *slots;
+    size_t mask;
+    /** Next position to claim for producers. */
+    size_t tail __attribute__((aligned(CACHE_LINE_SIZE)));
+    /** Next position to read for the consumer. */
+    size_t head __attribute__((aligned(CACHE_LINE_SIZE)));
+    /** Set while the consumer waits for messages. */
+    int consumerWaiting __attribute__((aligned(CACHE_LINE_SIZE)));
+    /** Set to interrupt the consumer wait. */
+    int wakeRequested;
+    /** Number of producers waiting for space. */
+    int producersWaiting;
+    pthread_mutex_t mutex;
+    pthread_cond_t notEmpty;
+    pthread_cond_t notFull;
+};
+
+#ifdef __ATOMIC_ACQUIRE
+#   define LOAD_ACQUIRE(p) __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#   define STORE_RELEASE(p, v) __atomic_store_n(p, v, __ATOMIC_RELEASE)
+#   define LOAD_RELAXED(p) __atomic_load_n(p, __ATOMIC_RELAXED)
+#else
+static inline size_t loadAcquire(volatile size_t *p)
+{
+    size_t value = *p;
+    __sync_synchronize();
+    return value;
+}
+#   define LOAD_ACQUIRE(p) loadAcquire(p)
+#   define STORE_RELEASE(p, v) do { __sync_synchronize(); *(volatile size_t*)(p) = (v); } while (0)
+#   define LOAD_RELAXED(p) (*(volatile __typeof__(*(p))*)(p))
+#endif
+
+ETMessageQueue ETMessageQueueNew(size_t capacity)
+{
+    ETMessageQueue queue;
+    size_t size = 2;
+
+    if (capacity > MAX_CAPACITY)
+    {
+        return NULL;
+    }
+    while (size < capacity)
+    {
+        size <<= 1;
+    }
+    if (0 != posix_memalign((void**)&queue, CACHE_LINE_SIZE, sizeof(struct _ETMessageQueue)))
+    {
+        return NULL;
+    }
+    queue->slots = malloc(size * sizeof(struct ETMessageSlot));
+    if (NULL == queue->slots)
+    {
+        free(queue);
+        return NULL;
+    }
+    queue->mask = size - 1;
+    for (size_t i=0 ; i<size ; i++)
+    {
+        queue->slots[i].sequence = i;
+    }
+    queue->tail = 0;
+    queue->head = 0;
+    queue->consumerWaiting = 0;
+    queue->wakeRequested = 0;
+    queue->producersWaiting = 0;
+    pthread_mutex_init(&queue->mutex, NULL);
+    pthread_cond_init(&queue->notEmpty, NULL);
+    pthread_cond_init(&queue->notFull, NULL);
+    return queue;
+}
+
+size_t ETMessageQueueCapacity(ETMessageQueue queue)
+{
+    return queue->mask + 1;
+}
+
+size_t ETMessageQueueCount(ETMessageQueue queue)
+{
+    return LOAD_RELAXED(&queue->tail) - LOAD_RELAXED(&queue->head);
+}
+
+int ETMessageQueueTryPush(ETMessageQueue queue, void *message, void *context)
+{
+    size_t pos = LOAD_RELAXED(&queue->tail);
+    struct ETMessageSlot *slot;
+
+    for (;;)
+    {
+        slot = &queue->slots[pos & queue->mask];
+        intptr_t difference = (intptr_t)(LOAD_ACQUIRE(&slot->sequence) - pos);
+
+        if (0 == difference)
+        {
+            if (__sync_bool_compare_and_swap(&queue->tail, pos, pos + 1))
+            {
+                break;
+            }
+            pos = LOAD_RELAXED(&queue->tail);
+        }
+        else if (difference < 0)
+        {
+            // The consumer has not released this slot yet.
+            return -1;
+        }
+        else
+        {
+            // Another producer claimed this position.
+            pos = LOAD_RELAXED(&queue->tail);
+        }
+    }
+    slot->message.message = message;
+    slot->message.context = context;
+    STORE_RELEASE(&slot->sequence, pos + 1);
+
+    __sync_synchronize();
+    if (LOAD_RELAXED(&queue->consumerWaiting))
+    {
+        pthread_mutex_lock(&queue->mutex);
+        pthread_cond_signal(&queue->notEmpty);
+        pthread_mutex_unlock(&queue->mutex);
+    }
+    return 0;
+}
+
+/**
+ * Returns whether the slot at the tail is still in use by the consumer.
+ */
+static inline int isFull(ETMessageQueue queue)
+{
+    size_t pos = LOAD_RELAXED(&queue->tail);
+    size_t sequence = LOAD_ACQUIRE(&queue->slots[pos & queue->mask].sequence);
+    return (intptr_t)(sequence - pos) < 0;
+}
+
+void ETMessageQueuePush(ETMessageQueue queue, void *message, void *context)
+{
+    while (0 != ETMessageQueueTryPush(queue, message, context))
+    {
+        pthread_mutex_lock(&queue->mutex);
+        queue->producersWaiting++;
+        __sync_synchronize();
+        if (isFull(queue))
+        {
+            pthread_cond_wait(&queue->notFull, &queue->mutex);
+        }
+        queue->producersWaiting--;
+        pthread_mutex_unlock(&queue->mutex);
+    }
+}
+
+int ETMessageQueueTimedPush(ETMessageQueue queue, void *message, void *context,
+                            unsigned long nanoseconds)
+{
+    struct timespec until;
+
+    if (0 == ETMessageQueueTryPush(queue, message, context))
+    {
+        return 0;
+    }
+    if (0 == nanoseconds)
+    {
+        return -1;
+    }
+    clock_gettime(CLOCK_REALTIME, &until);
+    until.tv_sec += nanoseconds / 1000000000;
+    until.tv_nsec += nanoseconds % 1000000000;
+    if (until.tv_nsec >= 1000000000)
+    {
+        until.tv_sec++;
+        until.tv_nsec -= 1000000000;
+    }
+
+    pthread_mutex_lock(&queue->mutex);
+    queue->producersWaiting++;
+    __sync_synchronize();
+    if (isFull(queue))
+    {
+        pthread_cond_timedwait(&queue->notFull, &queue->mutex, &until);
+    }
+    queue->producersWaiting--;
+    pthread_mutex_unlock(&queue->mutex);
+    return ETMessageQueueTryPush(queue, message, context);
+}
+
+/**
+ * Returns whether the slot at the head has been published by a producer.
+ */
+static inline int isReady(ETMessageQueue queue)
+{
+    size_t pos = queue->head;
+    return LOAD_ACQUIRE(&queue->slots[pos & queue->mask].sequence) == pos + 1;
+}
+
+size_t ETMessageQueuePopBatch(ETMessageQueue queue, ETMessage *messages, size_t max)
+{
+    size_t pos = queue->head;
+    size_t count = 0;
+
+    while (count < max)
+    {
+        struct ETMessageSlot *slot = &queue->slots[pos & queue->mask];
+
+        if (LOAD_ACQUIRE(&slot->sequence) != pos + 1)
+        {
+            break;
+        }
+        messages[count++] = slot->message;
+        STORE_RELEASE(&slot->sequence, pos + queue->mask + 1);
+        pos++;
+    }
+    if (0 == count)
+    {
+        return 0;
+    }
+    STORE_RELEASE(&queue->head, pos);
+
+    __sync_synchronize();
+    if (LOAD_RELAXED(&queue->producersWaiting) > 0)
+    {
+        pthread_mutex_lock(&queue->mutex);
+        pthread_cond_broadcast(&queue->notFull);
+        pthread_mutex_unlock(&queue->mutex);
+    }
+    return count;
+}
+
+size_t ETMessageQueueWaitPopBatch(ETMessageQueue queue, ETMessage *messages, size_t max)
+{
+    size_t count = ETMessageQueuePopBatch(queue, messages, max);
+
+    if (count > 0)
+    {
+        return count;
+    }
+    pthread_mutex_lock(&queue->mutex);
+    queue->consumerWaiting = 1;
+    __sync_synchronize();
+    while (!isReady(queue) && !queue->wakeRequested)
+    {
+        pthread_cond_wait(&queue->notEmpty, &queue->mutex);
+    }
+    queue->consumerWaiting = 0;
+    queue->wakeRequested = 0;
+    pthread_mutex_unlock(&queue->mutex);
+    return ETMessageQueuePopBatch(queue, messages, max);
+}
+
+void ETMessageQueueWakeConsumer(ETMessageQueue queue)
+{
+    pthread_mutex_lock(&queue->mutex);
+    queue->wakeRequested = 1;
+    pthread_cond_signal(&queue->notEmpty);
+    pthread_mutex_unlock(&queue->mutex);
+}
+
+void ETMessageQueueFree(ETMessageQueue queue)
+{
+    pthread_mutex_destroy(&queue->mutex);
+    pthread_cond_destroy(&queue->notEmpty);
+    pthread_cond_destroy(&queue->notFull);
+    free(queue->slots);
+    free(queue);
+}
@@ -0,0 +1,87 @@
+/*
+    ETMessageQueue.h
+
+    Copyright (C) 2026 The Etoile Project
+
+    Date:  October 2026
+    License:  Modified BSD (see COPYING)
+ */
+
+#ifndef __ET_MESSAGE_QUEUE_INCLUDED__
+#define __ET_MESSAGE_QUEUE_INCLUDED__
+
+#include <stddef.h>
+
+/**
+ * A message in an ETMessageQueue: an opaque pointer and some context, which
+ * are enqueued and dequeued together.  ETThreadedObject stores an invocation
+ * and where to deliver its return value.
+ */
+typedef struct
+{
+    void *message;
+    void *context;
+} ETMessage;
+
+/**
+ * Opaque type representing a bounded, multiple-producer, single-consumer FIFO
+ * queue.
+ *
+ * Any number of threads may push messages concurrently.  Only one thread at a
+ * time may pop them.  Pushing and popping are lockless while the queue is
+ * neither full nor empty; otherwise, producers and the consumer sleep on
+ * condition variables instead of spinning.
+ */
+typedef struct _ETMessageQueue* ETMessageQueue;
+
+/**
+ * Creates a new queue that can hold capacity messages.  The capacity is
+ * rounded up to a power of two.  Returns NULL if the capacity is too large
+ * for the slots to be allocated.
+ */
+ETMessageQueue ETMessageQueueNew(size_t capacity);
+/**
+ * Returns the number of messages the queue can hold.
+ */
+size_t ETMessageQueueCapacity(ETMessageQueue queue);
+/**
+ * Returns the number of messages in the queue.  Only a hint if other threads
+ * are using the queue.
+ */
+size_t ETMessageQueueCount(ETMessageQueue queue);
+/**
+ * Adds a message to the queue, and returns 0, or returns -1 without doing
+ * anything if the queue is full.
+ */
+int ETMessageQueueTryPush(ETMessageQueue queue, void *message, void *context);
+/**
+ * Adds a message to the queue, waiting for space if it is full.
+ */
+void ETMessageQueuePush(ETMessageQueue queue, void *message, void *context);
+/**
+ * Adds a message to the queue like ETMessageQueuePush(), but waits at most
+ * nanoseconds for space.  Returns 0 if the message was added, -1 otherwise.
+ */
+int ETMessageQueueTimedPush(ETMessageQueue queue, void *message, void *context,
+                            unsigned long nanoseconds);
+/**
+ * Removes up to max messages from the queue, without waiting, and stores them
+ * in messages.  Returns the number of messages removed.  Must only be called
+ * by the consumer.
+ */
+size_t ETMessageQueuePopBatch(ETMessageQueue queue, ETMessage *messages, size_t max);
+/**
+ * Removes up to max messages from the queue like ETMessageQueuePopBatch(),
+ * but waits for a message if the queue is empty.  Returns 0 only if the wait
+ * was interrupted by ETMessageQueueWakeConsumer().
+ */
+size_t ETMessageQueueWaitPopBatch(ETMessageQueue queue, ETMessage *messages, size_t max);
+/**
+ * Interrupts the current (or next) wait in ETMessageQueueWaitPopBatch().
+ */
+void ETMessageQueueWakeConsumer(ETMessageQueue queue);
+/**
+ * Destroy the queue.  Messages still in it are discarded.
+ */
+void ETMessageQueueFree(ETMessageQueue queue);
+#endif
@@ -1,6 +1,14 @@
 #import <Foundation/NSObject.h>
 #import <Foundation/NSLock.h>
 
+@class NSArray;
+@class NSMutableArray;
+
+/**
+ * Number of requests a pipe can hold when no capacity is given.
+ */
+#define ETObjectPipeDefaultCapacity 16
+
 /**
  * The ETObjectPipe class encapsulates a connection between two filters. 
  *
@@ -13,13 +21,36 @@
  * Every request must have corresponding reply sent, although this may be nil.
  * The intended use for this is to allow a small set of buffers to be recycled
  * between a cooperating pair of filters.  
+ *
+ * Requests and replies each travel through their own ring buffer, whose
+ * capacity is fixed when the pipe is created.  The pipe is full when as many
+ * requests as its capacity are waiting or being handled, or have replies
+ * which have not been collected yet.  A thread that has to wait for the other
+ * end first spins for a while, adjusted according to how long recent waits
+ * took, then sleeps on a condition variable.
+ *
+ * Objects passed through the pipe are not retained by it.  The sender hands
+ * its reference over to the receiver, and objects still in the pipe when it
+ * is deallocated must be collected and released by its owner first.
  */
 @interface ETObjectPipe : NSObject
+/**
+ * Initialises a pipe that can hold up to aCapacity requests (rounded up to a
+ * power of two).  Returns nil if aCapacity is larger than 2^31.
+ */
+- (id)initWithCapacity: (NSUInteger)aCapacity;
+/**
+ * Returns the number of requests the pipe can hold.
+ */
+- (NSUInteger)capacity;
 /**
  * Disconnects the pipe.  This prevents either end from blocking waiting for
  * data that will never arrive.  There is no mechanism for reconnecting a
  * disconnected pipe: you must create a new pipe and connect it to both filters.
  *
+ * Objects can still be sent through a disconnected pipe as long as this does
+ * not require waiting for space.
+ *
  * Note that only one end of the connection is required to call -disconnect.
  * There are no ill effects from calling it twice, however, so it is generally
  * good practice to call -disconnect before you call -release on a connected pipe.
@@ -27,12 +58,26 @@
 - (void)disconnect;
 /**
  * Insert anObject into the ring buffer as a request.
+ *
+ * Returns NO if the pipe is disconnected and full, in which case anObject is
+ * released instead.
+ */
+- (BOOL)sendRequest: (id)anObject;
+/**
+ * Inserts the requests in order, waiting for space as needed.  Fewer
+ * wakeups are needed than when sending them one at a time.
  */
-- (void)sendRequest: (id)anObject;
+- (void)sendRequests: (NSArray*)requests;
 /**
  * Retrieve the next request from the ring buffer.
  */
 - (id)nextRequest;
+/**
+ * Waits until there is a request, then moves all the waiting requests to the
+ * end of anArray.  Returns the number of requests added, which is 0 only if
+ * the pipe has been disconnected.
+ */
+- (NSUInteger)drainRequestsInto: (NSMutableArray*)anArray;
 /**
  * Returns the next request if there is one waiting, or nil if this pipe is
  * empty.
@@ -48,8 +93,11 @@
 - (id)pollForReply;
 /**
  * Insert a reply into the ring buffer.
+ *
+ * Returns NO if the pipe is disconnected and full, in which case anObject is
+ * released instead.
  */
-- (void)sendReply: (id)anObject;
+- (BOOL)sendReply: (id)anObject;
 /**
  * Retrieve the next reply from the buffer.
  */
@@ -58,6 +106,14 @@
  * Returns YES if the pipe is completely full, NO otherwise.
  */
 - (BOOL)isPipeFull;
+/**
+ * Returns YES if a request is waiting.  Never blocks.
+ */
+- (BOOL)hasRequests;
+/**
+ * Returns YES if a reply is waiting.  Never blocks.
+ */
+- (BOOL)hasReplies;
 /**
  * Returns the condition variable used to block when waiting for a request.
  */
@@ -1,153 +1,206 @@
 #import "../Headers/Macros.h"
 #import "ETObjectPipe.h"
+#import <Foundation/NSArray.h>
+#include <stdint.h>
+#include <stdlib.h>
 
+#define CACHE_LINE_SIZE 64
 
 /**
- * The size of the ring buffer.  Defined statically so the masking is easy.  We
- * could make this dynamic in future though...
- *
- * For most things in MediaKit, low latency is important.  Having a large ring
- * buffer will make latency worse.  It will, however, increase buffering, so
- * will cause fewer frames to be dropped in high CPU load times.  This will
- * need some tweaking.
- *
- * Note, RING_BUFFER_SIZE must be a power of two.
+ * Bounds for the number of times a thread checks the other end of the pipe
+ * before sleeping.  The limit for each wait doubles when the wait ends while
+ * spinning and halves when the thread has to sleep, so a pipe whose ends keep
+ * up with each other never sleeps, and one whose other end is idle stops
+ * wasting time spinning.
  */
-#define RING_BUFFER_SIZE 16
-#define RING_BUFFER_MASK (RING_BUFFER_SIZE - 1)
+#define MIN_SPIN 16
+#define INITIAL_SPIN 256
+#define MAX_SPIN 8192
 
 /**
- * GCC 4.1 provides atomic operations which impose memory barriers.  These are
- * not needed on x86, but might be on other platforms (anything that does not
- * enforce strong ordering of memory operations, e.g. Itanium or Alpha).
+ * Largest capacity a pipe can have, so the ring sizes fit the 32-bit
+ * counters.
  */
-#if __GNUC__ < 4 || (__GNUC__ == 4 && __GNUC_MINOR__ < 1)
-#warning Potentially unsafe memory operations being used
-static inline void __sync_fetch_and_add(unsigned long *ptr, unsigned int value)
+#define MAX_CAPACITY ((NSUInteger)1 << 31)
+
+#ifdef __ATOMIC_ACQUIRE
+#   define LOAD_ACQUIRE(p) __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#   define STORE_RELEASE(p, v) __atomic_store_n(p, v, __ATOMIC_RELEASE)
+#else
+static inline uint32_t loadAcquire(volatile uint32_t *p)
 {
-    *ptr += value;
+    uint32_t value = *p;
+    __sync_synchronize();
+    return value;
 }
+#   define LOAD_ACQUIRE(p) loadAcquire(p)
+#   define STORE_RELEASE(p, v) do { __sync_synchronize(); *(p) = (v); } while (0)
 #endif
 
 /**
- * Check how much space is in the queue.  The number of used elements in the
- * queue is always equal to producer - consumer.   Producer will always
- * overflow before consumer (because you can't remove objects that have not
- * been inserted.  In this case, the subtraction will be something along the
- * lines of (0 - (2^32 - 14)).  This will be -(2^32 - 14), however this value
- * can't be represented in a 32-bit integer and so will overflow to 14, giving
- * the correct result, irrespective of overflow.
- */
-#define SPACE(producer, consumer) (RING_BUFFER_SIZE - (producer - consumer))
-/**
- * The buffer is full if there is no space in it.
- */
-#define ISFULL(producer, consumer) (SPACE(producer, consumer) == 0)
-/**
- * The buffer is empty if there is no data in it.
+ * A single-producer, single-consumer ring buffer.  There is one for requests
+ * and one for replies.
+ *
+ * The number of used elements is always equal to producer - consumer, even
+ * after the free-running counters overflow, and converting them to array
+ * indexes is a masking operation, since the size is a power of two.
+ *
+ * Each end only writes to its own cache line: the counter it advances, the
+ * flag telling the other end that it sleeps, and its spin limit.
  */
-#define ISEMPTY(producer, consumer) ((producer - consumer) == 0)
+struct ETPipeRing
+{
+    id *slots;
+    uint32_t mask;
+    volatile uint32_t producer __attribute__((aligned(CACHE_LINE_SIZE)));
+    volatile int producerWaiting;
+    unsigned int producerSpin;
+    volatile uint32_t consumer __attribute__((aligned(CACHE_LINE_SIZE)));
+    volatile int consumerWaiting;
+    unsigned int consumerSpin;
+};
+
+static struct ETPipeRing *ringNew(uint32_t size)
+{
+    struct ETPipeRing *ring;
+
+    if (0 != posix_memalign((void**)&ring, CACHE_LINE_SIZE, sizeof(struct ETPipeRing)))
+    {
+        return NULL;
+    }
+    ring->slots = calloc(size, sizeof(id));
+    if (NULL == ring->slots)
+    {
+        free(ring);
+        return NULL;
+    }
+    ring->mask = size - 1;
+    ring->producer = 0;
+    ring->producerWaiting = 0;
+    ring->producerSpin = INITIAL_SPIN;
+    ring->consumer = 0;
+    ring->consumerWaiting = 0;
+    ring->consumerSpin = INITIAL_SPIN;
+    return ring;
+}
+
+static void ringFree(struct ETPipeRing *ring)
+{
+    if (NULL == ring)
+    {
+        return;
+    }
+    free(ring->slots);
+    free(ring);
+}
+
+static BOOL hasSpace(struct ETPipeRing *ring)
+{
+    return LOAD_ACQUIRE(&ring->consumer) + ring->mask + 1 != ring->producer;
+}
+
+static BOOL hasItems(struct ETPipeRing *ring)
+{
+    return LOAD_ACQUIRE(&ring->producer) != ring->consumer;
+}
+
 /**
- * Converting the free running counters to array indexes is a masking
- * operation.  For this to work, the buffer size must be a power of two.
- * RING_BUFFER_MASK = RING_BUFFER_SIZE - 1.  If RING_BUFFER_SIZE is 256, we
- * want the lowest 8 bits of the index, which is obtained by ANDing the value
- * with 255.  Any power of two may be selected.  Non power-of-two values could
- * be used if a more complex mapping operation were chosen, but this one is
- * nice and cheap.
+ * Takes the next object from the ring, which must not be empty.
  */
-#define MASK(index) ((index) & RING_BUFFER_MASK)
+static inline id take(struct ETPipeRing *ring)
+{
+    uint32_t consumer = ring->consumer;
+    id obj = ring->slots[consumer & ring->mask];
+    ring->slots[consumer & ring->mask] = nil;
+    STORE_RELEASE(&ring->consumer, consumer + 1);
+    return obj;
+}
+
+static inline void cpuRelax(void)
+{
+#if defined(__i386__) || defined(__x86_64__)
+    __asm__ __volatile__("pause");
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
 /**
- * Inserting an element into the queue involves the following steps:
- *
- * 1) Check that there is space in the buffer.
- *     Spin if there isn't any.
- * 2) Add the invocation to the ring buffer.
- * 3) Increment the producer counter.
- * 4) If the queue was previously empty, we need to transition back to lockless
- * mode.  This is done by signalling the condition variable that the other
- * thread will be waiting on if it is in blocking mode.
- *
- * If the queue is full then we poke the condition variable periodically.  This
- * is not required when the condition variable is not shared, but when more than
- * one thread consumes the data, it needs to be signaled in order to wake a
- * thread that will remove an element from the buffer.
+ * Waits until ready(ring) returns YES.  Spins first, then sets the waiting
+ * flag and sleeps on the condition until the other end signals it.  Returns
+ * NO if the pipe was disconnected before.
  */
-#define INSERT(x,direction) do {\
-    int count = 0;\
-    /* Wait for space in the buffer */\
-    while (ISFULL(direction ## Producer, direction ## Consumer))\
-    {\
-        if (++count % 20 == 0)\
-        {\
-            [direction ## Condition signal];\
-        }\
-        if (count % 39 == 0)\
-        {\
-            sched_yield();\
-        }\
-    }\
-    queue[MASK(direction ## Producer)] = x;\
-    __sync_fetch_and_add(&direction ## Producer, 1);\
-    if (direction ## Producer - direction ## Consumer == 1)\
-    {\
-        [direction ## Condition lock];\
-        [direction ## Condition signal];\
-        [direction ## Condition unlock];\
-    }\
-} while(0)
+static BOOL waitFor(struct ETPipeRing *ring,
+                    BOOL (*ready)(struct ETPipeRing*),
+                    unsigned int *spinLimit,
+                    volatile int *waiting,
+                    NSCondition *condition,
+                    volatile BOOL *disconnected)
+{
+    unsigned int limit = *spinLimit;
+
+    for (unsigned int i=0 ; i<limit ; i++)
+    {
+        if (ready(ring))
+        {
+            *spinLimit = MIN(limit * 2, MAX_SPIN);
+            return YES;
+        }
+        if (*disconnected)
+        {
+            return NO;
+        }
+        cpuRelax();
+    }
+    *spinLimit = MAX(limit / 2, MIN_SPIN);
+
+    [condition lock];
+    *waiting = 1;
+    /* Either we see the other end's change, or it sees the flag */
+    __sync_synchronize();
+    while (!ready(ring) && !*disconnected)
+    {
+        [condition wait];
+    }
+    *waiting = 0;
+    [condition unlock];
+    return ready(ring);
+}
+
 /**
- * Removing an element from the queue involves the following steps:
- *
- * 1) Wait until the queue has messages waiting.  If there are none, enter
- * blocking mode.  The additional test inside the mutex ensures that a
- * transition from blocking to non-blocking mode will not be missed, since the
- * condition variable can only be signalled when the producer thread has the
- * mutex.
- * 2) Read the invocation from the buffer.
- * 3) Increment the consumer counter.
+ * Wakes up the other end if it sleeps (or always, if its condition may be
+ * shared with other pipes).
  */
-#define REMOVE(x,direction) do {\
-    if (ISEMPTY(direction ## Producer, direction ## Consumer))\
-    {\
-        if (disconnect) { return nil; }\
-        else\
-        {\
-            [direction ## Condition lock];\
-            if (ISEMPTY(direction ## Producer, direction ## Consumer))\
-            {\
-                [direction ## Condition wait];\
-            }\
-            [direction ## Condition unlock];\
-        }\
-    }\
-    x = queue[MASK(direction ## Consumer)];\
-    queue[MASK(direction ## Consumer)] = nil;\
-    __sync_fetch_and_add(&direction ## Consumer, 1);\
-} while(0)
+static inline void notify(volatile int *waiting, NSCondition *condition, BOOL always)
+{
+    __sync_synchronize();
+    if (*waiting || always)
+    {
+        [condition lock];
+        [condition broadcast];
+        [condition unlock];
+    }
+}
 
 @interface ETObjectPipe ()
 {
-    /** The ring buffer. */
-    id queue[RING_BUFFER_SIZE];
-    /** Producer free-running counter for requests. */
-    uint32_t requestProducer;
-    /** Consumer free-running counter for requests. */
-    uint32_t requestConsumer;
-    /** Producer free-running counter for replies. */
-    uint32_t replyProducer;
-    /** Consumer free-running counter for replies. */
-    uint32_t replyConsumer;
+    /** Requests, sent by the front end to the back end. */
+    struct ETPipeRing *requests;
+    /** Replies, sent by the back end to the front end. */
+    struct ETPipeRing *replies;
     /** 
-     * Condition variable used to signal a transition from locked to lockless
-     * mode for requests.
+     * Condition variable the back end (handling requests) sleeps on.
      */
     NSCondition *requestCondition;
     /** 
-     * Condition variable used to signal a transition from locked to lockless
-     * mode for replies.
+     * Condition variable the front end (receiving replies) sleeps on.
      */
     NSCondition *replyCondition;
+    /**
+     * Set when the request condition was set with -setRequestCondition:, in
+     * which case the back end may wait on it without the pipe knowing.
+     */
+    BOOL sharedRequestCondition;
     /** Flag used to interrupt the object in locked mode */
     volatile BOOL disconnect;
 }
@@ -155,11 +208,28 @@ static inline void __sync_fetch_and_add(unsigned long *ptr, unsigned int value)
 
 @implementation ETObjectPipe
 - (id)init
+{
+    return [self initWithCapacity: ETObjectPipeDefaultCapacity];
+}
+- (id)initWithCapacity: (NSUInteger)aCapacity
 {
     SUPERINIT;
+    if (aCapacity > MAX_CAPACITY)
+    {
+        [self release];
+        return nil;
+    }
+    uint32_t size = 2;
+    while (size < aCapacity)
+    {
+        size <<= 1;
+    }
+    requests = ringNew(size);
+    replies = ringNew(size);
     requestCondition  = [NSCondition new];
     replyCondition  = [NSCondition new];
-    if (NULL == queue || nil == replyCondition || nil == requestCondition)
+    if (NULL == requests || NULL == replies 
+        || nil == replyCondition || nil == requestCondition)
     {
         [self release];
         return nil;
@@ -168,53 +238,134 @@ static inline void __sync_fetch_and_add(unsigned long *ptr, unsigned int value)
 }
 - (void)dealloc
 {
-    for (unsigned int i=0 ; i<RING_BUFFER_SIZE ; i++)
-    {
-        [queue[i] release];
-    }
+    ringFree(requests);
+    ringFree(replies);
     [requestCondition release];
     [replyCondition release];
     [super dealloc];
 }
-- (void)sendRequest: (id)anObject
+- (NSUInteger)capacity
 {
-    if (disconnect) { return; }
-    INSERT(anObject, request);
+    return requests->mask + 1;
+}
+- (BOOL)sendRequest: (id)anObject
+{
+    if (!hasSpace(requests) 
+        && (disconnect
+            || !waitFor(requests, hasSpace, &requests->producerSpin,
+                        &requests->producerWaiting, replyCondition, &disconnect)))
+    {
+        [anObject release];
+        return NO;
+    }
+    uint32_t producer = requests->producer;
+    requests->slots[producer & requests->mask] = anObject;
+    STORE_RELEASE(&requests->producer, producer + 1);
+    /* Don't read a consumer position from before the store */
+    __sync_synchronize();
+    notify(&requests->consumerWaiting, requestCondition,
+           sharedRequestCondition && producer == requests->consumer);
+    return YES;
+}
+- (void)sendRequests: (NSArray*)objects
+{
+    NSUInteger count = [objects count];
+    NSUInteger sent = 0;
+
+    while (sent < count)
+    {
+        if (!hasSpace(requests)
+            && (disconnect
+                || !waitFor(requests, hasSpace, &requests->producerSpin,
+                            &requests->producerWaiting, replyCondition, &disconnect)))
+        {
+            return;
+        }
+        uint32_t producer = requests->producer;
+        uint32_t consumer = LOAD_ACQUIRE(&requests->consumer);
+        NSUInteger space = requests->mask + 1 - (producer - consumer);
+        NSUInteger n = MIN(space, count - sent);
+
+        for (NSUInteger i=0 ; i<n ; i++)
+        {
+            requests->slots[(producer + i) & requests->mask] = 
+                [objects objectAtIndex: sent + i];
+        }
+        STORE_RELEASE(&requests->producer, producer + (uint32_t)n);
+        sent += n;
+        __sync_synchronize();
+        notify(&requests->consumerWaiting, requestCondition,
+               sharedRequestCondition && producer == requests->consumer);
+    }
 }
 - (id)nextRequest
 {
-    id obj;
-    REMOVE(obj, request);
+    if (!hasItems(requests)
+        && !waitFor(requests, hasItems, &requests->consumerSpin,
+                    &requests->consumerWaiting, requestCondition, &disconnect))
+    {
+        return nil;
+    }
+    id obj = take(requests);
+    notify(&requests->producerWaiting, replyCondition, NO);
     return obj;
 }
+- (NSUInteger)drainRequestsInto: (NSMutableArray*)anArray
+{
+    if (!hasItems(requests)
+        && !waitFor(requests, hasItems, &requests->consumerSpin,
+                    &requests->consumerWaiting, requestCondition, &disconnect))
+    {
+        return 0;
+    }
+    uint32_t producer = LOAD_ACQUIRE(&requests->producer);
+    uint32_t consumer = requests->consumer;
+    NSUInteger count = producer - consumer;
+
+    for (uint32_t i=consumer ; i!=producer ; i++)
+    {
+        [anArray addObject: requests->slots[i & requests->mask]];
+        requests->slots[i & requests->mask] = nil;
+    }
+    STORE_RELEASE(&requests->consumer, producer);
+    notify(&requests->producerWaiting, replyCondition, NO);
+    return count;
+}
 - (id)pollForRequest
 {
-    if (ISEMPTY(requestProducer, requestConsumer))
+    if (!hasItems(requests))
     {
         return nil;
     }
-    id obj = queue[MASK(requestConsumer)];
-    queue[MASK(requestConsumer)] = nil;
-    __sync_fetch_and_add(&requestConsumer, 1);
+    id obj = take(requests);
+    notify(&requests->producerWaiting, replyCondition, NO);
     return obj;
 }
 - (BOOL)isPipeFull
 {
-    return ISFULL(requestProducer, replyConsumer);
+    // Requests sent, minus replies collected, are the objects in flight.
+    return requests->producer - replies->consumer > requests->mask;
+}
+- (BOOL)hasRequests
+{
+    return hasItems(requests);
+}
+- (BOOL)hasReplies
+{
+    return hasItems(replies);
 }
 - (id)pollForReply
 {
     // If there is a reply waiting, get it without blocking
-    if (replyConsumer < replyProducer)
+    if (hasItems(replies))
     {
-        id reply = queue[MASK(replyConsumer)];
-        queue[MASK(replyConsumer)] = nil;
-        __sync_fetch_and_add(&replyConsumer, 1);
+        id reply = take(replies);
+        notify(&replies->producerWaiting, requestCondition, NO);
         return reply;
     }
     // If the queue is not full, return and let the caller create a new request
     // object to insert.
-    else if (!ISFULL(requestProducer, replyConsumer))
+    else if (![self isPipeFull])
     {
         return nil;
     }
@@ -228,23 +379,46 @@ static inline void __sync_fetch_and_add(unsigned long *ptr, unsigned int value)
 - (void)setRequestCondition: (NSCondition*)aCondition
 {
     ASSIGN(requestCondition, aCondition);
+    sharedRequestCondition = YES;
 }
-- (void)sendReply: (id)anObject
+- (BOOL)sendReply: (id)anObject
 {
-    if (disconnect) { return; }
-    INSERT(anObject, reply);
+    if (!hasSpace(replies)
+        && (disconnect
+            || !waitFor(replies, hasSpace, &replies->producerSpin,
+                        &replies->producerWaiting, requestCondition, &disconnect)))
+    {
+        [anObject release];
+        return NO;
+    }
+    uint32_t producer = replies->producer;
+    replies->slots[producer & replies->mask] = anObject;
+    STORE_RELEASE(&replies->producer, producer + 1);
+    notify(&replies->consumerWaiting, replyCondition, NO);
+    return YES;
 }
 - (id)nextReply
 {
-    id obj;
-    REMOVE(obj, reply);
+    if (!hasItems(replies)
+        && !waitFor(replies, hasItems, &replies->consumerSpin,
+                    &replies->consumerWaiting, replyCondition, &disconnect))
+    {
+        return nil;
+    }
+    id obj = take(replies);
+    notify(&replies->producerWaiting, requestCondition, NO);
     return obj;
 }
 - (void)disconnect
 {
     disconnect = YES;
+    __sync_synchronize();
     // Wake up any threads that are waiting on either end.
+    [requestCondition lock];
     [requestCondition broadcast];
+    [requestCondition unlock];
+    [replyCondition lock];
     [replyCondition broadcast];
+    [replyCondition unlock];
 }
 @end
@@ -0,0 +1,137 @@
+/*
+    ETPipeline.h
+
+    Copyright (C) 2026 The Etoile Project
+
+    Date:  October 2026
+    License:  Modified BSD (see COPYING)
+ */
+
+#import <Foundation/Foundation.h>
+
+@class ETThreadPool;
+
+/**
+ * A stage of an ETPipeline.
+ *
+ * Filters work on buffers, which are recycled: once a filter has processed an
+ * input buffer, the buffer goes back to the previous stage (or to the
+ * pipeline's user for the first stage) to be filled again.
+ */
+@protocol ETPipelineFilter <NSObject>
+/**
+ * Processes anInput and writes the result into anOutput, which is either a
+ * new buffer or one that the next stage has finished with.  Returns YES if
+ * anOutput must be passed to the next stage, or NO if there is nothing to
+ * pass on yet, in which case anOutput is given again with the next input.
+ */
+- (BOOL)processBuffer: (id)anInput intoBuffer: (id)anOutput;
+@optional
+/**
+ * Returns a new output buffer, owned by the caller, when none can be
+ * recycled.  Defaults to an empty NSMutableData.
+ */
+- (id)newOutputBuffer;
+@end
+
+/**
+ * Statistics about a stage of an ETPipeline.
+ */
+typedef struct
+{
+    /** Number of input buffers processed. */
+    unsigned long long processedCount;
+    /** Number of times the stage had to wait for input. */
+    unsigned long long inputStallCount;
+    /** Number of times the stage had to wait for the next stage. */
+    unsigned long long outputStallCount;
+    /** Buffers processed per second since the pipeline started. */
+    double throughput;
+} ETPipelineStageStatistics;
+
+/**
+ * The ETPipeline class runs a chain of filters concurrently.
+ *
+ * Consecutive filters are connected by ETObjectPipe instances: a stage
+ * receives its input buffers as requests on one pipe, sends them back as
+ * replies once processed, and sends its output buffers as requests on the
+ * next pipe.  The number of buffers in flight between two stages is bounded
+ * by the pipe capacity, so a slow stage holds back the previous ones instead
+ * of letting buffers accumulate.
+ *
+ * Each stage runs either in its own thread, or as a task on an ETThreadPool
+ * which is scheduled whenever it can make progress.  A stage never runs
+ * concurrently with itself, so filters need not be thread-safe.
+ *
+ * The user of the pipeline is the front end of the first pipe and the back
+ * end of the last one:
+ *
+ * <example>
+ * id buffer = [pipeline recycledInput];
+ * if (nil == buffer)
+ * {
+ *     buffer = [NSMutableData new];
+ * }
+ * // Fill the buffer...
+ * [pipeline sendInput: buffer];
+ *
+ * // Elsewhere:
+ * id output = [pipeline nextOutput];
+ * // Use the output...
+ * [pipeline recycleOutput: output];
+ * </example>
+ */
+@interface ETPipeline : NSObject
+/**
+ * Initialises a pipeline running each filter in its own thread, with at most
+ * aCapacity buffers in flight between consecutive stages.
+ */
+- (id)initWithFilters: (NSArray*)filters capacity: (NSUInteger)aCapacity;
+/**
+ * Initialises a pipeline running the filters as tasks on aPool, with at most
+ * aCapacity buffers in flight between consecutive stages.
+ */
+- (id)initWithFilters: (NSArray*)filters
+           threadPool: (ETThreadPool*)aPool
+             capacity: (NSUInteger)aCapacity;
+/**
+ * Returns a buffer the first stage has finished with, nil if a new one should
+ * be created, or waits for a buffer if the first pipe is full.
+ *
+ * Must be called before each -sendInput:.
+ */
+- (id)recycledInput;
+/**
+ * Passes aBuffer to the first stage.  The pipeline takes over the caller's
+ * reference to the buffer, and releases it if the pipeline was disconnected.
+ */
+- (void)sendInput: (id)aBuffer;
+/**
+ * Waits for a buffer produced by the last stage and returns it, or returns
+ * nil once the pipeline is disconnected.
+ */
+- (id)nextOutput;
+/**
+ * Returns a buffer produced by the last stage if there is one, nil otherwise.
+ */
+- (id)pollForOutput;
+/**
+ * Gives back a buffer obtained from -nextOutput or -pollForOutput, so the
+ * last stage can reuse it.
+ */
+- (void)recycleOutput: (id)aBuffer;
+/**
+ * Stops the stages and disconnects the pipes, waiting for the stages to
+ * finish the buffers they are processing.  Buffers still in flight are
+ * released.
+ */
+- (void)disconnect;
+/**
+ * Returns the number of stages.
+ */
+- (NSUInteger)stageCount;
+/**
+ * Returns statistics about the stage at anIndex.
+ */
+- (ETPipelineStageStatistics)statisticsForStageAtIndex: (NSUInteger)anIndex;
+@end
@@ -0,0 +1,394 @@
+/*
+    ETPipeline.m
+
+    Copyright (C) 2026 The Etoile Project
+
+    Date:  October 2026
+    License:  Modified BSD (see COPYING)
+ */
+
+#import "ETPipeline.h"
+#import "ETObjectPipe.h"
+#import "ETThreadPool.h"
+#import "../Headers/Macros.h"
+#include <pthread.h>
+
+/**
+ * Maximum number of buffers a pooled stage processes before giving its worker
+ * back to the pool.
+ */
+#define BATCH_SIZE 32
+
+@class ETPipelineStage;
+
+@interface ETPipeline ()
+{
+    NSArray *stages;
+    /** Pipes between the stages.  There is one more pipe than stages. */
+    NSArray *pipes;
+    ETThreadPool *threadPool;
+    NSTimeInterval startTime;
+    volatile BOOL stopping;
+    /** Number of stage threads running or stage tasks scheduled. */
+    NSUInteger activeStages;
+    pthread_mutex_t activeLock;
+    pthread_cond_t activeChanged;
+}
+- (void)scheduleStageAtIndex: (NSUInteger)anIndex;
+- (void)stageDidStop;
+- (BOOL)isStopping;
+@end
+
+/**
+ * A filter with its input and output pipes.
+ */
+@interface ETPipelineStage : NSObject
+{
+    @public
+    ETPipeline *pipeline;
+    NSUInteger index;
+    id<ETPipelineFilter> filter;
+    ETObjectPipe *input;
+    ETObjectPipe *output;
+    /** Output buffer the filter did not pass on, to reuse with the next input. */
+    id pendingOutput;
+    /** Set while the stage is submitted to, or running in, the pool. */
+    volatile int scheduled;
+    unsigned long long processedCount;
+    unsigned long long inputStallCount;
+    unsigned long long outputStallCount;
+}
+@end
+
+@implementation ETPipelineStage
+
+- (void)dealloc
+{
+    [filter release];
+    [input release];
+    [output release];
+    [pendingOutput release];
+    [super dealloc];
+}
+
+/**
+ * Returns a buffer to write output into: the pending one, one recycled by the
+ * next stage or a new one.  Waits if the output pipe is full and blocking is
+ * allowed, otherwise returns nil.
+ */
+- (id)outputBufferWaiting: (BOOL)canBlock
+{
+    id buffer = pendingOutput;
+
+    if (nil != buffer)
+    {
+        pendingOutput = nil;
+        return buffer;
+    }
+    if ([output isPipeFull] && ![output hasReplies])
+    {
+        outputStallCount++;
+        if (!canBlock)
+        {
+            return nil;
+        }
+    }
+    buffer = [output pollForReply];
+    if (nil == buffer && ![pipeline isStopping])
+    {
+        if ([filter respondsToSelector: @selector(newOutputBuffer)])
+        {
+            buffer = [filter newOutputBuffer];
+        }
+        else
+        {
+            buffer = [NSMutableData new];
+        }
+    }
+    return buffer;
+}
+
+/**
+ * Runs the filter on one input buffer and hands over the results.
+ */
+- (void)processInput: (id)inputBuffer intoBuffer: (id)outputBuffer
+{
+    BOOL forward = [filter processBuffer: inputBuffer intoBuffer: outputBuffer];
+
+    processedCount++;
+    [input sendReply: inputBuffer];
+    if (forward)
+    {
+        [output sendRequest: outputBuffer];
+    }
+    else
+    {
+        pendingOutput = outputBuffer;
+    }
+}
+
+- (void)runInThread: (id)sender
+{
+    while (![pipeline isStopping])
+    {
+        NSAutoreleasePool *pool = [NSAutoreleasePool new];
+        id inputBuffer = [input pollForRequest];
+
+        if (nil == inputBuffer)
+        {
+            inputStallCount++;
+            inputBuffer = [input nextRequest];
+        }
+        if (nil == inputBuffer)
+        {
+            [pool release];
+            break;
+        }
+
+        id outputBuffer = [self outputBufferWaiting: YES];
+        if (nil == outputBuffer)
+        {
+            [input sendReply: inputBuffer];
+            [pool release];
+            break;
+        }
+        [self processInput: inputBuffer intoBuffer: outputBuffer];
+        [pool release];
+    }
+    [pipeline stageDidStop];
+}
+
+/**
+ * Returns YES if the stage can process a buffer without waiting.
+ */
+- (BOOL)canMakeProgress
+{
+    return [input hasRequests]
+        && (nil != pendingOutput || [output hasReplies] || ![output isPipeFull]);
+}
+
+static void runStage(void *context)
+{
+    ETPipelineStage *stage = context;
+    [stage runBatch];
+}
+
+- (void)runBatch
+{
+    NSUInteger count = 0;
+
+    while (count < BATCH_SIZE && ![pipeline isStopping])
+    {
+        if (![input hasRequests])
+        {
+            inputStallCount++;
+            break;
+        }
+        id outputBuffer = [self outputBufferWaiting: NO];
+        if (nil == outputBuffer)
+        {
+            break;
+        }
+        [self processInput: [input pollForRequest] intoBuffer: outputBuffer];
+        count++;
+        /* The neighbours may now be able to make progress */
+        [pipeline scheduleStageAtIndex: index + 1];
+        if (index > 0)
+        {
+            [pipeline scheduleStageAtIndex: index - 1];
+        }
+    }
+
+    /* Full barrier, so a neighbour either sees the flag cleared or we see
+       what it sent */
+    __sync_lock_release(&scheduled);
+    __sync_synchronize();
+    if (![pipeline isStopping] && [self canMakeProgress])
+    {
+        [pipeline scheduleStageAtIndex: index];
+    }
+    [pipeline stageDidStop];
+}
+
+@end
+
+@implementation ETPipeline
+
+- (id)initWithFilters: (NSArray*)filters capacity: (NSUInteger)aCapacity
+{
+    return [self initWithFilters: filters threadPool: nil capacity: aCapacity];
+}
+
+- (id)initWithFilters: (NSArray*)filters
+           threadPool: (ETThreadPool*)aPool
+             capacity: (NSUInteger)aCapacity
+{
+    SUPERINIT;
+    NSUInteger count = [filters count];
+    NSMutableArray *newPipes = [NSMutableArray arrayWithCapacity: count + 1];
+    NSMutableArray *newStages = [NSMutableArray arrayWithCapacity: count];
+
+    for (NSUInteger i=0 ; i<=count ; i++)
+    {
+        ETObjectPipe *pipe = [[ETObjectPipe alloc] initWithCapacity: aCapacity];
+        [newPipes addObject: pipe];
+        [pipe release];
+    }
+    for (NSUInteger i=0 ; i<count ; i++)
+    {
+        ETPipelineStage *stage = [ETPipelineStage new];
+        stage->pipeline = self;
+        stage->index = i;
+        stage->filter = [[filters objectAtIndex: i] retain];
+        stage->input = [[newPipes objectAtIndex: i] retain];
+        stage->output = [[newPipes objectAtIndex: i + 1] retain];
+        [newStages addObject: stage];
+        [stage release];
+    }
+    pipes = [newPipes copy];
+    stages = [newStages copy];
+    threadPool = [aPool retain];
+    pthread_mutex_init(&activeLock, NULL);
+    pthread_cond_init(&activeChanged, NULL);
+    startTime = [NSDate timeIntervalSinceReferenceDate];
+
+    if (nil == threadPool)
+    {
+        activeStages = count;
+        for (ETPipelineStage *stage in stages)
+        {
+            [NSThread detachNewThreadSelector: @selector(runInThread:)
+                                     toTarget: stage
+                                   withObject: nil];
+        }
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    [self disconnect];
+    /* The stages have stopped, so collect the buffers left in the pipes */
+    for (ETObjectPipe *pipe in pipes)
+    {
+        while ([pipe hasRequests])
+        {
+            [[pipe pollForRequest] release];
+        }
+        while ([pipe hasReplies])
+        {
+            [[pipe nextReply] release];
+        }
+    }
+    [stages release];
+    [pipes release];
+    [threadPool release];
+    pthread_mutex_destroy(&activeLock);
+    pthread_cond_destroy(&activeChanged);
+    [super dealloc];
+}
+
+- (BOOL)isStopping
+{
+    return stopping;
+}
+
+- (void)scheduleStageAtIndex: (NSUInteger)anIndex
+{
+    if (nil == threadPool || anIndex >= [stages count])
+    {
+        return;
+    }
+    ETPipelineStage *stage = [stages objectAtIndex: anIndex];
+    if (stage->scheduled || !__sync_bool_compare_and_swap(&stage->scheduled, 0, 1))
+    {
+        return;
+    }
+    /* Checked under the lock, so -disconnect either waits for the task or
+       the task is not submitted */
+    pthread_mutex_lock(&activeLock);
+    if (stopping)
+    {
+        pthread_mutex_unlock(&activeLock);
+        return;
+    }
+    activeStages++;
+    pthread_mutex_unlock(&activeLock);
+    [threadPool submitFunction: runStage context: stage];
+}
+
+- (void)stageDidStop
+{
+    pthread_mutex_lock(&activeLock);
+    activeStages--;
+    pthread_cond_broadcast(&activeChanged);
+    pthread_mutex_unlock(&activeLock);
+}
+
+- (id)recycledInput
+{
+    return [[pipes objectAtIndex: 0] pollForReply];
+}
+
+- (void)sendInput: (id)aBuffer
+{
+    [[pipes objectAtIndex: 0] sendRequest: aBuffer];
+    [self scheduleStageAtIndex: 0];
+}
+
+- (id)nextOutput
+{
+    return [[pipes lastObject] nextRequest];
+}
+
+- (id)pollForOutput
+{
+    return [[pipes lastObject] pollForRequest];
+}
+
+- (void)recycleOutput: (id)aBuffer
+{
+    [[pipes lastObject] sendReply: aBuffer];
+    [self scheduleStageAtIndex: [stages count] - 1];
+}
+
+- (void)disconnect
+{
+    if (stopping)
+    {
+        return;
+    }
+    pthread_mutex_lock(&activeLock);
+    stopping = YES;
+    pthread_mutex_unlock(&activeLock);
+    for (ETObjectPipe *pipe in pipes)
+    {
+        [pipe disconnect];
+    }
+    pthread_mutex_lock(&activeLock);
+    while (activeStages > 0)
+    {
+        pthread_cond_wait(&activeChanged, &activeLock);
+    }
+    pthread_mutex_unlock(&activeLock);
+}
+
+- (NSUInteger)stageCount
+{
+    return [stages count];
+}
+
+- (ETPipelineStageStatistics)statisticsForStageAtIndex: (NSUInteger)anIndex
+{
+    ETPipelineStage *stage = [stages objectAtIndex: anIndex];
+    NSTimeInterval elapsed = [NSDate timeIntervalSinceReferenceDate] - startTime;
+    ETPipelineStageStatistics statistics;
+
+    statistics.processedCount = stage->processedCount;
+    statistics.inputStallCount = stage->inputStallCount;
+    statistics.outputStallCount = stage->outputStallCount;
+    statistics.throughput = (elapsed > 0) ? stage->processedCount / elapsed : 0;
+    return statistics;
+}
+
+@end
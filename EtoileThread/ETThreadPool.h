@@ -0,0 +1,129 @@
+/*
+    ETThreadPool.h
+
+    Copyright (C) 2026 The Etoile Project
+
+    Date:  October 2026
+    License:  Modified BSD (see COPYING)
+ */
+
+#import <Foundation/Foundation.h>
+#import "ETExecutor.h"
+
+/**
+ * A task run by an ETThreadPool: a function and the argument passed to it.
+ */
+typedef void (*ETThreadPoolFunction)(void *context);
+/**
+ * A function waiting for an event for at most the given number of nanoseconds
+ * (0 to only check for it), and returning whether the event has happened.
+ */
+typedef BOOL (*ETThreadPoolWaitFunction)(void *context, unsigned long nanoseconds);
+
+/**
+ * The ETThreadPool class runs tasks on a fixed set of worker threads.
+ *
+ * Each worker has its own deque of tasks.  Tasks submitted from a worker are
+ * added to that worker's deque, and tasks submitted from other threads are
+ * distributed between the workers.  A worker runs the tasks in its deque in
+ * the order in which they were added, oldest first, and when its own deque is
+ * empty, steals the most recently added task from another worker.  Workers
+ * with nothing to steal sleep until a task is submitted.
+ *
+ * Each task runs under its own autorelease pool, and exceptions it raises
+ * are logged.  Tasks must not block for long: a blocked task keeps its worker
+ * away from the other tasks, and if all the workers block waiting for tasks
+ * that have not run yet, the pool deadlocks.  Tasks that have to wait for
+ * other tasks should wait with -waitWithFunction:context:, which runs the
+ * pending tasks meanwhile.  Sends to threaded objects and futures do so when
+ * called from a worker.
+ *
+ * The pool is used to run threaded objects as mailboxes (see
+ * [NSObject(Threaded)+pooledNew]), instead of giving each one a thread.
+ */
+@interface ETThreadPool : NSObject
+/**
+ * Returns the pool shared by the pooled threaded objects.  It is created on
+ * first use with +sharedPoolWorkerCount workers.
+ */
++ (ETThreadPool *) sharedPool;
+/**
+ * Returns the number of workers the shared pool has, or will have when
+ * created.  Defaults to the number of active processors.
+ */
++ (NSUInteger) sharedPoolWorkerCount;
+/**
+ * Sets the number of workers of the shared pool.  Has no effect once the
+ * shared pool has been created.
+ */
++ (void) setSharedPoolWorkerCount: (NSUInteger)aCount;
+/**
+ * Returns the pool running the current task, or nil if the caller is not a
+ * worker thread.
+ */
++ (ETThreadPool *) currentPool;
+/**
+ * Initialises a pool with aCount worker threads.  A count of 0 means one
+ * worker per active processor.
+ *
+ * The workers retain the pool until it is shut down.
+ */
+- (id) initWithWorkerCount: (NSUInteger)aCount;
+/**
+ * Schedules aFunction(aContext) to run on one of the workers.
+ */
+- (void) submitFunction: (ETThreadPoolFunction)aFunction context: (void*)aContext;
+/**
+ * Runs one pending task in the calling worker, if there is one, and returns
+ * YES.  Returns NO if there was nothing to run or if the caller is not one of
+ * the receiver's workers.
+ *
+ * A task which must wait for the other tasks to make progress can call this
+ * instead of blocking its worker, or use -waitWithFunction:context:.
+ */
+- (BOOL) runPendingTask;
+/**
+ * Waits until aFunction(aContext, timeout) returns YES.
+ *
+ * When called from one of the receiver's workers, runs the pending tasks in
+ * the meantime, since the event may depend on them, and only waits in
+ * aFunction while there is nothing to run, for increasingly long periods so
+ * that tasks submitted in the meantime are noticed.  Otherwise, simply waits
+ * in aFunction.
+ *
+ * The tasks run by the waiting worker must not depend on the waiting task
+ * finishing first, since it sits lower on the same stack.  Past a few nested
+ * waits, the worker stops running other tasks and just blocks.
+ */
+- (void) waitWithFunction: (ETThreadPoolWaitFunction)aFunction context: (void*)aContext;
+/**
+ * Stops the workers once the tasks already submitted have run.  Tasks must not
+ * be submitted afterwards.
+ */
+- (void) shutdown;
+/**
+ * Returns the number of worker threads.
+ */
+- (NSUInteger) workerCount;
+/**
+ * Returns the number of tasks submitted but not yet started.
+ */
+- (NSUInteger) pendingTaskCount;
+/**
+ * Returns the number of tasks run since the pool was created.
+ */
+- (unsigned long long) executedTaskCount;
+/**
+ * Returns the number of tasks run by another worker than the one they were
+ * submitted to.
+ */
+- (unsigned long long) stolenTaskCount;
+@end
+
+#if __has_feature(blocks)
+/**
+ * Makes thread pools executors, which run blocks as tasks on their workers.
+ */
+@interface ETThreadPool (ETExecutor) <ETExecutor>
+@end
+#endif
@@ -0,0 +1,455 @@
+/*
+    ETThreadPool.m
+
+    Copyright (C) 2026 The Etoile Project
+
+    Date:  October 2026
+    License:  Modified BSD (see COPYING)
+ */
+
+#import "ETThreadPool.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CACHE_LINE_SIZE 64
+#define INITIAL_DEQUE_CAPACITY 64
+
+/**
+ * Shortest and longest time, in nanoseconds, that -waitWithFunction:context:
+ * blocks between looking for pending tasks.
+ */
+#define MINIMUM_WAIT_BACKOFF 10000
+#define MAXIMUM_WAIT_BACKOFF 1000000
+/**
+ * Number of nested -waitWithFunction:context: calls in which a worker still
+ * runs pending tasks.  Deeper waits just block, which bounds the stack.
+ */
+#define MAXIMUM_WAIT_DEPTH 16
+
+struct ETTask
+{
+    ETThreadPoolFunction function;
+    void *context;
+};
+
+/**
+ * A worker and its deque of tasks.
+ *
+ * The deque is a growable ring buffer indexed by free-running counters and
+ * protected by a mutex, which is only contended when another worker steals
+ * from it.  Tasks are pushed at the tail.  The owner takes the oldest task,
+ * at the head, so that it runs its tasks in submission order and a mailbox
+ * resubmitting itself goes after the tasks already waiting.  Thieves take
+ * the newest task, at the tail, which is the other end from the owner.
+ */
+struct ETWorker
+{
+    pthread_mutex_t lock;
+    struct ETTask *tasks;
+    size_t capacity;
+    size_t head;
+    size_t tail;
+    ETThreadPool *pool;
+    NSUInteger index;
+    /* Only written by the worker itself. */
+    unsigned long long executed;
+    unsigned long long stolen;
+    NSUInteger waitDepth;
+} __attribute__((aligned(CACHE_LINE_SIZE)));
+
+static void dequeInit(struct ETWorker *worker)
+{
+    pthread_mutex_init(&worker->lock, NULL);
+    worker->capacity = INITIAL_DEQUE_CAPACITY;
+    worker->tasks = malloc(worker->capacity * sizeof(struct ETTask));
+    worker->head = 0;
+    worker->tail = 0;
+}
+
+static void dequeDestroy(struct ETWorker *worker)
+{
+    pthread_mutex_destroy(&worker->lock);
+    free(worker->tasks);
+}
+
+static void dequePush(struct ETWorker *worker, struct ETTask task)
+{
+    pthread_mutex_lock(&worker->lock);
+    if (worker->tail - worker->head == worker->capacity)
+    {
+        size_t count = worker->capacity;
+        struct ETTask *tasks = malloc(2 * count * sizeof(struct ETTask));
+
+        for (size_t i=0 ; i<count ; i++)
+        {
+            tasks[i] = worker->tasks[(worker->head + i) & (count - 1)];
+        }
+        free(worker->tasks);
+        worker->tasks = tasks;
+        worker->capacity = 2 * count;
+        worker->head = 0;
+        worker->tail = count;
+    }
+    worker->tasks[worker->tail & (worker->capacity - 1)] = task;
+    worker->tail++;
+    pthread_mutex_unlock(&worker->lock);
+}
+
+/**
+ * Returns whether the deque looks empty, without locking.  Only a hint.
+ */
+static inline BOOL dequeIsEmpty(struct ETWorker *worker)
+{
+    return *(volatile size_t*)&worker->head == *(volatile size_t*)&worker->tail;
+}
+
+static BOOL dequeTake(struct ETWorker *worker, struct ETTask *task, BOOL fromTail)
+{
+    BOOL found = NO;
+
+    if (dequeIsEmpty(worker))
+    {
+        return NO;
+    }
+    pthread_mutex_lock(&worker->lock);
+    if (worker->head != worker->tail)
+    {
+        if (fromTail)
+        {
+            worker->tail--;
+            *task = worker->tasks[worker->tail & (worker->capacity - 1)];
+        }
+        else
+        {
+            *task = worker->tasks[worker->head & (worker->capacity - 1)];
+            worker->head++;
+        }
+        found = YES;
+    }
+    pthread_mutex_unlock(&worker->lock);
+    return found;
+}
+
+/** The ETWorker of the current thread, if it is a pool worker. */
+static pthread_key_t currentWorkerKey;
+static ETThreadPool *sharedPool;
+static NSUInteger sharedPoolWorkerCount;
+
+@interface ETThreadPool ()
+{
+    struct ETWorker *workers;
+    NSUInteger workerCount;
+    /** Round-robin counter for tasks submitted from other threads. */
+    volatile NSUInteger nextWorker;
+    /** Number of tasks in the deques.  May briefly be negative. */
+    volatile long pending;
+    /** Number of workers sleeping, protected by sleepLock. */
+    volatile int sleepers;
+    volatile BOOL stopping;
+    pthread_mutex_t sleepLock;
+    pthread_cond_t workAvailable;
+}
+@end
+
+@implementation ETThreadPool
+
++ (void) initialize
+{
+    if (self != [ETThreadPool class])
+    {
+        return;
+    }
+    pthread_key_create(&currentWorkerKey, NULL);
+    sharedPoolWorkerCount = [[NSProcessInfo processInfo] activeProcessorCount];
+}
+
++ (ETThreadPool *) sharedPool
+{
+    @synchronized(self)
+    {
+        if (nil == sharedPool)
+        {
+            sharedPool = [[ETThreadPool alloc] initWithWorkerCount: sharedPoolWorkerCount];
+        }
+    }
+    return sharedPool;
+}
+
++ (NSUInteger) sharedPoolWorkerCount
+{
+    return sharedPoolWorkerCount;
+}
+
++ (void) setSharedPoolWorkerCount: (NSUInteger)aCount
+{
+    @synchronized(self)
+    {
+        if (nil == sharedPool)
+        {
+            sharedPoolWorkerCount = aCount;
+        }
+    }
+}
+
++ (ETThreadPool *) currentPool
+{
+    struct ETWorker *worker = pthread_getspecific(currentWorkerKey);
+    return (NULL == worker) ? nil : worker->pool;
+}
+
+- (id) init
+{
+    return [self initWithWorkerCount: 0];
+}
+
+- (id) initWithWorkerCount: (NSUInteger)aCount
+{
+    if (nil == (self = [super init]))
+    {
+        return nil;
+    }
+    if (0 == aCount)
+    {
+        aCount = [[NSProcessInfo processInfo] activeProcessorCount];
+    }
+    workerCount = MAX(aCount, 1);
+    if (0 != posix_memalign((void**)&workers, CACHE_LINE_SIZE,
+                            workerCount * sizeof(struct ETWorker)))
+    {
+        [self release];
+        return nil;
+    }
+    memset(workers, 0, workerCount * sizeof(struct ETWorker));
+    pthread_mutex_init(&sleepLock, NULL);
+    pthread_cond_init(&workAvailable, NULL);
+    for (NSUInteger i=0 ; i<workerCount ; i++)
+    {
+        dequeInit(&workers[i]);
+        workers[i].pool = self;
+        workers[i].index = i;
+    }
+    for (NSUInteger i=0 ; i<workerCount ; i++)
+    {
+        [NSThread detachNewThreadSelector: @selector(runWorker:)
+                                 toTarget: self
+                               withObject: [NSNumber numberWithUnsignedInteger: i]];
+    }
+    return self;
+}
+
+- (void) dealloc
+{
+    for (NSUInteger i=0 ; i<workerCount ; i++)
+    {
+        dequeDestroy(&workers[i]);
+    }
+    free(workers);
+    pthread_mutex_destroy(&sleepLock);
+    pthread_cond_destroy(&workAvailable);
+    [super dealloc];
+}
+
+/**
+ * Returns the worker of the current thread if it belongs to the receiver.
+ */
+- (struct ETWorker *) currentWorker
+{
+    struct ETWorker *worker = pthread_getspecific(currentWorkerKey);
+    return (NULL != worker && worker->pool == self) ? worker : NULL;
+}
+
+- (void) submitFunction: (ETThreadPoolFunction)aFunction context: (void*)aContext
+{
+    struct ETWorker *worker = [self currentWorker];
+    struct ETTask task = { aFunction, aContext };
+
+    if (NULL == worker)
+    {
+        NSUInteger index = __sync_fetch_and_add(&nextWorker, 1);
+        worker = &workers[index % workerCount];
+    }
+    dequePush(worker, task);
+
+    /* Full barrier, paired with the one in -runWorker: */
+    __sync_fetch_and_add(&pending, 1);
+    if (sleepers > 0)
+    {
+        pthread_mutex_lock(&sleepLock);
+        pthread_cond_signal(&workAvailable);
+        pthread_mutex_unlock(&sleepLock);
+    }
+}
+
+/**
+ * Takes a task from the worker's own deque or, failing that, steals one from
+ * another worker.
+ */
+- (BOOL) takeTask: (struct ETTask *)aTask forWorker: (struct ETWorker *)worker
+{
+    if (dequeTake(worker, aTask, NO))
+    {
+        __sync_fetch_and_sub(&pending, 1);
+        return YES;
+    }
+    for (NSUInteger i=1 ; i<workerCount ; i++)
+    {
+        struct ETWorker *victim = &workers[(worker->index + i) % workerCount];
+
+        if (dequeTake(victim, aTask, YES))
+        {
+            __sync_fetch_and_sub(&pending, 1);
+            worker->stolen++;
+            return YES;
+        }
+    }
+    return NO;
+}
+
+/**
+ * Runs a task, logging any exception it raises so that the worker survives.
+ */
+static inline void runTask(struct ETWorker *worker, struct ETTask task)
+{
+    NSAutoreleasePool *pool = [NSAutoreleasePool new];
+    NS_DURING
+        task.function(task.context);
+    NS_HANDLER
+        NSLog(@"Exception raised by a thread pool task: %@", localException);
+    NS_ENDHANDLER
+    [pool release];
+    worker->executed++;
+}
+
+- (BOOL) runPendingTask
+{
+    struct ETWorker *worker = [self currentWorker];
+    struct ETTask task;
+
+    if (NULL == worker || ![self takeTask: &task forWorker: worker])
+    {
+        return NO;
+    }
+    runTask(worker, task);
+    return YES;
+}
+
+- (void) waitWithFunction: (ETThreadPoolWaitFunction)aFunction context: (void*)aContext
+{
+    struct ETWorker *worker = [self currentWorker];
+    unsigned long backoff = MINIMUM_WAIT_BACKOFF;
+
+    if (NULL == worker || worker->waitDepth >= MAXIMUM_WAIT_DEPTH)
+    {
+        while (!aFunction(aContext, MAXIMUM_WAIT_BACKOFF)) {}
+        return;
+    }
+    worker->waitDepth++;
+    while (!aFunction(aContext, 0))
+    {
+        if ([self runPendingTask])
+        {
+            backoff = MINIMUM_WAIT_BACKOFF;
+            continue;
+        }
+        if (aFunction(aContext, backoff))
+        {
+            break;
+        }
+        backoff = MIN(2 * backoff, MAXIMUM_WAIT_BACKOFF);
+    }
+    worker->waitDepth--;
+}
+
+- (void) runWorker: (NSNumber *)anIndex
+{
+    struct ETWorker *worker = &workers[[anIndex unsignedIntegerValue]];
+    struct ETTask task;
+
+    pthread_setspecific(currentWorkerKey, worker);
+    for (;;)
+    {
+        if ([self takeTask: &task forWorker: worker])
+        {
+            runTask(worker, task);
+            continue;
+        }
+
+        pthread_mutex_lock(&sleepLock);
+        if (stopping && pending <= 0)
+        {
+            pthread_mutex_unlock(&sleepLock);
+            break;
+        }
+        sleepers++;
+        __sync_synchronize();
+        while (pending <= 0 && !stopping)
+        {
+            pthread_cond_wait(&workAvailable, &sleepLock);
+        }
+        sleepers--;
+        pthread_mutex_unlock(&sleepLock);
+    }
+    pthread_setspecific(currentWorkerKey, NULL);
+}
+
+- (void) shutdown
+{
+    pthread_mutex_lock(&sleepLock);
+    stopping = YES;
+    pthread_cond_broadcast(&workAvailable);
+    pthread_mutex_unlock(&sleepLock);
+}
+
+- (NSUInteger) workerCount
+{
+    return workerCount;
+}
+
+- (NSUInteger) pendingTaskCount
+{
+    long count = pending;
+    return (count > 0) ? count : 0;
+}
+
+- (unsigned long long) executedTaskCount
+{
+    unsigned long long count = 0;
+
+    for (NSUInteger i=0 ; i<workerCount ; i++)
+    {
+        count += workers[i].executed;
+    }
+    return count;
+}
+
+- (unsigned long long) stolenTaskCount
+{
+    unsigned long long count = 0;
+
+    for (NSUInteger i=0 ; i<workerCount ; i++)
+    {
+        count += workers[i].stolen;
+    }
+    return count;
+}
+
+@end
+
+#if __has_feature(blocks)
+static void runBlock(void *context)
+{
+    void (^block)(void) = context;
+    block();
+    [(id)block release];
+}
+
+@implementation ETThreadPool (ETExecutor)
+
+- (void) executeBlock: (void(^)(void))aBlock
+{
+    [self submitFunction: runBlock context: [(id)aBlock copy]];
+}
+
+@end
+#endif
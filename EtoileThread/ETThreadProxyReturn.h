@@ -32,11 +32,26 @@
  */
 
 #import <Foundation/Foundation.h>
+#import "ETExecutor.h"
 #include <pthread.h>
 
+/**
+ * Name of the exception a future created with -futureWithTimeout: fails with
+ * when the timeout expires first.
+ */
+extern NSString *ETFutureTimeoutException;
+
 /**
  * The ETThreadProxyReturn class is used to implement futures.  It is returned
  * from a threaded object.
+ *
+ * Sending any other message than the ones declared here to a future blocks
+ * until its value is available, then forwards the message to it.  To avoid
+ * waiting, register a continuation with -onComplete: or derive a new future
+ * with -then:.  Futures can be combined with +whenAll: and +whenAny:.
+ *
+ * A future completes once, with either a value (possibly nil) or an
+ * exception raised by the method that computes it.
  */
 @interface ETThreadProxyReturn : NSProxy
 {
@@ -65,4 +80,63 @@
  * Returns YES if the caller is a future, no otherwise.
  */
 - (BOOL) isFuture;
+/**
+ * Returns YES if the value or the exception has been set.  Never blocks.
+ */
+- (BOOL) isComplete;
+/**
+ * Waits until the future completes or aDate is reached, and returns whether
+ * it completed.
+ */
+- (BOOL) waitUntilDate: (NSDate*)aDate;
+#if __has_feature(blocks)
+/**
+ * Returns a future which completes like the receiver, or with an
+ * ETFutureTimeoutException if the receiver does not complete within
+ * aTimeout seconds.  No thread waits for the receiver in the meantime.
+ */
+- (ETThreadProxyReturn*) futureWithTimeout: (NSTimeInterval)aTimeout;
+/**
+ * Calls aBlock with the value, or with the exception, once the future
+ * completes.
+ *
+ * The block runs in the thread that completes the future, or immediately in
+ * the caller if it is already complete.  Exceptions raised by the block are
+ * logged and otherwise ignored.
+ */
+- (void) onComplete: (void(^)(id value, NSException *exception))aBlock;
+/**
+ * Calls aBlock with the value, or with the exception, on anExecutor once the
+ * future completes.  Exceptions raised by the block are logged and otherwise
+ * ignored, so they don't reach the executor.
+ */
+- (void) onComplete: (void(^)(id value, NSException *exception))aBlock
+           executor: (id<ETExecutor>)anExecutor;
+/**
+ * Returns a future for the result of aBlock applied to the receiver's value.
+ *
+ * If the receiver fails, or aBlock raises an exception, the returned future
+ * fails with the same exception.  If aBlock returns a future, the returned
+ * future completes when that one does.
+ */
+- (ETThreadProxyReturn*) then: (id(^)(id value))aBlock;
+/**
+ * Like -then:, but runs aBlock on anExecutor.
+ */
+- (ETThreadProxyReturn*) then: (id(^)(id value))aBlock
+                     executor: (id<ETExecutor>)anExecutor;
+/**
+ * Returns a future whose value is an array of the values of futures, in the
+ * same order, with NSNull standing for nil.  It fails as soon as one of them
+ * fails.
+ *
+ * futures may also contain objects that are not futures, which are taken as
+ * their own values.
+ */
++ (ETThreadProxyReturn*) whenAll: (NSArray*)futures;
+/**
+ * Returns a future which completes like the first of futures to complete.
+ */
++ (ETThreadProxyReturn*) whenAny: (NSArray*)futures;
+#endif
 @end
@@ -32,12 +32,298 @@
  */
 
 #import "ETThreadProxyReturn.h"
+#import "ETThreadPool.h"
+#import "NSObject+Futures.h"
+#include <stdlib.h>
+#include <sys/time.h>
+
+NSString *ETFutureTimeoutException = @"ETFutureTimeoutException";
+
+#if __has_feature(blocks)
+/**
+ * A block waiting for a future to complete, and the executor to run it on
+ * (nil to run it in the completing thread).
+ */
+struct ETContinuation
+{
+    void (^block)(id, NSException*);
+    id<ETExecutor> executor;
+    struct ETContinuation *next;
+};
+#endif
+
 @interface ETThreadProxyReturn ()
 {
     BOOL replyReceived;
+#if __has_feature(blocks)
+    /** Continuations in reverse registration order. */
+    struct ETContinuation *continuations;
+    @public
+    /**
+     * Index of the receiver's timeout in the heap plus one, or 0 if it has
+     * none.  Protected by timeoutLock.
+     */
+    size_t timeoutPosition;
+#endif
+}
+- (BOOL) completeWithObject: (id)anObject exception: (NSException*)anException;
+- (BOOL) waitUntilTime: (struct timespec)until;
+@end
+
+#if __has_feature(blocks)
+/*
+ * Timeouts are kept in a binary min-heap ordered by deadline, and expired by
+ * a single thread sleeping until the earliest one.
+ */
+struct ETTimeout
+{
+    double deadline;
+    ETThreadProxyReturn *future;
+};
+
+static pthread_mutex_t timeoutLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t timeoutChanged = PTHREAD_COND_INITIALIZER;
+static struct ETTimeout *timeouts;
+static size_t timeoutCount;
+static size_t timeoutCapacity;
+static BOOL timeoutThreadStarted;
+
+static double currentTime(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+/**
+ * Stores timeout at index i, and records the index in its future.
+ */
+static void timeoutSet(size_t i, struct ETTimeout timeout)
+{
+    timeouts[i] = timeout;
+    timeout.future->timeoutPosition = i + 1;
+}
+
+static void timeoutSwap(size_t i, size_t j)
+{
+    struct ETTimeout tmp = timeouts[i];
+    timeoutSet(i, timeouts[j]);
+    timeoutSet(j, tmp);
+}
+
+static void timeoutSiftUp(size_t i)
+{
+    while (i > 0 && timeouts[(i - 1) / 2].deadline > timeouts[i].deadline)
+    {
+        timeoutSwap(i, (i - 1) / 2);
+        i = (i - 1) / 2;
+    }
+}
+
+static void timeoutSiftDown(size_t i)
+{
+    for (;;)
+    {
+        size_t smallest = i;
+        size_t left = 2 * i + 1;
+        size_t right = left + 1;
+
+        if (left < timeoutCount && timeouts[left].deadline < timeouts[smallest].deadline)
+        {
+            smallest = left;
+        }
+        if (right < timeoutCount && timeouts[right].deadline < timeouts[smallest].deadline)
+        {
+            smallest = right;
+        }
+        if (smallest == i)
+        {
+            break;
+        }
+        timeoutSwap(i, smallest);
+        i = smallest;
+    }
+}
+
+/**
+ * Adds timeout to the heap.  Returns NO if the heap could not grow.
+ */
+static BOOL timeoutPush(struct ETTimeout timeout)
+{
+    if (timeoutCount == timeoutCapacity)
+    {
+        size_t capacity = (0 == timeoutCapacity) ? 64 : 2 * timeoutCapacity;
+        struct ETTimeout *grown = realloc(timeouts, capacity * sizeof(struct ETTimeout));
+
+        if (NULL == grown)
+        {
+            return NO;
+        }
+        timeouts = grown;
+        timeoutCapacity = capacity;
+    }
+    timeoutSet(timeoutCount, timeout);
+    timeoutSiftUp(timeoutCount++);
+    return YES;
+}
+
+/**
+ * Removes the timeout at index i from the heap and returns it.
+ */
+static struct ETTimeout timeoutRemove(size_t i)
+{
+    struct ETTimeout removed = timeouts[i];
+
+    removed.future->timeoutPosition = 0;
+    if (i != --timeoutCount)
+    {
+        timeoutSet(i, timeouts[timeoutCount]);
+        timeoutSiftUp(i);
+        timeoutSiftDown(i);
+    }
+    return removed;
+}
+
+static struct ETTimeout timeoutPop(void)
+{
+    return timeoutRemove(0);
 }
+
+/**
+ * Owns the thread that expires the timeouts.
+ */
+@interface ETFutureTimer : NSObject
++ (void) runTimeouts: (id)sender;
 @end
 
+@implementation ETFutureTimer
++ (void) runTimeouts: (id)sender
+{
+    pthread_mutex_lock(&timeoutLock);
+    for (;;)
+    {
+        if (0 == timeoutCount)
+        {
+            pthread_cond_wait(&timeoutChanged, &timeoutLock);
+            continue;
+        }
+        if (timeouts[0].deadline > currentTime())
+        {
+            struct timespec until;
+            until.tv_sec = (time_t)timeouts[0].deadline;
+            until.tv_nsec = (long)((timeouts[0].deadline - until.tv_sec) * 1e9);
+            pthread_cond_timedwait(&timeoutChanged, &timeoutLock, &until);
+            continue;
+        }
+
+        ETThreadProxyReturn *future = timeoutPop().future;
+        pthread_mutex_unlock(&timeoutLock);
+
+        NSAutoreleasePool *pool = [NSAutoreleasePool new];
+        [future completeWithObject: nil 
+                         exception: [NSException exceptionWithName: ETFutureTimeoutException
+                                                            reason: @"The future did not complete in time"
+                                                          userInfo: nil]];
+        [future release];
+        [pool release];
+
+        pthread_mutex_lock(&timeoutLock);
+    }
+}
+@end
+
+/**
+ * Makes aFuture fail with a timeout exception after aTimeout seconds, unless
+ * it has completed by then.
+ */
+static void scheduleTimeout(ETThreadProxyReturn *aFuture, NSTimeInterval aTimeout)
+{
+    struct ETTimeout timeout = { currentTime() + aTimeout, aFuture };
+
+    pthread_mutex_lock(&timeoutLock);
+    // Completed since the caller checked, and maybe cancelled already.
+    if ([aFuture isComplete])
+    {
+        pthread_mutex_unlock(&timeoutLock);
+        return;
+    }
+    [aFuture retain];
+    if (!timeoutThreadStarted)
+    {
+        timeoutThreadStarted = YES;
+        [NSThread detachNewThreadSelector: @selector(runTimeouts:)
+                                 toTarget: [ETFutureTimer class]
+                               withObject: nil];
+    }
+    if (!timeoutPush(timeout))
+    {
+        pthread_mutex_unlock(&timeoutLock);
+        [aFuture release];
+        [NSException raise: NSMallocException
+                    format: @"Failed to schedule the timeout of %p", aFuture];
+    }
+    if (timeouts[0].future == aFuture)
+    {
+        pthread_cond_signal(&timeoutChanged);
+    }
+    pthread_mutex_unlock(&timeoutLock);
+}
+
+/**
+ * Removes the timeout of aFuture, which has completed, from the heap.
+ */
+static void cancelTimeout(ETThreadProxyReturn *aFuture)
+{
+    ETThreadProxyReturn *cancelled = nil;
+
+    pthread_mutex_lock(&timeoutLock);
+    if (0 != aFuture->timeoutPosition)
+    {
+        cancelled = timeoutRemove(aFuture->timeoutPosition - 1).future;
+    }
+    pthread_mutex_unlock(&timeoutLock);
+    [cancelled release];
+}
+
+/**
+ * Calls the block of a continuation, logging the exceptions it raises, so
+ * that they don't prevent the next continuations from running or kill the
+ * executor thread.
+ */
+static void callContinuationBlock(void (^block)(id, NSException*), id value, NSException *exception)
+{
+    NS_DURING
+        block(value, exception);
+    NS_HANDLER
+        NSLog(@"Exception raised by a continuation of a future: %@", localException);
+    NS_ENDHANDLER
+}
+
+/**
+ * Runs the continuation and frees it.
+ */
+static void runContinuation(struct ETContinuation *continuation, id value, NSException *exception)
+{
+    void (^block)(id, NSException*) = continuation->block;
+
+    if (nil == continuation->executor)
+    {
+        callContinuationBlock(block, value, exception);
+    }
+    else
+    {
+        NS_DURING
+            [continuation->executor executeBlock: ^{ callContinuationBlock(block, value, exception); }];
+        NS_HANDLER
+            NSLog(@"Exception raised submitting a continuation of a future: %@", localException);
+        NS_ENDHANDLER
+    }
+    [(id)block release];
+    [continuation->executor release];
+    free(continuation);
+}
+#endif
+
 @implementation ETThreadProxyReturn
 
 - (id) init
@@ -59,30 +345,137 @@
     [super dealloc];
 }
 
-- (void) setProxyObject: (id)anObject
+/**
+ * Sets the value or the exception, wakes up the waiting threads and runs the
+ * continuations, unless the receiver was already complete.  Returns whether
+ * it completed the receiver.
+ */
+- (BOOL) completeWithObject: (id)anObject exception: (NSException*)anException
 {
     pthread_mutex_lock(&mutex);
+    if (replyReceived)
+    {
+        pthread_mutex_unlock(&mutex);
+        return NO;
+    }
     object = [anObject retain];
+    exception = [anException retain];
+    /* Publish the result to -isComplete, which doesn't lock */
+    __sync_synchronize();
     replyReceived = YES;
-    pthread_cond_signal(&conditionVariable);
+#if __has_feature(blocks)
+    struct ETContinuation *list = continuations;
+    continuations = NULL;
+#endif
+    pthread_cond_broadcast(&conditionVariable);
     pthread_mutex_unlock(&mutex);
+
+#if __has_feature(blocks)
+    /* Reverse the list to run the continuations in registration order */
+    struct ETContinuation *ordered = NULL;
+    while (NULL != list)
+    {
+        struct ETContinuation *next = list->next;
+        list->next = ordered;
+        ordered = list;
+        list = next;
+    }
+    while (NULL != ordered)
+    {
+        struct ETContinuation *next = ordered->next;
+        runContinuation(ordered, object, exception);
+        ordered = next;
+    }
+#endif
     [self release];
+    return YES;
+}
+
+- (void) setProxyObject: (id)anObject
+{
+    [self completeWithObject: anObject exception: nil];
 }
 
 - (void) setProxyException: (NSException*)anException
+{
+    [self completeWithObject: nil exception: anException];
+}
+
+- (BOOL) isComplete
+{
+    BOOL complete = replyReceived;
+
+    /* Order the reads of the result after the flag */
+    __sync_synchronize();
+    return complete;
+}
+
+/**
+ * Waits until the receiver completes or the absolute time until is reached,
+ * and returns whether it completed.
+ */
+- (BOOL) waitUntilTime: (struct timespec)until
 {
     pthread_mutex_lock(&mutex);
-    exception = [anException retain];
-    pthread_cond_signal(&conditionVariable);
+    while (!replyReceived)
+    {
+        if (0 != pthread_cond_timedwait(&conditionVariable, &mutex, &until))
+        {
+            break;
+        }
+    }
     pthread_mutex_unlock(&mutex);
-    [self release];
+    return replyReceived;
+}
+
+- (BOOL) waitUntilDate: (NSDate*)aDate
+{
+    if (![self isComplete])
+    {
+        NSTimeInterval deadline = [aDate timeIntervalSince1970];
+        struct timespec until;
+
+        until.tv_sec = (time_t)deadline;
+        until.tv_nsec = (long)((deadline - until.tv_sec) * 1e9);
+        return [self waitUntilTime: until];
+    }
+    return YES;
 }
+
+static BOOL waitForReply(void *context, unsigned long nanoseconds)
+{
+    ETThreadProxyReturn *future = context;
+    struct timeval now;
+    struct timespec until;
+
+    if ([future isComplete] || 0 == nanoseconds)
+    {
+        return [future isComplete];
+    }
+    gettimeofday(&now, NULL);
+    until.tv_sec = now.tv_sec + nanoseconds / 1000000000;
+    until.tv_nsec = now.tv_usec * 1000 + nanoseconds % 1000000000;
+    if (until.tv_nsec >= 1000000000)
+    {
+        until.tv_sec++;
+        until.tv_nsec -= 1000000000;
+    }
+    return [future waitUntilTime: until];
+}
+
 - (id) value
 {
-    if (!replyReceived)
+    ETThreadPool *currentPool = [ETThreadPool currentPool];
+
+    if (![self isComplete] && nil != currentPool)
+    {
+        /* The value may be computed by a task waiting for this worker */
+        [currentPool waitWithFunction: waitForReply context: self];
+    }
+    if (![self isComplete])
     {
         pthread_mutex_lock(&mutex);
-        if (!replyReceived && (nil == exception))
+        while (!replyReceived)
         {
             pthread_cond_wait(&conditionVariable, &mutex);
         }
@@ -96,6 +489,176 @@
     return object;
 }
 
+#if __has_feature(blocks)
+- (void) onComplete: (void(^)(id value, NSException *exception))aBlock
+{
+    [self onComplete: aBlock executor: nil];
+}
+
+- (void) onComplete: (void(^)(id value, NSException *exception))aBlock
+           executor: (id<ETExecutor>)anExecutor
+{
+    struct ETContinuation *continuation = malloc(sizeof(struct ETContinuation));
+
+    if (NULL == continuation)
+    {
+        [NSException raise: NSMallocException
+                    format: @"Failed to allocate a continuation for %p", self];
+    }
+    continuation->block = (void(^)(id, NSException*))[(id)aBlock copy];
+    continuation->executor = [anExecutor retain];
+
+    pthread_mutex_lock(&mutex);
+    if (!replyReceived)
+    {
+        continuation->next = continuations;
+        continuations = continuation;
+        pthread_mutex_unlock(&mutex);
+        return;
+    }
+    pthread_mutex_unlock(&mutex);
+    runContinuation(continuation, object, exception);
+}
+
+- (ETThreadProxyReturn*) then: (id(^)(id value))aBlock
+{
+    return [self then: aBlock executor: nil];
+}
+
+- (ETThreadProxyReturn*) then: (id(^)(id value))aBlock
+                     executor: (id<ETExecutor>)anExecutor
+{
+    ETThreadProxyReturn *result = [[[ETThreadProxyReturn alloc] init] autorelease];
+
+    [self onComplete: ^(id value, NSException *anException)
+    {
+        id next = nil;
+        NSException *raised = anException;
+
+        if (nil == raised)
+        {
+            NS_DURING
+                next = aBlock(value);
+            NS_HANDLER
+                raised = localException;
+            NS_ENDHANDLER
+        }
+        if (nil != raised)
+        {
+            [result completeWithObject: nil exception: raised];
+        }
+        else if ([next isFuture])
+        {
+            [next onComplete: ^(id nextValue, NSException *nextException)
+            {
+                [result completeWithObject: nextValue exception: nextException];
+            }];
+        }
+        else
+        {
+            [result completeWithObject: next exception: nil];
+        }
+    } executor: anExecutor];
+    return result;
+}
+
+- (ETThreadProxyReturn*) futureWithTimeout: (NSTimeInterval)aTimeout
+{
+    ETThreadProxyReturn *result = [[[ETThreadProxyReturn alloc] init] autorelease];
+
+    [self onComplete: ^(id value, NSException *anException)
+    {
+        if ([result completeWithObject: value exception: anException])
+        {
+            cancelTimeout(result);
+        }
+    }];
+    if (![result isComplete])
+    {
+        scheduleTimeout(result, aTimeout);
+    }
+    return result;
+}
+
++ (ETThreadProxyReturn*) whenAll: (NSArray*)futures
+{
+    NSUInteger count = [futures count];
+    ETThreadProxyReturn *all = [[[ETThreadProxyReturn alloc] init] autorelease];
+    NSMutableArray *values = [NSMutableArray arrayWithCapacity: count];
+    __block NSUInteger remaining = count;
+    NSUInteger index = 0;
+
+    for (NSUInteger i=0 ; i<count ; i++)
+    {
+        [values addObject: [NSNull null]];
+    }
+    if (0 == count)
+    {
+        [all setProxyObject: [NSArray array]];
+        return all;
+    }
+    for (id future in futures)
+    {
+        NSUInteger position = index++;
+        void (^completion)(id, NSException*) = ^(id value, NSException *anException)
+        {
+            if (nil != anException)
+            {
+                [all completeWithObject: nil exception: anException];
+                return;
+            }
+            @synchronized(values)
+            {
+                [values replaceObjectAtIndex: position 
+                                  withObject: (nil == value ? [NSNull null] : value)];
+            }
+            if (0 == __sync_sub_and_fetch(&remaining, 1))
+            {
+                @synchronized(values)
+                {
+                    [all completeWithObject: [NSArray arrayWithArray: values] 
+                                  exception: nil];
+                }
+            }
+        };
+
+        if ([future isFuture])
+        {
+            [future onComplete: completion];
+        }
+        else
+        {
+            completion(future, nil);
+        }
+    }
+    return all;
+}
+
++ (ETThreadProxyReturn*) whenAny: (NSArray*)futures
+{
+    ETThreadProxyReturn *any = [[[ETThreadProxyReturn alloc] init] autorelease];
+
+    if (0 == [futures count])
+    {
+        [any setProxyObject: nil];
+        return any;
+    }
+    for (id future in futures)
+    {
+        if (![future isFuture])
+        {
+            [any completeWithObject: future exception: nil];
+            break;
+        }
+        [future onComplete: ^(id value, NSException *anException)
+        {
+            [any completeWithObject: value exception: anException];
+        }];
+    }
+    return any;
+}
+#endif
+
 - (id) forwardingTargetForSelector: (SEL)aSelector
 {
     return [self value];
@@ -105,7 +668,7 @@
 {
     /* If we haven't yet got the object, then block until we have, otherwise do
        this quickly */
-    if (!replyReceived)
+    if (![self isComplete])
     {
         [self value];
     }
@@ -114,7 +677,7 @@
 
 - (void) forwardInvocation: (NSInvocation *)anInvocation
 {
-    if (!replyReceived)
+    if (![self isComplete])
     {
         [self value];
     }
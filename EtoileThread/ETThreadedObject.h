@@ -33,10 +33,32 @@
 
 #import <Foundation/Foundation.h>
 #import "NSObject+Threaded.h"
+#include "ETMessageQueue.h"
 #include <pthread.h>
 
-#define QUEUE_SIZE 256
-#define QUEUE_MASK 0xff
+/**
+ * Number of messages that can be queued for a threaded object before the
+ * senders wait, unless another capacity is requested.
+ */
+#define ETThreadedObjectDefaultQueueCapacity 256
+
+@class ETThreadPool;
+
+/**
+ * Statistics about the messages sent to a threaded object, returned by
+ * -[ETThreadedObject mailboxStatistics].
+ */
+typedef struct
+{
+    /** Number of messages waiting to be executed. */
+    NSUInteger queueDepth;
+    /** Largest number of messages seen waiting at once. */
+    NSUInteger maximumQueueDepth;
+    /** Number of messages that fit in the queue. */
+    NSUInteger queueCapacity;
+    /** Number of messages executed so far. */
+    unsigned long long processedMessageCount;
+} ETMailboxStatistics;
 
 /**
  * The ETThreadedObject class represents an object which has its
@@ -47,9 +69,35 @@
  * be returned immediately.  Messages passed to this object will
  * block until the real return value is ready.
  *
+ * Messages may be sent from any number of threads.  They are executed in the
+ * order in which they were queued, several at a time under a single
+ * autorelease pool.  When the queue is full, senders sleep until there is
+ * space.
+ *
+ * A threaded object either has its own thread, or is a mailbox run by the
+ * workers of an ETThreadPool.  Pooled objects only use a worker while they
+ * have messages to execute, so large numbers of them are cheap.  A pooled
+ * object runs on at most one worker at a time and still executes its
+ * messages in order, but its -idle method (see the Idle protocol) is never
+ * called.
+ *
+ * A method returning a scalar blocks the sender until it has run.  A pool
+ * worker blocked this way runs other pool tasks meanwhile, so that the
+ * workers don't all end up blocked on messages no worker is free to run.
+ * This doesn't prevent every deadlock: the tasks run while waiting may send
+ * a scalar message back to the waiting object, whose mailbox is held lower on
+ * the same stack, e.g. when A waits on B and the worker meanwhile runs C,
+ * which calls A.  Pooled objects should not call each other in cycles.  When
+ * the sender is the receiver itself, for instance a method of the proxied
+ * object calling back through the proxy, the message runs at once instead of
+ * being queued, ahead of the messages already waiting.  Waiting on a future
+ * returned by the receiver itself still deadlocks.
+ *
+ * Exceptions raised by void messages are logged.
+ *
  * In general, methods in this class should not be called directly.
- * Instead, the [NSObject(Threaded)+threadedNew] method should be 
- * used.
+ * Instead, the [NSObject(Threaded)+threadedNew] and 
+ * [NSObject(Threaded)+pooledNew] methods should be used.
  */
 @interface ETThreadedObject : NSProxy
 {
@@ -58,21 +106,28 @@
      */
     id object;
     /** 
-     * The condition variable and mutex are only used when the queue is empty.
-     * If the message queue is kept fed then the class moves to a lockless
-     * model for communication.
+     * The condition variable and mutex are used by the worker thread to tell
+     * -dealloc that it has exited.
      */
     pthread_cond_t conditionVariable;
     pthread_mutex_t mutex;
     /**
-     * Lockless ring buffer and free-running counters.
+     * Queue of invocations and their return proxies.
      */
-    id invocations[QUEUE_SIZE];
-    unsigned long producer;
-    unsigned long consumer;
-    id proxy;
+    ETMessageQueue queue;
     BOOL terminate;
+    BOOL exited;
     NSThread *thread;
+    /**
+     * Pool running the messages, or nil if the object has its own thread.
+     */
+    ETThreadPool *threadPool;
+    /**
+     * Set while the mailbox is submitted to, or running in, the pool.
+     */
+    volatile int scheduled;
+    volatile NSUInteger maximumQueueDepth;
+    volatile unsigned long long processedMessageCount;
 }
 /**
  * Create a threaded instance of aClass
@@ -82,6 +137,26 @@
  * Create a thread and run loop for anObject
  */
 - (id) initWithObject: (id)anObject;
+/**
+ * Create a thread and run loop for anObject, whose queue holds up to
+ * aCapacity messages (rounded up to a power of two).  Returns nil if the
+ * queue cannot be allocated.
+ */
+- (id) initWithObject: (id)anObject queueCapacity: (NSUInteger)aCapacity;
+/**
+ * Run anObject as a mailbox in aPool, with a queue holding up to aCapacity
+ * messages.  No thread is created, and -runloop: must not be called.
+ */
+- (id) initWithObject: (id)anObject 
+           threadPool: (ETThreadPool*)aPool
+        queueCapacity: (NSUInteger)aCapacity;
+/**
+ * Returns statistics about the receiver's queue.
+ *
+ * Because this method is implemented by the proxy, it is never forwarded to
+ * the proxied object.
+ */
+- (ETMailboxStatistics) mailboxStatistics;
 /**
  * Method encapsulating the run loop.  Should not be called directly
  */
@@ -33,141 +33,95 @@
 
 #import "ETThreadedObject.h"
 #import "ETThreadProxyReturn.h"
+#import "ETThreadPool.h"
 #import "../Headers/Macros.h"
-#include <sched.h>
+#include "ETCompletionSlot.h"
+#include <stdint.h>
 
 /**
- * GCC 4.1 provides atomic operations which impose memory barriers.  These are
- * not needed on x86, but might be on other platforms (anything that does not
- * enforce strong ordering of memory operations, e.g. Itanium or Alpha).
+ * Maximum number of invocations executed under a single autorelease pool.
  */
-#if __GNUC__ < 4 || (__GNUC__ == 4 && __GNUC_MINOR__ < 1)
-#warning Potentially unsafe memory operations being used
-static inline void __sync_fetch_and_add(unsigned long *ptr, unsigned int value)
-{
-    *ptr += value;
-}
-#endif
+#define BATCH_SIZE 64
 
 /**
- * Ring buffer implementation:
- * 
- * The ring buffer has three components:
- *
- * invocations - an array of QUEUE_SIZE elements (ids) which contains the
- * buffer itself.
- * 
- * producer - a free running counter indicating the index at which objects
- * should be inserted into the buffer.  Only incremented by the inserting
- * thread.
- *
- * consumer - a free running counter indicating the index at which objects
- * should be removed from the buffer.  Only incremented by the removing thread.
- *
- * These, together, provide a lockless ring buffer (FIFO) implementation. 
+ * A synchronous call to a method returning a scalar, allocated on the
+ * caller's stack.  The caller waits on the slot until the invocation has run,
+ * then reads the return value from the invocation.
  */
+struct ETScalarCall
+{
+    ETCompletionSlot slot;
+    NSException *exception;
+};
 
 /**
- * Check how much space is in the queue.  The number of used elements in the
- * queue is always equal to producer - consumer.   Producer will always
- * overflow before consumer (because you can't remove objects that have not
- * been inserted.  In this case, the subtraction will be something along the
- * lines of (0 - (2^32 - 14)).  This will be -(2^32 - 14), however this value
- * can't be represented in a 32-bit integer and so will overflow to 14, giving
- * the correct result, irrespective of overflow.  
- */
-#define SPACE (QUEUE_SIZE - (producer - consumer))
-/**
- * The buffer is full if there is no space in it.
+ * The queue context of an invocation is its return proxy for methods
+ * returning objects, a struct ETScalarCall tagged with the lowest bit for
+ * methods returning scalars, or NULL for void methods.
  */
-#define ISFULL (SPACE == 0)
-/**
- * The buffer is empty if there is no data in it.
- */
-#define ISEMPTY ((producer - consumer) == 0)
+#define SCALAR_CALL_TAG ((uintptr_t)1)
+#define IS_SCALAR_CALL(context) (((uintptr_t)(context) & SCALAR_CALL_TAG) != 0)
+#define SCALAR_CALL(context) ((struct ETScalarCall*)((uintptr_t)(context) & ~SCALAR_CALL_TAG))
+
 /**
- * Converting the free running counters to array indexes is a masking
- * operation.  For this to work, the buffer size must be a power of two.
- * QUEUE_MASK = QUEUE_SIZE - 1.  If QUEUE_SIZE is 256, we want the lowest 8
- * bits of the index, which is obtained by ANDing the value with 255.  Any
- * power of two may be selected.  Non power-of-two values could be used if a
- * more complex mapping operation were chosen, but this one is nice and cheap.
+ * A message that a pool worker waits to add to a full queue.
  */
-#define MASK(index) ((index) & QUEUE_MASK)
+struct ETPendingMessage
+{
+    ETMessageQueue queue;
+    void *message;
+    void *context;
+};
+
+static BOOL pushPendingMessage(void *context, unsigned long nanoseconds)
+{
+    struct ETPendingMessage *pending = context;
+
+    return 0 == ETMessageQueueTimedPush(pending->queue, pending->message,
+                                        pending->context, nanoseconds);
+}
+
+static BOOL waitForScalarCall(void *context, unsigned long nanoseconds)
+{
+    return ETCompletionSlotTimedWait(&((struct ETScalarCall*)context)->slot, nanoseconds);
+}
+
 /**
- * Inserting an element into the queue involves the following steps:
- *
- * 1) Check that there is space in the buffer.
- *     Spin if there isn't any.
- * 2) Add the invocation and optionally the proxy containing the return value
- * (nil for none) to the next two elements in the ring buffer.
- * 3) Increment the producer counter (by two, since we are adding two elements).
- * 4) If the queue was previously empty, we need to transition back to lockless
- * mode.  This is done by signalling the condition variable that the other
- * thread will be waiting on if it is in blocking mode.
+ * The threaded object whose messages the current thread is running, if any.
  */
-#define INSERT(x,r) do {\
-    /* Wait for space in the buffer */\
-    while (ISFULL)\
-    {\
-        sched_yield();\
-    }\
-    invocations[MASK(producer)] = x;\
-    invocations[MASK(producer+1)] = r;\
-    __sync_fetch_and_add(&producer, 2);\
-    if (producer - consumer == 2)\
-    {\
-        pthread_mutex_lock(&mutex);\
-        pthread_cond_signal(&conditionVariable);\
-        pthread_mutex_unlock(&mutex);\
-    }\
-} while(0);
+static pthread_key_t runningObjectKey;
+
 /**
- * Removing an element from the queue involves the following steps:
- *
- * 1) Wait until the queue has messages waiting.  If there are none, enter
- * blocking mode.  The additional test inside the mutex ensures that a
- * transition from blocking to non-blocking mode will not be missed, since the
- * condition variable can only be signalled when the producer thread has the
- * mutex.  
- * 2) Read the invocation and return proxy from the buffer.
- * 3) Incrememt the consumer counter.
+ * Returns a retained copy of anInvocation, with its arguments retained.
  */
-#define REMOVE(x,r) do {\
-    while (ISEMPTY)\
-    {\
-        if (terminate) { return; }\
-        if (idle && [object shouldIdle])\
-        {\
-            [object idle];\
-        }\
-        else\
-        {\
-            pthread_mutex_lock(&mutex);\
-            if (ISEMPTY)\
-            {\
-                    pthread_cond_wait(&conditionVariable, &mutex);\
-            }\
-            pthread_mutex_unlock(&mutex);\
-        }\
-    }\
-    x = invocations[MASK(consumer)];\
-    r = invocations[MASK(consumer+1)];\
-    __sync_fetch_and_add(&consumer, 2);\
-} while(0);
-
-
-@interface ETThreadedObject ()
+static NSInvocation *copyInvocation(NSInvocation *anInvocation)
 {
-    NSConditionLock *returnConcrete;
-}
-@end
+    NSMethodSignature *signature = [anInvocation methodSignature];
+    NSInvocation *copy = [[NSInvocation invocationWithMethodSignature: signature] retain];
+    NSUInteger count = [signature numberOfArguments];
+
+    [copy setSelector: [anInvocation selector]];
+    for (NSUInteger i=2 ; i<count ; i++)
+    {
+        NSUInteger size;
 
+        NSGetSizeAndAlignment([signature getArgumentTypeAtIndex: i], &size, NULL);
+        char argument[size];
+        [anInvocation getArgument: argument atIndex: i];
+        [copy setArgument: argument atIndex: i];
+    }
+    [copy retainArguments];
+    return copy;
+}
 
 @implementation ETThreadedObject
 // Remove this when GNUstep is fixed.
 + (void) initialize
 {
+    if (self == [ETThreadedObject class])
+    {
+        pthread_key_create(&runningObjectKey, NULL);
+    }
     if (Nil != NSClassFromString(@"GSFFCallInvocation"))
     {
         NSLog(@"WARNING: You are using FFCall-based NSInvocations.  "
@@ -176,7 +130,6 @@ static inline void __sync_fetch_and_add(unsigned long *ptr, unsigned int value)
     }
 }
 
-/* Designated initializer */
 - (id) init
 {
     return [self initWithObject: nil];
@@ -188,149 +141,394 @@ static inline void __sync_fetch_and_add(unsigned long *ptr, unsigned int value)
 }
 
 - (id) initWithObject: (id)anObject
+{
+    return [self initWithObject: anObject 
+                  queueCapacity: ETThreadedObjectDefaultQueueCapacity];
+}
+
+- (id) initWithObject: (id)anObject queueCapacity: (NSUInteger)aCapacity
+{
+    return [self initWithObject: anObject 
+                     threadPool: nil
+                  queueCapacity: aCapacity];
+}
+
+/* Designated initializer */
+- (id) initWithObject: (id)anObject 
+           threadPool: (ETThreadPool*)aPool
+        queueCapacity: (NSUInteger)aCapacity
 {
     pthread_cond_init(&conditionVariable, NULL);
     pthread_mutex_init(&mutex, NULL);
-    returnConcrete = [NSConditionLock new];
+    queue = ETMessageQueueNew(aCapacity);
+    threadPool = [aPool retain];
     // Retained in the creating thread.
     object = anObject;
+    if (NULL == queue)
+    {
+        [self release];
+        return nil;
+    }
     return self;
 }
 
 - (void) dealloc
 {
-    /* Instruct worker thread to exit */
-    pthread_mutex_lock(&mutex);
-    terminate = YES;
-
-    /* Wait for worker thread to let us know which thread object belongs to it*/
-    while (thread == nil)
+    /* A pooled object is retained while its mailbox is scheduled, so no
+       worker can be using it any more.  Otherwise, stop our own thread. */
+    if (nil == threadPool && NULL != queue)
     {
-        pthread_cond_signal(&conditionVariable);
-        pthread_mutex_unlock(&mutex);
+        /* Instruct worker thread to exit once it has run the queued invocations */
+        terminate = YES;
+        __sync_synchronize();
+        ETMessageQueueWakeConsumer(queue);
+
+        /* Wait for worker thread to terminate, unless we are running in it */
         pthread_mutex_lock(&mutex);
+        if (thread != [NSThread currentThread])
+        {
+            while (!exited)
+            {
+                pthread_cond_wait(&conditionVariable, &mutex);
+            }
+        }
+        pthread_mutex_unlock(&mutex);
+        [thread release];
     }
-    pthread_cond_signal(&conditionVariable);
-    pthread_mutex_unlock(&mutex);
-
-    /* Wait for worker thread to terminate */
-    // FIXME: [thread waitForTermination];
-    [thread release];
 
     /* Destroy synchronisation objects */
     pthread_cond_destroy(&conditionVariable);
     pthread_mutex_destroy(&mutex);
+    if (NULL != queue)
+    {
+        [self discardQueuedInvocations];
+        ETMessageQueueFree(queue);
+    }
 
+    [threadPool release];
     [object release];
-    [returnConcrete release];
 
     [super dealloc];
 }
 
+/**
+ * Releases the invocations still queued, which will never run, and fails
+ * their futures and scalar calls so that nobody waits for them forever.
+ */
+- (void) discardQueuedInvocations
+{
+    ETMessage batch[BATCH_SIZE];
+    size_t count;
+    NSException *discarded = 
+        [NSException exceptionWithName: NSInternalInconsistencyException
+                                reason: @"The threaded object was deallocated "
+                                         "before running the message"
+                              userInfo: nil];
+
+    while (0 != (count = ETMessageQueuePopBatch(queue, batch, BATCH_SIZE)))
+    {
+        for (size_t i=0 ; i<count ; i++)
+        {
+            void *context = batch[i].context;
+
+            [(NSInvocation*)batch[i].message release];
+            if (IS_SCALAR_CALL(context))
+            {
+                SCALAR_CALL(context)->exception = [discarded retain];
+                ETCompletionSlotSignal(&SCALAR_CALL(context)->slot);
+            }
+            else if (NULL != context)
+            {
+                [(ETThreadProxyReturn*)context setProxyException: discarded];
+            }
+        }
+    }
+}
+
+/**
+ * Runs an invocation taken from the queue, and hands the result to the caller
+ * described by aContext.
+ */
+- (void) invoke: (NSInvocation*)anInvocation context: (void*)aContext
+{
+    if (IS_SCALAR_CALL(aContext))
+    {
+        struct ETScalarCall *call = SCALAR_CALL(aContext);
+
+        /* The caller raises the exception again in its own thread */
+        NS_DURING
+            [anInvocation invokeWithTarget:object];
+        NS_HANDLER
+            call->exception = [localException retain];
+        NS_ENDHANDLER
+        [anInvocation setTarget: nil];
+        [anInvocation release];
+        /* The caller, and thus the slot, may be gone after this */
+        ETCompletionSlotSignal(&call->slot);
+        return;
+    }
+    if (aContext != NULL)
+    {
+        ETThreadProxyReturn *retVal = aContext;
+        id realReturn = nil;
+        NSException *raised = nil;
+
+        /* Hand exceptions to the future, which raises them in the caller or
+           passes them to its continuations */
+        NS_DURING
+            [anInvocation invokeWithTarget:object];
+            [anInvocation getReturnValue:&realReturn];
+        NS_HANDLER
+            raised = localException;
+        NS_ENDHANDLER
+        if (nil != raised)
+        {
+            [retVal setProxyException: raised];
+        }
+        else
+        {
+            [retVal setProxyObject:realReturn];
+        }
+    }
+    else
+    {
+        /* Nobody waits for a void message, so its exception is only logged,
+           and the rest of the batch still runs */
+        NS_DURING
+            [anInvocation invokeWithTarget:object];
+        NS_HANDLER
+            NSLog(@"Exception raised by %@ sent to %@: %@",
+                NSStringFromSelector([anInvocation selector]), object, localException);
+        NS_ENDHANDLER
+    }
+
+    [anInvocation setTarget: nil];
+    [anInvocation release];
+}
+
 - (void) runloop: (id)sender
 {
+    ETMessage batch[BATCH_SIZE];
+
+    pthread_mutex_lock(&mutex);
     thread = [[NSThread currentThread] retain];
+    pthread_mutex_unlock(&mutex);
+    pthread_setspecific(runningObjectKey, self);
+
     BOOL idle = [object conformsToProtocol: @protocol(Idle)];
     while (object)
     {
-        NSAutoreleasePool * pool = [[NSAutoreleasePool alloc] init];
-        /* Take the first invocation from the queue */
-        NSInvocation * anInvocation;
-
-        ETThreadProxyReturn *retVal;
-        REMOVE(anInvocation, retVal);
+        size_t count = ETMessageQueuePopBatch(queue, batch, BATCH_SIZE);
 
-        [anInvocation invokeWithTarget:object];
-        if (retVal != nil)
+        if (0 == count)
         {
-            id realReturn;
-            [anInvocation getReturnValue:&realReturn];
-            [retVal setProxyObject:realReturn];
-            /*
-              Proxy return object is created with a retain count of 2 and an
-              autorelease count of 1 in the main thread.  This will set it to a
-              retain count of 1 and an autorelease count of 1 if it has not
-              been used, or dealloc it if it has
-            */
-            //[retVal release];
+            if (terminate)
+            {
+                break;
+            }
+            if (idle && [object shouldIdle])
+            {
+                NSAutoreleasePool * pool = [[NSAutoreleasePool alloc] init];
+                [object idle];
+                [pool release];
+                continue;
+            }
+            count = ETMessageQueueWaitPopBatch(queue, batch, BATCH_SIZE);
         }
-        else
+
+        /* Run everything taken from the queue under a single pool */
+        NSAutoreleasePool * pool = [[NSAutoreleasePool alloc] init];
+        for (size_t i=0 ; i<count ; i++)
         {
-            [returnConcrete lock];
-            [returnConcrete unlockWithCondition: 1];
+            [self invoke: batch[i].message context: batch[i].context];
         }
-
-        [anInvocation setTarget: nil];
-        [anInvocation release];
         [pool release];
+        __sync_fetch_and_add(&processedMessageCount, count);
     }
+
+    pthread_mutex_lock(&mutex);
+    exited = YES;
+    pthread_cond_signal(&conditionVariable);
+    pthread_mutex_unlock(&mutex);
     NSLog(@"Thread exiting");
     [NSThread exit];
 }
 
-- (NSMethodSignature *) methodSignatureForSelector: (SEL)aSelector
+/**
+ * Pool task running a pooled object's mailbox.
+ */
+static void runMailbox(void *context)
 {
-    return [object methodSignatureForSelector:aSelector];
+    [(ETThreadedObject*)context runMailbox];
 }
 
-- (id) returnProxy
+/**
+ * Submits the mailbox to the pool unless it is already scheduled.  The
+ * scheduled flag is what ensures that only one worker at a time runs it.
+ */
+- (void) scheduleMailbox
 {
-    return proxy;
+    if (__sync_bool_compare_and_swap(&scheduled, 0, 1))
+    {
+        [self retain];
+        [threadPool submitFunction: runMailbox context: self];
+    }
 }
 
-- (void) forwardInvocation: (NSInvocation *)anInvocation
+/**
+ * Runs one batch of messages from the mailbox, then gives the worker back to
+ * the pool, resubmitting the mailbox at the end of the worker's deque if more
+ * messages have arrived in the meantime.
+ */
+- (void) runMailbox
+{
+    ETMessage batch[BATCH_SIZE];
+    size_t count = ETMessageQueuePopBatch(queue, batch, BATCH_SIZE);
+    /* The worker may be running this mailbox while waiting in another one */
+    void *previous = pthread_getspecific(runningObjectKey);
+
+    pthread_setspecific(runningObjectKey, self);
+    /* The pool task already runs under an autorelease pool */
+    for (size_t i=0 ; i<count ; i++)
+    {
+        [self invoke: batch[i].message context: batch[i].context];
+    }
+    pthread_setspecific(runningObjectKey, previous);
+    __sync_fetch_and_add(&processedMessageCount, count);
+
+    /* Full barrier, so a sender either sees the flag cleared or we see its
+       message */
+    __sync_lock_release(&scheduled);
+    __sync_synchronize();
+    if (ETMessageQueueCount(queue) > 0)
+    {
+        [self scheduleMailbox];
+    }
+    [self release];
+}
+
+/**
+ * Adds an invocation to the queue.  A pool worker sending to a full queue
+ * runs other tasks while it waits, since the receiver may need a worker to
+ * drain it, or be waiting for a task itself.
+ */
+- (void) enqueueInvocation: (NSInvocation*)anInvocation context: (void*)aContext
 {
-    BOOL concreteType = NO;
+    ETThreadPool *currentPool = [ETThreadPool currentPool];
+
+    if (nil == currentPool)
+    {
+        ETMessageQueuePush(queue, anInvocation, aContext);
+    }
+    else
+    {
+        struct ETPendingMessage pending = { queue, anInvocation, aContext };
+
+        [currentPool waitWithFunction: pushPendingMessage context: &pending];
+    }
 
-    if (![anInvocation argumentsRetained])
+    NSUInteger depth = ETMessageQueueCount(queue);
+    NSUInteger maximum = maximumQueueDepth;
+    while (depth > maximum
+        && !__sync_bool_compare_and_swap(&maximumQueueDepth, maximum, depth))
     {
-        [anInvocation retainArguments];
+        maximum = maximumQueueDepth;
     }
 
-    ETThreadProxyReturn * retVal = nil;
+    if (nil != threadPool)
+    {
+        [self scheduleMailbox];
+    }
+}
+
+- (ETMailboxStatistics) mailboxStatistics
+{
+    ETMailboxStatistics statistics;
+
+    statistics.queueDepth = ETMessageQueueCount(queue);
+    statistics.maximumQueueDepth = maximumQueueDepth;
+    statistics.queueCapacity = ETMessageQueueCapacity(queue);
+    statistics.processedMessageCount = processedMessageCount;
+    return statistics;
+}
+
+- (NSMethodSignature *) methodSignatureForSelector: (SEL)aSelector
+{
+    return [object methodSignatureForSelector:aSelector];
+}
+
+- (void) forwardInvocation: (NSInvocation *)anInvocation
+{
+    struct ETScalarCall call;
+    NSInvocation *message = anInvocation;
+    void *context = NULL;
     char returnType = [[anInvocation methodSignature] methodReturnType][0];
 
+    /*
+     * A scalar call sent while running one of our own messages would wait for
+     * a queue that only the caller can drain, so run it at once.
+     */
+    if (returnType != '@' && returnType != 'v'
+     && pthread_getspecific(runningObjectKey) == self)
+    {
+        [anInvocation invokeWithTarget: object];
+        return;
+    }
+
     if (returnType == '@')
     {
-        retVal = [[[ETThreadProxyReturn alloc] init] autorelease];
-        proxy = retVal;
         /*
-          This is a hack to force the invocation to stop blocking the caller.
-        */
-        SEL selector = [anInvocation selector];
-        [anInvocation setSelector:@selector(returnProxy)];
-        [anInvocation invokeWithTarget:self];
-        [anInvocation setSelector:selector];
+         * The future is returned at once as the return value of anInvocation,
+         * which the caller reads after we return, so the worker runs a copy
+         * whose return value it can set meanwhile.  The future releases itself
+         * once it completes.
+         */
+        ETThreadProxyReturn *retVal = [[[ETThreadProxyReturn alloc] init] autorelease];
+
+        message = copyInvocation(anInvocation);
+        context = retVal;
+        [anInvocation setReturnValue: &retVal];
+    }
+    else
+    {
+        if (![anInvocation argumentsRetained])
+        {
+            [anInvocation retainArguments];
+        }
+        [anInvocation retain];
     }
     //Non-void, non-object, return
-    else if (returnType != 'v')
+    if (returnType != '@' && returnType != 'v')
     {
         /*
-         * This is a hack.. if the method returns a concrete type (eg not an
-         * object) the result is immediately assigned as soon a
-         * forwardInvocation: ends.  As the invocation is not yet invoked, that
-         * means we get default values instead of the correct returned value
-         * (eg, with a method returning an int, say 42, the actual value
-         * returned will be 0) But as we can't call the invocation ourself
-         * (that would break the invocations order) we need to wait until the
-         * runloop invoke it. We could use a condition variable to signal that
-         * the invocation is ready, but a faster way is to poll until the
-         * invocation is done (no context switch that way).  There doesn't seem
-         * to be a method returning the invocation status, therefore we simply
-         * increment the retain count before adding the invocation to the
-         * runloop.  In the runloop we decrement the retain count once the
-         * invocation is invoked, and we just wait until the retain count
-         * equals the original count.
+         * The return value is read from the invocation as soon as
+         * forwardInvocation: returns, so we must wait until the invocation
+         * has run in order.  Each caller waits on its own completion slot on
+         * its stack, which spins briefly before sleeping, so concurrent
+         * callers do not contend and a quick call costs no context switch.
          */
-        concreteType = YES;
+        ETCompletionSlotInit(&call.slot);
+        call.exception = nil;
+        context = (void*)((uintptr_t)&call | SCALAR_CALL_TAG);
     }
-    [anInvocation retain];
-    INSERT(anInvocation, retVal);
+    [self enqueueInvocation: message context: context];
 
-    if (concreteType)
+    if (IS_SCALAR_CALL(context))
     {
-        [returnConcrete lockWhenCondition: 1];
-        [returnConcrete unlockWithCondition: 0];
+        ETThreadPool *currentPool = [ETThreadPool currentPool];
+
+        /* A worker must not block while the call may be waiting for one */
+        if (nil == currentPool)
+        {
+            ETCompletionSlotWait(&call.slot);
+        }
+        else
+        {
+            [currentPool waitWithFunction: waitForScalarCall context: &call];
+        }
+        ETCompletionSlotDestroy(&call.slot);
+        [call.exception autorelease];
+        [call.exception raise];
     }
 }
 
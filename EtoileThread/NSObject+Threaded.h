@@ -33,6 +33,8 @@
 
 #import <Foundation/Foundation.h>
 
+@class ETThreadPool;
+
 /**
  * Threaded objects should implement the Idle protocol if they wish to do
  * something while waiting for messages.  If they have work to do, they should
@@ -68,4 +70,24 @@
  * execute a method on the called object in a new thread.
  */
 - (id) inNewThread;
+/**
+ * Returns a trampoline object like -inNewThread, which can hold up to
+ * aCapacity messages waiting to be executed before senders have to wait.
+ */
+- (id) inNewThreadWithQueueCapacity: (NSUInteger)aCapacity;
+/**
+ * Create an instance of the object whose messages are run by the shared
+ * [ETThreadPool], instead of by a thread of its own.
+ */
++ (id) pooledNew;
+/**
+ * Returns a trampoline object like -inNewThread, whose messages are run by
+ * the shared [ETThreadPool] instead of by a new thread.
+ */
+- (id) inThreadPool;
+/**
+ * Returns a trampoline object whose messages are run by aPool, and which can
+ * hold up to aCapacity messages waiting to be executed.
+ */
+- (id) inThreadPool: (ETThreadPool *)aPool queueCapacity: (NSUInteger)aCapacity;
 @end
@@ -34,6 +34,7 @@
 #import "NSObject+Threaded.h"
 #import "ETThreadedObject.h"
 #import "ETThreadProxyReturn.h"
+#import "ETThreadPool.h"
 
 @implementation NSObject (Threaded)
 
@@ -48,11 +49,41 @@
 
 - (id) inNewThread
 {
-    id proxy = [[[ETThreadedObject alloc] initWithObject: self] autorelease];
+    return [self inNewThreadWithQueueCapacity: ETThreadedObjectDefaultQueueCapacity];
+}
+
+- (id) inNewThreadWithQueueCapacity: (NSUInteger)aCapacity
+{
+    id proxy = [[[ETThreadedObject alloc] initWithObject: self
+                                           queueCapacity: aCapacity] autorelease];
+    if (nil == proxy)
+    {
+        return nil;
+    }
     [NSThread detachNewThreadSelector: @selector(runloop:)
                              toTarget: [[proxy retain] autorelease]
                            withObject: nil];
     return proxy;
 }
 
++ (id) pooledNew
+{
+    return [[ETThreadedObject alloc] initWithObject: [[self alloc] init]
+                                         threadPool: [ETThreadPool sharedPool]
+                                      queueCapacity: ETThreadedObjectDefaultQueueCapacity];
+}
+
+- (id) inThreadPool
+{
+    return [self inThreadPool: [ETThreadPool sharedPool]
+                queueCapacity: ETThreadedObjectDefaultQueueCapacity];
+}
+
+- (id) inThreadPool: (ETThreadPool *)aPool queueCapacity: (NSUInteger)aCapacity
+{
+    return [[[ETThreadedObject alloc] initWithObject: [self retain]
+                                          threadPool: aPool
+                                       queueCapacity: aCapacity] autorelease];
+}
+
 @end
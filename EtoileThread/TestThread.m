@@ -33,6 +33,11 @@
 #import <Foundation/Foundation.h>
 #import <UnitKit/UnitKit.h>
 #import <EtoileFoundation/EtoileFoundation.h>
+#import "ETObjectPipe.h"
+#import "ETPipeline.h"
+#import "ETThreadedObject.h"
+#import "ETThreadPool.h"
+#import "ETThreadProxyReturn.h"
 
 static BOOL deallocCalled;
 
@@ -71,6 +76,24 @@ static BOOL deallocCalled;
 
 
 
+/**
+ * Pipeline filter adding one to the int stored in each buffer.
+ */
+@interface IncrementFilter : NSObject <ETPipelineFilter>
+@end
+
+@implementation IncrementFilter
+
+- (BOOL) processBuffer: (id)anInput intoBuffer: (id)anOutput
+{
+    int value = *(int *)[anInput bytes] + 1;
+
+    [anOutput setData: [NSData dataWithBytes: &value length: sizeof(int)]];
+    return YES;
+}
+
+@end
+
 @interface TestThread : NSObject <UKTest>
 @end
 
@@ -138,4 +161,224 @@ static BOOL deallocCalled;
     UKTrue(deallocCalled);
 }
 
+- (void) testPooledNewRetainCount
+{
+    deallocCalled = NO;
+    
+    id pool = [[NSAutoreleasePool alloc] init];
+    id object = [ThreadTestClass pooledNew];
+    [[object test] description];
+    [object release];
+    [pool release];
+
+    sleep(1);
+    UKTrue(deallocCalled);
+}
+
+- (void) testPooledMessageOrder
+{
+    id pool = [[NSAutoreleasePool alloc] init];
+    NSMutableArray *array = [NSMutableArray array];
+    id object = [array inThreadPool: [ETThreadPool sharedPool] queueCapacity: 16];
+
+    for (unsigned i=0 ; i<1000 ; i++)
+    {
+        [object addObject: [NSNumber numberWithUnsignedInt: i]];
+    }
+    /* Returns once the messages sent before have been executed */
+    UKIntsEqual(1000, [object count]);
+    for (unsigned i=0 ; i<1000 ; i++)
+    {
+        UKIntsEqual(i, [[array objectAtIndex: i] unsignedIntValue]);
+    }
+
+    ETMailboxStatistics statistics = [object mailboxStatistics];
+    UKIntsEqual(0, statistics.queueDepth);
+    UKIntsEqual(16, statistics.queueCapacity);
+    UKTrue(statistics.maximumQueueDepth <= 16);
+    UKTrue(statistics.processedMessageCount >= 1000);
+    [pool release];
+}
+
+- (void) testOversizedQueueCapacity
+{
+    UKNil([[ETThreadedObject alloc] initWithObject: nil
+                                        threadPool: [ETThreadPool sharedPool]
+                                     queueCapacity: NSUIntegerMax]);
+}
+
+/**
+ * Sends the ints 0 to 99 through the pipeline.
+ */
+- (void) feedPipeline: (ETPipeline *)pipeline
+{
+    id pool = [[NSAutoreleasePool alloc] init];
+
+    for (int i=0 ; i<100 ; i++)
+    {
+        NSMutableData *input = [pipeline recycledInput];
+        if (nil == input)
+        {
+            input = [NSMutableData new];
+        }
+        [input setData: [NSData dataWithBytes: &i length: sizeof(int)]];
+        [pipeline sendInput: input];
+    }
+    [pool release];
+}
+
+- (void) checkPipeline: (ETPipeline *)pipeline
+{
+    id pool = [[NSAutoreleasePool alloc] init];
+
+    /* Fed from another thread, so that both ends of the pipeline can wait */
+    [NSThread detachNewThreadSelector: @selector(feedPipeline:)
+                             toTarget: self
+                           withObject: pipeline];
+    for (int i=0 ; i<100 ; i++)
+    {
+        id output = [pipeline nextOutput];
+        UKIntsEqual(i + 3, *(int *)[output bytes]);
+        [pipeline recycleOutput: output];
+    }
+    UKIntsEqual(3, [pipeline stageCount]);
+    UKIntsEqual(100, [pipeline statisticsForStageAtIndex: 2].processedCount);
+    [pipeline disconnect];
+    [pool release];
+}
+
+- (void) testThreadedPipeline
+{
+    NSArray *filters = A([[IncrementFilter new] autorelease],
+        [[IncrementFilter new] autorelease], [[IncrementFilter new] autorelease]);
+    ETPipeline *pipeline = [[ETPipeline alloc] initWithFilters: filters capacity: 4];
+
+    [self checkPipeline: pipeline];
+    [pipeline release];
+}
+
+- (void) testPooledPipeline
+{
+    NSArray *filters = A([[IncrementFilter new] autorelease],
+        [[IncrementFilter new] autorelease], [[IncrementFilter new] autorelease]);
+    ETPipeline *pipeline = [[ETPipeline alloc] initWithFilters: filters
+                                                    threadPool: [ETThreadPool sharedPool]
+                                                      capacity: 4];
+
+    [self checkPipeline: pipeline];
+    [pipeline release];
+}
+
+- (void) testObjectPipeCapacity
+{
+    ETObjectPipe *pipe = [[ETObjectPipe alloc] initWithCapacity: 5];
+
+    UKIntsEqual(8, [pipe capacity]);
+    [pipe release];
+    pipe = [[ETObjectPipe alloc] initWithCapacity: 0];
+    UKIntsEqual(2, [pipe capacity]);
+    [pipe release];
+    UKNil([[ETObjectPipe alloc] initWithCapacity: NSUIntegerMax]);
+}
+
+- (void) testObjectPipeBatches
+{
+    ETObjectPipe *pipe = [[ETObjectPipe alloc] initWithCapacity: 4];
+    NSMutableArray *received = [NSMutableArray array];
+
+    [pipe sendRequests: A(@"a", @"b", @"c")];
+    UKTrue([pipe hasRequests]);
+    UKIntsEqual(3, [pipe drainRequestsInto: received]);
+    UKObjectsEqual(A(@"a", @"b", @"c"), received);
+    UKFalse([pipe hasRequests]);
+
+    /* Three requests are still waiting for their replies */
+    [pipe sendRequests: A(@"d")];
+    UKTrue([pipe isPipeFull]);
+    [pipe sendReply: @"a"];
+    UKObjectsEqual(@"a", [pipe pollForReply]);
+    UKFalse([pipe isPipeFull]);
+    [pipe release];
+}
+
+- (void) testObjectPipeReleasesObjectsSentWhenDisconnectedAndFull
+{
+    ETObjectPipe *pipe = [[ETObjectPipe alloc] initWithCapacity: 2];
+    id object = [NSObject new];
+
+    UKTrue([pipe sendRequest: @"a"]);
+    UKTrue([pipe sendRequest: @"b"]);
+    [pipe disconnect];
+    [object retain];
+    UKFalse([pipe sendRequest: object]);
+    UKIntsEqual(1, [object retainCount]);
+    [object release];
+    [pipe release];
+}
+
+- (void) sendRequestsToPipe: (ETObjectPipe *)aPipe
+{
+    id pool = [[NSAutoreleasePool alloc] init];
+
+    [aPipe sendRequests: A(@"a", @"b", @"c", @"d", @"e", @"f", @"g")];
+    [pool release];
+}
+
+- (void) testObjectPipeSendRequestsWaitsForSpace
+{
+    ETObjectPipe *pipe = [[ETObjectPipe alloc] initWithCapacity: 2];
+    NSMutableArray *received = [NSMutableArray array];
+
+    [NSThread detachNewThreadSelector: @selector(sendRequestsToPipe:)
+                             toTarget: self
+                           withObject: pipe];
+    while ([received count] < 7)
+    {
+        UKTrue([pipe drainRequestsInto: received] > 0);
+    }
+    UKObjectsEqual(A(@"a", @"b", @"c", @"d", @"e", @"f", @"g"), received);
+
+    /* Once disconnected, waiting for a request returns at once */
+    [pipe disconnect];
+    UKIntsEqual(0, [pipe drainRequestsInto: received]);
+    [pipe release];
+}
+
+#if __has_feature(blocks)
+- (void) testFutureContinuations
+{
+    id pool = [[NSAutoreleasePool alloc] init];
+    NSMutableArray *objects = [NSMutableArray array];
+
+    for (unsigned i=0 ; i<4 ; i++)
+    {
+        ThreadTestClass *object = [[ThreadTestClass alloc] init];
+        [objects addObject: [object inThreadPool]];
+        [object release];
+    }
+
+    NSMutableArray *futures = [NSMutableArray array];
+    for (id object in objects)
+    {
+        [futures addObject: [[object test] then: ^(id value)
+        {
+            return [value description];
+        }]];
+    }
+
+    ETThreadProxyReturn *all = [ETThreadProxyReturn whenAll: futures];
+    UKTrue([all waitUntilDate: [NSDate dateWithTimeIntervalSinceNow: 5]]);
+    UKIntsEqual(4, [[all value] count]);
+    UKTrue([[[all value] objectAtIndex: 0] hasPrefix: @"<NSObject"]);
+
+    ETThreadProxyReturn *never = [[[ETThreadProxyReturn alloc] init] autorelease];
+    ETThreadProxyReturn *timeout = [never futureWithTimeout: 0.1];
+    UKTrue([timeout waitUntilDate: [NSDate dateWithTimeIntervalSinceNow: 5]]);
+    UKRaisesException([timeout value]);
+    [never setProxyObject: nil];
+
+    [pool release];
+}
+#endif
+
 @end
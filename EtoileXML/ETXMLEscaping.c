@@ -0,0 +1,374 @@
+/*
+    Copyright (C) 2026 The Etoile Project
+
+    Date:  October 2026
+    License:  Modified BSD (see COPYING)
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "ETXMLEscaping.h"
+
+#if defined(__AVX2__)
+#   include <immintrin.h>
+#elif defined(__SSE2__)
+#   include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#   include <arm_neon.h>
+#   define USE_NEON 1
+#endif
+
+/**
+ * Replacement text for each byte that must be escaped, NULL for the others.
+ */
+static const char *const entities[256] =
+{
+    ['&'] = "&amp;",
+    ['<'] = "&lt;",
+    ['>'] = "&gt;",
+    ['\''] = "&apos;",
+    ['"'] = "&quot;"
+};
+
+static const unsigned char entityLengths[256] =
+{
+    ['&'] = 5, ['<'] = 4, ['>'] = 4, ['\''] = 6, ['"'] = 6
+};
+
+static inline size_t findEscapableByteScalar(const unsigned char *bytes,
+                                             size_t start,
+                                             size_t length)
+{
+    for (size_t i=start ; i<length ; i++)
+    {
+        if (0 != entityLengths[bytes[i]])
+        {
+            return i;
+        }
+    }
+    return length;
+}
+
+/*
+ * The vector loops test for the five characters with three comparisons:
+ * '<' (0x3C) and '>' (0x3E) are the only bytes for which (b | 2) == 0x3E, and
+ * '&' (0x26) and '\'' (0x27) are the only ones for which (b | 1) == 0x27.
+ */
+size_t ETXMLFindEscapableByte(const char *string, size_t length)
+{
+    const unsigned char *bytes = (const unsigned char*)string;
+    size_t i = 0;
+#if defined(__AVX2__)
+    const __m256i angle = _mm256_set1_epi8(0x3E);
+    const __m256i two = _mm256_set1_epi8(2);
+    const __m256i ampersand = _mm256_set1_epi8(0x27);
+    const __m256i one = _mm256_set1_epi8(1);
+    const __m256i quote = _mm256_set1_epi8('"');
+
+    for (; i + 32 <= length ; i += 32)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(bytes + i));
+        __m256i match = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(_mm256_or_si256(v, two), angle),
+                            _mm256_cmpeq_epi8(_mm256_or_si256(v, one), ampersand)),
+            _mm256_cmpeq_epi8(v, quote));
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(match);
+        if (0 != mask)
+        {
+            return i + __builtin_ctz(mask);
+        }
+    }
+#elif defined(__SSE2__)
+    const __m128i angle = _mm_set1_epi8(0x3E);
+    const __m128i two = _mm_set1_epi8(2);
+    const __m128i ampersand = _mm_set1_epi8(0x27);
+    const __m128i one = _mm_set1_epi8(1);
+    const __m128i quote = _mm_set1_epi8('"');
+
+    for (; i + 16 <= length ; i += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*)(bytes + i));
+        __m128i match = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(_mm_or_si128(v, two), angle),
+                         _mm_cmpeq_epi8(_mm_or_si128(v, one), ampersand)),
+            _mm_cmpeq_epi8(v, quote));
+        unsigned int mask = (unsigned int)_mm_movemask_epi8(match);
+        if (0 != mask)
+        {
+            return i + __builtin_ctz(mask);
+        }
+    }
+#elif defined(USE_NEON)
+    const uint8x16_t angle = vdupq_n_u8(0x3E);
+    const uint8x16_t two = vdupq_n_u8(2);
+    const uint8x16_t ampersand = vdupq_n_u8(0x27);
+    const uint8x16_t one = vdupq_n_u8(1);
+    const uint8x16_t quote = vdupq_n_u8('"');
+
+    for (; i + 16 <= length ; i += 16)
+    {
+        uint8x16_t v = vld1q_u8(bytes + i);
+        uint8x16_t match = vorrq_u8(
+            vorrq_u8(vceqq_u8(vorrq_u8(v, two), angle),
+                     vceqq_u8(vorrq_u8(v, one), ampersand)),
+            vceqq_u8(v, quote));
+        uint64x2_t lanes = vreinterpretq_u64_u8(match);
+        if (0 != (vgetq_lane_u64(lanes, 0) | vgetq_lane_u64(lanes, 1)))
+        {
+            // NEON has no movemask, so locate the match in this block with
+            // the scalar loop.
+            return findEscapableByteScalar(bytes, i, i + 16);
+        }
+    }
+#endif
+    return findEscapableByteScalar(bytes, i, length);
+}
+
+const char *ETXMLEntityForByte(char c, size_t *outLength)
+{
+    *outLength = entityLengths[(unsigned char)c];
+    return entities[(unsigned char)c];
+}
+
+int ETXMLEscapeBytes(const char *bytes, size_t length, char **outBytes, size_t *outLength)
+{
+    size_t next = ETXMLFindEscapableByte(bytes, length);
+
+    *outBytes = NULL;
+    if (next == length)
+    {
+        return 0;
+    }
+
+    // Most text contains few special characters, so start with a little slack
+    // and double the buffer if it runs out.
+    size_t capacity = length + (length >> 3) + 16;
+    char *escaped = malloc(capacity);
+    size_t used = 0;
+    size_t i = 0;
+
+    if (NULL == escaped)
+    {
+        return -1;
+    }
+    while (1)
+    {
+        size_t run = next - i;
+        // Room for the run, the longest entity and the terminator.
+        if (used + run + 7 > capacity)
+        {
+            capacity = (capacity * 2 > used + run + 7) ? capacity * 2 : used + run + 7;
+            char *grown = realloc(escaped, capacity);
+            if (NULL == grown)
+            {
+                free(escaped);
+                return -1;
+            }
+            escaped = grown;
+        }
+        memcpy(escaped + used, bytes + i, run);
+        used += run;
+        if (next == length)
+        {
+            break;
+        }
+
+        unsigned char c = (unsigned char)bytes[next];
+        memcpy(escaped + used, entities[c], entityLengths[c]);
+        used += entityLengths[c];
+        i = next + 1;
+        next = i + ETXMLFindEscapableByte(bytes + i, length - i);
+    }
+    escaped[used] = '\0';
+    *outBytes = escaped;
+    *outLength = used;
+    return 0;
+}
+
+/**
+ * Writes the UTF-8 encoding of a character that may appear in an XML document
+ * to out and returns the number of bytes written, or returns 0 if the
+ * character is not allowed in XML.
+ */
+static inline size_t encodeCharacter(uint32_t c, char *out)
+{
+    if (c < 0x20 && c != '\t' && c != '\n' && c != '\r')
+    {
+        return 0;
+    }
+    if (c < 0x80)
+    {
+        out[0] = (char)c;
+        return 1;
+    }
+    if (c < 0x800)
+    {
+        out[0] = (char)(0xC0 | (c >> 6));
+        out[1] = (char)(0x80 | (c & 0x3F));
+        return 2;
+    }
+    if (c < 0x10000)
+    {
+        if ((c >= 0xD800 && c <= 0xDFFF) || c == 0xFFFE || c == 0xFFFF)
+        {
+            return 0;
+        }
+        out[0] = (char)(0xE0 | (c >> 12));
+        out[1] = (char)(0x80 | ((c >> 6) & 0x3F));
+        out[2] = (char)(0x80 | (c & 0x3F));
+        return 3;
+    }
+    if (c < 0x110000)
+    {
+        out[0] = (char)(0xF0 | (c >> 18));
+        out[1] = (char)(0x80 | ((c >> 12) & 0x3F));
+        out[2] = (char)(0x80 | ((c >> 6) & 0x3F));
+        out[3] = (char)(0x80 | (c & 0x3F));
+        return 4;
+    }
+    return 0;
+}
+
+/**
+ * Decodes the reference starting with the '&' at bytes[0] into out.  Returns
+ * the number of input bytes consumed, or 0 if this is not a reference we
+ * understand.  Sets *written to the number of bytes written to out, which is
+ * never more than the number of bytes consumed.
+ */
+static inline size_t decodeReference(const char *bytes, size_t length,
+                                     char *out, size_t *written)
+{
+    // The longest reference we understand is &#x10FFFF; plus some leading
+    // zeros, so give up if there is no ';' close by.
+    const char *semicolon = memchr(bytes, ';', length < 16 ? length : 16);
+    if (NULL == semicolon)
+    {
+        return 0;
+    }
+
+    size_t consumed = semicolon - bytes + 1;
+    const char *name = bytes + 1;
+    size_t nameLength = consumed - 2;
+
+    if (nameLength > 1 && name[0] == '#')
+    {
+        uint32_t c = 0;
+        int hex = (name[1] == 'x' || name[1] == 'X');
+        size_t digits = hex ? 2 : 1;
+
+        if (digits == nameLength)
+        {
+            return 0;
+        }
+        for (; digits < nameLength ; digits++)
+        {
+            char d = name[digits];
+            uint32_t value;
+
+            if (d >= '0' && d <= '9')
+            {
+                value = d - '0';
+            }
+            else if (hex && d >= 'a' && d <= 'f')
+            {
+                value = d - 'a' + 10;
+            }
+            else if (hex && d >= 'A' && d <= 'F')
+            {
+                value = d - 'A' + 10;
+            }
+            else
+            {
+                return 0;
+            }
+            c = c * (hex ? 16 : 10) + value;
+            if (c > 0x10FFFF)
+            {
+                return 0;
+            }
+        }
+        *written = encodeCharacter(c, out);
+        return (0 == *written) ? 0 : consumed;
+    }
+
+    char c;
+    if (nameLength == 2 && name[0] == 'l' && name[1] == 't')
+    {
+        c = '<';
+    }
+    else if (nameLength == 2 && name[0] == 'g' && name[1] == 't')
+    {
+        c = '>';
+    }
+    else if (nameLength == 3 && 0 == memcmp(name, "amp", 3))
+    {
+        c = '&';
+    }
+    else if (nameLength == 4 && 0 == memcmp(name, "apos", 4))
+    {
+        c = '\'';
+    }
+    else if (nameLength == 4 && 0 == memcmp(name, "quot", 4))
+    {
+        c = '"';
+    }
+    else
+    {
+        return 0;
+    }
+    out[0] = c;
+    *written = 1;
+    return consumed;
+}
+
+int ETXMLUnescapeBytes(const char *bytes, size_t length, char **outBytes, size_t *outLength)
+{
+    // Only '&' matters here, and memchr() is already vectorised by the C
+    // library on the platforms we care about.
+    const char *ampersand = memchr(bytes, '&', length);
+
+    *outBytes = NULL;
+    if (NULL == ampersand)
+    {
+        return 0;
+    }
+
+    // A reference is never shorter than the text it decodes to.
+    char *unescaped = malloc(length + 1);
+    const char *end = bytes + length;
+    size_t used = 0;
+
+    if (NULL == unescaped)
+    {
+        return -1;
+    }
+    while (NULL != ampersand)
+    {
+        size_t run = ampersand - bytes;
+        size_t written = 0;
+        size_t consumed;
+
+        memcpy(unescaped + used, bytes, run);
+        used += run;
+        consumed = decodeReference(ampersand, end - ampersand,
+                                   unescaped + used, &written);
+        if (0 == consumed)
+        {
+            unescaped[used++] = '&';
+            consumed = 1;
+        }
+        else
+        {
+            used += written;
+        }
+        bytes = ampersand + consumed;
+        ampersand = memchr(bytes, '&', end - bytes);
+    }
+    memcpy(unescaped + used, bytes, end - bytes);
+    used += end - bytes;
+    unescaped[used] = '\0';
+    *outBytes = unescaped;
+    *outLength = used;
+    return 0;
+}
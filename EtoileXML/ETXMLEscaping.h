@@ -0,0 +1,53 @@
+/**
+    Copyright (C) 2026 The Etoile Project
+
+    Date:  October 2026
+    License:  Modified BSD (see COPYING)
+ */
+
+#ifndef __ET_XML_ESCAPING_INCLUDED__
+#define __ET_XML_ESCAPING_INCLUDED__
+
+#include <stddef.h>
+
+/**
+ * Returns the offset of the first byte in the length bytes that must be
+ * escaped in XML character data or attribute values (one of &amp;, &lt;,
+ * &gt;, ' and "), or length if there is none.
+ *
+ * The input is scanned 32 bytes at a time with AVX2, or 16 bytes at a time
+ * with SSE2 or NEON, when the compiler targets these instruction sets.
+ */
+size_t ETXMLFindEscapableByte(const char *bytes, size_t length);
+/**
+ * Returns the entity reference that replaces c when escaping and stores its
+ * length in outLength, or returns NULL if c does not need escaping.
+ */
+const char *ETXMLEntityForByte(char c, size_t *outLength);
+/**
+ * Escapes the five XML special characters in the length bytes of UTF-8 text.
+ *
+ * Stores a NULL-terminated buffer allocated with malloc(), which the caller
+ * must free, in outBytes and its length (excluding the terminator) in
+ * outLength.  Stores NULL in outBytes if nothing needs escaping, in which case
+ * the input can be used as it is.
+ *
+ * Returns 0 on success, or -1 if the buffer could not be allocated.
+ */
+int ETXMLEscapeBytes(const char *bytes, size_t length, char **outBytes, size_t *outLength);
+/**
+ * Replaces the predefined entity references (&amp;lt; &amp;gt; &amp;amp;
+ * &amp;apos; and &amp;quot;) and numeric character references (&amp;#NNN; and
+ * &amp;#xHHH;) in the length bytes of UTF-8 text by the characters they
+ * represent.  Unrecognised references are copied unmodified.
+ *
+ * Stores a NULL-terminated buffer allocated with malloc(), which the caller
+ * must free, in outBytes and its length (excluding the terminator) in
+ * outLength.  Stores NULL in outBytes if the input contains no references, in
+ * which case it can be used as it is.
+ *
+ * Returns 0 on success, or -1 if the buffer could not be allocated.
+ */
+int ETXMLUnescapeBytes(const char *bytes, size_t length, char **outBytes, size_t *outLength);
+
+#endif
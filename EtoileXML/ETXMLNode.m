@@ -204,7 +204,7 @@
     if([elements count] > 0 && [childrenByName count] == 0)
     {
         [XML appendString:@">"];
-        [XML appendString:escapeXMLCData([NSMutableString stringWithString:plainCDATA])];
+        [XML appendString:escapeXMLCData(plainCDATA)];
         [XML appendString:[NSString stringWithFormat:@"</%@>",nodeType]];
     }
     else if([elements count] > 0)
@@ -35,23 +35,27 @@
 
 @protocol ETXMLWriting;
 
+/**
+ * Markup languages understood by the parser.
+ */
+enum MarkupLanguage {PARSER_MODE_XML, PARSER_MODE_SGML};
+
 /**
  * An XML stream parse class.  This parser is statefull, and will cache any 
  * unparsed data.  Messages are fired off to the delegate for start and end tags
  * as well as character data.  
  *
+ * The parser works directly on UTF-8 bytes.  Unparsed input is kept in a
+ * compacting byte buffer and scanned by a table-driven state machine, which
+ * can be suspended at any byte when the input runs out and resumed when more
+ * data arrives.  Input that has been scanned once is never scanned again, so
+ * the cost of parsing a stream is linear in its size irrespective of how it is
+ * split into chunks.
+ *
  * This class might more accurately be called ETXMLScanner or ETXMLTokeniser
  * since the actual parsing is handled by the delegate.
  */
 @interface ETXMLParser : NSObject 
-{
-    NSMutableString *buffer;
-    int depth;
-    NSMutableArray *openTags;
-    enum {notag, intag, inattribute, incdata, instupidcdata, incomment, broken} state;
-    enum MarkupLanguage {PARSER_MODE_XML, PARSER_MODE_SGML}  mode;
-    NSMutableArray *handlers;
-}
 /**
  * Create a new parser with the specified delegate.
  */
@@ -74,6 +78,19 @@
  * Returns the content handler above the current one.  
  */
 - (id)parentHandler;
+/**
+ * Parse the given UTF-8 encoded bytes.  This, appended to any data previously
+ * supplied, must form a (partial) XML document.  The input may be split at any
+ * byte, including inside a multi-byte character.  This function returns NO if
+ * an error occurs while parsing.
+ */
+- (BOOL) parseBytes: (const void *)someBytes length: (NSUInteger)aLength;
+/**
+ * Parse the given UTF-8 encoded data.  Equivalent to -parseBytes:length: with
+ * the contents of the data object.  This is the preferred method for data
+ * read from a socket, since it avoids decoding the input into a string.
+ */
+- (BOOL) parseFromData: (NSData *)data;
 /**
  * Parse the given input string.  This, appended to any data previously supplied
  * using this method, must form a (partial) XML document.  This function returns
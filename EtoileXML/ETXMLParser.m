@@ -34,10 +34,481 @@
 #import "ETXMLParser.h"
 #import "ETXMLParserDelegate.h"
 #import "../Headers/Macros.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
 
-#define SUCCESS 0
-#define FAILURE -1
-#define TEMPORARYFAILURE 1
+/**
+ * Character classes used by the tokeniser.  Every input byte is mapped to one
+ * of these by the charClasses table, so the transition table only needs one
+ * column per class rather than one per byte.
+ */
+enum
+{
+    CC_NAME,
+    CC_SPACE,
+    CC_LT,
+    CC_GT,
+    CC_SLASH,
+    CC_EQ,
+    CC_QUOTE,
+    CC_BANG,
+    CC_QMARK,
+    CC_COUNT
+};
+
+/**
+ * Tokeniser states.  The states before TS_COUNT are inside a tag and are
+ * driven one byte at a time by the transition table.  The remaining states
+ * skip over runs of bytes with memchr() and friends.
+ */
+enum
+{
+    /** After '<'. */
+    TS_OPEN,
+    /** In the name of a start tag. */
+    TS_NAME,
+    /** In a start tag, between attributes. */
+    TS_ATTRIBUTES,
+    /** In an attribute name. */
+    TS_ATTRIBUTE_NAME,
+    /** After an attribute name, before '='. */
+    TS_AFTER_ATTRIBUTE_NAME,
+    /** After '=', before the value. */
+    TS_BEFORE_VALUE,
+    /** In an unquoted (SGML) attribute value. */
+    TS_UNQUOTED_VALUE,
+    /** After the '/' of an empty element tag. */
+    TS_EMPTY_TAG,
+    /** After '</'. */
+    TS_END_OPEN,
+    /** In the name of an end tag. */
+    TS_END_NAME,
+    /** After the name of an end tag. */
+    TS_END_SPACE,
+    TS_COUNT,
+    /** Before the root element.  Character data is discarded. */
+    S_PROLOG = TS_COUNT,
+    /** Character data. */
+    S_TEXT,
+    /** In a quoted attribute value. */
+    S_QUOTED_VALUE,
+    /** After '<!', before we know what follows. */
+    S_MARKUP_DECLARATION,
+    /** In a &lt;!-- comment --&gt;. */
+    S_COMMENT,
+    /** In a &lt;![CDATA[ section ]]&gt;. */
+    S_CDATA,
+    /** In a &lt;!DOCTYPE or other declaration. */
+    S_DECLARATION,
+    /** In a &lt;? processing instruction ?&gt;. */
+    S_PROCESSING_INSTRUCTION,
+    /** Unrecoverable error. */
+    S_BROKEN
+};
+
+/**
+ * Actions attached to transitions.  The low byte of a transition is the next
+ * state and the high byte is a set of these flags.  When several are set,
+ * they are performed in the order in which they are declared.
+ */
+#define A_NAME      (1<<8)  /* Tag name ends before this byte. */
+#define A_ATTRIBUTE (1<<9)  /* Attribute name ends before this byte. */
+#define A_VALUE     (1<<10) /* Unquoted attribute value ends before this byte. */
+#define A_BARE      (1<<11) /* The pending attribute has no value. */
+#define A_MARK      (1<<12) /* A new token starts at this byte. */
+#define A_QUOTE     (1<<13) /* A quoted value starts after this byte. */
+#define A_FINISH    (1<<14) /* The tag ends with this byte. */
+#define A_ERROR     (1<<15) /* Not well formed. */
+#define ERR A_ERROR
+
+static const unsigned char charClasses[256] =
+{
+    ['\t'] = CC_SPACE, ['\n'] = CC_SPACE, ['\r'] = CC_SPACE, ['\f'] = CC_SPACE,
+    ['\v'] = CC_SPACE, [' '] = CC_SPACE,
+    ['<'] = CC_LT, ['>'] = CC_GT, ['/'] = CC_SLASH, ['='] = CC_EQ,
+    ['"'] = CC_QUOTE, ['\''] = CC_QUOTE, ['!'] = CC_BANG, ['?'] = CC_QMARK
+};
+
+static const uint16_t transitions[TS_COUNT][CC_COUNT] =
+{
+    /*                          NAME                               SPACE                                LT   GT                             SLASH                                     EQ                                  QUOTE                              BANG                               QMARK */
+    [TS_OPEN] =                 { TS_NAME|A_MARK,                  TS_OPEN,                             ERR, ERR,                           TS_END_OPEN,                              ERR,                                ERR,                               S_MARKUP_DECLARATION,              S_PROCESSING_INSTRUCTION },
+    [TS_NAME] =                 { TS_NAME,                         TS_ATTRIBUTES|A_NAME,                ERR, A_NAME|A_FINISH,               TS_EMPTY_TAG|A_NAME,                      TS_NAME,                            TS_NAME,                           TS_NAME,                           TS_NAME },
+    [TS_ATTRIBUTES] =           { TS_ATTRIBUTE_NAME|A_MARK,        TS_ATTRIBUTES,                       ERR, A_FINISH,                      TS_EMPTY_TAG,                             ERR,                                ERR,                               TS_ATTRIBUTE_NAME|A_MARK,          TS_ATTRIBUTE_NAME|A_MARK },
+    [TS_ATTRIBUTE_NAME] =       { TS_ATTRIBUTE_NAME,               TS_AFTER_ATTRIBUTE_NAME|A_ATTRIBUTE, ERR, A_ATTRIBUTE|A_BARE|A_FINISH,   TS_EMPTY_TAG|A_ATTRIBUTE|A_BARE,          TS_BEFORE_VALUE|A_ATTRIBUTE,        ERR,                               TS_ATTRIBUTE_NAME,                 TS_ATTRIBUTE_NAME },
+    [TS_AFTER_ATTRIBUTE_NAME] = { TS_ATTRIBUTE_NAME|A_BARE|A_MARK, TS_AFTER_ATTRIBUTE_NAME,             ERR, A_BARE|A_FINISH,               TS_EMPTY_TAG|A_BARE,                      TS_BEFORE_VALUE,                    ERR,                               TS_ATTRIBUTE_NAME|A_BARE|A_MARK,   TS_ATTRIBUTE_NAME|A_BARE|A_MARK },
+    [TS_BEFORE_VALUE] =         { TS_UNQUOTED_VALUE|A_MARK,        TS_BEFORE_VALUE,                     ERR, A_BARE|A_FINISH,               TS_UNQUOTED_VALUE|A_MARK,                 TS_UNQUOTED_VALUE|A_MARK,           S_QUOTED_VALUE|A_QUOTE,            TS_UNQUOTED_VALUE|A_MARK,          TS_UNQUOTED_VALUE|A_MARK },
+    [TS_UNQUOTED_VALUE] =       { TS_UNQUOTED_VALUE,               TS_ATTRIBUTES|A_VALUE,               ERR, A_VALUE|A_FINISH,              TS_UNQUOTED_VALUE,                        TS_UNQUOTED_VALUE,                  TS_UNQUOTED_VALUE,                 TS_UNQUOTED_VALUE,                 TS_UNQUOTED_VALUE },
+    [TS_EMPTY_TAG] =            { ERR,                             TS_EMPTY_TAG,                        ERR, A_FINISH,                      ERR,                                      ERR,                                ERR,                               ERR,                               ERR },
+    [TS_END_OPEN] =             { TS_END_NAME|A_MARK,              TS_END_OPEN,                         ERR, ERR,                           ERR,                                      TS_END_NAME|A_MARK,                 TS_END_NAME|A_MARK,                TS_END_NAME|A_MARK,                TS_END_NAME|A_MARK },
+    [TS_END_NAME] =             { TS_END_NAME,                     TS_END_SPACE|A_NAME,                 ERR, A_NAME|A_FINISH,               ERR,                                      TS_END_NAME,                        TS_END_NAME,                       TS_END_NAME,                       TS_END_NAME },
+    [TS_END_SPACE] =            { ERR,                             TS_END_SPACE,                        ERR, A_FINISH,                      ERR,                                      ERR,                                ERR,                               ERR,                               ERR }
+};
+#undef ERR
+
+/**
+ * Buffer and tokeniser state.  Offsets are relative to the start of bytes.
+ * Everything before start has been consumed and can be discarded the next
+ * time the buffer needs to grow.
+ */
+struct ETXMLScanner
+{
+    unsigned char *bytes;
+    size_t length;
+    size_t capacity;
+    /** First byte that must be kept. */
+    size_t start;
+    /** Next byte to scan. */
+    size_t cursor;
+    /** First byte of the token being scanned. */
+    size_t mark;
+    /** Current state. */
+    unsigned char state;
+    /** State to return to after a comment or declaration. */
+    unsigned char outerState;
+    /** Delimiter of the current quoted attribute value. */
+    unsigned char quote;
+    /** Nesting depth of [ ] in a declaration. */
+    unsigned int declarationDepth;
+    /** YES in PARSER_MODE_SGML. */
+    BOOL sgml;
+};
+
+@interface ETXMLParser ()
+{
+    struct ETXMLScanner scanner;
+    NSMutableArray *openTags;
+    NSMutableArray *handlers;
+    /** Name of the tag being scanned. */
+    NSString *tagName;
+    /** Attributes of the tag being scanned. */
+    NSMutableDictionary *tagAttributes;
+    /** Name of the attribute being scanned. */
+    NSString *attributeName;
+}
+@end
+
+/**
+ * Returns a new string from UTF-8 bytes.  Falls back to Latin-1 if the input
+ * is not valid UTF-8, since we would rather be tolerant than lose the data.
+ */
+static inline NSString *newStringWithBytes(const unsigned char *bytes, size_t length)
+{
+    NSString *str = [[NSString alloc] initWithBytes: bytes
+                                             length: length
+                                           encoding: NSUTF8StringEncoding];
+    if (nil == str)
+    {
+        str = [[NSString alloc] initWithBytes: bytes
+                                       length: length
+                                     encoding: NSISOLatin1StringEncoding];
+    }
+    return str;
+}
+
+/**
+ * Returns the offset of the first occurrence of the three byte sequence
+ * needle in [from, end), or end if there is none.
+ */
+static inline size_t findSequence(const unsigned char *bytes, size_t from,
+                                  size_t end, const char *needle)
+{
+    while (from + 2 < end)
+    {
+        const unsigned char *found = memchr(bytes + from, needle[0], end - from - 2);
+        if (NULL == found)
+        {
+            break;
+        }
+        from = found - bytes;
+        if (found[1] == (unsigned char)needle[1] && found[2] == (unsigned char)needle[2])
+        {
+            return from;
+        }
+        from++;
+    }
+    return end;
+}
+
+static BOOL parserCharacters(ETXMLParser *parser, const unsigned char *bytes, size_t length);
+static BOOL parserTagName(ETXMLParser *parser, const unsigned char *bytes, size_t length);
+static BOOL parserAttributeName(ETXMLParser *parser, const unsigned char *bytes, size_t length);
+static BOOL parserAttributeValue(ETXMLParser *parser, const unsigned char *bytes, size_t length);
+static BOOL parserStartTag(ETXMLParser *parser, BOOL isEmpty);
+static BOOL parserEndTag(ETXMLParser *parser);
+
+/**
+ * Runs the tokeniser over the unscanned part of the buffer, firing events as
+ * tokens are completed.  Returns NO if the input is not well formed.  On
+ * return, s->start is the first byte that is still needed.
+ */
+static BOOL scan(ETXMLParser *parser, struct ETXMLScanner *s)
+{
+#define BREAK() do { s->state = S_BROKEN; return NO; } while(0)
+#define CHECK(x) do { if (!(x)) { BREAK(); } } while(0)
+    const unsigned char *bytes = s->bytes;
+    size_t end = s->length;
+    size_t i = s->cursor;
+    size_t mark = s->mark;
+    unsigned int state = s->state;
+
+    while (i < end)
+    {
+        if (state < TS_COUNT)
+        {
+            unsigned int previous = state;
+            unsigned int transition = transitions[state][charClasses[bytes[i]]];
+
+            state = transition & 0xff;
+            if (transition > 0xff)
+            {
+                if (transition & A_ERROR)
+                {
+                    BREAK();
+                }
+                if (transition & A_NAME)
+                {
+                    CHECK(parserTagName(parser, bytes + mark, i - mark));
+                }
+                if (transition & A_ATTRIBUTE)
+                {
+                    CHECK(parserAttributeName(parser, bytes + mark, i - mark));
+                }
+                if (transition & A_VALUE)
+                {
+                    CHECK(parserAttributeValue(parser, bytes + mark, i - mark));
+                }
+                if (transition & A_BARE)
+                {
+                    // Attributes without values are only allowed in SGML
+                    CHECK(s->sgml && parserAttributeValue(parser, bytes, 0));
+                }
+                if (transition & A_MARK)
+                {
+                    // Unquoted values are only allowed in SGML
+                    CHECK(state != TS_UNQUOTED_VALUE || s->sgml);
+                    mark = i;
+                }
+                if (transition & A_QUOTE)
+                {
+                    s->quote = bytes[i];
+                    mark = i + 1;
+                }
+                if (transition & A_FINISH)
+                {
+                    if (previous == TS_END_NAME || previous == TS_END_SPACE)
+                    {
+                        CHECK(parserEndTag(parser));
+                    }
+                    else
+                    {
+                        CHECK(parserStartTag(parser, previous == TS_EMPTY_TAG));
+                    }
+                    state = s->outerState = S_TEXT;
+                    mark = i + 1;
+                }
+            }
+            i++;
+            continue;
+        }
+        switch (state)
+        {
+            case S_PROLOG:
+            {
+                const unsigned char *lt = memchr(bytes + i, '<', end - i);
+                if (NULL == lt)
+                {
+                    i = end;
+                    break;
+                }
+                i = lt - bytes + 1;
+                mark = i;
+                state = TS_OPEN;
+                break;
+            }
+            case S_TEXT:
+            {
+                const unsigned char *lt = memchr(bytes + i, '<', end - i);
+                size_t textEnd = (NULL == lt) ? end : (size_t)(lt - bytes);
+                // If the character data contains a > (close tag) then we are
+                // parsing nonsense, not XML.
+                CHECK(NULL == memchr(bytes + i, '>', textEnd - i));
+                i = textEnd;
+                if (NULL == lt)
+                {
+                    break;
+                }
+                if (i > mark)
+                {
+                    CHECK(parserCharacters(parser, bytes + mark, i - mark));
+                }
+                i++;
+                mark = i;
+                state = TS_OPEN;
+                break;
+            }
+            case S_QUOTED_VALUE:
+            {
+                const unsigned char *quote = memchr(bytes + i, s->quote, end - i);
+                if (NULL == quote)
+                {
+                    i = end;
+                    break;
+                }
+                i = quote - bytes;
+                CHECK(parserAttributeValue(parser, bytes + mark, i - mark));
+                i++;
+                state = TS_ATTRIBUTES;
+                break;
+            }
+            case S_MARKUP_DECLARATION:
+            {
+                static const char cdata[] = "[CDATA[";
+                size_t available = end - i;
+
+                if (bytes[i] == '-')
+                {
+                    if (available < 2)
+                    {
+                        goto suspend;
+                    }
+                    if (bytes[i + 1] == '-')
+                    {
+                        i += 2;
+                        state = S_COMMENT;
+                        break;
+                    }
+                }
+                else if (bytes[i] == '[')
+                {
+                    size_t compared = MIN(available, sizeof(cdata) - 1);
+                    if (0 == memcmp(bytes + i, cdata, compared))
+                    {
+                        if (compared < sizeof(cdata) - 1)
+                        {
+                            goto suspend;
+                        }
+                        i += compared;
+                        mark = i;
+                        state = S_CDATA;
+                        break;
+                    }
+                }
+                s->declarationDepth = 0;
+                state = S_DECLARATION;
+                break;
+            }
+            case S_COMMENT:
+            {
+                size_t found = findSequence(bytes, i, end, "-->");
+                if (found == end)
+                {
+                    // Keep the last two bytes in case they start the terminator
+                    i = MAX(i, end - MIN(end, 2));
+                    goto suspend;
+                }
+                i = found + 3;
+                mark = i;
+                state = s->outerState;
+                break;
+            }
+            case S_CDATA:
+            {
+                size_t found = findSequence(bytes, i, end, "]]>");
+                if (found == end)
+                {
+                    // Deliver what we have so far, except for a possible
+                    // partial terminator or a partial multibyte character.
+                    size_t deliverable = MAX(mark, end - MIN(end, 2));
+                    while (deliverable > mark && (bytes[deliverable] & 0xC0) == 0x80)
+                    {
+                        deliverable--;
+                    }
+                    if (deliverable > mark)
+                    {
+                        CHECK(parserCharacters(parser, bytes + mark, deliverable - mark));
+                    }
+                    i = mark = deliverable;
+                    goto suspend;
+                }
+                if (found > mark)
+                {
+                    CHECK(parserCharacters(parser, bytes + mark, found - mark));
+                }
+                i = found + 3;
+                mark = i;
+                state = s->outerState = S_TEXT;
+                break;
+            }
+            case S_DECLARATION:
+            {
+                // Skip to the closing '>', ignoring any in an internal subset.
+                for (; i < end ; i++)
+                {
+                    unsigned char c = bytes[i];
+                    if (c == '[')
+                    {
+                        s->declarationDepth++;
+                    }
+                    else if (c == ']' && s->declarationDepth > 0)
+                    {
+                        s->declarationDepth--;
+                    }
+                    else if (c == '>' && s->declarationDepth == 0)
+                    {
+                        break;
+                    }
+                }
+                if (i == end)
+                {
+                    break;
+                }
+                i++;
+                mark = i;
+                state = s->outerState;
+                break;
+            }
+            case S_PROCESSING_INSTRUCTION:
+            {
+                const unsigned char *gt = memchr(bytes + i, '>', end - i);
+                if (NULL == gt)
+                {
+                    i = end;
+                    break;
+                }
+                i = gt - bytes + 1;
+                mark = i;
+                state = s->outerState;
+                break;
+            }
+            default:
+                BREAK();
+        }
+    }
+suspend:
+    s->cursor = i;
+    s->mark = mark;
+    s->state = state;
+    switch (state)
+    {
+        case TS_NAME:
+        case TS_ATTRIBUTE_NAME:
+        case TS_UNQUOTED_VALUE:
+        case TS_END_NAME:
+        case S_TEXT:
+        case S_QUOTED_VALUE:
+        case S_CDATA:
+            s->start = mark;
+            break;
+        default:
+            // The current token, if any, needs nothing from the buffer.
+            s->start = s->mark = i;
+    }
+    return YES;
+#undef CHECK
+#undef BREAK
+}
 
 @implementation ETXMLParser
 
@@ -57,10 +528,9 @@
 {
     SUPERINIT;
     handlers = [NSMutableArray new];
-    buffer = [[NSMutableString stringWithString:@""] retain];
     openTags = [[NSMutableArray alloc] init];
-    mode = PARSER_MODE_XML;
-    state = notag;
+    scanner.state = S_PROLOG;
+    scanner.outerState = S_PROLOG;
     return self;
 }
 
@@ -90,408 +560,190 @@
     return [handlers objectAtIndex: count - 2];
 }
 
-- (int) parseFrom: (int)_index to: (unichar)_endCharacter
+static BOOL parserCharacters(ETXMLParser *parser, const unsigned char *bytes, size_t length)
 {
-    int end = [buffer length];
-    //TODO:  Make this a bit less slow.
-    while(_index < end && [buffer characterAtIndex:_index] != _endCharacter)
+    NSString *cdata = newStringWithBytes(bytes, length);
+    NS_DURING
     {
-        _index++;
+        [[parser->handlers lastObject] characters: cdata];
     }
-    if(_index < end)
+    NS_HANDLER
     {
-        return _index;
+        NSLog(@"An exception occured while adding CDATA: \n'%@'\n.  Write better code!", cdata);
     }
-    return -1;
+    NS_ENDHANDLER
+    [cdata release];
+    return YES;
 }
 
-- (int) ignoreWhiteSpaceFrom: (int)_index
+static BOOL parserTagName(ETXMLParser *parser, const unsigned char *bytes, size_t length)
 {
-    int end = [buffer length];
-    if(_index >= end)
+    [parser->tagName release];
+    parser->tagName = newStringWithBytes(bytes, length);
+    return YES;
+}
+
+static BOOL parserAttributeName(ETXMLParser *parser, const unsigned char *bytes, size_t length)
+{
+    [parser->attributeName release];
+    parser->attributeName = newStringWithBytes(bytes, length);
+    return YES;
+}
+
+static BOOL parserAttributeValue(ETXMLParser *parser, const unsigned char *bytes, size_t length)
+{
+    size_t unescapedLength;
+    char *unescaped;
+    NSString *value;
+
+    if (0 != ETXMLUnescapeBytes((const char*)bytes, length, &unescaped, &unescapedLength))
+    {
+        NSLog(@"Failed to allocate memory to unescape an attribute value.");
+        return NO;
+    }
+    if (NULL == unescaped)
     {
-        return -1;
+        value = newStringWithBytes(bytes, length);
     }
-    unichar character = [buffer characterAtIndex:_index];
-    while(isspace(character))
+    else
     {
-        _index++;
-        if(_index >= end)
-        {
-            break;
-        }
-        character = [buffer characterAtIndex:_index];
+        value = newStringWithBytes((const unsigned char*)unescaped, unescapedLength);
+        free(unescaped);
     }
-    if(_index < end)
+    if (nil == parser->tagAttributes)
     {
-        return _index;
+        parser->tagAttributes = [NSMutableDictionary new];
     }
-    return -1;  
+    [parser->tagAttributes setObject: value
+                              forKey: parser->attributeName];
+    [value release];
+    return YES;
 }
 
-#define ISCOMMENT(tag) (([tag length] > 2) && [[tag substringToIndex:3] isEqualToString:@"!--"])
-
-- (int) parseTagFrom: (int *)_index 
-               named: (NSMutableString *)_name 
-      withAttributes:(NSMutableDictionary*)_attributes
+static BOOL parserEndTag(ETXMLParser *parser)
 {
-#define RETURN(x) (*_index) = current ; return x
-#define SKIPWHITESPACE  start = [self ignoreWhiteSpaceFrom:start]; if(start == -1) {RETURN(TEMPORARYFAILURE);}  current = start;
-#define SEARCHTO(x) current = [self parseFrom:start to:x];if(current == -1){RETURN(TEMPORARYFAILURE);}
-#define CURRENTSTRING [buffer substringWithRange:NSMakeRange(start,MIN((current - start), ([buffer length] - 1)))]
-
-    int start = *_index;
-    int current = -1;
-    int bufferLength = [buffer length];
-    NSString * attributeName;
-    NSString * attributeValue;
-    unichar currentChar;
-
-    SKIPWHITESPACE;
-    //Skip a leading '<' if there is one
-    currentChar = [buffer characterAtIndex:start];
-    while(
-          start < bufferLength && 
-          (
-           currentChar == '<' || 
-           currentChar == '/' 
-           )
-          )
-    {
-        start++;
-        currentChar = [buffer characterAtIndex:start];
-    }
-    SKIPWHITESPACE;
-//TODO: Parse <?xml and <!DOCTYPE things with this.
-    //get the name
-    currentChar=[buffer characterAtIndex:current];
-    while(current < (bufferLength-1) && !isspace(currentChar) && currentChar != '>' && currentChar != '/')
+    NSString *name = parser->tagName;
+    if (!parser->scanner.sgml)
     {
-        current++;
-        currentChar=[buffer characterAtIndex:current];      
-        if(current - start == 8
-            &&
-            [CURRENTSTRING isEqualToString:@"![CDATA["])
+        NSMutableArray *openTags = parser->openTags;
+        if ([openTags count] == 0 || ![[openTags lastObject] isEqualToString: name])
         {
-            [_name setString:CURRENTSTRING];
-            RETURN(SUCCESS);
+            NSLog(@"Tag %@ closed, but last tag opened was %@.", name, [openTags lastObject]);
+            return NO;
         }
+        [openTags removeLastObject];
     }
-    [_name setString:CURRENTSTRING];
-    if(ISCOMMENT(_name))
+    NS_DURING
     {
-        SEARCHTO('>');
-        state = incdata;
-        RETURN(SUCCESS);
+        [[parser->handlers lastObject] endElement: name];
     }
-    start = current;
-    //Skip to the end or the first attribute 
-    SKIPWHITESPACE;
-    while([buffer characterAtIndex:start] != '>' && start+1 < bufferLength && [buffer characterAtIndex:(start + 1)] != '>')
+    NS_HANDLER
     {
-        unichar quote;
-        SEARCHTO('=');
-        attributeName = CURRENTSTRING;
-        current++;
-        if((unsigned int)current >= [buffer length])
-        {
-            return TEMPORARYFAILURE;
-        }
-        quote = [buffer characterAtIndex:current];
-        BOOL quotedAttribute = (quote == '"' || quote == '\'');
-        if(!quotedAttribute)
-        {
-            if(mode == PARSER_MODE_XML)
-            {
-                RETURN(FAILURE);
-            }
-            else
-            {
-                quote = ' ';
-                current--;
-            }
-        }
-        current++;
-        start = current;
-        if(quotedAttribute)
-        {
-            SEARCHTO(quote);            
-        }
-        else
-        {
-            int end = [buffer length];
-            //TODO:  Make this a bit less slow.
-            while(current < end && 
-                  [buffer characterAtIndex:current] != quote
-                  &&
-                  [buffer characterAtIndex:current] != '>')
-            {
-                current++;
-            }
-            if(current >= end)
-            {
-                return TEMPORARYFAILURE;
-            }
-        }
-        attributeValue = CURRENTSTRING;
-        [_attributes setValue:unescapeXMLCData(attributeValue) forKey:attributeName];
-        start = current;
-        if(quotedAttribute)
-        {
-            start++;
-        }
-        SKIPWHITESPACE;
+        NSLog(@"An exception (%@) occured while ending element %@.  Write better code!", [localException reason], name);
+    }
+    NS_ENDHANDLER
+    return YES;
+}
+
+static BOOL parserStartTag(ETXMLParser *parser, BOOL isEmpty)
+{
+    NSString *name = parser->tagName;
+    NSMutableDictionary *attributes = parser->tagAttributes;
+
+    if (nil == attributes)
+    {
+        attributes = [NSMutableDictionary new];
+    }
+    parser->tagAttributes = nil;
+    NS_DURING
+    {
+        [[parser->handlers lastObject] startElement: name attributes: attributes];
+    }
+    NS_HANDLER
+    {
+        NSLog(@"An exception occured while starting element %@.  Write better code!  Exception: %@", name, [localException reason]); 
     }
-    if([buffer characterAtIndex:start] == '>' || (start+1 < bufferLength && [buffer characterAtIndex:(start + 1)] == '>'))
+    NS_ENDHANDLER
+    [attributes release];
+    if (!parser->scanner.sgml)
     {
-        RETURN(SUCCESS);
+        [parser->openTags addObject: name];
     }
-    RETURN(TEMPORARYFAILURE);
-#undef RETURN
-#undef CURRENTSTRING
-#undef SKIPWHITESPACE
-#undef SEARCHTO
+    return isEmpty ? parserEndTag(parser) : YES;
 }
 
-- (BOOL) parseFromSource: (NSString *)data
+- (BOOL) parseBytes: (const void *)someBytes length: (NSUInteger)aLength
 {
-//Macro to end parsing neatly if a particular condition is met
-//Invoking this stores the unparsed buffer and returns YES.
-#define ENDPARSINGIF(x) if(x) { [buffer deleteCharactersInRange:NSMakeRange(0,lastSuccessfullyParsed)]; /*NSLog(@"Unparsed: '%@'", buffer);*/ return YES;}
-#define SKIPTO(x) currentIndex = [self parseFrom:currentIndex to:x]; ENDPARSINGIF(currentIndex == -1);
-#define CURRENTSTRING [buffer substringWithRange:NSMakeRange(lastSuccessfullyParsed,currentIndex - lastSuccessfullyParsed)]
-                        
-    int currentIndex = 0;
-    int lastSuccessfullyParsed = 0;
-    int bufferLength;
-    if(state == broken)
+    struct ETXMLScanner *s = &scanner;
+
+    if (s->state == S_BROKEN)
     {
         return NO;
     }
-    //NSLog(@"Old XML: %@", buffer);    
-    [buffer appendString:data];
-    //NSLog(@"XML: %@", buffer);
-    bufferLength = [buffer length];
-    while(currentIndex < bufferLength)
+    if (s->length + aLength > s->capacity)
     {
-        unichar currentChar;
-        //If we have not yet parsed a tag, we are looking for either:
-        //1) An <?xml... tag
-        //2) A <!DOCTYPE... tag
-        //3) A root tag.
-        //Currently, we ignore anything other than case 3.
-        switch (state)
+        // Discard the consumed prefix before growing the buffer.
+        if (s->start > 0)
         {
-            case notag:
-            {
-                currentIndex = [self ignoreWhiteSpaceFrom:currentIndex];
-                if(currentIndex < 0)
-                {
-                    [buffer setString:@""];
-                    return YES;
-                }
-                SKIPTO('<');
-                currentIndex++;
-                state = intag;
-                ENDPARSINGIF(currentIndex >= bufferLength);
-                currentChar = [buffer characterAtIndex:currentIndex];
-                //Case 2.
-                //BUG: <?xml...?> initial tags containing the > tag will break this parser.
-                if(currentChar == '!' || currentChar == '?')
-                {
-                    //Skip to the end of the tag
-                    SKIPTO('>');
-                    state = notag;
-                    lastSuccessfullyParsed = currentIndex;
-                    currentIndex++;
-                } 
-                else
-                {
-                    lastSuccessfullyParsed = currentIndex;
-                }
-                break;
-            }
-            case intag:
-            {
-                NSMutableString * tagName = [[NSMutableString alloc] init];
-                NSMutableDictionary * tagAttributes = [[NSMutableDictionary alloc] init];
-                BOOL openTag = YES;
-                int parseSuccess;
-                
-                if([buffer characterAtIndex:currentIndex] == '<')
-                {
-                    currentIndex++;
-                    if(currentIndex >= bufferLength)
-                    {
-                        [buffer deleteCharactersInRange:NSMakeRange(0,currentIndex)];
-                        return YES;
-                    }
-                }
-                if([buffer characterAtIndex:currentIndex] == '/')
-                {
-                    openTag = NO;
-                    currentIndex++;
-                }
-                parseSuccess = [self parseTagFrom:&currentIndex named:tagName withAttributes:tagAttributes];
-                switch(parseSuccess)
-                {
-                    case SUCCESS:
-                        if(openTag)
-                        {
-                            if(!ISCOMMENT(tagName))
-                            {
-                                //Special case for stupid CDATA things.
-                                if([tagName isEqualToString:@"![CDATA["])
-                                {
-                                    lastSuccessfullyParsed = currentIndex;
-                                    state = instupidcdata;
-                                    break;
-                                }
-                                else
-                                {
-                                    NS_DURING
-                                    {
-                                        //NSLog(@"<%@> (%@)", tagName, tagAttributes);
-                                        [[handlers lastObject] startElement:tagName attributes:tagAttributes];
-                                    }
-                                    NS_HANDLER
-                                    {
-                                        NSLog(@"An exception occured while starting element %@.  Write better code!  Exception: %@", tagName, [localException reason]); 
-                                    }
-                                    NS_ENDHANDLER
-                                    if(mode == PARSER_MODE_XML)
-                                    {
-                                        [openTags addObject:tagName];
-                                    }
-                                    state = incdata;
-                                }
-                            }
-                        }
-                        currentChar = [buffer characterAtIndex:currentIndex];
-                        if(currentChar == '/' || !openTag)
-                        {
-                            if(mode == PARSER_MODE_XML)
-                            {
-                                if([openTags count] == 0 || ![[openTags lastObject] isEqualToString:tagName])
-                                {
-                                    state = broken;
-                                    NSLog(@"Tag %@ closed, but last tag opened was %@.", tagName, [openTags lastObject]);
-                                    return NO;
-                                }
-                                [openTags removeLastObject];
-                            }
-                            NS_DURING
-                            {
-                                //NSLog(@"</%@> (%@)", tagName, openTags);
-                                [[handlers lastObject] endElement:tagName];
-                            }
-                            NS_HANDLER
-                            {
-                                NSLog(@"An exception (%@) occured while ending element %@.  Write better code!", [localException reason], tagName);
-                            }
-                            NS_ENDHANDLER
-                            currentIndex++;
-                            state = incdata;
-                        }
-                        currentIndex--;
-                        SKIPTO('>');
-                        currentIndex++;
-                        lastSuccessfullyParsed = currentIndex;
-                        break;
-                    case TEMPORARYFAILURE:
-                        ENDPARSINGIF(YES);
-                    case FAILURE:
-                        state = broken;
-                        return NO;
-                    default:
-                        NSLog(@"parseTagFrom returned %d, which is just plain wrgon.", parseSuccess);
-                        state = broken;
-                        return NO;
-                }
-                [tagName release];
-                [tagAttributes release];
-                break;
-            }
-            case incdata:
-            {
-                NSString * cdata;
-                SKIPTO('<');
-                if (currentIndex != lastSuccessfullyParsed)
-                {
-                    cdata = CURRENTSTRING;
-                    //If cdata contains a > (close tag) then we are parsing nonsense, not XML.
-                    if([cdata rangeOfString:@">"].location != NSNotFound)
-                    {
-                        [cdata release];
-                        state = broken;
-                        return NO;
-                    }
-                    NS_DURING
-                    {
-                        [[handlers lastObject] characters:cdata];
-                    }
-                    NS_HANDLER
-                    {
-                        NSLog(@"An exception occured while adding CDATA: \n'%@'\n.  Write better code!", cdata);
-                    }
-                    NS_ENDHANDLER
-                    lastSuccessfullyParsed = currentIndex;
-                }
-                state = intag;
-                break;
-            }
-            case instupidcdata:
+            s->length -= s->start;
+            memmove(s->bytes, s->bytes + s->start, s->length);
+            s->cursor -= s->start;
+            s->mark -= s->start;
+            s->start = 0;
+        }
+        if (s->length + aLength > s->capacity)
+        {
+            size_t capacity = MAX(MAX(s->capacity * 2, 1024), s->length + aLength);
+            unsigned char *bytes = realloc(s->bytes, capacity);
+
+            if (NULL == bytes)
             {
-                NSString * cdata = [buffer substringFromIndex:lastSuccessfullyParsed];
-                NSRange cdataEnd = [cdata rangeOfString:@"]]>"];
-                if(cdataEnd.location == NSNotFound)
-                {               
-                    NS_DURING
-                    {
-                        [[handlers lastObject] characters:cdata];
-                    }
-                    NS_HANDLER
-                    {
-                        NSLog(@"An exception occured while adding CDATA: \n'%@'\n.  Write better code!", cdata);
-                    }
-                    NS_ENDHANDLER
-                    currentIndex = bufferLength;
-                }
-                else
-                {
-                    NS_DURING
-                    {
-                        [[handlers lastObject] characters:[cdata substringToIndex:cdataEnd.location]];
-                    }
-                    NS_HANDLER
-                    {
-                        NSLog(@"An exception occured while adding CDATA: \n'%@'\n.  Write better code!", cdata);
-                    }
-                    NS_ENDHANDLER
-                    currentIndex += cdataEnd.location + 3;
-                    state = notag;
-                }
-                lastSuccessfullyParsed = currentIndex;
-                break;
+                s->state = S_BROKEN;
+                return NO;
             }
-            default:
-                NSLog(@"Parser in undefined state.");
+            s->bytes = bytes;
+            s->capacity = capacity;
         }
     }
-    [buffer setString:@""];
-    return YES;
-#undef CURRENTSTRING
-#undef ENDPARSINGIF
-#undef SKIPTO
+    if (aLength > 0)
+    {
+        memcpy(s->bytes + s->length, someBytes, aLength);
+        s->length += aLength;
+    }
+
+    BOOL success = scan(self, s);
+
+    // Everything has been consumed, so we can reuse the whole buffer.
+    if (s->start == s->length)
+    {
+        s->start = s->length = s->cursor = s->mark = 0;
+    }
+    return success;
+}
+
+- (BOOL) parseFromData: (NSData *)data
+{
+    return [self parseBytes: [data bytes] length: [data length]];
+}
+
+- (BOOL) parseFromSource: (NSString *)data
+{
+    return [self parseBytes: [data UTF8String]
+                     length: [data lengthOfBytesUsingEncoding: NSUTF8StringEncoding]];
 }
 
 - (void) setMode: (enum MarkupLanguage)aMode
 {
-    mode = aMode;
+    scanner.sgml = (aMode == PARSER_MODE_SGML);
 }
 - (void)dealloc
 {
-    [buffer release];
+    free(scanner.bytes);
+    [openTags release];
+    [handlers release];
+    [tagName release];
+    [tagAttributes release];
+    [attributeName release];
     [super dealloc];
 }
 
@@ -32,6 +32,31 @@
  */
 
 #import <Foundation/Foundation.h>
+#include "ETXMLEscaping.h"
+
+/**
+ * Returns a new mutable string made from the UTF-8 bytes returned by an
+ * escaping function, or a mutable copy of aString when bytes is NULL.
+ * Raises an NSMallocException if the escaping function failed.
+ */
+static inline NSMutableString * ETXMLMutableStringWithConvertedBytes(int status,
+    char *bytes, size_t length, NSString *aString)
+{
+    if(status != 0)
+    {
+        [NSException raise: NSMallocException
+                    format: @"Failed to allocate the converted copy of a "
+                             "string of %lu characters", (unsigned long)[aString length]];
+    }
+    if(bytes == NULL)
+    {
+        return [NSMutableString stringWithString: aString];
+    }
+    return [[[NSMutableString alloc] initWithBytesNoCopy: bytes
+                                                  length: length
+                                                encoding: NSUTF8StringEncoding
+                                            freeWhenDone: YES] autorelease];
+}
 
 /**
  * Helper function for escaping XML character data.
@@ -42,17 +67,17 @@ static inline NSMutableString * escapeXMLCData(NSString *_XMLString)
     {
         return [NSMutableString stringWithString:@""];
     }
-    NSMutableString * XMLString = [NSMutableString stringWithString:_XMLString];
-    [XMLString replaceOccurrencesOfString:@"&" withString:@"&amp;" options:0 range:NSMakeRange(0,[XMLString length])];
-    [XMLString replaceOccurrencesOfString:@"<" withString:@"&lt;" options:0 range:NSMakeRange(0,[XMLString length])];
-    [XMLString replaceOccurrencesOfString:@">" withString:@"&gt;" options:0 range:NSMakeRange(0,[XMLString length])];
-    [XMLString replaceOccurrencesOfString:@"'" withString:@"&apos;" options:0 range:NSMakeRange(0,[XMLString length])];
-    [XMLString replaceOccurrencesOfString:@"\"" withString:@"&quot;" options:0 range:NSMakeRange(0,[XMLString length])];
-    return XMLString;
+    char *escaped;
+    size_t length;
+    int status = ETXMLEscapeBytes([_XMLString UTF8String],
+        [_XMLString lengthOfBytesUsingEncoding: NSUTF8StringEncoding],
+        &escaped, &length);
+    return ETXMLMutableStringWithConvertedBytes(status, escaped, length, _XMLString);
 }
 
 /**
- * Helper function for unescaping XML character data.
+ * Helper function for unescaping XML character data.  Numeric character
+ * references are decoded as well as the predefined entities.
  */
 static inline NSMutableString * unescapeXMLCData(NSString *_XMLString)
 {
@@ -60,13 +85,12 @@ static inline NSMutableString * unescapeXMLCData(NSString *_XMLString)
     {
         return [NSMutableString stringWithString:@""];
     }
-    NSMutableString * XMLString = [NSMutableString stringWithString:_XMLString];
-    [XMLString replaceOccurrencesOfString:@"&lt;" withString:@"<" options:0 range:NSMakeRange(0,[XMLString length])];
-    [XMLString replaceOccurrencesOfString:@"&gt;" withString:@">" options:0 range:NSMakeRange(0,[XMLString length])];
-    [XMLString replaceOccurrencesOfString:@"&amp;" withString:@"&" options:0 range:NSMakeRange(0,[XMLString length])];
-    [XMLString replaceOccurrencesOfString:@"&apos;" withString:@"'" options:0 range:NSMakeRange(0,[XMLString length])];
-    [XMLString replaceOccurrencesOfString:@"&quot;" withString:@"\"" options:0 range:NSMakeRange(0,[XMLString length])];
-    return XMLString;
+    char *unescaped;
+    size_t length;
+    int status = ETXMLUnescapeBytes([_XMLString UTF8String],
+        [_XMLString lengthOfBytesUsingEncoding: NSUTF8StringEncoding],
+        &unescaped, &length);
+    return ETXMLMutableStringWithConvertedBytes(status, unescaped, length, _XMLString);
 }
 
 /**
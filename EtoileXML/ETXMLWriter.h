@@ -1,11 +1,16 @@
 #import "ETXMLParserDelegate.h"
 
+/**
+ * The ETXMLWriter class generates XML from SAX-like events.
+ *
+ * The output is accumulated as UTF-8 bytes in a growable buffer.  The encoded
+ * forms of element and attribute names are cached, so writing a name that has
+ * been written before (typically a constant string) costs a memcpy().
+ */
 @interface ETXMLWriter : NSObject <ETXMLWriting> 
 {
     BOOL autoindent;
-    NSMutableString *buffer;
     NSMutableArray *tagStack;
-    NSMutableString *indentString;
     NSCondition *condition;
     NSInteger subwriterCount;
     BOOL inOpenTag;
@@ -76,6 +81,12 @@
  * if you know you will not use this writer object again.  
  */
 - (NSString*)endDocument;
+/**
+ * Returns the generated UTF-8 bytes and places the object in the same state
+ * as -endDocument.  The returned data object takes over the receiver's buffer,
+ * so no bytes are copied.
+ */
+- (NSData*)endDocumentData;
 
 /**
  * Resets the receiver to begin a new document.  Can be called after -endDocument.
@@ -97,14 +108,118 @@
 @class ETSocket;
 
 /**
- * An XML writer that outputs to a socket.  This sends the data directly after
- * each method call, so may be mixed with other forms of access to the socket.
+ * Conditions under which an ETXMLSocketWriter sends its buffered output.
+ * These may be combined.
+ */
+typedef enum
+{
+    /** Send the output after every call that writes to the buffer. */
+    ETXMLFlushImmediately = 0,
+    /**
+     * Send the output when the element depth falls to the flush depth or
+     * below, i.e. when a complete message has been written.
+     */
+    ETXMLFlushOnElementBoundary = 1 << 0,
+    /** Send the output when more than the flush threshold is buffered. */
+    ETXMLFlushOnByteCount = 1 << 1,
+    /**
+     * Send the output when it has been buffered for longer than the flush
+     * interval.
+     */
+    ETXMLFlushOnDeadline = 1 << 2
+} ETXMLFlushPolicy;
+
+/**
+ * An XML writer that outputs to a socket.
+ *
+ * By default, the data is sent after each method call, as earlier versions
+ * did.  Buffering is opt-in: with ETXMLFlushOnElementBoundary, each element
+ * closed at depth one or less (e.g. each XMPP stanza inside the stream
+ * element) is sent with a single system call.  When a buffering policy is
+ * set, call -flush before using the socket directly.
+ *
+ * When a message is sent in several parts because it exceeded the flush
+ * threshold, the socket is corked until the end of the message, so that it
+ * leaves the host in as few segments as possible.
+ *
+ * The buffered bytes are handed to the socket as they are, and subtrees
+ * written in a transaction are sent together with them as a chunk list,
+ * without being copied into the receiver's buffer first.
  */
 @interface ETXMLSocketWriter : ETXMLWriter 
 {
     ETSocket *socket;   
+    ETXMLFlushPolicy flushPolicy;
+    NSUInteger flushDepth;
+    NSUInteger flushThreshold;
+    NSTimeInterval flushInterval;
+    /** Time at which the oldest unsent byte was written. */
+    NSTimeInterval pendingSince;
+    BOOL deadlineScheduled;
+    BOOL inPartialMessage;
+    NSUInteger sentMessageCount;
+    unsigned long long sentByteCount;
+    NSUInteger sendCallCount;
 }
 - (void)setSocket: (ETSocket*)aSocket;
+/**
+ * Sets the conditions under which buffered output is sent.  The default is
+ * ETXMLFlushImmediately.
+ */
+- (void)setFlushPolicy: (ETXMLFlushPolicy)aPolicy;
+/**
+ * Returns the conditions under which buffered output is sent.
+ */
+- (ETXMLFlushPolicy)flushPolicy;
+/**
+ * Sets the element depth at or below which ETXMLFlushOnElementBoundary sends
+ * the output.  The default is 1.
+ */
+- (void)setFlushDepth: (NSUInteger)aDepth;
+/**
+ * Returns the depth used by ETXMLFlushOnElementBoundary.
+ */
+- (NSUInteger)flushDepth;
+/**
+ * Sets the number of buffered bytes that triggers a send with
+ * ETXMLFlushOnByteCount.  The default is 16KB.
+ */
+- (void)setFlushThreshold: (NSUInteger)aByteCount;
+/**
+ * Returns the threshold used by ETXMLFlushOnByteCount.
+ */
+- (NSUInteger)flushThreshold;
+/**
+ * Sets how long output may stay in the buffer with ETXMLFlushOnDeadline.  The
+ * default is 50ms.
+ *
+ * The deadline is checked on each write, and by a timer in the run loop of
+ * the thread that wrote the oldest buffered byte.
+ */
+- (void)setFlushInterval: (NSTimeInterval)anInterval;
+/**
+ * Returns the interval used by ETXMLFlushOnDeadline.
+ */
+- (NSTimeInterval)flushInterval;
+/**
+ * Sends any buffered output and ends the current message.
+ */
+- (void)flush;
+/**
+ * Returns the number of messages sent.  A message is everything sent between
+ * two flushes caused by an element boundary, a deadline or -flush (or every
+ * send with ETXMLFlushImmediately).
+ */
+- (NSUInteger)sentMessageCount;
+/**
+ * Returns the number of bytes handed to the socket.
+ */
+- (unsigned long long)sentByteCount;
+/**
+ * Returns the number of system calls the socket issued to send the output.
+ * Divide by -sentMessageCount to obtain the number per message.
+ */
+- (NSUInteger)sendCallCount;
 @end
 
 extern NSString *ETXMLMismatchedTagException;
@@ -2,9 +2,177 @@
 #import <EtoileFoundation/Macros.h>
 #import <EtoileFoundation/EtoileCompatibility.h>
 #import "ETXMLWriter.h"
+#include "ETXMLEscaping.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
 
 NSString *ETXMLMismatchedTagException = @"ETXMLMismatchedTagException";
 
+/**
+ * Number of entries in the encoded name cache.  Must be a power of two.
+ */
+#define NAME_CACHE_SIZE 64
+
+/**
+ * Growable buffer holding UTF-8 output.
+ */
+struct ETXMLArena
+{
+    char *bytes;
+    size_t length;
+    size_t capacity;
+};
+
+/**
+ * Cached UTF-8 encoding of an element or attribute name.  Entries are looked
+ * up by the address of the name, which is stable for constant strings, the
+ * usual case for generated XML.  The entry holds a copy of the name, so a
+ * mutable name never matches (its copy is a different object) and the address
+ * of a cached name cannot be reused while the entry exists.
+ */
+struct ETXMLEncodedName
+{
+    NSString *name;
+    char *bytes;
+    size_t length;
+};
+
+static inline void arenaReserve(struct ETXMLArena *arena, size_t extra)
+{
+    if (arena->length + extra > arena->capacity)
+    {
+        size_t capacity = MAX(arena->capacity * 2, 256);
+        char *bytes;
+
+        capacity = MAX(capacity, arena->length + extra);
+        bytes = realloc(arena->bytes, capacity);
+        if (NULL == bytes)
+        {
+            [NSException raise: NSMallocException
+                        format: @"Failed to grow the XML output buffer to %lu bytes",
+                                (unsigned long)capacity];
+        }
+        arena->bytes = bytes;
+        arena->capacity = capacity;
+    }
+}
+
+static inline void arenaAppend(struct ETXMLArena *arena, const char *bytes, size_t length)
+{
+    arenaReserve(arena, length);
+    memcpy(arena->bytes + arena->length, bytes, length);
+    arena->length += length;
+}
+
+static inline void arenaAppendByte(struct ETXMLArena *arena, char byte)
+{
+    arenaReserve(arena, 1);
+    arena->bytes[arena->length++] = byte;
+}
+
+/**
+ * Returns the UTF-8 bytes of the string and their length, which includes
+ * embedded NULs.  A nil string is treated as an empty one.
+ */
+static inline const char *UTF8BytesForString(NSString *aString, size_t *length)
+{
+    if (nil == aString)
+    {
+        *length = 0;
+        return "";
+    }
+    *length = [aString lengthOfBytesUsingEncoding: NSUTF8StringEncoding];
+    return [aString UTF8String];
+}
+
+static inline void arenaAppendString(struct ETXMLArena *arena, NSString *aString)
+{
+    size_t length;
+    const char *UTF8 = UTF8BytesForString(aString, &length);
+    arenaAppend(arena, UTF8, length);
+}
+
+/**
+ * Appends the string with the XML special characters escaped.
+ */
+static void arenaAppendEscaped(struct ETXMLArena *arena, NSString *aString)
+{
+    size_t length;
+    const char *bytes = UTF8BytesForString(aString, &length);
+    size_t i = 0;
+
+    arenaReserve(arena, length);
+    while (i < length)
+    {
+        size_t next = i + ETXMLFindEscapableByte(bytes + i, length - i);
+        size_t entityLength;
+        const char *entity;
+
+        arenaAppend(arena, bytes + i, next - i);
+        if (next == length)
+        {
+            break;
+        }
+        entity = ETXMLEntityForByte(bytes[next], &entityLength);
+        arenaAppend(arena, entity, entityLength);
+        i = next + 1;
+    }
+}
+
+/**
+ * Appends a newline followed by depth tabs.
+ */
+static inline void arenaAppendIndent(struct ETXMLArena *arena, NSUInteger depth)
+{
+    arenaReserve(arena, depth + 1);
+    arena->bytes[arena->length++] = '\n';
+    memset(arena->bytes + arena->length, '\t', depth);
+    arena->length += depth;
+}
+
+/**
+ * Returns the cache entry holding the encoded form of aName, replacing
+ * whatever was cached in the same slot on a miss.
+ */
+static inline struct ETXMLEncodedName *encodedName(struct ETXMLEncodedName *cache,
+                                                   NSString *aName)
+{
+    struct ETXMLEncodedName *entry =
+        &cache[((uintptr_t)aName >> 4) & (NAME_CACHE_SIZE - 1)];
+
+    if (entry->name != aName)
+    {
+        const char *UTF8 = [aName UTF8String];
+        size_t length = strlen(UTF8);
+        char *bytes = malloc(MAX(length, 1));
+
+        if (NULL == bytes)
+        {
+            [NSException raise: NSMallocException
+                        format: @"Failed to cache the encoded name %@", aName];
+        }
+        memcpy(bytes, UTF8, length);
+        [entry->name release];
+        free(entry->bytes);
+        entry->name = [aName copy];
+        entry->bytes = bytes;
+        entry->length = length;
+    }
+    return entry;
+}
+
+@interface ETXMLWriter ()
+{
+    /** Output buffer. */
+    struct ETXMLArena arena;
+    /** Cache of encoded element and attribute names. */
+    struct ETXMLEncodedName names[NAME_CACHE_SIZE];
+}
+- (void)appendSubtreeBytes: (const char*)bytes length: (NSUInteger)length;
+- (void)writeSubtreeBytes: (const char*)bytes length: (NSUInteger)length;
+@end
+
 /**
  * A buffered XML-writer that flushes its buffer to the parent writer upon
  * deallocation.
@@ -66,35 +234,47 @@ NSString *ETXMLMismatchedTagException = @"ETXMLMismatchedTagException";
 }
 - (NSString*)stringValue
 {
-    return [[buffer copy] autorelease];
+    return [[[NSString alloc] initWithBytes: arena.bytes
+                                     length: arena.length
+                                   encoding: NSUTF8StringEncoding] autorelease];
 }
-- (NSString*)endDocument
+- (NSData*)endDocumentData
 {
     // Close all open tags when ending a document.
     while ([tagStack count] > 0)
     {
         [self endElement];
     }
-    id ret = [buffer autorelease];
-    buffer = nil;
-    return ret;
+    NSData *data = [NSData dataWithBytesNoCopy: arena.bytes
+                                        length: arena.length
+                                  freeWhenDone: YES];
+    arena.bytes = NULL;
+    arena.length = arena.capacity = 0;
+    return data;
+}
+- (NSString*)endDocument
+{
+    NSData *data = [self endDocumentData];
+    return [[[NSString alloc] initWithData: data
+                                  encoding: NSUTF8StringEncoding] autorelease];
 }
 - (void)characters: (NSString*)chars
 {
     if (inOpenTag)
     {
-        [buffer appendString:@">"];
+        arenaAppendByte(&arena, '>');
         inOpenTag = NO;
     }
-    [buffer appendString: escapeXMLCData(chars)];
+    arenaAppendEscaped(&arena, chars);
 }
 - (void)writeXMLHeader
 {
-    [buffer appendString: @"<?xml version=\"1.0\" encoding=\"utf-8\" ?>"];
+    static const char header[] = "<?xml version=\"1.0\" encoding=\"utf-8\" ?>";
+    arenaAppend(&arena, header, sizeof(header) - 1);
 }
 - (void)appendUnescapedString: (NSString*)aString
 {
-    [buffer appendString: aString];
+    arenaAppendString(&arena, aString);
 }
 - (void)startElement: (NSString*)aName
 {
@@ -151,19 +331,17 @@ NSString *ETXMLMismatchedTagException = @"ETXMLMismatchedTagException";
     [condition lock];
     if (inOpenTag)
     {
-        [buffer appendString: @">"];
+        arenaAppendByte(&arena, '>');
         inOpenTag = NO;
     }
-    if (autoindent)
+    if (autoindent && 0 != [tagStack count])
     {
-        if (0 != [tagStack count])
-        {
-            [buffer appendString: indentString];
-        }
-        [indentString appendString: @"\t"];
+        arenaAppendIndent(&arena, [tagStack count]);
     }
     //Open tag
-    [buffer appendFormat: @"<%@",aName];
+    struct ETXMLEncodedName *name = encodedName(names, aName);
+    arenaAppendByte(&arena, '<');
+    arenaAppend(&arena, name->bytes, name->length);
     
     //Add attributes
     if (attributes != nil)
@@ -172,8 +350,12 @@ NSString *ETXMLMismatchedTagException = @"ETXMLMismatchedTagException";
         NSString* key;
         while (nil != (key = [enumerator nextObject])) 
         {
-            [buffer appendFormat: @" %@=\"%@\"", key,
-                    escapeXMLCData([attributes objectForKey:key])];
+            struct ETXMLEncodedName *attribute = encodedName(names, key);
+            arenaAppendByte(&arena, ' ');
+            arenaAppend(&arena, attribute->bytes, attribute->length);
+            arenaAppend(&arena, "=\"", 2);
+            arenaAppendEscaped(&arena, [attributes objectForKey: key]);
+            arenaAppendByte(&arena, '"');
         }
     }
     [tagStack addObject: aName];
@@ -185,25 +367,20 @@ NSString *ETXMLMismatchedTagException = @"ETXMLMismatchedTagException";
 {
     [condition lock];
     NSString *aName = [tagStack lastObject];
-    if (autoindent)
-    {
-        int length = [indentString length];
-        if (length > 0)
-        {
-            [indentString deleteCharactersInRange: NSMakeRange(length-1, 1)];
-        }
-    }
     if (inOpenTag)
     {
-        [buffer appendString: @" />"];
+        arenaAppend(&arena, " />", 3);
     }
     else
     {
         if (autoindent)
         {
-            [buffer appendString: indentString];
+            arenaAppendIndent(&arena, [tagStack count] - 1);
         }
-        [buffer appendFormat: @"</%@>", aName];
+        struct ETXMLEncodedName *name = encodedName(names, aName);
+        arenaAppend(&arena, "</", 2);
+        arenaAppend(&arena, name->bytes, name->length);
+        arenaAppendByte(&arena, '>');
     }
     [tagStack removeLastObject];
     inOpenTag = NO;
@@ -222,25 +399,27 @@ NSString *ETXMLMismatchedTagException = @"ETXMLMismatchedTagException";
 }
 - (void)reset
 {
-    [buffer release];
     [tagStack release];
-    [indentString release];
-    buffer = [NSMutableString new];
-    indentString = [@"\n" mutableCopy];
+    arena.length = 0;
     tagStack = [NSMutableArray new];
 }
 
-- (void)appendSubtree: (NSString*)anXMLString
+- (void)writeSubtreeBytes: (const char*)bytes length: (NSUInteger)length
+{
+    arenaAppend(&arena, bytes, length);
+}
+
+- (void)appendSubtreeBytes: (const char*)bytes length: (NSUInteger)length
 {
     // NOTE: Additional synchronization is not needed here because the calling
     // ETXMLSubtreeWriter obtains the condition prior to this.
     if (inOpenTag)
     {
-        [buffer appendString:@">"];
+        arenaAppendByte(&arena, '>');
         inOpenTag = NO;
     }
     subwriterCount--;
-    [buffer appendString: anXMLString];
+    [self writeSubtreeBytes: bytes length: length];
     if (0 == subwriterCount)
     {
         [condition release];
@@ -251,53 +430,250 @@ NSString *ETXMLMismatchedTagException = @"ETXMLMismatchedTagException";
 - (id)init
 {
     SUPERINIT;
-    buffer = [NSMutableString new];
-    indentString = [@"\n" mutableCopy];
     tagStack = [NSMutableArray new];
     return self;
 }
 - (void)dealloc
 {
-    [buffer release];
+    for (unsigned int i=0 ; i<NAME_CACHE_SIZE ; i++)
+    {
+        [names[i].name release];
+        free(names[i].bytes);
+    }
+    free(arena.bytes);
     [tagStack release];
-    [indentString release];
     [condition release];
     [super dealloc];
 }
 @end    
 @implementation ETXMLSocketWriter : ETXMLWriter 
-- (void)sendBuffer
+- (id)init
 {
-    [socket sendData: [buffer dataUsingEncoding: NSUTF8StringEncoding]];
-    [buffer setString: @""];
+    SUPERINIT;
+    flushPolicy = ETXMLFlushImmediately;
+    flushDepth = 1;
+    flushThreshold = 16384;
+    flushInterval = 0.05;
+    return self;
+}
+/**
+ * Hands the chunks to the socket and updates the counters.
+ */
+- (void)sendChunks: (const struct iovec*)chunks count: (int)count
+{
+    NSUInteger calls = [socket sendCallCount];
+    for (int i=0 ; i<count ; i++)
+    {
+        sentByteCount += chunks[i].iov_len;
+    }
+    [socket sendChunks: chunks count: count];
+    sendCallCount += [socket sendCallCount] - calls;
+}
+- (void)endMessage
+{
+    if (inPartialMessage)
+    {
+        [socket setCorked: NO];
+        inPartialMessage = NO;
+    }
+    sentMessageCount++;
+}
+/**
+ * Sends the buffer.  If the message is not complete, the socket is corked
+ * until it is, so that the remainder can fill the segments started here.
+ */
+- (void)sendBufferEndingMessage: (BOOL)isMessageEnd
+{
+    if (arena.length > 0)
+    {
+        if (!isMessageEnd && !inPartialMessage)
+        {
+            [socket setCorked: YES];
+            inPartialMessage = YES;
+        }
+        struct iovec chunk = { arena.bytes, arena.length };
+        [self sendChunks: &chunk count: 1];
+        arena.length = 0;
+    }
+    if (isMessageEnd)
+    {
+        [self endMessage];
+    }
+}
+- (void)flush
+{
+    if (arena.length > 0 || inPartialMessage)
+    {
+        [self sendBufferEndingMessage: YES];
+    }
+}
+/**
+ * Run by the deadline timer, possibly while a transaction appends a subtree
+ * from another thread, so the buffer is only touched with the condition held.
+ */
+- (void)flushAfterDeadline
+{
+    // The condition is released when the last transaction finishes.
+    NSCondition *lock = [condition retain];
+
+    [lock lock];
+    deadlineScheduled = NO;
+    if (arena.length > 0)
+    {
+        NSTimeInterval remaining = 
+            pendingSince + flushInterval - [NSDate timeIntervalSinceReferenceDate];
+        if (remaining <= 0)
+        {
+            [self flush];
+        }
+        else
+        {
+            deadlineScheduled = YES;
+            [self performSelector: @selector(flushAfterDeadline)
+                       withObject: nil
+                       afterDelay: remaining];
+        }
+    }
+    [lock unlock];
+    [lock release];
+}
+/**
+ * Applies the flush policy after something was written to the buffer.
+ * previousLength is the length of the buffer before the write.
+ */
+- (void)didWriteAfterLength: (size_t)previousLength
+{
+    if (ETXMLFlushImmediately == flushPolicy)
+    {
+        [self flush];
+        return;
+    }
+    if ((flushPolicy & ETXMLFlushOnElementBoundary) && [tagStack count] <= flushDepth)
+    {
+        [self flush];
+        return;
+    }
+    if (flushPolicy & ETXMLFlushOnDeadline)
+    {
+        NSTimeInterval now = [NSDate timeIntervalSinceReferenceDate];
+        if (0 == previousLength)
+        {
+            pendingSince = now;
+        }
+        else if (now - pendingSince >= flushInterval)
+        {
+            [self flush];
+            return;
+        }
+    }
+    if ((flushPolicy & ETXMLFlushOnByteCount) && arena.length >= flushThreshold)
+    {
+        // Only messages delimited by element boundaries are known to end, so
+        // do not leave the socket corked otherwise.
+        [self sendBufferEndingMessage: !(flushPolicy & ETXMLFlushOnElementBoundary)];
+        return;
+    }
+    if ((flushPolicy & ETXMLFlushOnDeadline) && !deadlineScheduled && arena.length > 0)
+    {
+        deadlineScheduled = YES;
+        [self performSelector: @selector(flushAfterDeadline)
+                   withObject: nil
+                   afterDelay: flushInterval];
+    }
 }
 - (void)characters: (NSString*)chars
 {
+    size_t length = arena.length;
     [super characters: chars];
-    [self sendBuffer];
+    [self didWriteAfterLength: length];
 }
 - (void)startElement: (NSString*)aName
           attributes: (NSDictionary*)attributes
 {
+    size_t length = arena.length;
     [super startElement: aName attributes: attributes];
-    [self sendBuffer];
+    [self didWriteAfterLength: length];
 }
 - (void)endElement
 {
+    size_t length = arena.length;
     [super endElement];
-    [self sendBuffer];
+    [self didWriteAfterLength: length];
 }
 - (void)setSocket: (ETSocket*)aSocket
 {
+    [self flush];
     ASSIGN(socket, aSocket);
 }
-- (void)appendSubtree: (NSString*)anXMLString
+- (void)writeSubtreeBytes: (const char*)bytes length: (NSUInteger)length
+{
+    // Inside a message, the subtree is only part of what has to be sent, so
+    // let the flush policy decide.
+    if (ETXMLFlushImmediately != flushPolicy && [tagStack count] > flushDepth)
+    {
+        size_t previousLength = arena.length;
+        [super writeSubtreeBytes: bytes length: length];
+        [self didWriteAfterLength: previousLength];
+        return;
+    }
+    // Otherwise, send any pending output together with the subtree, rather
+    // than copying the subtree into our buffer first.
+    struct iovec chunks[2] =
+    {
+        { arena.bytes, arena.length },
+        { (void*)bytes, length }
+    };
+    [self sendChunks: chunks count: 2];
+    arena.length = 0;
+    [self endMessage];
+}
+- (void)setFlushPolicy: (ETXMLFlushPolicy)aPolicy
+{
+    flushPolicy = aPolicy;
+}
+- (ETXMLFlushPolicy)flushPolicy
+{
+    return flushPolicy;
+}
+- (void)setFlushDepth: (NSUInteger)aDepth
+{
+    flushDepth = aDepth;
+}
+- (NSUInteger)flushDepth
+{
+    return flushDepth;
+}
+- (void)setFlushThreshold: (NSUInteger)aByteCount
+{
+    flushThreshold = aByteCount;
+}
+- (NSUInteger)flushThreshold
+{
+    return flushThreshold;
+}
+- (void)setFlushInterval: (NSTimeInterval)anInterval
+{
+    flushInterval = anInterval;
+}
+- (NSTimeInterval)flushInterval
+{
+    return flushInterval;
+}
+- (NSUInteger)sentMessageCount
+{
+    return sentMessageCount;
+}
+- (unsigned long long)sentByteCount
+{
+    return sentByteCount;
+}
+- (NSUInteger)sendCallCount
 {
-    [super appendSubtree: anXMLString];
-    [self sendBuffer];
+    return sendCallCount;
 }
 - (void)dealloc
 {
+    [self flush];
     [socket release];
     [super dealloc];
 }
@@ -333,7 +709,8 @@ NSString *ETXMLMismatchedTagException = @"ETXMLMismatchedTagException";
 
     if ([parent depth] == initialDepth)
     {
-        [parent appendSubtree: [self endDocument]];
+        [parent appendSubtreeBytes: arena.bytes length: arena.length];
+        arena.length = 0;
         success = YES;
     }
     // We also don't want to append any data if the parent writer has left the
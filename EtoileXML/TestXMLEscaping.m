@@ -0,0 +1,170 @@
+/*
+    TestXMLEscaping.m
+
+    Copyright (C) 2026 The Etoile Project
+
+    Date:  October 2026
+    License:  Modified BSD (see COPYING)
+ */
+
+#import <Foundation/Foundation.h>
+#import <UnitKit/UnitKit.h>
+#import <EtoileFoundation/EtoileFoundation.h>
+#import "ETXMLParserDelegate.h"
+#include <stdlib.h>
+#include <string.h>
+
+@interface TestXMLEscaping : NSObject <UKTest>
+@end
+
+@implementation TestXMLEscaping
+
+- (void) testEscapeNothing
+{
+    char *escaped = (char *)"";
+    size_t length = 0;
+
+    UKIntsEqual(0, ETXMLEscapeBytes("", 0, &escaped, &length));
+    UKTrue(escaped == NULL);
+    UKIntsEqual(0, ETXMLEscapeBytes("plain text", 10, &escaped, &length));
+    UKTrue(escaped == NULL);
+
+    UKStringsEqual(@"", escapeXMLCData(@""));
+    UKStringsEqual(@"", escapeXMLCData(nil));
+    UKStringsEqual(@"plain text", escapeXMLCData(@"plain text"));
+}
+
+- (void) testEscapeEveryEntity
+{
+    UKStringsEqual(@"&lt;a href=&quot;x&quot; title=&apos;y&apos;&gt;&amp;",
+                   escapeXMLCData(@"<a href=\"x\" title='y'>&"));
+}
+
+/* The vector loops scan 16 or 32 bytes at a time, so put the special
+   character at every offset around the block boundaries. */
+- (void) testEscapeAtVectorBlockBoundaries
+{
+    char input[80];
+
+    for (size_t offset = 0; offset < 70; offset++)
+    {
+        char *escaped = NULL;
+        size_t length = 0;
+
+        memset(input, 'a', 70);
+        input[offset] = '<';
+
+        UKIntsEqual(0, ETXMLEscapeBytes(input, 70, &escaped, &length));
+        UKIntsEqual(73, length);
+        UKIntsEqual(0, memcmp(escaped + offset, "&lt;", 4));
+        UKIntsEqual(0, memcmp(escaped, input, offset));
+        UKIntsEqual('\0', escaped[length]);
+        free(escaped);
+    }
+}
+
+- (void) testEscapeDoesNotLookPastLength
+{
+    char *escaped = NULL;
+    size_t length = 0;
+
+    UKIntsEqual(0, ETXMLEscapeBytes("abc<", 3, &escaped, &length));
+    UKTrue(escaped == NULL);
+}
+
+- (void) testEscapeKeepsEmbeddedNul
+{
+    NSString *input = [NSString stringWithCharacters: (unichar[]){'a', 0, '<'} length: 3];
+    NSString *expected = [NSString stringWithCharacters: (unichar[]){'a', 0, '&', 'l', 't', ';'}
+                                                 length: 6];
+
+    UKStringsEqual(expected, escapeXMLCData(input));
+}
+
+- (void) testEscapeMultibyteCharacters
+{
+    UKStringsEqual(@"café &amp; thé 漢&lt;", escapeXMLCData(@"café & thé 漢<"));
+}
+
+- (void) testEscapedStringsAreMutable
+{
+    NSMutableString *escaped = escapeXMLCData(@"a<b");
+    NSMutableString *unchanged = escapeXMLCData(@"ab");
+    NSString *immutable = @"ab";
+    NSMutableString *unescaped = unescapeXMLCData(immutable);
+
+    [escaped appendString: @"c"];
+    [unchanged appendString: @"c"];
+    [unescaped appendString: @"c"];
+
+    UKStringsEqual(@"a&lt;bc", escaped);
+    UKStringsEqual(@"abc", unchanged);
+    UKStringsEqual(@"abc", unescaped);
+    UKStringsEqual(@"ab", immutable);
+}
+
+- (void) testUnescapePredefinedEntities
+{
+    UKStringsEqual(@"<a href=\"x\" title='y'>&",
+                   unescapeXMLCData(@"&lt;a href=&quot;x&quot; title=&apos;y&apos;&gt;&amp;"));
+    /* Only one level of references is decoded */
+    UKStringsEqual(@"a&amp;b", unescapeXMLCData(@"a&amp;amp;b"));
+}
+
+- (void) testUnescapeNumericReferences
+{
+    UKStringsEqual(@"AB\t", unescapeXMLCData(@"&#65;&#x42;&#9;"));
+    UKStringsEqual(@"A", unescapeXMLCData(@"&#000000000065;"));
+    UKStringsEqual(@"\U0001F600", unescapeXMLCData(@"&#x1F600;"));
+    UKStringsEqual(@"\U0010FFFF", unescapeXMLCData(@"&#x10FFFF;"));
+}
+
+- (void) testUnescapeKeepsInvalidReferences
+{
+    /* Out of range, not allowed in XML, surrogates and not a number */
+    UKStringsEqual(@"&#x110000;", unescapeXMLCData(@"&#x110000;"));
+    UKStringsEqual(@"&#0;", unescapeXMLCData(@"&#0;"));
+    UKStringsEqual(@"&#xD800;", unescapeXMLCData(@"&#xD800;"));
+    UKStringsEqual(@"&#x;&#;&#12a;", unescapeXMLCData(@"&#x;&#;&#12a;"));
+    UKStringsEqual(@"&nbsp;", unescapeXMLCData(@"&nbsp;"));
+}
+
+- (void) testUnescapeTruncatedReferences
+{
+    UKStringsEqual(@"&", unescapeXMLCData(@"&"));
+    UKStringsEqual(@"a&am", unescapeXMLCData(@"a&am"));
+    UKStringsEqual(@"&amp", unescapeXMLCData(@"&amp"));
+    /* A ';' more than 16 bytes away doesn't end a reference we understand */
+    UKStringsEqual(@"&#00000000000000065;", unescapeXMLCData(@"&#00000000000000065;"));
+}
+
+- (void) testUnescapeDoesNotLookPastLength
+{
+    char *unescaped = NULL;
+    size_t length = 0;
+
+    UKIntsEqual(0, ETXMLUnescapeBytes("ab&lt;", 2, &unescaped, &length));
+    UKTrue(unescaped == NULL);
+    UKIntsEqual(0, ETXMLUnescapeBytes("&lt;", 3, &unescaped, &length));
+    UKIntsEqual(3, length);
+    UKIntsEqual(0, memcmp(unescaped, "&lt", 3));
+    free(unescaped);
+}
+
+- (void) testUnescapeKeepsEmbeddedNul
+{
+    NSString *input = [NSString stringWithCharacters: (unichar[]){'a', 0, '&', 'l', 't', ';'}
+                                              length: 6];
+    NSString *expected = [NSString stringWithCharacters: (unichar[]){'a', 0, '<'} length: 3];
+
+    UKStringsEqual(expected, unescapeXMLCData(input));
+}
+
+- (void) testRoundTrip
+{
+    NSString *input = @"<p class='x'>Tom & \"Jerry\" é</p>";
+
+    UKStringsEqual(input, unescapeXMLCData(escapeXMLCData(input)));
+}
+
+@end
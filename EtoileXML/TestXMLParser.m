@@ -0,0 +1,209 @@
+/*
+    TestXMLParser.m
+
+    Copyright (C) 2026 The Etoile Project
+
+    Date:  October 2026
+    License:  Modified BSD (see COPYING)
+ */
+
+#import <Foundation/Foundation.h>
+#import <UnitKit/UnitKit.h>
+#import <EtoileFoundation/EtoileFoundation.h>
+#import "ETXMLParser.h"
+#import "ETXMLParserDelegate.h"
+
+/**
+ * Content handler recording the parser events as strings.  Consecutive
+ * character data is coalesced, since the parser may deliver it in pieces.
+ */
+@interface XMLEventRecorder : NSObject <ETXMLParserDelegate>
+{
+    @public
+    NSMutableArray *events;
+    NSMutableString *characters;
+}
+@end
+
+@implementation XMLEventRecorder
+
+- (id) init
+{
+    SUPERINIT;
+    events = [NSMutableArray new];
+    return self;
+}
+
+- (void) dealloc
+{
+    DESTROY(events);
+    DESTROY(characters);
+    [super dealloc];
+}
+
+- (void) flushCharacters
+{
+    if (characters == nil)
+        return;
+
+    [events addObject: [@"chars " stringByAppendingString: characters]];
+    DESTROY(characters);
+}
+
+- (void) characters: (NSString *)aString
+{
+    if (characters == nil)
+    {
+        characters = [NSMutableString new];
+    }
+    [characters appendString: aString];
+}
+
+- (void) startElement: (NSString *)aName attributes: (NSDictionary *)attributes
+{
+    NSMutableString *event = [NSMutableString stringWithFormat: @"start %@", aName];
+
+    for (NSString *key in [[attributes allKeys] sortedArrayUsingSelector: @selector(compare:)])
+    {
+        [event appendFormat: @" %@=%@", key, [attributes objectForKey: key]];
+    }
+    [self flushCharacters];
+    [events addObject: event];
+}
+
+- (void) endElement: (NSString *)aName
+{
+    [self flushCharacters];
+    [events addObject: [@"end " stringByAppendingString: aName]];
+}
+
+- (void) setParser: (id)aParser
+{
+}
+
+- (NSArray *) events
+{
+    [self flushCharacters];
+    return events;
+}
+
+@end
+
+@interface TestXMLParser : NSObject <UKTest>
+{
+    XMLEventRecorder *recorder;
+    ETXMLParser *parser;
+}
+
+@end
+
+@implementation TestXMLParser
+
+- (id) init
+{
+    SUPERINIT;
+    recorder = [XMLEventRecorder new];
+    parser = [[ETXMLParser alloc] initWithContentHandler: recorder];
+    return self;
+}
+
+- (void) dealloc
+{
+    DESTROY(parser);
+    DESTROY(recorder);
+    [super dealloc];
+}
+
+- (NSArray *) eventsForSource: (NSString *)aSource
+{
+    XMLEventRecorder *otherRecorder = AUTORELEASE([XMLEventRecorder new]);
+    ETXMLParser *otherParser = [ETXMLParser parserWithContentHandler: otherRecorder];
+
+    UKTrue([otherParser parseFromSource: aSource]);
+    return [otherRecorder events];
+}
+
+- (void) testElementsAndAttributes
+{
+    UKTrue([parser parseFromSource: @"<?xml version='1.0'?><a x='1' y=\"2\"><b/>text</a>"]);
+    UKObjectsEqual(A(@"start a x=1 y=2", @"start b", @"end b", @"chars text", @"end a"),
+                   [recorder events]);
+}
+
+- (void) testSplitBuffers
+{
+    NSString *source = @"<doc lang='fr'><p class=\"x\">café <i>au</i> lait</p>"
+                        "<!-- comment --><br /><![CDATA[<raw>]]></doc>";
+    NSData *data = [source dataUsingEncoding: NSUTF8StringEncoding];
+    const char *bytes = [data bytes];
+
+    /* Feed one byte at a time, which splits every token and the two-byte é */
+    for (NSUInteger i = 0; i < [data length]; i++)
+    {
+        UKTrue([parser parseBytes: bytes + i length: 1]);
+    }
+    UKObjectsEqual([self eventsForSource: source], [recorder events]);
+}
+
+- (void) testEntities
+{
+    UKTrue([parser parseFromSource: @"<a title='&lt;&amp;&#65;&#x42;&quot;'>x &amp; y</a>"]);
+
+    /* Attribute values are unescaped, character data is passed unmodified */
+    UKObjectsEqual(A(@"start a title=<&AB\"", @"chars x &amp; y", @"end a"),
+                   [recorder events]);
+    UKStringsEqual(@"x & y", unescapeXMLCData(@"x &amp; y"));
+}
+
+- (void) testUnknownEntitiesAreKept
+{
+    UKTrue([parser parseFromSource: @"<a title='&nbsp;&#xZZ;&'/>"]);
+    UKObjectsEqual(A(@"start a title=&nbsp;&#xZZ;&", @"end a"), [recorder events]);
+}
+
+- (void) testCDATA
+{
+    UKTrue([parser parseFromSource: @"<a><![CDATA[<b>&amp;]]]></a>"]);
+    UKObjectsEqual(A(@"start a", @"chars <b>&amp;]", @"end a"), [recorder events]);
+}
+
+- (void) testCDATATerminatorSplitAcrossBuffers
+{
+    UKTrue([parser parseFromSource: @"<a><![CDA"]);
+    UKTrue([parser parseFromSource: @"TA[x]"]);
+    UKTrue([parser parseFromSource: @"]"]);
+    UKTrue([parser parseFromSource: @">y</a>"]);
+    UKObjectsEqual(A(@"start a", @"chars xy", @"end a"), [recorder events]);
+}
+
+- (void) testMismatchedEndTag
+{
+    UKFalse([parser parseFromSource: @"<a><b></a>"]);
+}
+
+- (void) testGreaterThanInCharacterData
+{
+    UKFalse([parser parseFromSource: @"<a>b > c</a>"]);
+}
+
+- (void) testUnquotedAttributeValue
+{
+    UKFalse([parser parseFromSource: @"<a x=1/>"]);
+}
+
+- (void) testParserStaysBrokenAfterError
+{
+    UKFalse([parser parseFromSource: @"<a><</a>"]);
+    UKFalse([parser parseFromSource: @"<b/>"]);
+}
+
+- (void) testSGMLMode
+{
+    [parser setMode: PARSER_MODE_SGML];
+
+    UKTrue([parser parseFromSource: @"<p>a<br>b<input checked></p>"]);
+    UKObjectsEqual(A(@"start p", @"chars a", @"start br", @"chars b",
+                     @"start input checked=", @"end p"), [recorder events]);
+}
+
+@end
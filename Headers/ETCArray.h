@@ -8,12 +8,28 @@
 #ifndef __ET_C_ARRAY_INCLUDED__
 #define __ET_C_ARRAY_INCLUDED__
 
+#include <stddef.h>
+
 /**
  * Opaque type representing a thin layer of abstraction around a dynamic C
  * array.  An ETCArray can be used to store any pointer type.
+ *
+ * The elements are stored in a ring buffer, so objects can be added or
+ * removed at both ends in amortised constant time, which makes an ETCArray
+ * usable as a queue, a stack or a double-ended queue.  Insertions and
+ * removals in the middle move the elements on the shorter side only.
+ *
+ * The capacity doubles when the array is full, and only shrinks on
+ * ETCArrayShrink().
  */
 typedef struct _ETCArray* ETCArray;
 
+/**
+ * Index returned by ETCArrayIndexOfObjectIdenticalTo() when the object is not
+ * in the array.
+ */
+#define ETCArrayNotFound ((size_t)-1)
+
 /**
  * Creates a new array with some default initial capacity.
  */
@@ -21,16 +37,32 @@ ETCArray ETCArrayNew(void);
 /**
  * Creates a new array with a specified initial capacity.
  */
-ETCArray ETCArrayNewWithInitialSize(unsigned int initialSize);
+ETCArray ETCArrayNewWithInitialSize(size_t initialSize);
 
 /**
  * Adds object at the end of array, allocating more space if needed.
  */
 int ETCArrayAdd(ETCArray array, void* object);
 /**
- * Adds object to array at anIndex, replacing the existing value at that index.
+ * Adds object at the beginning of array, allocating more space if needed.
+ */
+int ETCArrayAddFirst(ETCArray array, void* object);
+/**
+ * Inserts object into array at anIndex.  The objects at anIndex and beyond
+ * are moved down the array by one element.  Returns -2 if anIndex is greater
+ * than the count.
+ */
+int ETCArrayAddAtIndex(ETCArray array, void* object, size_t anIndex);
+/**
+ * Adds count objects from the objects C array at the end of array.
+ */
+int ETCArrayAddObjects(ETCArray array, void** objects, size_t count);
+/**
+ * Inserts count objects from the objects C array into array at anIndex.
+ * Returns -2 if anIndex is greater than the count.
  */
-int ETCArrayAddAtIndex(ETCArray array, void* object, unsigned int anIndex);
+int ETCArrayInsertObjectsAtIndex(ETCArray array, void** objects, size_t count,
+                                 size_t anIndex);
 
 /**
  * Appends the contents of otherArray to array.
@@ -38,37 +70,170 @@ int ETCArrayAddAtIndex(ETCArray array, void* object, unsigned int anIndex);
 int ETCArrayAppendArray(ETCArray array, ETCArray otherArray);
 
 /**
- * Returns the value at the specified index.
+ * Returns the value at the specified index, or NULL if the index is out of
+ * bounds.
+ */
+void* ETCArrayObjectAtIndex(ETCArray array, size_t anIndex);
+/**
+ * Returns the first value, or NULL if the array is empty.
+ */
+void* ETCArrayFirstObject(ETCArray array);
+/**
+ * Returns the last value, or NULL if the array is empty.
  */
-void* ETCArrayObjectAtIndex(ETCArray array, unsigned int anIndex);
+void* ETCArrayLastObject(ETCArray array);
+/**
+ * Copies length values starting at location into the objects C array.
+ * Returns -2 if the range is out of bounds.
+ */
+int ETCArrayGetObjectsInRange(ETCArray array, void** objects, size_t location,
+                              size_t length);
 /**
  * Swap the values at two indexes.
  */
-int ETCArraySwap(ETCArray array, unsigned int index1, unsigned int index2);
+int ETCArraySwap(ETCArray array, size_t index1, size_t index2);
 
 /**
  * Removes the object at the specified index.  All subsequent objects will
- * moved up the array by one element.
+ * moved up the array by one element.  Returns -1 if the index is out of
+ * bounds.
+ */
+int ETCArrayRemoveObjectAtIndex(ETCArray array, size_t anIndex);
+/**
+ * Removes length objects starting at location.  Returns -2 if the range is
+ * out of bounds.
  */
-int ETCArrayRemoveObjectAtIndex(ETCArray array, unsigned int anIndex);
+int ETCArrayRemoveObjectsInRange(ETCArray array, size_t location, size_t length);
 /**
- * Removes the last object from an array.
+ * Removes the first object from an array.  Returns -1 if the array is empty.
+ */
+int ETCArrayRemoveFirstObject(ETCArray array);
+/**
+ * Removes the last object from an array.  Returns -1 if the array is empty.
  */
 int ETCArrayRemoveLastObject(ETCArray array);
 /**
- * Removes all objects from the array, giving an empty array.
+ * Removes all objects from the array, giving an empty array.  If freeObjects
+ * is true, free() is called on each object.
  */
 int ETCArrayRemoveAllObjects(ETCArray array, int freeObjects);
 /**
  * Returns the number of objects in the array.
  */
-unsigned int ETCArrayCount(ETCArray array);
+size_t ETCArrayCount(ETCArray array);
+/**
+ * Returns the index of the specified value, or ETCArrayNotFound.
+ */
+size_t ETCArrayIndexOfObjectIdenticalTo(ETCArray array, void* object);
+
+/**
+ * Returns the number of objects the array can hold without growing.
+ */
+size_t ETCArrayCapacity(ETCArray array);
+/**
+ * Grows the array to hold at least capacity objects without allocating.
+ */
+int ETCArrayReserve(ETCArray array, size_t capacity);
 /**
- * Returns the index of the specified value.
+ * Releases the space not needed to hold the current objects.
  */
-int ETCArrayIndexOfObjectIdenticalTo(ETCArray array, void* object);
+int ETCArrayShrink(ETCArray array);
 /**
  * Destroy the array.
  */
 void ETCArrayFree(ETCArray array);
+
+/**
+ * Opaque type representing an ETCArray variant that stores fixed-size values
+ * such as integers or structs inline, rather than pointers.
+ *
+ * Values are copied in and out with memcpy(), the size being given at
+ * creation time.  The storage is the same ring buffer as ETCArray.
+ */
+typedef struct _ETCValueArray* ETCValueArray;
+
+/**
+ * Creates a new array of elementSize-byte values with some default initial
+ * capacity.
+ */
+ETCValueArray ETCValueArrayNew(size_t elementSize);
+/**
+ * Creates a new array of elementSize-byte values with a specified initial
+ * capacity.
+ */
+ETCValueArray ETCValueArrayNewWithInitialSize(size_t elementSize, size_t initialSize);
+
+/**
+ * Copies the value pointed to by element at the end of array.
+ */
+int ETCValueArrayAdd(ETCValueArray array, const void* element);
+/**
+ * Copies the value pointed to by element at the beginning of array.
+ */
+int ETCValueArrayAddFirst(ETCValueArray array, const void* element);
+/**
+ * Copies count contiguous values from elements at the end of array.
+ */
+int ETCValueArrayAddElements(ETCValueArray array, const void* elements, size_t count);
+/**
+ * Copies count contiguous values from elements into array at anIndex.
+ * Returns -2 if anIndex is greater than the count.
+ */
+int ETCValueArrayInsertElementsAtIndex(ETCValueArray array, const void* elements,
+                                       size_t count, size_t anIndex);
+/**
+ * Returns a pointer to the value at the specified index, or NULL if the index
+ * is out of bounds.  The pointer is valid until the array is mutated.
+ */
+void* ETCValueArrayElementAtIndex(ETCValueArray array, size_t anIndex);
+/**
+ * Copies length values starting at location into the elements buffer.
+ * Returns -2 if the range is out of bounds.
+ */
+int ETCValueArrayGetElementsInRange(ETCValueArray array, void* elements,
+                                    size_t location, size_t length);
+/**
+ * Removes the first value, copying it into element unless element is NULL.
+ * Returns -1 if the array is empty.
+ */
+int ETCValueArrayRemoveFirstElement(ETCValueArray array, void* element);
+/**
+ * Removes the last value, copying it into element unless element is NULL.
+ * Returns -1 if the array is empty.
+ */
+int ETCValueArrayRemoveLastElement(ETCValueArray array, void* element);
+/**
+ * Removes length values starting at location.  Returns -2 if the range is out
+ * of bounds.
+ */
+int ETCValueArrayRemoveElementsInRange(ETCValueArray array, size_t location,
+                                       size_t length);
+/**
+ * Removes all values from the array, giving an empty array.
+ */
+void ETCValueArrayRemoveAllElements(ETCValueArray array);
+/**
+ * Returns the number of values in the array.
+ */
+size_t ETCValueArrayCount(ETCValueArray array);
+/**
+ * Returns the size of a value in bytes.
+ */
+size_t ETCValueArrayElementSize(ETCValueArray array);
+/**
+ * Returns the number of values the array can hold without growing.
+ */
+size_t ETCValueArrayCapacity(ETCValueArray array);
+/**
+ * Grows the array to hold at least capacity values without allocating.
+ */
+int ETCValueArrayReserve(ETCValueArray array, size_t capacity);
+/**
+ * Releases the space not needed to hold the current values.
+ */
+int ETCValueArrayShrink(ETCValueArray array);
+/**
+ * Destroy the array.
+ */
+void ETCValueArrayFree(ETCValueArray array);
 #endif
@@ -0,0 +1,136 @@
+/**
+    Copyright (C) 2026 The Etoile Project
+
+    Date:  October 2026
+    License:  Modified BSD (see COPYING)
+ */
+
+#ifndef __ET_C_IDENTITY_MAP_INCLUDED__
+#define __ET_C_IDENTITY_MAP_INCLUDED__
+
+#include <stddef.h>
+
+/**
+ * Opaque type representing a hash table mapping pointers to pointers, where
+ * keys are compared by identity.
+ *
+ * The table uses open addressing with Robin Hood hashing, so lookups probe a
+ * few adjacent slots of a single array rather than following chains.  Keys
+ * are never dereferenced nor retained, which makes the map usable with
+ * classes, partially deallocated objects or any other raw pointer.  NULL is
+ * not a valid key.
+ */
+typedef struct _ETCIdentityMap* ETCIdentityMap;
+
+/**
+ * Callbacks invoked when a value is stored into or removed from a map, e.g.
+ * to retain and release objects.  Either callback can be NULL.  Without a
+ * retain callback, the map holds plain pointers which are never cleared when
+ * the values are freed.
+ */
+typedef struct
+{
+    void *(*retain)(void *value);
+    void (*release)(void *value);
+} ETCIdentityMapValueCallBacks;
+
+/**
+ * Creates a new map with some default initial capacity and no value
+ * callbacks.
+ */
+ETCIdentityMap ETCIdentityMapNew(void);
+/**
+ * Creates a new map able to hold initialSize entries without growing, and no
+ * value callbacks.
+ */
+ETCIdentityMap ETCIdentityMapNewWithInitialSize(size_t initialSize);
+/**
+ * Creates a new map able to hold initialSize entries without growing, which
+ * calls the given callbacks on its values.  callBacks can be NULL.
+ */
+ETCIdentityMap ETCIdentityMapNewWithCallBacks(size_t initialSize,
+                                              const ETCIdentityMapValueCallBacks *callBacks);
+
+/**
+ * Returns the value for key, or NULL if the key is not in the map.
+ */
+void *ETCIdentityMapGet(ETCIdentityMap map, const void *key);
+/**
+ * Returns 1 if key is in the map, 0 otherwise.
+ */
+int ETCIdentityMapContainsKey(ETCIdentityMap map, const void *key);
+/**
+ * Sets the value for key, replacing any existing value and growing the map if
+ * needed.  Returns -1 if the memory could not be allocated, 0 otherwise.
+ */
+int ETCIdentityMapSet(ETCIdentityMap map, const void *key, void *value);
+/**
+ * Removes key and its value.  Returns -1 if the key is not in the map, 0
+ * otherwise.
+ */
+int ETCIdentityMapRemove(ETCIdentityMap map, const void *key);
+/**
+ * Removes all entries, keeping the allocated capacity.
+ */
+void ETCIdentityMapRemoveAll(ETCIdentityMap map);
+/**
+ * Returns the number of entries in the map.
+ */
+size_t ETCIdentityMapCount(ETCIdentityMap map);
+/**
+ * Iterates over the entries.  cursor must be set to 0 before the first call.
+ * Returns 1 and sets key and value (either can be NULL) to the next entry, or
+ * returns 0 once all entries have been returned.  The map must not be
+ * modified during the iteration.
+ */
+int ETCIdentityMapNextEntry(ETCIdentityMap map, size_t *cursor,
+                            const void **key, void **value);
+/**
+ * Destroy the map, releasing its values.
+ */
+void ETCIdentityMapFree(ETCIdentityMap map);
+
+/**
+ * Opaque type representing a set of pointers compared by identity, with the
+ * same storage as ETCIdentityMap but no values.
+ */
+typedef struct _ETCIdentitySet* ETCIdentitySet;
+
+/**
+ * Creates a new set with some default initial capacity.
+ */
+ETCIdentitySet ETCIdentitySetNew(void);
+/**
+ * Creates a new set able to hold initialSize members without growing.
+ */
+ETCIdentitySet ETCIdentitySetNewWithInitialSize(size_t initialSize);
+/**
+ * Adds member to the set if it is not already present.  Returns -1 if the
+ * memory could not be allocated, 0 otherwise.
+ */
+int ETCIdentitySetAdd(ETCIdentitySet set, const void *member);
+/**
+ * Returns 1 if member is in the set, 0 otherwise.
+ */
+int ETCIdentitySetContains(ETCIdentitySet set, const void *member);
+/**
+ * Removes member.  Returns -1 if it is not in the set, 0 otherwise.
+ */
+int ETCIdentitySetRemove(ETCIdentitySet set, const void *member);
+/**
+ * Removes all members, keeping the allocated capacity.
+ */
+void ETCIdentitySetRemoveAll(ETCIdentitySet set);
+/**
+ * Returns the number of members in the set.
+ */
+size_t ETCIdentitySetCount(ETCIdentitySet set);
+/**
+ * Iterates over the members, as ETCIdentityMapNextEntry() does.
+ */
+int ETCIdentitySetNextMember(ETCIdentitySet set, size_t *cursor, const void **member);
+/**
+ * Destroy the set.
+ */
+void ETCIdentitySetFree(ETCIdentitySet set);
+#endif
@@ -34,8 +34,23 @@
  * filter] isEqualToString: [B each]];</code>, <code>A</code> will still contain
  * "bar" (but not "BAR"), since one of the elements of <code>B</code> matched
  * "bar".
+ *
+ * The number of messages sent grows with the product of the sizes of the
+ * eached collections. Use -eachZipped to pair their elements instead.
  */
 - (id)each;
+/**
+ * Returns a proxy like -each does, but whose elements are paired by position
+ * with the elements of the other zipped arguments of the message, rather than
+ * combined with them. For example,
+ * <code>[[people map] sendMail: [messages eachZipped] withSubject: [subjects
+ * eachZipped]];</code> sends -sendMail:withSubject: to every person once per
+ * message, with the subject at the same index as the message.
+ *
+ * The zipped arguments stop with the shortest of the collections. Arguments
+ * created with -each are still combined with the pairs.
+ */
+- (id)eachZipped;
 @end
 
 @protocol ETCollection, ETCollectionMutation;
@@ -147,9 +162,62 @@
  * respond with NO to aBlock.
  */
 - (id)filteredOutCollectionWithBlock: (BOOL(^)(id))aBlock;
+
+/**
+ * Returns a collection with each element of the original collection mapped by
+ * applying aBlock, like -mappedCollectionWithBlock:, but evaluates aBlock
+ * concurrently on chunks of the collection.
+ *
+ * aBlock must be safe to call from several threads at once, and must not raise
+ * exceptions. The results are placed in the returned collection in the
+ * receiver order, once all the elements have been mapped.
+ *
+ * See also ETSetConcurrentHOMThreadCount().
+ */
+- (id)concurrentMappedCollectionWithBlock: (id(^)(id))aBlock;
+
+/**
+ * Returns a collection containing all elements of the original collection that
+ * respond with YES to aBlock, like -filteredCollectionWithBlock:, but
+ * evaluates aBlock concurrently on chunks of the collection.
+ *
+ * The restrictions on aBlock are the same as for
+ * -concurrentMappedCollectionWithBlock:.
+ */
+- (id)concurrentFilteredCollectionWithBlock: (BOOL(^)(id))aBlock;
+
+/**
+ * Folds the collection concurrently and returns the result.
+ *
+ * The collection is split into chunks, each folded like
+ * -leftFoldWithInitialValue:intoBlock: starting from initialValue. Then
+ * neighbouring partial results are combined pairwise with aCombiner until one
+ * remains.
+ *
+ * initialValue must be an identity for aCombiner, and aCombiner must be
+ * associative, e.g. 0 and addition. The restrictions on aBlock are the same as
+ * for -concurrentMappedCollectionWithBlock:.
+ */
+- (id)reduceWithInitialValue: (id)initialValue
+                   intoBlock: (id(^)(id, id))aBlock
+                    combiner: (id(^)(id, id))aCombiner;
 #endif
 @end
 
+/**
+ * Returns the maximum number of threads, including the calling one, used by
+ * the concurrent higher-order methods such as
+ * -concurrentMappedCollectionWithBlock:.
+ *
+ * Defaults to the number of active processors.
+ */
+extern NSUInteger ETConcurrentHOMThreadCount(void);
+/**
+ * Sets the maximum number of threads used by the concurrent higher-order
+ * methods. 0 restores the default, and 1 disables concurrency.
+ */
+extern void ETSetConcurrentHOMThreadCount(NSUInteger aCount);
+
 /** 
  * @group High Order Messaging and Blocks
  * @abstract Higher-order messaging additions to ETCollectionMutation.
@@ -286,6 +286,36 @@ mutation notifications. */
                     atIndexes: (NSIndexSet *)indexes
                   withObjects: (NSArray *)objects
                  mutationKind: (ETCollectionMutationKind)mutationKind;
+/**
+ * Inserts the objects into the mutable collection bound to the property with 
+ * -insertObjects:atIndexes:hints:, and posts a single will/did change 
+ * notification pair for the whole batch.
+ *
+ * For an ordered collection, the notification carries all the inserted 
+ * indexes (when the indexes are empty, the objects are appended and their 
+ * resulting indexes are reported).
+ *
+ * -valueForKey: must return the collection itself and not a copy.
+ */
+- (void) insertObjects: (NSArray *)objects
+             atIndexes: (NSIndexSet *)indexes
+                 hints: (NSArray *)hints
+  intoCollectionForKey: (NSString *)key;
+/**
+ * Removes the objects from the mutable collection bound to the property with 
+ * -removeObjects:atIndexes:hints:, and posts a single will/did change 
+ * notification pair for the whole batch.
+ *
+ * For an ordered collection, the notification carries all the removed 
+ * indexes (when the indexes are empty, the indexes of every occurrence of the 
+ * objects are reported).
+ *
+ * -valueForKey: must return the collection itself and not a copy.
+ */
+- (void) removeObjects: (NSArray *)objects
+             atIndexes: (NSIndexSet *)indexes
+                 hints: (NSArray *)hints
+  fromCollectionForKey: (NSString *)key;
 @end
 
 /** @group Collection Protocols
@@ -455,6 +485,9 @@ For a use case example, see ETCollectionTrait. */
 - (NSArray *) contentArray;
 - (NSArray *) arrayRepresentation;
 - (NSArray *) viewpointArray;
+- (NSUInteger) countByEnumeratingValuesWithState: (NSFastEnumerationState *)state
+                                         objects: (id *)objects
+                                           count: (NSUInteger)count;
 @end
 
 /** @group Collection Protocols
@@ -482,6 +515,9 @@ protocol methods implemented in NSSet(ETCollection). */
 - (id) content;
 - (NSArray *) contentArray;
 - (NSEnumerator *) objectEnumerator;
+- (NSUInteger) countByEnumeratingWithState: (NSFastEnumerationState *)state 
+                                   objects: (id *)objects
+                                     count: (NSUInteger)count;
 @end
 
 /** @group Collection Protocols
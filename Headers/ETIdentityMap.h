@@ -0,0 +1,113 @@
+/**
+    Copyright (C) 2026 The Etoile Project
+
+    Date:  October 2026
+    License:  Modified BSD (see COPYING)
+ */
+
+#import <Foundation/Foundation.h>
+#import <EtoileFoundation/ETCollection.h>
+#import <EtoileFoundation/ETCIdentityMap.h>
+
+/**
+ * @group Collection Additions
+ * @abstract A map table whose keys are compared by identity.
+ *
+ * ETIdentityMap is an object wrapper around the ETCIdentityMap C API.  Keys
+ * are neither retained nor sent any message, unlike NSMapTable or
+ * NSDictionary which call -hash and -isEqual:, so an identity map can be
+ * keyed by classes or objects being deallocated.  Lookups hash the key
+ * pointer and probe a few adjacent slots, which makes the map well suited to
+ * hot paths keyed by pointers.
+ *
+ * Values are retained by default, or can be left unretained with
+ * -initWithCapacity:retainsObjects:.  Unretained values are not weak
+ * references: the map is not told when they are deallocated and doesn't
+ * clear them.  Keys must not be nil.
+ *
+ * ETIdentityMap supports ETCollection protocol, the collection elements being
+ * the values.  Code that cannot afford a message send per lookup can use the
+ * C API directly.
+ */
+@interface ETIdentityMap : NSObject <ETCollection>
+{
+    @private
+    ETCIdentityMap _map;
+    unsigned long _mutationCount;
+}
+
+/** @taskunit Initialization */
+
+/**
+ * Returns a new autoreleased map which retains its values.
+ */
++ (id) identityMap;
+/**
+ * <init />
+ * Initializes and returns a map able to hold capacity entries without
+ * growing.
+ *
+ * When retainsObjects is NO, the values are not retained, and the caller is
+ * responsible for removing them before they are deallocated, otherwise
+ * -objectForKey: returns a dangling pointer.
+ */
+- (id) initWithCapacity: (NSUInteger)capacity retainsObjects: (BOOL)retainsObjects;
+/**
+ * Initializes and returns a map which retains its values.
+ */
+- (id) init;
+
+/** @taskunit Accessing and Mutating Entries */
+
+/**
+ * Returns the value for the given key, or nil if there is none.
+ */
+- (id) objectForKey: (id)aKey;
+/**
+ * Sets the value for the given key, replacing any existing value.
+ *
+ * For a nil key or value, raises an NSInvalidArgumentException.
+ */
+- (void) setObject: (id)anObject forKey: (id)aKey;
+/**
+ * Removes the given key and its value, or does nothing if the key is not in
+ * the map.
+ */
+- (void) removeObjectForKey: (id)aKey;
+/**
+ * Removes all the entries.
+ */
+- (void) removeAllObjects;
+/**
+ * Returns the keys in no particular order.
+ */
+- (NSArray *) allKeys;
+/**
+ * Returns the values in no particular order.
+ */
+- (NSArray *) allValues;
+#if __has_feature(blocks)
+/**
+ * Evaluates the block with each key and value, until stop is set to YES.
+ *
+ * The map must not be mutated in the block.
+ */
+- (void) enumerateKeysAndObjectsUsingBlock: (void (^)(id key, id obj, BOOL *stop))aBlock;
+#endif
+
+/** @taskunit Collection Protocol */
+
+/**
+ * Returns YES.
+ */
+- (BOOL) isKeyed;
+/**
+ * Returns the values.
+ */
+- (id) content;
+/**
+ * Returns the values.
+ */
+- (NSArray *) contentArray;
+
+@end
@@ -9,9 +9,9 @@
 #import <EtoileFoundation/ETModelElementDescription.h>
 #import <EtoileFoundation/ETCollection.h>
 
-// NOTE: NSMapTable is not available on iOS (see implementation)
 @class ETModelElementDescription, ETEntityDescription, ETPackageDescription, 
-    ETPropertyDescription, NSMapTable;
+    ETPropertyDescription, ETIdentityMap;
+struct _ETResolvedLookupSlot;
 
 /** @group Metamodel
 @abstract Repository used to store the entity descriptions at runtime.
@@ -103,6 +103,11 @@ If no bound entity description or class can be found, -entityDescriptionForClass
 and -classForEntityDescription both attempt to return a parent entity or 
 superclass.
 
+The resolved entity descriptions and classes are cached, so once resolved, 
+these lookups take constant time and no lock, whatever the class hierarchy 
+depth. The cache is discarded when descriptions are added, removed or bound to 
+classes, or when an entity description parent changes.
+
 @section Consistency Checking
 
 Every time entity or package descriptions are added to the repository, you must 
@@ -111,14 +116,34 @@ check the model description graph consistency with -checkConstraints:.
 It is up to you to do it, because the repository has no way to know when you are 
 done adding descriptions and the repository content is in a coherent state that 
 won't raise warnings.  */
+
 @interface ETModelDescriptionRepository : NSObject <ETCollection, ETCollectionMutation>
 {
     @private
     NSMutableSet *_unresolvedDescriptions; /* Used to build the repository */
     NSMutableDictionary *_descriptionsByName; /* Descriptions registered in the repositiory */
-    NSMapTable *_entityDescriptionsByClass;
-    NSMapTable *_classesByEntityDescription;
+    ETIdentityMap *_entityDescriptionsByClass;
+    ETIdentityMap *_classesByEntityDescription;
+    /* Resolved -entityDescriptionForClass: and -classForEntityDescription: results */
+    struct _ETResolvedLookupSlot *_resolvedEntityDescriptionSlots;
+    struct _ETResolvedLookupSlot *_resolvedClassSlots;
+    /* Incremented to discard the resolved lookups of the receiver */
+    volatile unsigned long _resolvedLookupGeneration;
+    /* Nesting of the registration batches, and whether the property accessors 
+       must be invalidated when they end */
+    NSUInteger _registrationDepth;
+    BOOL _needsPropertyAccessorInvalidation;
     BOOL _needsConstantStringLookupHack;
+    /* Classes whose entity descriptions are not yet created, keyed by name */
+    NSMutableDictionary *_pendingClassesByName;
+    NSRecursiveLock *_pendingLock;
+    BOOL _isResolving;
+    /* Startup instrumentation */
+    NSUInteger _createdEntityDescriptionCount;
+    NSTimeInterval _entityDescriptionCreationTime;
+    NSTimeInterval _resolutionTime;
+    NSUInteger _snapshotEntityDescriptionCount;
+    NSTimeInterval _snapshotLoadTime;
 }
 
 
@@ -174,6 +199,94 @@ For resolveNow, see -collectEntityDescriptionsFromClass:excludedClasses:resolveN
 - (void) registerEntityDescriptionsForClasses: (NSSet *)classes
                                    resolveNow: (BOOL)resolve;
 
+
+/** @taskunit Lazy Registration */
+
+
+/** Whether -collectEntityDescriptionsFromClass:excludedClasses:resolveNow: and 
+-registerEntityDescriptionsForClasses:resolveNow: defer creating the entity 
+descriptions.
+
+When YES, these methods just record the classes. The entity description of a 
+recorded class is created with +newEntityDescription, bound to its class and 
+resolved the first time -entityDescriptionForClass: or -descriptionForName: 
+asks for it (or for a subclass entity description). The entity descriptions 
+referenced by a resolved entity description (parent, property types etc.) are 
+created at the same time.
+
+Until they are created, the pending entity descriptions are not returned by 
+-entityDescriptions, -allDescriptions or the collection protocol methods. Use 
+-resolvePendingEntityDescriptions to create them all.
+
+By default, returns NO. */
+@property (nonatomic, assign) BOOL registersEntityDescriptionsLazily;
+/** Creates, binds and resolves all the entity descriptions deferred by the 
+lazy registration.
+
+See -registersEntityDescriptionsLazily. */
+- (void) resolvePendingEntityDescriptions;
+
+
+/** @taskunit Metamodel Snapshots */
+
+
+/** Returns a fingerprint of the bundles and frameworks loaded in the process, 
+based on the path, modification date and size of their executables.
+
+A snapshot can only be loaded if it was written in a process with the same 
+fingerprint. The fingerprint changes when bundles or frameworks are loaded, 
+or when their executables are updated. */
++ (NSString *) snapshotFingerprint;
+/** Writes the entity descriptions bound to classes, along with their 
+property and package descriptions, to the given file, and returns whether the 
+file was written.
+
+The snapshot is a versioned binary property list tagged with 
++snapshotFingerprint. Entity descriptions that cannot be represented in a 
+property list (e.g. a property description with a role) are recorded by class 
+name, and rebuilt with +newEntityDescription when the snapshot is loaded. 
+
+Pending entity descriptions are created first, see 
+-resolvePendingEntityDescriptions. Entity descriptions not bound to a class and 
+property extensions are not written. */
+- (BOOL) writeSnapshotToFile: (NSString *)aPath;
+/** Adds the entity descriptions from the given snapshot file to the receiver, 
+binds them to their classes and resolves them, then returns YES.
+
+The file is memory-mapped. The entity descriptions bound to classes in the 
+receiver are not replaced.
+
+If the file doesn't exist, its version is not supported or its fingerprint 
+doesn't match +snapshotFingerprint, returns NO without changing the receiver. 
+In this case, collect the entity descriptions as usual and write a new 
+snapshot.  */
+- (BOOL) loadSnapshotFromFile: (NSString *)aPath;
+
+
+/** @taskunit Startup Instrumentation */
+
+
+/** Returns the time spent and the work done to build the receiver content.
+
+The returned dictionary contains NSNumber values for these keys:
+
+<deflist>
+<term>createdEntityDescriptionCount</term><desc>the number of 
++newEntityDescription calls</desc>
+<term>entityDescriptionCreationTime</term><desc>the seconds spent in 
++newEntityDescription</desc>
+<term>resolutionTime</term><desc>the seconds spent in 
+-resolveNamedObjectReferences, including the entity descriptions created for 
+the referenced types</desc>
+<term>snapshotEntityDescriptionCount</term><desc>the number of entity 
+descriptions loaded from snapshots</desc>
+<term>snapshotLoadTime</term><desc>the seconds spent in 
+-loadSnapshotFromFile:, including the resolution</desc>
+<term>pendingEntityDescriptionCount</term><desc>the number of entity 
+descriptions deferred by the lazy registration and not yet created</desc>
+</deflist> */
+@property (nonatomic, readonly) NSDictionary *startupStatistics;
+
 /** @taskunit Registering and Enumerating Descriptions */
 
 
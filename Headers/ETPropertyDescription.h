@@ -180,6 +180,13 @@ entity. See -isRelationship. */
 If -type returns a valid entity description, the parenthesis contains the 
 entity name in the returned string. */
 @property (nonatomic, readonly) NSString *typeDescription;
+/** Returns the interned property ID for -name.
+
+Can be passed to -valueForPropertyID: and -setValue:forPropertyID: to access 
+the described property without comparing property names.
+
+See ETPropertyIDForName(). */
+@property (nonatomic, readonly) ETPropertyID propertyID;
 @property (nonatomic, retain) id role;
 /** Returns YES when this property is a relationship to the destination entity
 returned by -type, otherwise returns NO when the property is an attribute.
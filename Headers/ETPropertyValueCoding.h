@@ -7,6 +7,15 @@
 
 #import <Foundation/Foundation.h>
 
+/** @group Model Additions
+@abstract Interned property name.
+
+A property ID is unique per property name, so two property IDs can be compared 
+with <code>==</code> rather than -isEqualToString:.
+
+See ETPropertyIDForName() and -[NSObject valueForPropertyID:]. */
+typedef const struct _ETPropertyID *ETPropertyID;
+
 /** @group Model Additions
 @abstract Protocol to read and write properties.
 
@@ -32,6 +41,18 @@ NSObject(ETModelAdditions), but few classes such as ETMutableObjectViewpoint and
 ETLayoutItem in EtoileUI overrides the NSObject semantic for -valueForProperty: 
 and -setValue:forProperty:. */
 @interface NSObject (ETPropertyValueCoding)
+/** <override-dummy />
+Returns whether -propertyNames can return different names for instances of 
+the receiver class, e.g. when they depend on another object.
+
+By default, returns NO, and NSObject caches per class whether a name is 
+listed in -propertyNames. When YES is returned, -propertyNames is checked on 
+each -valueForProperty: and -setValue:forProperty: instead, which is slower.
+
+Overriding -propertyNames doesn't require overriding this method, as long as 
+the returned names are the same for all instances, and only change along 
+with the entity descriptions or by calling ETInvalidatePropertyAccessors(). */
++ (BOOL) hasInstanceSpecificPropertyNames;
 /** Can be overriden to return YES in order to support exposing properties, in 
 case -valueForProperty: and -setValue:forProperty: access another object and 
 not the receiver.
@@ -69,6 +90,10 @@ For a NSObject subclass not bound to an entity description, the property names
 related to the closest superclass bound to an entity description are returned 
 through a recursive lookup in -entityDescriptionForClass:.
 
+NSObject looks up the property names once per class, the first time a property 
+is accessed, so the returned names must be the same for all the instances of a 
+class, unless +hasInstanceSpecificPropertyNames is overriden to return YES.
+
 See -basicPropertyNames, -valueForProperty: and -setValue:forProperty:.
 See also -[ETPropertyValueCoding propertyNames]. */
 - (NSArray *) propertyNames;
@@ -93,10 +118,152 @@ protocol.
 See also -[NSObject setValue:forProperty:] and 
 -[ETPropertyViewpoint setValue:forProperty:]. */
 - (BOOL) setValue: (id)value forProperty: (NSString *)key;
+/** Returns the value of the property identified by the given property ID.
+
+This is the fast path for -valueForProperty:, which avoids interning the 
+property name on each access.
+
+By default, -valueForProperty: is called if it is overriden in a subclass but 
+not -valueForPropertyID:. When both methods are overriden, -valueForProperty: 
+should usually call -valueForPropertyID:, and subclasses must then override 
+-valueForPropertyID: rather than -valueForProperty:. */
+- (id) valueForPropertyID: (ETPropertyID)aPropertyID;
+/** Sets the value of the property identified by the given property ID and 
+returns YES if the value was successfully set.
+
+This is the fast path for -setValue:forProperty:. See -valueForPropertyID:. */
+- (BOOL) setValue: (id)value forPropertyID: (ETPropertyID)aPropertyID;
+/** Returns the value at the end of the given property path, such as 
+<em>owner.name</em>, by sending -valueForProperty: for each component.
+
+The path is parsed once and cached, see ETPropertyPath. */
 - (id) valueForPropertyPath: (NSString *)aPropertyPath;
+/** Sets the value of the last property in the given path, on the object at 
+the end of the path without its last component.
+
+See -valueForPropertyPath: and ETPropertyPath. */
 - (BOOL) setValue: (id)aValue forPropertyPath: (NSString *)aPropertyPath;
 @end
 
+/**
+ * Discards the property accessors resolved by -[NSObject valueForProperty:] 
+ * and -[NSObject setValue:forProperty:] for each class.
+ *
+ * The accessors are discarded automatically when an entity description 
+ * changes, an entity description is bound to a class or a trait is applied. 
+ * Call this function if some methods are added to classes by other means, or 
+ * if the property names returned by -propertyNames change for another reason.
+ */
+void ETInvalidatePropertyAccessors(void);
+/**
+ * Returns the unique property ID for the given property name.
+ *
+ * Property IDs are interned for the process lifetime, so the result can be 
+ * stored in a static variable. For a nil name, returns NULL.
+ *
+ * Since interned names are never freed, this function should only be called 
+ * with property names, and not with arbitrary strings such as user input. Use 
+ * ETDeclaredPropertyIDForName() for the latter.
+ *
+ * Looking up a name already interned takes no lock.
+ */
+ETPropertyID ETPropertyIDForName(NSString *aName);
+/**
+ * Returns the unique property ID for the given property name, if the name is 
+ * already interned or is listed in the -propertyNames of anObject, otherwise 
+ * returns NULL without interning the name.
+ *
+ * -valueForProperty: and -setValue:forProperty: use this function, so 
+ * accessing undeclared properties doesn't grow the interned names. Unless 
+ * +hasInstanceSpecificPropertyNames returns YES, recently looked up 
+ * undeclared names are remembered per class, so -propertyNames isn't called 
+ * again for them.
+ */
+ETPropertyID ETDeclaredPropertyIDForName(id anObject, NSString *aName);
+/**
+ * Returns the property name for the given property ID.
+ */
+NSString *ETPropertyIDName(ETPropertyID aPropertyID);
+
+struct _ETPropertyPathStep;
+
+/** @group Model Additions
+@abstract Parsed property path evaluated through Property Value Coding.
+
+A property path such as <em>owner.name</em> is parsed once into steps. Each 
+step resolves its property ID the first time it is evaluated on an object 
+declaring its name (see ETDeclaredPropertyIDForName()), so paths built from 
+arbitrary strings don't grow the interned names. Each step also caches the 
+property accessor resolved for the last class it was evaluated on, so 
+evaluating a path repeatedly on objects of the same classes involves no 
+string manipulation and no accessor lookup.
+
+Property paths are immutable and can be evaluated from multiple threads. 
+Paths returned by +pathWithString: are shared, so their caches are reused by 
+-[NSObject valueForPropertyPath:] and other callers.
+
+Each step honors -valueForPropertyID: and -valueForProperty: overriden in the 
+class of the object it is evaluated on, exactly as -valueForPropertyPath: 
+does. */
+@interface ETPropertyPath : NSObject <NSCopying>
+{
+    @private
+    NSString *_string;
+    NSUInteger _count;
+    struct _ETPropertyPathStep *_steps;
+}
+
+/** @taskunit Initialization */
+
+/** Returns a shared property path for the given string.
+
+For a nil string, returns nil. */
++ (ETPropertyPath *) pathWithString: (NSString *)aPath;
+/** <init />
+Initializes and returns a property path by splitting the given string on 
+dots.
+
+For a nil string, raises an NSInvalidArgumentException. */
+- (id) initWithString: (NSString *)aPath;
+
+/** @taskunit Path Components */
+
+/** Returns the string the receiver was initialized with. */
+@property (nonatomic, readonly) NSString *string;
+/** Returns the number of property IDs in the path. */
+@property (nonatomic, readonly) NSUInteger count;
+/** Returns the property ID at the given index, interning the property name 
+if needed (see ETPropertyIDForName()).
+
+Raises an NSRangeException if the index is out of bounds. */
+- (ETPropertyID) propertyIDAtIndex: (NSUInteger)anIndex;
+/** Returns the first property ID in the path. See -propertyIDAtIndex:. */
+@property (nonatomic, readonly) ETPropertyID firstPropertyID;
+/** Returns the last property ID in the path. See -propertyIDAtIndex:. */
+@property (nonatomic, readonly) ETPropertyID lastPropertyID;
+
+/** @taskunit Evaluation */
+
+/** Returns the value at the end of the path, starting from the given object.
+
+Returns nil when an intermediate value is nil. */
+- (id) valueForObject: (id)anObject;
+/** Sets the value of the last property, on the object obtained by evaluating 
+the path without its last component from the given object, and returns YES if 
+the value was successfully set.
+
+See -[NSObject setValue:forProperty:]. */
+- (BOOL) setValue: (id)aValue forObject: (id)anObject;
+/** Evaluates the path on count objects and puts the results into values.
+
+The values are nil for the objects whose path evaluates to nil. */
+- (void) getValues: (id *)values forObjects: (const id *)objects count: (NSUInteger)count;
+/** Returns the values at the end of the path for each object, in the same 
+order.
+
+The nil values are replaced by NSNull. */
+- (NSArray *) valuesForObjects: (NSArray *)objects;
+@end
 
 /** @group Model Additions
 @abstract Property reading support for NSDictionary. */
@@ -0,0 +1,96 @@
+/**
+    Copyright (C) 2026 The Etoile Project
+
+    Date:  October 2026
+    License:  Modified BSD (see COPYING)
+ */
+
+#ifndef __ET_SEGMENT_BUFFER_INCLUDED__
+#define __ET_SEGMENT_BUFFER_INCLUDED__
+
+#include <stddef.h>
+#include <sys/uio.h>
+
+/**
+ * Opaque type representing a sequence of byte segments, used to pass data
+ * through socket filters without copying it.
+ *
+ * Segments either borrow memory owned by someone else, which must remain valid
+ * until the buffer is reset, or point into scratch memory owned by the buffer.
+ * Borrowed segments are read-only unless added with
+ * ETSegmentBufferAppendMutable(); scratch segments are always writable.
+ *
+ * Each append adds exactly one segment, so a filter can use segments to
+ * delimit messages.
+ *
+ * If memory cannot be allocated, the segment being added is dropped and the
+ * buffer records the failure, which ETSegmentBufferFailed() reports until the
+ * buffer is reset.
+ */
+typedef struct _ETSegmentBuffer* ETSegmentBuffer;
+
+/**
+ * Creates a new, empty, segment buffer.
+ */
+ETSegmentBuffer ETSegmentBufferNew(void);
+/**
+ * Appends a read-only segment borrowing length bytes at bytes.  Empty
+ * segments are ignored.
+ */
+void ETSegmentBufferAppend(ETSegmentBuffer buffer, const void *bytes, size_t length);
+/**
+ * Appends a segment borrowing length bytes at bytes, which filters may modify
+ * in place.  Empty segments are ignored.
+ */
+void ETSegmentBufferAppendMutable(ETSegmentBuffer buffer, void *bytes, size_t length);
+/**
+ * Appends a copy of length bytes at bytes, stored in scratch memory.
+ */
+void ETSegmentBufferAppendCopy(ETSegmentBuffer buffer, const void *bytes, size_t length);
+/**
+ * Appends all the segments of other, which must not be reset before buffer.
+ */
+void ETSegmentBufferAppendBuffer(ETSegmentBuffer buffer, ETSegmentBuffer other);
+/**
+ * Returns at least capacity bytes of scratch memory, which remain valid until
+ * the buffer is reset.  Call ETSegmentBufferCommit() to append the part that
+ * was written as a segment.  Returns NULL if the memory cannot be allocated.
+ */
+void *ETSegmentBufferReserve(ETSegmentBuffer buffer, size_t capacity);
+/**
+ * Appends the first length bytes of the memory returned by the last call to
+ * ETSegmentBufferReserve() as a segment.
+ */
+void ETSegmentBufferCommit(ETSegmentBuffer buffer, size_t length);
+/**
+ * Returns the number of segments in the buffer.
+ */
+int ETSegmentBufferCount(ETSegmentBuffer buffer);
+/**
+ * Returns the segments of the buffer, in order.  The returned array is
+ * invalidated by any other call on the buffer.
+ */
+const struct iovec *ETSegmentBufferSegments(ETSegmentBuffer buffer);
+/**
+ * Returns the bytes of the segment at anIndex if they may be modified in
+ * place, or NULL if the segment is read-only.
+ */
+void *ETSegmentBufferMutableBytesAtIndex(ETSegmentBuffer buffer, int anIndex);
+/**
+ * Returns the total number of bytes in the buffer.
+ */
+size_t ETSegmentBufferLength(ETSegmentBuffer buffer);
+/**
+ * Returns non-zero if memory could not be allocated since the buffer was
+ * created or last reset, in which case segments are missing.
+ */
+int ETSegmentBufferFailed(ETSegmentBuffer buffer);
+/**
+ * Removes all segments, and makes the scratch memory available for reuse.
+ */
+void ETSegmentBufferReset(ETSegmentBuffer buffer);
+/**
+ * Destroy the buffer.
+ */
+void ETSegmentBufferFree(ETSegmentBuffer buffer);
+#endif
@@ -0,0 +1,100 @@
+/**
+    Copyright (C) 2026 The Etoile Project
+
+    Date:  October 2026
+    License:  Modified BSD (see COPYING)
+ */
+
+#import <Foundation/Foundation.h>
+#import <EtoileFoundation/EtoileCompatibility.h>
+
+@protocol ETCollection;
+
+#if __has_feature(blocks)
+
+/** @group High Order Messaging and Blocks
+@abstract A lazy sequence of operations applied to a collection.
+
+ETSequence records map, filter, take, flat map and zip stages, and evaluates
+them only when the sequence is consumed with -collection,
+-leftFoldWithInitialValue:intoBlock: or fast enumeration. Each element of the
+source collection then goes through all the stages in a single pass, so no
+intermediate collection is created between the stages, unlike when chaining
+-mappedCollectionWithBlock: and -filteredCollectionWithBlock:.
+
+<example>
+NSArray *names = [[[[ETSequence sequenceWithCollection: people]
+    filteredSequenceWithBlock: ^ (id person) { return [person isAdult]; }]
+    mappedSequenceWithBlock: ^ (id person) { return [person name]; }]
+    collection];
+</example>
+
+Sequences are immutable: each stage method returns a new sequence, and a
+sequence can be consumed several times. The stages are evaluated again on each
+consumption, and see the source collection as it is at that time.
+
+Each enumeration of a sequence has its own state, so a sequence can be
+enumerated in nested loops or by several threads at the same time. The 
+sequence owns the state of an enumeration left early until it is 
+deallocated. */
+@interface ETSequence : NSObject <NSFastEnumeration>
+{
+    @private
+    id _source;
+    struct ETSequenceStage *_stages;
+    NSUInteger _stageCount;
+    NSMutableArray *_enumerations;
+}
+
+/** @taskunit Initialization */
+
+/** Returns a new autoreleased sequence with no stages over aCollection. */
++ (ETSequence *)sequenceWithCollection: (id <ETCollection>)aCollection;
+/** Initializes a sequence with no stages over aCollection.
+
+For an NSDictionary, the sequence elements are the dictionary values. */
+- (id)initWithCollection: (id <ETCollection>)aCollection;
+
+/** @taskunit Stages */
+
+/** Returns a sequence whose elements are the receiver elements mapped by
+aBlock. nil results are replaced by NSNull, as with
+-mappedCollectionWithBlock:. */
+- (ETSequence *)mappedSequenceWithBlock: (id (^)(id))aBlock;
+/** Returns a sequence containing the receiver elements for which aBlock
+returns YES. */
+- (ETSequence *)filteredSequenceWithBlock: (BOOL (^)(id))aBlock;
+/** Returns a sequence containing at most the first aCount elements of the
+receiver.
+
+The source elements past the last element taken are not evaluated. */
+- (ETSequence *)sequenceLimitedToCount: (NSUInteger)aCount;
+/** Returns a sequence whose elements are the elements of the collections
+returned by aBlock for each receiver element, in order.
+
+aBlock must return an ETCollection or nil, which stands for an empty
+collection. */
+- (ETSequence *)flatMappedSequenceWithBlock: (id <ETCollection> (^)(id))aBlock;
+/** Returns a sequence whose elements are the results of aBlock applied to the
+receiver elements paired with the elements of aCollection.
+
+The sequence ends with the shorter of the receiver and aCollection. */
+- (ETSequence *)zippedSequenceWithCollection: (id <ETCollection>)aCollection
+                                    andBlock: (id (^)(id, id))aBlock;
+
+/** @taskunit Consuming the Sequence */
+
+/** Returns a new collection containing the sequence elements.
+
+The collection is an instance of the source collection -mutableClass, except
+for keyed collections such as NSDictionary, for which an NSMutableArray is
+returned since the stages do not preserve the keys. */
+- (id)collection;
+/** Folds the sequence by applying aBlock consecutively with the accumulator
+as the first and each element as the second argument of the block. */
+- (id)leftFoldWithInitialValue: (id)initialValue
+                     intoBlock: (id (^)(id, id))aBlock;
+
+@end
+
+#endif
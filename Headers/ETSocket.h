@@ -7,6 +7,8 @@
 
 #import <Foundation/Foundation.h>
 #if !(TARGET_OS_IPHONE) && !(TARGET_OS_MAC)
+#include <sys/uio.h>
+#import <EtoileFoundation/ETSegmentBuffer.h>
 
 /**
  * @group Network and Communication
@@ -14,15 +16,27 @@
  *
  * The socket is opened when the object is created, and closed when it is 
  * destroyed.
+ *
+ * The socket is non-blocking.  Once it has a delegate, it is watched by an
+ * event loop (based on epoll where available) attached to the run loop of the
+ * thread that set the delegate, which reads incoming data and, with
+ * -setSendsInBackground:, writes queued output when the socket becomes
+ * writable.  Such a socket should be released on that thread.
  */
 @interface ETSocket : NSObject
 {
-    /** Buffer used for receiving data. */
-    unsigned char buffer[512];
-    /** File handle encapsulating the socket.  Used for runloop integration. */
+    /** Buffer the socket is read into, reused for each read. */
+    NSMutableData *readBuffer;
+    /** Size of readBuffer. */
+    NSUInteger readCapacity;
+    /** File handle encapsulating the socket.  Owns the descriptor. */
     NSFileHandle *handle;
     /** Reference to the delegate. */
     id delegate;
+    /** Event loop that reports readiness of the socket. */
+    id eventLoop;
+    /** Readiness events the event loop watches for. */
+    int watchedEvents;
     /** OpenSSL context. */
     void *ssl;
     /** OpenSSL context. */
@@ -31,10 +45,32 @@
     NSMutableArray *outFilters;
     /** Array of filters used for filtering the input. */
     NSMutableArray *inFilters;
-    /** EOF Counter */
-    NSInteger eofCounter;
+    /** Buffers holding the output of each output filter (and its input). */
+    ETSegmentBuffer *outFilterBuffers;
+    /** Buffers holding the output of each input filter (and its input). */
+    ETSegmentBuffer *inFilterBuffers;
+    /** Output that could not be written yet, as NSData objects. */
+    NSMutableArray *outputQueue;
+    /** Number of bytes of the first object in outputQueue already written. */
+    NSUInteger outputOffset;
+    /** Number of bytes in outputQueue still to be written. */
+    NSUInteger queuedByteCount;
+    /** Queued byte count above which the delegate is told to back off. */
+    NSUInteger outputHighWaterMark;
+    /** YES between exceeding the high water mark and draining the queue. */
+    BOOL outputAboveHighWaterMark;
+    /** YES if queued output is written by the event loop. */
+    BOOL sendsInBackground;
+    /** YES if writing is waiting for the socket to become readable (SSL). */
+    BOOL writeWantsRead;
     /** YES if the connection is broken, NO otherwise */
     BOOL connectionIsBroken;
+    /** YES if partial frames are held back by the kernel. */
+    BOOL corked;
+    /** Number of bytes written to the socket. */
+    unsigned long long sentByteCount;
+    /** Number of system calls (or SSL writes) issued to send data. */
+    NSUInteger sendCallCount;
 }
 /**
  * Returns YES if the connection is broken, NO otherwise
@@ -57,8 +93,82 @@
 /**
  * Sends the specified data through the socket.  Throw ETSocketException if
  * sending failed.
+ *
+ * Data that the socket can not accept immediately is queued.  If the socket
+ * sends in the background and this is called on the thread that set the
+ * delegate, the queue is written out as the socket becomes writable, and
+ * this method returns at once.  Otherwise, this method waits (without
+ * spinning) until all the data has been written.
  */
 - (void)sendData: (NSData*)data;
+/**
+ * Sends count chunks of data through the socket, as if they were a single
+ * buffer made by concatenating them.  Without output filters, this results in
+ * a single writev() call in the common case, so the chunks never need to be
+ * copied into a contiguous buffer.  Throw ETSocketException if sending failed.
+ */
+- (void)sendChunks: (const struct iovec*)chunks count: (int)count;
+/**
+ * Appends a filter to the chain applied to outgoing data.  The filter must
+ * conform to ETSocketSegmentFilter or ETSocketFilter.
+ */
+- (void)addOutFilter: (id)aFilter;
+/**
+ * Appends a filter to the chain applied to incoming data.  The filter must
+ * conform to ETSocketSegmentFilter or ETSocketFilter.
+ */
+- (void)addInFilter: (id)aFilter;
+/**
+ * Sets whether the socket is corked.  While corked, the kernel does not send
+ * partial frames, so data written in several calls goes out in as few
+ * segments as possible.  Uncorking sends anything that is still pending.
+ *
+ * This uses TCP_CORK on Linux and TCP_NOPUSH on BSD, and does nothing on
+ * other systems.
+ */
+- (void)setCorked: (BOOL)aFlag;
+/**
+ * Returns whether the socket is corked.
+ */
+- (BOOL)isCorked;
+/**
+ * Returns the number of bytes written to the socket so far, after output
+ * filters have been applied.
+ */
+- (unsigned long long)sentByteCount;
+/**
+ * Returns the number of system calls issued to write data to the socket so
+ * far.  For SSL sockets, this is the number of SSL writes.
+ */
+- (NSUInteger)sendCallCount;
+/**
+ * Sets the number of queued output bytes above which the delegate receives
+ * -socketOutputDidExceedHighWaterMark:.  The default is 1MB.
+ */
+- (void)setOutputHighWaterMark: (NSUInteger)aByteCount;
+/**
+ * Returns the number of queued output bytes above which the delegate is asked
+ * to stop sending.
+ */
+- (NSUInteger)outputHighWaterMark;
+/**
+ * Returns the number of bytes waiting to be written to the socket.
+ */
+- (NSUInteger)queuedByteCount;
+/**
+ * Sets whether output that the socket can not accept immediately is written
+ * by the event loop, while the run loop of the thread that set the delegate
+ * runs, rather than by waiting in -sendData: and -sendChunks:count:.  The
+ * default is NO.
+ *
+ * Only enable this on a thread whose run loop keeps running, otherwise
+ * queued output is never sent.
+ */
+- (void)setSendsInBackground: (BOOL)aFlag;
+/**
+ * Returns whether queued output is written by the event loop.
+ */
+- (BOOL)sendsInBackground;
 @end
 
 /** 
@@ -109,8 +219,29 @@
 @interface NSObject (ETSocketDelegate)
 /**
  * Handle data received over the specified socket.
+ *
+ * aData is a new object for each read, which the receiver may retain.
  */
 - (void)receivedData: (NSData*)aData fromSocket: (ETSocket*)aSocket;
+/**
+ * Handle data received over the specified socket, as the segments produced
+ * by the input filters, without gathering them into an NSData object.  Used
+ * instead of -receivedData:fromSocket: when implemented.
+ *
+ * The segments are only valid during this call.
+ */
+- (void)receivedSegments: (ETSegmentBuffer)segments fromSocket: (ETSocket*)aSocket;
+/**
+ * Tells the delegate that the output queued on aSocket exceeds its high water
+ * mark.  The delegate should stop sending until it receives
+ * -socketOutputDidDrain:.
+ */
+- (void)socketOutputDidExceedHighWaterMark: (ETSocket*)aSocket;
+/**
+ * Tells the delegate that aSocket has written all its queued output after
+ * exceeding its high water mark.
+ */
+- (void)socketOutputDidDrain: (ETSocket*)aSocket;
 @end
 
 /**
@@ -141,6 +272,29 @@
 - (NSMutableData*) filterData: (NSMutableData*)aData;
 @end
 
+/**
+ * @group Network and Communication
+ * @abstract Protocol for socket filters working on segmented data.
+ *
+ * Unlike ETSocketFilter, filters conforming to this protocol do not require
+ * the data to be gathered in an NSMutableData object, so a chain of them
+ * passes data from the application to the socket (or the other way) without
+ * copying it, unless a filter has to transform it.
+ */
+@protocol ETSocketSegmentFilter <NSObject>
+/**
+ * Filters the segments in input, and appends the result to output.
+ *
+ * A filter may pass segments through untouched, by appending them to output
+ * (e.g. with ETSegmentBufferAppendBuffer()), modify the segments for which
+ * ETSegmentBufferMutableBytesAtIndex() returns non-NULL in place before
+ * passing them on, and write new data into scratch memory obtained from
+ * output.  Both buffers are reset after the data has been sent or delivered,
+ * so anything kept for the next call must be copied.
+ */
+- (void)filterSegments: (ETSegmentBuffer)input into: (ETSegmentBuffer)output;
+@end
+
 /**
  * Exception thrown on abrupt termination.
  */
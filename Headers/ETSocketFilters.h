@@ -0,0 +1,95 @@
+/**
+    Copyright (C) 2026 The Etoile Project
+
+    Date:  October 2026
+    License:  Modified BSD (see COPYING)
+ */
+
+#import <Foundation/Foundation.h>
+#import <EtoileFoundation/ETSocket.h>
+#if !(TARGET_OS_IPHONE) && !(TARGET_OS_MAC)
+
+/**
+ * @group Network and Communication
+ * @abstract Output filter that compresses the data sent through a socket.
+ *
+ * The data is compressed as a single zlib stream, which is flushed after each
+ * send, so that the receiver can decompress each message as soon as it
+ * arrives.  Use ETInflateFilter on the other end.
+ */
+@interface ETDeflateFilter : NSObject <ETSocketSegmentFilter>
+{
+    /** zlib stream state. */
+    void *stream;
+}
+/**
+ * Initializes the filter with a zlib compression level between 0 (none) and
+ * 9 (best compression).
+ */
+- (id)initWithCompressionLevel: (int)aLevel;
+@end
+
+/**
+ * @group Network and Communication
+ * @abstract Input filter that decompresses data compressed by ETDeflateFilter.
+ *
+ * Throws ETSocketException if the data is not a valid zlib stream.
+ */
+@interface ETInflateFilter : NSObject <ETSocketSegmentFilter>
+{
+    /** zlib stream state. */
+    void *stream;
+}
+@end
+
+/**
+ * @group Network and Communication
+ * @abstract Output filter that prefixes the data of each send with its length.
+ *
+ * The length is written as a 32-bit big-endian integer, followed by the data,
+ * which is passed on untouched.  Use ETFrameDecoder on the other end.
+ *
+ * Sending no data sends no frame, since empty frames are not valid.  Sending
+ * more than 2^32 - 1 bytes at once raises ETSocketException.
+ */
+@interface ETFrameEncoder : NSObject <ETSocketSegmentFilter>
+@end
+
+/**
+ * @group Network and Communication
+ * @abstract Input filter that splits the data received into the frames sent
+ * by an ETFrameEncoder.
+ *
+ * Each complete frame is output as a single segment, without its length
+ * prefix, so a delegate implementing -receivedSegments:fromSocket: receives
+ * one segment per frame.  Frames that arrive in a single read are passed on
+ * without copying; only frames split across reads are assembled in a copy.
+ *
+ * Segment buffers have no empty segments, so an empty frame could not be
+ * delivered.  Receiving one raises ETSocketException.
+ */
+@interface ETFrameDecoder : NSObject <ETSocketSegmentFilter>
+{
+    /** Bytes of the length prefix received so far. */
+    unsigned char header[4];
+    /** Number of valid bytes in header. */
+    NSUInteger headerLength;
+    /** Length of the frame being received. */
+    NSUInteger frameLength;
+    /** Part of the frame being received, when it spans several reads. */
+    NSMutableData *partialFrame;
+    /** Largest frame accepted. */
+    NSUInteger maximumFrameLength;
+}
+/**
+ * Sets the length of the largest frame accepted, to bound the memory used by
+ * a connection.  Longer frames raise ETSocketException.  The default is 16MB.
+ */
+- (void)setMaximumFrameLength: (NSUInteger)aLength;
+/**
+ * Returns the length of the largest frame accepted.
+ */
+- (NSUInteger)maximumFrameLength;
+@end
+
+#endif
@@ -7,6 +7,8 @@
 
 #import <Foundation/Foundation.h>
 
+@class ETIdentityMap;
+
 // NOTE: -[NSThread callStackSymbols] was introduced with Mac OS X 10.6.
 // MAC_OS_X_VERSION_MIN_REQUIRED seems to be defined even while targeting iOS.
 #if defined(GNUSTEP) || (MAC_OS_X_VERSION_MIN_REQUIRED >= 1060 && !(TARGET_OS_IPHONE))
@@ -59,7 +61,7 @@ ETStackTraceRecorder is thread-safe (not fully yet), multiple threads can invoke
 @interface ETStackTraceRecorder : NSObject
 {
     @private
-    NSMapTable *_tracesByObject;
+    ETIdentityMap *_tracesByObject;
     NSThread *_recordThread;
     NSLock *_lock;
     NSMutableSet *_allocMonitoredClasses;
@@ -12,11 +12,14 @@
 #import <EtoileFoundation/ETCollection+HOM.h>
 #import <EtoileFoundation/ETGetOptionsDictionary.h>
 #import <EtoileFoundation/ETHistory.h>
+#import <EtoileFoundation/ETIdentityMap.h>
 #import <EtoileFoundation/ETKeyValuePair.h>
 #import <EtoileFoundation/ETPlugInRegistry.h>
 #import <EtoileFoundation/ETPropertyValueCoding.h>
 #import <EtoileFoundation/ETReflection.h>
+#import <EtoileFoundation/ETSequence.h>
 #import <EtoileFoundation/ETSocket.h>
+#import <EtoileFoundation/ETSocketFilters.h>
 #import <EtoileFoundation/ETStackTraceRecorder.h>
 #import <EtoileFoundation/ETUTI.h>
 #import <EtoileFoundation/ETUUID.h>
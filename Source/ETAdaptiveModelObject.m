@@ -55,6 +55,12 @@
     return NO;
 }
 
+/** Returns YES, since the property names are those of its entity description. */
++ (BOOL) hasInstanceSpecificPropertyNames
+{
+    return YES;
+}
+
 - (NSArray *) propertyNames
 {
     return (NSArray *)[[[_description propertyDescriptions] mappedCollection] name];
@@ -10,183 +10,711 @@
 #include <string.h>
 #include "ETCArray.h"
 
+/** Smallest capacity allocated for an array. */
+#define MIN_CAPACITY 8
+
+/**
+ * Ring buffer shared by ETCArray and ETCValueArray.
+ *
+ * The element at logical index i is stored in the slot (head + i) modulo the
+ * capacity, which is always a power of two so the modulo is a mask.  Adding or
+ * removing at either end moves head or count, and never the elements.
+ *
+ * The helpers below take the element size as an argument, so that the
+ * ETCArray functions which pass sizeof(void*) get inlined copies of fixed
+ * size.
+ */
+struct _ETCDeque
+{
+    char *storage;
+    size_t elementSize;
+    size_t head;
+    size_t count;
+    size_t capacity;
+};
+
 struct _ETCArray
 {
-    void ** array;
-    unsigned int elements;
-    unsigned int space;
+    struct _ETCDeque deque;
 };
 
-//TODO: Optimise this so deleting the first element doesn't require the whole array to be shuffled.
+struct _ETCValueArray
+{
+    struct _ETCDeque deque;
+};
 
-ETCArray ETCArrayNew(void)
+static inline char *ETCDequeSlot(struct _ETCDeque *d, size_t elementSize, size_t anIndex)
 {
-    return ETCArrayNewWithInitialSize(8);
+    return d->storage + ((d->head + anIndex) & (d->capacity - 1)) * elementSize;
 }
 
-ETCArray ETCArrayNewWithInitialSize(unsigned int initialSize)
+static size_t ETCDequeCapacityForSize(size_t size)
 {
-    ETCArray newArray = malloc(sizeof(struct _ETCArray));
-    newArray->elements = 0;
-    newArray->space = initialSize;
-    newArray->array = malloc(initialSize * sizeof(void*));
-    return newArray;
+    size_t capacity = MIN_CAPACITY;
+
+    while (capacity < size)
+    {
+        if (capacity > ((size_t)-1) / 2)
+        {
+            return 0;
+        }
+        capacity *= 2;
+    }
+    return capacity;
+}
+
+static int ETCDequeInit(struct _ETCDeque *d, size_t elementSize, size_t initialSize)
+{
+    size_t capacity = ETCDequeCapacityForSize(initialSize);
+
+    if (capacity == 0 || capacity > ((size_t)-1) / elementSize)
+    {
+        return -1;
+    }
+    d->storage = malloc(capacity * elementSize);
+    if (d->storage == NULL)
+    {
+        return -1;
+    }
+    d->elementSize = elementSize;
+    d->head = 0;
+    d->count = 0;
+    d->capacity = capacity;
+    return 0;
 }
-int ETCArrayResize(ETCArray array, unsigned int newSize)
+
+/**
+ * Copies length elements starting at location into buffer, in at most two
+ * chunks since the range can wrap around the end of the storage.
+ */
+static inline void ETCDequeCopyOut(struct _ETCDeque *d, size_t elementSize,
+                                   size_t location, size_t length, void *buffer)
 {
-    void ** resizedArray = realloc(array->array,newSize* sizeof(void*));
-    if(resizedArray != NULL)
+    size_t start = (d->head + location) & (d->capacity - 1);
+    size_t firstLength = d->capacity - start;
+
+    if (firstLength > length)
+    {
+        firstLength = length;
+    }
+    memcpy(buffer, d->storage + start * elementSize, firstLength * elementSize);
+    memcpy((char *)buffer + firstLength * elementSize, d->storage,
+        (length - firstLength) * elementSize);
+}
+
+/**
+ * Copies length elements from buffer into the slots starting at location.
+ */
+static inline void ETCDequeCopyIn(struct _ETCDeque *d, size_t elementSize,
+                                  size_t location, size_t length, const void *buffer)
+{
+    size_t start = (d->head + location) & (d->capacity - 1);
+    size_t firstLength = d->capacity - start;
+
+    if (firstLength > length)
+    {
+        firstLength = length;
+    }
+    memcpy(d->storage + start * elementSize, buffer, firstLength * elementSize);
+    memcpy(d->storage, (const char *)buffer + firstLength * elementSize,
+        (length - firstLength) * elementSize);
+}
+
+static int ETCDequeSetCapacity(struct _ETCDeque *d, size_t capacity)
+{
+    char *storage;
+
+    if (capacity > ((size_t)-1) / d->elementSize)
+    {
+        return -1;
+    }
+    storage = malloc(capacity * d->elementSize);
+    if (storage == NULL)
+    {
+        return -1;
+    }
+    ETCDequeCopyOut(d, d->elementSize, 0, d->count, storage);
+    free(d->storage);
+    d->storage = storage;
+    d->head = 0;
+    d->capacity = capacity;
+    return 0;
+}
+
+static inline int ETCDequeReserve(struct _ETCDeque *d, size_t capacity)
+{
+    size_t newCapacity;
+
+    if (capacity <= d->capacity)
     {
-        array->space = newSize;
-        array->array = resizedArray;
         return 0;
     }
-    return -1;
+    newCapacity = ETCDequeCapacityForSize(capacity);
+    return (newCapacity == 0 ? -1 : ETCDequeSetCapacity(d, newCapacity));
 }
 
-int ETCArrayAdd(ETCArray array, void* object)
+static inline int ETCDequeReserveAdditional(struct _ETCDeque *d, size_t count)
 {
-    if((array->elements + 1) >= array->space)
+    if (count > ((size_t)-1) - d->count)
     {
-        if(ETCArrayResize(array, array->space * 4))
+        return -1;
+    }
+    return ETCDequeReserve(d, d->count + count);
+}
+
+static int ETCDequeShrink(struct _ETCDeque *d)
+{
+    size_t capacity = ETCDequeCapacityForSize(d->count);
+
+    return (capacity < d->capacity ? ETCDequeSetCapacity(d, capacity) : 0);
+}
+
+/**
+ * Moves length elements from logical index source to destination.  Each
+ * range spans at most two contiguous runs of slots, so the elements are moved
+ * with at most three memmove() calls, over chunks that are contiguous in both
+ * ranges, in an order that doesn't overwrite elements still to be moved.
+ */
+static inline void ETCDequeMove(struct _ETCDeque *d, size_t elementSize,
+                                size_t destination, size_t source, size_t length)
+{
+    size_t mask = d->capacity - 1;
+
+    if (destination < source)
+    {
+        for (size_t i = 0; i < length;)
         {
-            return -1;
+            size_t from = (d->head + source + i) & mask;
+            size_t to = (d->head + destination + i) & mask;
+            size_t chunk = length - i;
+
+            if (chunk > d->capacity - from)
+            {
+                chunk = d->capacity - from;
+            }
+            if (chunk > d->capacity - to)
+            {
+                chunk = d->capacity - to;
+            }
+            memmove(d->storage + to * elementSize, d->storage + from * elementSize,
+                chunk * elementSize);
+            i += chunk;
         }
     }
-    array->array[array->elements] = object;
-    array->elements++;
+    else
+    {
+        for (size_t i = length; i > 0;)
+        {
+            /* Slots of the last elements still to be moved */
+            size_t from = (d->head + source + i - 1) & mask;
+            size_t to = (d->head + destination + i - 1) & mask;
+            size_t chunk = i;
+
+            if (chunk > from + 1)
+            {
+                chunk = from + 1;
+            }
+            if (chunk > to + 1)
+            {
+                chunk = to + 1;
+            }
+            i -= chunk;
+            memmove(d->storage + (to + 1 - chunk) * elementSize,
+                d->storage + (from + 1 - chunk) * elementSize, chunk * elementSize);
+        }
+    }
+}
+
+/**
+ * Opens room for length elements at anIndex, moving the elements on the
+ * shorter side of anIndex.  The capacity must have been reserved.
+ */
+static inline void ETCDequeOpenGap(struct _ETCDeque *d, size_t elementSize,
+                                   size_t anIndex, size_t length)
+{
+    if (anIndex < d->count - anIndex)
+    {
+        d->head = (d->head - length) & (d->capacity - 1);
+        ETCDequeMove(d, elementSize, 0, length, anIndex);
+    }
+    else
+    {
+        ETCDequeMove(d, elementSize, anIndex + length, anIndex, d->count - anIndex);
+    }
+    d->count += length;
+}
+
+/**
+ * Removes length elements at anIndex, moving the elements on the shorter side
+ * of the range.
+ */
+static inline void ETCDequeCloseGap(struct _ETCDeque *d, size_t elementSize,
+                                    size_t anIndex, size_t length)
+{
+    if (anIndex < d->count - anIndex - length)
+    {
+        ETCDequeMove(d, elementSize, length, 0, anIndex);
+        d->head = (d->head + length) & (d->capacity - 1);
+    }
+    else
+    {
+        ETCDequeMove(d, elementSize, anIndex, anIndex + length,
+            d->count - anIndex - length);
+    }
+    d->count -= length;
+}
+
+static inline int ETCDequeIsValidRange(struct _ETCDeque *d, size_t location, size_t length)
+{
+    return (location <= d->count && length <= d->count - location);
+}
+
+static inline int ETCDequeInsert(struct _ETCDeque *d, size_t elementSize,
+                                 const void *elements, size_t count, size_t anIndex)
+{
+    if (anIndex > d->count)
+    {
+        return -2;
+    }
+    if (ETCDequeReserveAdditional(d, count))
+    {
+        return -1;
+    }
+    ETCDequeOpenGap(d, elementSize, anIndex, count);
+    ETCDequeCopyIn(d, elementSize, anIndex, count, elements);
     return 0;
 }
 
-int ETCArrayAddAtIndex(ETCArray array, void* object, unsigned int anIndex)
+static inline int ETCDequeRemove(struct _ETCDeque *d, size_t elementSize,
+                                 size_t location, size_t length)
 {
-    if(anIndex > (array->elements+1))
+    if (!ETCDequeIsValidRange(d, location, length))
     {
         return -2;
     }
-    if((array->elements+1) >= array->space)
+    ETCDequeCloseGap(d, elementSize, location, length);
+    return 0;
+}
+
+/* Pointer Arrays */
+
+#define POINTER_SIZE sizeof(void*)
+
+static inline void **ETCArraySlot(ETCArray array, size_t anIndex)
+{
+    return (void **)ETCDequeSlot(&array->deque, POINTER_SIZE, anIndex);
+}
+
+ETCArray ETCArrayNew(void)
+{
+    return ETCArrayNewWithInitialSize(MIN_CAPACITY);
+}
+
+ETCArray ETCArrayNewWithInitialSize(size_t initialSize)
+{
+    ETCArray newArray = malloc(sizeof(struct _ETCArray));
+
+    if (newArray == NULL)
+    {
+        return NULL;
+    }
+    if (ETCDequeInit(&newArray->deque, POINTER_SIZE, initialSize))
     {
-        if(ETCArrayResize(array, array->space * 2))
-        {
-            return -1;
-        }
+        free(newArray);
+        return NULL;
     }
-    if(anIndex < array->elements)
+    return newArray;
+}
+
+int ETCArrayAdd(ETCArray array, void* object)
+{
+    struct _ETCDeque *d = &array->deque;
+
+    if (d->count == d->capacity && ETCDequeSetCapacity(d, d->capacity * 2))
     {
-        size_t bytes = (array->elements - anIndex) * sizeof(void*);
-        memmove(&array->array[anIndex+1],&array->array[anIndex],bytes);
+        return -1;
     }
-    array->array[anIndex] = object;
-    array->elements++;
-    return 0;   
+    *ETCArraySlot(array, d->count) = object;
+    d->count++;
+    return 0;
+}
+
+int ETCArrayAddFirst(ETCArray array, void* object)
+{
+    struct _ETCDeque *d = &array->deque;
+
+    if (d->count == d->capacity && ETCDequeSetCapacity(d, d->capacity * 2))
+    {
+        return -1;
+    }
+    d->head = (d->head - 1) & (d->capacity - 1);
+    d->count++;
+    *ETCArraySlot(array, 0) = object;
+    return 0;
+}
+
+int ETCArrayAddAtIndex(ETCArray array, void* object, size_t anIndex)
+{
+    return ETCDequeInsert(&array->deque, POINTER_SIZE, &object, 1, anIndex);
+}
+
+int ETCArrayAddObjects(ETCArray array, void** objects, size_t count)
+{
+    return ETCDequeInsert(&array->deque, POINTER_SIZE, objects, count,
+        array->deque.count);
+}
+
+int ETCArrayInsertObjectsAtIndex(ETCArray array, void** objects, size_t count,
+                                 size_t anIndex)
+{
+    return ETCDequeInsert(&array->deque, POINTER_SIZE, objects, count, anIndex);
 }
 
 int ETCArrayAppendArray(ETCArray array, ETCArray otherArray)
 {
-    if(array->space < array->elements + otherArray->elements)
+    struct _ETCDeque *d = &array->deque;
+    struct _ETCDeque *other = &otherArray->deque;
+    size_t otherCount = other->count;
+
+    if (ETCDequeReserveAdditional(d, otherCount))
     {
-        if(ETCArrayResize(array,array->elements + otherArray->elements))
+        return -1;
+    }
+    /* The other array is copied chunk by chunk, which also handles appending
+       an array to itself since its count is read beforehand. */
+    for (size_t copied = 0; copied < otherCount; )
+    {
+        size_t start = (other->head + copied) & (other->capacity - 1);
+        size_t length = other->capacity - start;
+
+        if (length > otherCount - copied)
         {
-            return -1;
+            length = otherCount - copied;
         }
+        ETCDequeCopyIn(d, POINTER_SIZE, d->count, length,
+            other->storage + start * POINTER_SIZE);
+        d->count += length;
+        copied += length;
     }
-    memcpy(&array->array[array->elements], otherArray->array, otherArray->elements);
-    array->elements += otherArray->elements;
     return 0;
 }
 
-void* ETCArrayObjectAtIndex(ETCArray array, unsigned int anIndex)
+void* ETCArrayObjectAtIndex(ETCArray array, size_t anIndex)
 {
-    if(array == NULL 
+    if(array == NULL
        ||
-       anIndex >= array->elements)
+       anIndex >= array->deque.count)
     {
         return NULL;
     }
-    return array->array[anIndex];
+    return *ETCArraySlot(array, anIndex);
 }
 
-int ETCArrayRemoveLastObject(ETCArray array)
+void* ETCArrayFirstObject(ETCArray array)
+{
+    return (array->deque.count > 0 ? *ETCArraySlot(array, 0) : NULL);
+}
+
+void* ETCArrayLastObject(ETCArray array)
 {
-    if(array->elements > 0)
+    size_t count = array->deque.count;
+
+    return (count > 0 ? *ETCArraySlot(array, count - 1) : NULL);
+}
+
+int ETCArrayGetObjectsInRange(ETCArray array, void** objects, size_t location,
+                              size_t length)
+{
+    if (!ETCDequeIsValidRange(&array->deque, location, length))
     {
-        array->elements--;
-        return 0;
+        return -2;
     }
-    return -1;
+    ETCDequeCopyOut(&array->deque, POINTER_SIZE, location, length, objects);
+    return 0;
 }
-int ETCArrayRemoveObjectAtIndex(ETCArray array, unsigned int anIndex)
+
+int ETCArrayRemoveFirstObject(ETCArray array)
 {
-    if(anIndex > array->elements)
+    struct _ETCDeque *d = &array->deque;
+
+    if(d->count > 0)
     {
-        return -1;
+        d->head = (d->head + 1) & (d->capacity - 1);
+        d->count--;
+        return 0;
     }
-    if(array->elements == 0)
+    return -1;
+}
+
+int ETCArrayRemoveLastObject(ETCArray array)
+{
+    if(array->deque.count > 0)
     {
-        return -2;
+        array->deque.count--;
+        return 0;
     }
-    if(anIndex < array->elements)
+    return -1;
+}
+
+int ETCArrayRemoveObjectAtIndex(ETCArray array, size_t anIndex)
+{
+    if(anIndex >= array->deque.count)
     {
-        size_t bytes = (array->elements - (anIndex + 1)) * sizeof(void*);
-        memmove(&array->array[anIndex],&array->array[anIndex + 1],bytes);
+        return -1;
     }
-    array->elements--;
+    ETCDequeCloseGap(&array->deque, POINTER_SIZE, anIndex, 1);
     return 0;
 }
 
-int ETCArrayIndexOfObjectIdenticalTo(ETCArray array, void* object)
+int ETCArrayRemoveObjectsInRange(ETCArray array, size_t location, size_t length)
 {
-    for(int i=0 ; i<(int)array->elements ; i++)
+    return ETCDequeRemove(&array->deque, POINTER_SIZE, location, length);
+}
+
+size_t ETCArrayIndexOfObjectIdenticalTo(ETCArray array, void* object)
+{
+    for(size_t i=0 ; i<array->deque.count ; i++)
     {
-        if(object == array->array[i])
+        if(object == *ETCArraySlot(array, i))
         {
             return i;
         }
     }
-    return -1;
+    return ETCArrayNotFound;
 }
 
 int ETCArrayRemoveAllObjects(ETCArray array, int freeObjects)
 {
     if(freeObjects)
     {
-        for(unsigned int i=0 ; i<array->elements ; i++)
+        for(size_t i=0 ; i<array->deque.count ; i++)
         {
-            free(array->array[i]);
+            free(*ETCArraySlot(array, i));
         }
     }
-    array->elements = 0;
+    array->deque.head = 0;
+    array->deque.count = 0;
     return 0;
 }
 
-int ETCArraySwap(ETCArray array, unsigned int index1, unsigned int index2)
+int ETCArraySwap(ETCArray array, size_t index1, size_t index2)
 {
     if(array == NULL)
     {
         return -1;
     }
-    if(index1 >= array->elements
+    if(index1 >= array->deque.count
        ||
-       index2 >= array->elements)
+       index2 >= array->deque.count)
     {
         return -2;
     }
-    void * a = array->array[index1];
-    array->array[index1] = array->array[index2];
-    array->array[index2] = a;
+    void **slot1 = ETCArraySlot(array, index1);
+    void **slot2 = ETCArraySlot(array, index2);
+    void * a = *slot1;
+    *slot1 = *slot2;
+    *slot2 = a;
     return 0;
 }
 
-unsigned int ETCArrayCount(ETCArray array)
+size_t ETCArrayCount(ETCArray array)
 {
     if(array == NULL)
     {
         return 0;
     }
-    return array->elements;
+    return array->deque.count;
+}
+
+size_t ETCArrayCapacity(ETCArray array)
+{
+    return array->deque.capacity;
+}
+
+int ETCArrayReserve(ETCArray array, size_t capacity)
+{
+    return ETCDequeReserve(&array->deque, capacity);
+}
+
+int ETCArrayShrink(ETCArray array)
+{
+    return ETCDequeShrink(&array->deque);
 }
+
 void ETCArrayFree(ETCArray array)
 {
-    free(array->array);
+    free(array->deque.storage);
+    free(array);
+}
+
+/* Value Arrays */
+
+ETCValueArray ETCValueArrayNew(size_t elementSize)
+{
+    return ETCValueArrayNewWithInitialSize(elementSize, MIN_CAPACITY);
+}
+
+ETCValueArray ETCValueArrayNewWithInitialSize(size_t elementSize, size_t initialSize)
+{
+    ETCValueArray newArray;
+
+    if (elementSize == 0)
+    {
+        return NULL;
+    }
+    newArray = malloc(sizeof(struct _ETCValueArray));
+    if (newArray == NULL)
+    {
+        return NULL;
+    }
+    if (ETCDequeInit(&newArray->deque, elementSize, initialSize))
+    {
+        free(newArray);
+        return NULL;
+    }
+    return newArray;
+}
+
+int ETCValueArrayAdd(ETCValueArray array, const void* element)
+{
+    struct _ETCDeque *d = &array->deque;
+
+    if (d->count == d->capacity && ETCDequeSetCapacity(d, d->capacity * 2))
+    {
+        return -1;
+    }
+    memcpy(ETCDequeSlot(d, d->elementSize, d->count), element, d->elementSize);
+    d->count++;
+    return 0;
+}
+
+int ETCValueArrayAddFirst(ETCValueArray array, const void* element)
+{
+    struct _ETCDeque *d = &array->deque;
+
+    if (d->count == d->capacity && ETCDequeSetCapacity(d, d->capacity * 2))
+    {
+        return -1;
+    }
+    d->head = (d->head - 1) & (d->capacity - 1);
+    d->count++;
+    memcpy(ETCDequeSlot(d, d->elementSize, 0), element, d->elementSize);
+    return 0;
+}
+
+int ETCValueArrayAddElements(ETCValueArray array, const void* elements, size_t count)
+{
+    struct _ETCDeque *d = &array->deque;
+
+    return ETCDequeInsert(d, d->elementSize, elements, count, d->count);
+}
+
+int ETCValueArrayInsertElementsAtIndex(ETCValueArray array, const void* elements,
+                                       size_t count, size_t anIndex)
+{
+    struct _ETCDeque *d = &array->deque;
+
+    return ETCDequeInsert(d, d->elementSize, elements, count, anIndex);
+}
+
+void* ETCValueArrayElementAtIndex(ETCValueArray array, size_t anIndex)
+{
+    struct _ETCDeque *d = &array->deque;
+
+    if (anIndex >= d->count)
+    {
+        return NULL;
+    }
+    return ETCDequeSlot(d, d->elementSize, anIndex);
+}
+
+int ETCValueArrayGetElementsInRange(ETCValueArray array, void* elements,
+                                    size_t location, size_t length)
+{
+    struct _ETCDeque *d = &array->deque;
+
+    if (!ETCDequeIsValidRange(d, location, length))
+    {
+        return -2;
+    }
+    ETCDequeCopyOut(d, d->elementSize, location, length, elements);
+    return 0;
+}
+
+int ETCValueArrayRemoveFirstElement(ETCValueArray array, void* element)
+{
+    struct _ETCDeque *d = &array->deque;
+
+    if (d->count == 0)
+    {
+        return -1;
+    }
+    if (element != NULL)
+    {
+        memcpy(element, ETCDequeSlot(d, d->elementSize, 0), d->elementSize);
+    }
+    d->head = (d->head + 1) & (d->capacity - 1);
+    d->count--;
+    return 0;
+}
+
+int ETCValueArrayRemoveLastElement(ETCValueArray array, void* element)
+{
+    struct _ETCDeque *d = &array->deque;
+
+    if (d->count == 0)
+    {
+        return -1;
+    }
+    d->count--;
+    if (element != NULL)
+    {
+        memcpy(element, ETCDequeSlot(d, d->elementSize, d->count), d->elementSize);
+    }
+    return 0;
+}
+
+int ETCValueArrayRemoveElementsInRange(ETCValueArray array, size_t location,
+                                       size_t length)
+{
+    struct _ETCDeque *d = &array->deque;
+
+    return ETCDequeRemove(d, d->elementSize, location, length);
+}
+
+void ETCValueArrayRemoveAllElements(ETCValueArray array)
+{
+    array->deque.head = 0;
+    array->deque.count = 0;
+}
+
+size_t ETCValueArrayCount(ETCValueArray array)
+{
+    return array->deque.count;
+}
+
+size_t ETCValueArrayElementSize(ETCValueArray array)
+{
+    return array->deque.elementSize;
+}
+
+size_t ETCValueArrayCapacity(ETCValueArray array)
+{
+    return array->deque.capacity;
+}
+
+int ETCValueArrayReserve(ETCValueArray array, size_t capacity)
+{
+    return ETCDequeReserve(&array->deque, capacity);
+}
+
+int ETCValueArrayShrink(ETCValueArray array)
+{
+    return ETCDequeShrink(&array->deque);
+}
+
+void ETCValueArrayFree(ETCValueArray array)
+{
+    free(array->deque.storage);
     free(array);
 }
@@ -0,0 +1,404 @@
+/*
+    Copyright (C) 2026 The Etoile Project
+
+    Date:  October 2026
+    License:  Modified BSD (see COPYING)
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ETCIdentityMap.h"
+
+/** Smallest number of slots allocated for a table. */
+#define MIN_CAPACITY 8
+/** Index returned when a key is not found. */
+#define NOT_FOUND ((size_t)-1)
+
+/**
+ * The slots are split into three parallel arrays, so that probing touches the
+ * distances and keys only.  The distance of a slot is the number of slots
+ * between the entry and its home slot plus one, or 0 when the slot is empty.
+ *
+ * Robin Hood hashing keeps the distances low by letting an inserted entry take
+ * the slot of any entry closer to its home slot, which then moves on.  A
+ * lookup can thus stop at the first slot whose distance is smaller than its
+ * own probe distance.  Removals shift the following entries back instead of
+ * leaving tombstones.
+ */
+struct _ETCIdentityMap
+{
+    const void **keys;
+    /** NULL for sets. */
+    void **values;
+    uint32_t *distances;
+    /** Number of slots, always a power of two. */
+    size_t capacity;
+    size_t count;
+    /** Count above which the table grows, i.e. a load factor of 7/8. */
+    size_t growThreshold;
+    ETCIdentityMapValueCallBacks callBacks;
+};
+
+struct _ETCIdentitySet
+{
+    struct _ETCIdentityMap map;
+};
+
+static inline size_t ETCIdentityHash(const void *key)
+{
+    /* Pointers are aligned and often allocated close to each other, so their
+       bits are mixed with the 64-bit MurmurHash3 finalizer. */
+    uint64_t hash = (uintptr_t)key;
+
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    return (size_t)hash;
+}
+
+static size_t ETCIdentityMapCapacityForSize(size_t size)
+{
+    size_t capacity = MIN_CAPACITY;
+
+    while (capacity - capacity / 8 < size)
+    {
+        capacity *= 2;
+    }
+    return capacity;
+}
+
+static int ETCIdentityMapAllocateSlots(ETCIdentityMap map, size_t capacity, int hasValues)
+{
+    const void **keys = malloc(capacity * sizeof(void*));
+    void **values = (hasValues ? malloc(capacity * sizeof(void*)) : NULL);
+    uint32_t *distances = calloc(capacity, sizeof(uint32_t));
+
+    if (keys == NULL || distances == NULL || (hasValues && values == NULL))
+    {
+        free(keys);
+        free(values);
+        free(distances);
+        return -1;
+    }
+    map->keys = keys;
+    map->values = values;
+    map->distances = distances;
+    map->capacity = capacity;
+    map->growThreshold = capacity - capacity / 8;
+    return 0;
+}
+
+static ETCIdentityMap ETCIdentityMapCreate(size_t structSize, size_t initialSize,
+                                           int hasValues,
+                                           const ETCIdentityMapValueCallBacks *callBacks)
+{
+    ETCIdentityMap map = calloc(1, structSize);
+
+    if (map == NULL)
+    {
+        return NULL;
+    }
+    if (ETCIdentityMapAllocateSlots(map, ETCIdentityMapCapacityForSize(initialSize), hasValues))
+    {
+        free(map);
+        return NULL;
+    }
+    if (callBacks != NULL)
+    {
+        map->callBacks = *callBacks;
+    }
+    return map;
+}
+
+/**
+ * Puts an entry whose key is not in the table into it, assuming there is a
+ * free slot.
+ */
+static void ETCIdentityMapInsertEntry(ETCIdentityMap map, const void *key, void *value)
+{
+    size_t mask = map->capacity - 1;
+    size_t index = ETCIdentityHash(key) & mask;
+    uint32_t distance = 1;
+
+    while (map->distances[index] != 0)
+    {
+        if (map->distances[index] < distance)
+        {
+            /* Take the slot from the entry closer to its home slot, and go on
+               inserting that entry instead */
+            const void *displacedKey = map->keys[index];
+            uint32_t displacedDistance = map->distances[index];
+
+            map->keys[index] = key;
+            map->distances[index] = distance;
+            key = displacedKey;
+            distance = displacedDistance;
+            if (map->values != NULL)
+            {
+                void *displacedValue = map->values[index];
+
+                map->values[index] = value;
+                value = displacedValue;
+            }
+        }
+        index = (index + 1) & mask;
+        distance++;
+    }
+    map->keys[index] = key;
+    map->distances[index] = distance;
+    if (map->values != NULL)
+    {
+        map->values[index] = value;
+    }
+    map->count++;
+}
+
+static size_t ETCIdentityMapIndexOfKey(ETCIdentityMap map, const void *key)
+{
+    size_t mask = map->capacity - 1;
+    size_t index = ETCIdentityHash(key) & mask;
+    uint32_t distance = 1;
+
+    while (map->distances[index] >= distance)
+    {
+        if (map->keys[index] == key)
+        {
+            return index;
+        }
+        index = (index + 1) & mask;
+        distance++;
+    }
+    return NOT_FOUND;
+}
+
+static int ETCIdentityMapGrow(ETCIdentityMap map)
+{
+    const void **oldKeys = map->keys;
+    void **oldValues = map->values;
+    uint32_t *oldDistances = map->distances;
+    size_t oldCapacity = map->capacity;
+
+    if (ETCIdentityMapAllocateSlots(map, oldCapacity * 2, oldValues != NULL))
+    {
+        return -1;
+    }
+    map->count = 0;
+    for (size_t i = 0; i < oldCapacity; i++)
+    {
+        if (oldDistances[i] != 0)
+        {
+            ETCIdentityMapInsertEntry(map, oldKeys[i],
+                (oldValues != NULL ? oldValues[i] : NULL));
+        }
+    }
+    free(oldKeys);
+    free(oldValues);
+    free(oldDistances);
+    return 0;
+}
+
+static int ETCIdentityMapRemoveIndex(ETCIdentityMap map, size_t index)
+{
+    size_t mask = map->capacity - 1;
+    size_t next = (index + 1) & mask;
+
+    if (map->values != NULL && map->callBacks.release != NULL)
+    {
+        map->callBacks.release(map->values[index]);
+    }
+    /* Shift back the following entries which are not in their home slot */
+    while (map->distances[next] > 1)
+    {
+        map->keys[index] = map->keys[next];
+        map->distances[index] = map->distances[next] - 1;
+        if (map->values != NULL)
+        {
+            map->values[index] = map->values[next];
+        }
+        index = next;
+        next = (next + 1) & mask;
+    }
+    map->keys[index] = NULL;
+    map->distances[index] = 0;
+    map->count--;
+    return 0;
+}
+
+ETCIdentityMap ETCIdentityMapNew(void)
+{
+    return ETCIdentityMapNewWithCallBacks(0, NULL);
+}
+
+ETCIdentityMap ETCIdentityMapNewWithInitialSize(size_t initialSize)
+{
+    return ETCIdentityMapNewWithCallBacks(initialSize, NULL);
+}
+
+ETCIdentityMap ETCIdentityMapNewWithCallBacks(size_t initialSize,
+                                              const ETCIdentityMapValueCallBacks *callBacks)
+{
+    return ETCIdentityMapCreate(sizeof(struct _ETCIdentityMap), initialSize, 1, callBacks);
+}
+
+void *ETCIdentityMapGet(ETCIdentityMap map, const void *key)
+{
+    size_t index = ETCIdentityMapIndexOfKey(map, key);
+
+    return (index != NOT_FOUND ? map->values[index] : NULL);
+}
+
+int ETCIdentityMapContainsKey(ETCIdentityMap map, const void *key)
+{
+    return (ETCIdentityMapIndexOfKey(map, key) != NOT_FOUND);
+}
+
+int ETCIdentityMapSet(ETCIdentityMap map, const void *key, void *value)
+{
+    size_t index = ETCIdentityMapIndexOfKey(map, key);
+
+    if (map->callBacks.retain != NULL)
+    {
+        value = map->callBacks.retain(value);
+    }
+    if (index != NOT_FOUND)
+    {
+        if (map->callBacks.release != NULL)
+        {
+            map->callBacks.release(map->values[index]);
+        }
+        map->values[index] = value;
+        return 0;
+    }
+    if (map->count >= map->growThreshold && ETCIdentityMapGrow(map))
+    {
+        if (map->callBacks.release != NULL)
+        {
+            map->callBacks.release(value);
+        }
+        return -1;
+    }
+    ETCIdentityMapInsertEntry(map, key, value);
+    return 0;
+}
+
+int ETCIdentityMapRemove(ETCIdentityMap map, const void *key)
+{
+    size_t index = ETCIdentityMapIndexOfKey(map, key);
+
+    if (index == NOT_FOUND)
+    {
+        return -1;
+    }
+    return ETCIdentityMapRemoveIndex(map, index);
+}
+
+void ETCIdentityMapRemoveAll(ETCIdentityMap map)
+{
+    if (map->values != NULL && map->callBacks.release != NULL)
+    {
+        for (size_t i = 0; i < map->capacity; i++)
+        {
+            if (map->distances[i] != 0)
+            {
+                map->callBacks.release(map->values[i]);
+            }
+        }
+    }
+    memset(map->distances, 0, map->capacity * sizeof(uint32_t));
+    map->count = 0;
+}
+
+size_t ETCIdentityMapCount(ETCIdentityMap map)
+{
+    return map->count;
+}
+
+int ETCIdentityMapNextEntry(ETCIdentityMap map, size_t *cursor,
+                            const void **key, void **value)
+{
+    while (*cursor < map->capacity)
+    {
+        size_t index = (*cursor)++;
+
+        if (map->distances[index] != 0)
+        {
+            if (key != NULL)
+            {
+                *key = map->keys[index];
+            }
+            if (value != NULL)
+            {
+                *value = (map->values != NULL ? map->values[index] : NULL);
+            }
+            return 1;
+        }
+    }
+    return 0;
+}
+
+void ETCIdentityMapFree(ETCIdentityMap map)
+{
+    ETCIdentityMapRemoveAll(map);
+    free(map->keys);
+    free(map->values);
+    free(map->distances);
+    free(map);
+}
+
+ETCIdentitySet ETCIdentitySetNew(void)
+{
+    return ETCIdentitySetNewWithInitialSize(0);
+}
+
+ETCIdentitySet ETCIdentitySetNewWithInitialSize(size_t initialSize)
+{
+    return (ETCIdentitySet)ETCIdentityMapCreate(sizeof(struct _ETCIdentitySet),
+        initialSize, 0, NULL);
+}
+
+int ETCIdentitySetAdd(ETCIdentitySet set, const void *member)
+{
+    ETCIdentityMap map = &set->map;
+
+    if (ETCIdentityMapIndexOfKey(map, member) != NOT_FOUND)
+    {
+        return 0;
+    }
+    if (map->count >= map->growThreshold && ETCIdentityMapGrow(map))
+    {
+        return -1;
+    }
+    ETCIdentityMapInsertEntry(map, member, NULL);
+    return 0;
+}
+
+int ETCIdentitySetContains(ETCIdentitySet set, const void *member)
+{
+    return ETCIdentityMapContainsKey(&set->map, member);
+}
+
+int ETCIdentitySetRemove(ETCIdentitySet set, const void *member)
+{
+    return ETCIdentityMapRemove(&set->map, member);
+}
+
+void ETCIdentitySetRemoveAll(ETCIdentitySet set)
+{
+    ETCIdentityMapRemoveAll(&set->map);
+}
+
+size_t ETCIdentitySetCount(ETCIdentitySet set)
+{
+    return set->map.count;
+}
+
+int ETCIdentitySetNextMember(ETCIdentitySet set, size_t *cursor, const void **member)
+{
+    return ETCIdentityMapNextEntry(&set->map, cursor, member, NULL);
+}
+
+void ETCIdentitySetFree(ETCIdentitySet set)
+{
+    ETCIdentityMapFree(&set->map);
+}
@@ -13,14 +13,10 @@
 #import "Macros.h"
 #import "runtime.h"
 #import "EtoileCompatibility.h"
-
-// Define the maximum number of arguments a function can take. (C99 allows up to
-// 127 arguments.)
-#define MAX_ARGS 127
+#include <pthread.h>
 
 typedef id (*Value1Function)(id, SEL, id);
 typedef id (*Value2Function)(id, SEL, id, id);
-typedef id (*ObjectAtIndexFunction)(id, SEL, NSUInteger);
 typedef void (*MapPlaceObjectFunction)(id, SEL, id, id<ETCollectionMutation> *, id, NSUInteger, NSArray *, id);
 typedef void (*FilterPlaceObjectFunction)(id, SEL, id, NSUInteger, id<ETCollectionMutation> *, BOOL, id);
 
@@ -80,29 +76,25 @@ typedef void (*FilterPlaceObjectFunction)(id, SEL, id, NSUInteger, id<ETCollecti
 /*
  * The ETEachProxy wraps collection objects for the HOM code to iterate over
  * their elements if the proxy is passed as an argument.
+ *
+ * The HOM functions read the ivars directly when they expand the arguments of
+ * an invocation (see ETEachExpansion).
  */
 @interface ETEachProxy : NSProxy
 {
+    @public
     id<ETCollectionObject> collection;
     NSArray *contents;
-    NSUInteger counter;
-    NSUInteger maxElements;
-    ObjectAtIndexFunction objectAtIndex;
+    /* YES if the elements are paired by position with the other zipped
+       arguments, rather than combined with them. */
+    BOOL isZipped;
 }
-- (id)nextObjectFromContents;
 @end
 
 /* Structures */
 
-// Structure to wrap the char array that is used as a bitfield to mark
-// argument-slots that have ETEachProxies set.
-typedef struct
-{
-    char fields[16];
-} argField_t;
-
-// A structure to encapsulate the information the recursive mapping function
-// needs.
+// A structure to encapsulate the information the map function needs to place
+// the results of an expanded invocation.
 typedef struct
 {
     __unsafe_unretained id<ETCollection> source;
@@ -117,13 +109,11 @@ typedef struct
 } ETMapContext;
 
 @implementation ETEachProxy: NSProxy
-- (id)initWithOriginal: (id<ETCollectionObject>)aCollection
+- (id)initWithOriginal: (id<ETCollectionObject>)aCollection zipped: (BOOL)zipped
 {
     ASSIGN(collection,aCollection);
     contents = [[(NSObject*)collection collectionArray] retain];
-    counter = 0;
-    maxElements = [contents count];
-    objectAtIndex = (ObjectAtIndexFunction)[contents methodForSelector: @selector(objectAtIndex:)];
+    isZipped = zipped;
     return self;
 }
 
@@ -142,10 +132,6 @@ typedef struct
 
 - (BOOL)respondsToSelector: (SEL)aSelector
 {
-    if (sel_isEqual(@selector(nextObjectFromContents), aSelector))
-    {
-        return YES;
-    }
     return [collection respondsToSelector: aSelector];
 }
 
@@ -165,240 +151,625 @@ typedef struct
         [anInvocation invokeWithTarget: collection];
     }
 }
+@end
 
-- (id)nextObjectFromContents
+@implementation NSObject (ETEachHOM)
+- (id)each
 {
-    id object = nil;
-    if (counter < maxElements)
-    {
-        object = objectAtIndex(contents, @selector(objectAtIndex:), counter);
-        counter++;
-    }
-    else
+    if ([self conformsToProtocol: @protocol(ETCollection)])
     {
-        // Reset the counter for the next;
-        counter = 0;
+        return [[[ETEachProxy alloc] initWithOriginal: (id)self zipped: NO] autorelease];
     }
-    return object;
+    return self;
 }
-@end
 
-@implementation NSObject (ETEachHOM)
-- (id)each
+- (id)eachZipped
 {
     if ([self conformsToProtocol: @protocol(ETCollection)])
     {
-        return [[[ETEachProxy alloc] initWithOriginal: (id)self] autorelease];
+        return [[[ETEachProxy alloc] initWithOriginal: (id)self zipped: YES] autorelease];
     }
     return self;
 }
 @end
 
+/* Compiled Plans */
+
+/*
+ * A plan records how instances of a class respond to a selector, so that the
+ * HOM functions can call the method implementation directly instead of
+ * invoking an NSInvocation per element.
+ *
+ * Plans are kept in a hash table keyed by class, selector and the IMP the
+ * runtime currently resolves the selector to, so that a method added or
+ * replaced at runtime (e.g. by traits or prototypes) gets a new plan instead
+ * of the stale one, which is just no longer found. Entries are never removed,
+ * and are pushed atomically at the head of their bucket, so lookups need no
+ * lock. Two threads might build the same plan concurrently, in which case
+ * both entries are equivalent.
+ *
+ * Once the table holds PLAN_MAX_COUNT plans, new plans are no longer cached
+ * but autoreleased.
+ */
+typedef struct ETHOMPlan
+{
+    struct ETHOMPlan *next;
+    Class class;
+    SEL selector;
+    /* The IMP the plan was built for, possibly the forwarding one. */
+    IMP imp;
+    /* NULL when the class does not implement the selector itself. */
+    Method method;
+    /* nil when method is NULL. */
+    NSMethodSignature *signature;
+    /* Number of arguments, not counting self and _cmd. */
+    NSUInteger argumentCount;
+    /* YES if the method can be called through one of the IMP casts below. */
+    BOOL isCallable;
+    char returnKind;
+} ETHOMPlan;
+
+/* The maximum number of arguments a plan can call the IMP with. */
+#define PLAN_MAX_ARGS 2
+#define PLAN_BUCKET_COUNT 512
+#define PLAN_MAX_COUNT 4096
+
+static ETHOMPlan *planBuckets[PLAN_BUCKET_COUNT];
+static volatile NSUInteger planCount;
+/* Returned when a plan cannot be allocated, so elements take the invocation
+   path. */
+static ETHOMPlan unplanned;
+
 /*
- * Helper method to obtain a list of the argument slots in the invocation that
- * contain an ETEachProxy.
+ * Returns the type character of an encoding without its qualifiers, '@' for
+ * both id and Class, or 0 for a type a plan cannot pass or return.
  */
-static inline argField_t eachedArgumentsFromInvocation(NSInvocation *inv)
+static inline char ETHOMTypeKind(const char *type)
 {
-    NSMethodSignature *sig = [inv methodSignature];
-    NSUInteger argCount = [sig numberOfArguments];
-    /*
-     * We need a char[16] to hold 128bits, since C99 allows 127 arguments and
-     * initialize to zero:
-     */
-    argField_t argField;
-    memset(&(argField.fields[0]),'\0',16);
-    BOOL hasProxy = NO;
+    while (*type != '\0' && strchr("rnNoORV", *type) != NULL)
+    {
+        type++;
+    }
+    switch (*type)
+    {
+        case '@':
+        case '#':
+            return '@';
+        case 'v':
+            return 'v';
+        default:
+            return (*type == @encode(BOOL)[0]) ? *type : 0;
+    }
+}
+
+/*
+ * Fills argumentCount and returnKind from the signature, and returns whether
+ * all the arguments are objects and the return type is supported.
+ */
+static BOOL ETHOMSignatureIsCallable(NSMethodSignature *sig,
+                                     NSUInteger *argumentCount,
+                                     char *returnKind)
+{
+    NSUInteger argCount = [sig numberOfArguments] - 2;
 
-    /* No method arguments (only self and _cmd as invisible arguments) */
-    BOOL isUnaryInvocation = (argCount < 3);
+    *argumentCount = argCount;
+    *returnKind = ETHOMTypeKind([sig methodReturnType]);
 
-    if (isUnaryInvocation)
+    if (argCount > PLAN_MAX_ARGS || 0 == *returnKind)
     {
-        return argField;
+        return NO;
     }
+    for (NSUInteger i = 0; i < argCount; i++)
+    {
+        if ('@' != ETHOMTypeKind([sig getArgumentTypeAtIndex: i + 2]))
+        {
+            return NO;
+        }
+    }
+    return YES;
+}
+
+static ETHOMPlan *ETHOMPlanForClassAndSelector(Class aClass, SEL aSelector)
+{
+    uintptr_t hash = ((uintptr_t)aClass >> 4) ^ ((uintptr_t)sel_getName(aSelector) >> 3);
+    ETHOMPlan **bucket = &planBuckets[hash % PLAN_BUCKET_COUNT];
 
-    for (int i = 2; i < argCount; i++)
+    IMP imp = class_getMethodImplementation(aClass, aSelector);
+
+    for (ETHOMPlan *plan = *bucket; plan != NULL; plan = plan->next)
+    {
+        if (plan->class == aClass && plan->imp == imp
+         && sel_isEqual(plan->selector, aSelector))
+        {
+            return plan;
+        }
+    }
+
+    ETHOMPlan *plan = calloc(1, sizeof(ETHOMPlan));
+
+    if (NULL == plan)
+    {
+        return &unplanned;
+    }
+    plan->class = aClass;
+    plan->selector = aSelector;
+    plan->imp = imp;
+    plan->method = class_getInstanceMethod(aClass, aSelector);
+    /* Don't call a method whose IMP changed in the meantime */
+    if (plan->method != NULL && method_getImplementation(plan->method) == imp)
+    {
+        plan->signature = [[NSMethodSignature signatureWithObjCTypes:
+            method_getTypeEncoding(plan->method)] retain];
+        plan->isCallable = ETHOMSignatureIsCallable(plan->signature,
+            &plan->argumentCount, &plan->returnKind);
+    }
+    else
+    {
+        plan->method = NULL;
+    }
+
+    if (__sync_fetch_and_add(&planCount, 1) >= PLAN_MAX_COUNT)
+    {
+        __sync_fetch_and_sub(&planCount, 1);
+        /* Freed when the current autorelease pool is drained */
+        [plan->signature autorelease];
+        [NSData dataWithBytesNoCopy: plan length: sizeof(ETHOMPlan) freeWhenDone: YES];
+        return plan;
+    }
+
+    ETHOMPlan *head;
+    do
+    {
+        head = *bucket;
+        plan->next = head;
+    } while (!__sync_bool_compare_and_swap(bucket, head, plan));
+
+    return plan;
+}
+
+/*
+ * The call shape of an invocation, against which plans are checked. Elements
+ * whose class has no plan matching it take the invocation path.
+ */
+typedef struct
+{
+    NSUInteger argumentCount;
+    char returnKind;
+    BOOL isCallable;
+    id arguments[PLAN_MAX_ARGS];
+} ETHOMCall;
+
+static inline ETHOMCall ETHOMCallFromInvocation(NSInvocation *inv)
+{
+    ETHOMCall call;
+
+    call.isCallable = ETHOMSignatureIsCallable([inv methodSignature],
+        &call.argumentCount, &call.returnKind);
+    if (call.isCallable)
+    {
+        for (NSUInteger i = 0; i < call.argumentCount; i++)
+        {
+            [inv getArgument: &call.arguments[i] atIndex: i + 2];
+        }
+    }
+    return call;
+}
+
+/*
+ * Returns the IMP to call for elements of aClass, or NULL if they must take
+ * the invocation path.
+ */
+static inline IMP ETHOMImpForCall(ETHOMCall *call, Class aClass, SEL aSelector)
+{
+    if (NO == call->isCallable)
+    {
+        return NULL;
+    }
+    ETHOMPlan *plan = ETHOMPlanForClassAndSelector(aClass, aSelector);
+
+    if (NO == plan->isCallable
+     || plan->argumentCount != call->argumentCount
+     || plan->returnKind != call->returnKind)
+    {
+        return NULL;
+    }
+    return plan->imp;
+}
+
+/*
+ * Calls a method which returns an object or void, and returns nil in the
+ * latter case.
+ */
+static inline id ETHOMCallObjectIMP(IMP imp, id target, SEL selector, ETHOMCall *call)
+{
+    id *args = call->arguments;
+
+    if ('v' == call->returnKind)
+    {
+        switch (call->argumentCount)
+        {
+            case 0: ((void (*)(id, SEL))imp)(target, selector); break;
+            case 1: ((void (*)(id, SEL, id))imp)(target, selector, args[0]); break;
+            default: ((void (*)(id, SEL, id, id))imp)(target, selector, args[0], args[1]); break;
+        }
+        return nil;
+    }
+    switch (call->argumentCount)
+    {
+        case 0: return ((id (*)(id, SEL))imp)(target, selector);
+        case 1: return ((id (*)(id, SEL, id))imp)(target, selector, args[0]);
+        default: return ((id (*)(id, SEL, id, id))imp)(target, selector, args[0], args[1]);
+    }
+}
+
+static inline BOOL ETHOMCallPredicateIMP(IMP imp, id target, SEL selector, ETHOMCall *call)
+{
+    id *args = call->arguments;
+
+    switch (call->argumentCount)
+    {
+        case 0: return ((BOOL (*)(id, SEL))imp)(target, selector);
+        case 1: return ((BOOL (*)(id, SEL, id))imp)(target, selector, args[0]);
+        default: return ((BOOL (*)(id, SEL, id, id))imp)(target, selector, args[0], args[1]);
+    }
+}
+
+/*
+ * Returns the IMP of a -placeObject:... handler implemented by the collection
+ * class, or NULL.
+ */
+static inline IMP ETHOMHandlerForCollection(id aCollection, SEL handlerSelector)
+{
+    ETHOMPlan *plan =
+        ETHOMPlanForClassAndSelector(object_getClass(aCollection), handlerSelector);
+
+    return (NULL != plan->method ? plan->imp : NULL);
+}
+
+/* Each Expansion */
+
+/*
+ * An eached argument of an invocation, with a snapshot of the elements of the
+ * collection wrapped by its each proxy.
+ */
+typedef struct
+{
+    /* The argument index in the invocation. */
+    NSUInteger slot;
+    __unsafe_unretained ETEachProxy *proxy;
+    id *elements;
+    /* The dimension whose index selects the element. */
+    NSUInteger dimension;
+} ETEachArgument;
+
+/*
+ * An expansion enumerates the combinations of elements an invocation is sent
+ * with when some of its arguments are each proxies.
+ *
+ * It is created once per HOM operation, so the proxied collections are read
+ * once rather than for every element of the receiver. Each proxy gets a
+ * dimension of its own, except the zipped proxies which share a single
+ * dimension as long as the shortest of them. The combinations are enumerated
+ * with one index per dimension, the last dimension varying fastest.
+ */
+typedef struct
+{
+    NSUInteger argumentCount;
+    ETEachArgument *arguments;
+    NSUInteger dimensionCount;
+    NSUInteger *lengths;
+    NSUInteger *indexes;
+    /* The arguments to call the method IMP with, when plans can be used. */
+    ETHOMCall call;
+} ETEachExpansion;
+
+/*
+ * Returns an expansion for the each proxies among the invocation arguments,
+ * or NULL if there are none.
+ */
+static ETEachExpansion *ETEachExpansionCreate(NSInvocation *inv)
+{
+    NSMethodSignature *sig = [inv methodSignature];
+    NSUInteger argCount = [sig numberOfArguments];
+    Class proxyClass = [ETEachProxy class];
+    ETEachExpansion *expansion = NULL;
+    NSUInteger zippedDimension = NSNotFound;
+
+    for (NSUInteger i = 2; i < argCount; i++)
     {
         // Consider only object arguments:
-        const char *argType = [sig getArgumentTypeAtIndex: i];
-        if ((0 == strcmp(@encode(id), argType))
-          || (0 == strcmp(@encode(Class), argType)))
+        if ('@' != ETHOMTypeKind([sig getArgumentTypeAtIndex: i]))
         {
-            id arg;
-            [inv getArgument: &arg atIndex: i];
-            if ([arg respondsToSelector: @selector(nextObjectFromContents)])
-            {
-                // We need to skip to the next field of the char array every 8
-                // bits. The integer division/modulo operations calculate just
-                // the right offset for that.
-                int index = i / 8;
-                argField.fields[index] = (argField.fields[index] | (1 << (i % 8)));
-                hasProxy = YES;
-            }
+            continue;
+        }
+
+        id arg = nil;
+        [inv getArgument: &arg atIndex: i];
+        if (nil == arg || object_getClass(arg) != proxyClass)
+        {
+            continue;
+        }
+
+        if (NULL == expansion)
+        {
+            expansion = calloc(1, sizeof(ETEachExpansion));
+            expansion->arguments = calloc(argCount - 2, sizeof(ETEachArgument));
+            expansion->lengths = calloc(argCount - 2, sizeof(NSUInteger));
+            expansion->indexes = calloc(argCount - 2, sizeof(NSUInteger));
+        }
+
+        ETEachProxy *proxy = arg;
+        ETEachArgument *argument = &expansion->arguments[expansion->argumentCount++];
+        NSUInteger count = [proxy->contents count];
+
+        argument->slot = i;
+        argument->proxy = proxy;
+        argument->elements = malloc(MAX(count, 1) * sizeof(id));
+        [proxy->contents getObjects: argument->elements
+                              range: NSMakeRange(0, count)];
+
+        if (proxy->isZipped && zippedDimension != NSNotFound)
+        {
+            argument->dimension = zippedDimension;
+            expansion->lengths[zippedDimension] =
+                MIN(expansion->lengths[zippedDimension], count);
+            continue;
         }
+        argument->dimension = expansion->dimensionCount++;
+        expansion->lengths[argument->dimension] = count;
+        if (proxy->isZipped)
+        {
+            zippedDimension = argument->dimension;
+        }
+    }
+
+    if (expansion != NULL)
+    {
+        expansion->call = ETHOMCallFromInvocation(inv);
+    }
+    return expansion;
+}
+
+static void ETEachExpansionFree(ETEachExpansion *expansion)
+{
+    if (NULL == expansion)
+    {
+        return;
     }
+    for (NSUInteger i = 0; i < expansion->argumentCount; i++)
+    {
+        free(expansion->arguments[i].elements);
+    }
+    free(expansion->arguments);
+    free(expansion->lengths);
+    free(expansion->indexes);
+    free(expansion);
+}
 
-    if (hasProxy)
+/*
+ * Resets the indexes to the first combination, and returns NO if there is no
+ * combination because a proxied collection is empty.
+ */
+static inline BOOL ETEachExpansionStart(ETEachExpansion *expansion)
+{
+    for (NSUInteger i = 0; i < expansion->dimensionCount; i++)
     {
-        // Use the first bit as a marker to signify that the invocation has
-        // proxied-arguments.
-        argField.fields[0] = argField.fields[0] | 1;
+        if (0 == expansion->lengths[i])
+        {
+            return NO;
+        }
+        expansion->indexes[i] = 0;
     }
-    return argField;
+    return YES;
 }
 
 /*
- * Scan the argField to find the index of the next argument that has an
- * each-proxy set.
+ * Moves the indexes to the next combination, and returns NO once they have all
+ * been enumerated.
  */
-static inline NSUInteger nextSlotIDWithEachProxy(argField_t *slots, NSUInteger slotID)
+static inline BOOL ETEachExpansionAdvance(ETEachExpansion *expansion)
 {
-    while (!(slots->fields[(slotID / 8)] & (1 << (slotID % 8))) && (slotID < MAX_ARGS))
+    for (NSUInteger i = expansion->dimensionCount; i > 0; i--)
     {
-        slotID++;
+        if (++expansion->indexes[i - 1] < expansion->lengths[i - 1])
+        {
+            return YES;
+        }
+        expansion->indexes[i - 1] = 0;
     }
-    return slotID;
+    return NO;
 }
+
 /*
- * Recursive map function to fill the slots in an invocation
- * that are marked with an ETEachProxy and invoke it afterwards.
+ * Puts the elements of the current combination into the invocation, or into
+ * the call arguments when inv is nil.
  */
-static void recursiveMapWithInvocationAndContext(NSInvocation *inv, // the invocation, target and arguments < slotID set
-                                                 argField_t *slots, // a bitfield of the arguments that need to be replaced
-                                                 NSUInteger slotID, // the slotId for the present level of recursion
-                                                 ETMapContext *ctx) // the context
+static inline void ETEachExpansionSetArguments(ETEachExpansion *expansion,
+                                               NSInvocation *inv)
 {
-    // Scan the slots array for the next argument-slot that has a proxy.
-    slotID = nextSlotIDWithEachProxy(slots, slotID);
+    for (NSUInteger i = 0; i < expansion->argumentCount; i++)
+    {
+        ETEachArgument *argument = &expansion->arguments[i];
+        id element = argument->elements[expansion->indexes[argument->dimension]];
 
-    /*
-     * Also find the argument-slot after that. (Needed to determine whether we
-     * should fire the invocation.)
-     */
-    NSUInteger nextSlotID = nextSlotIDWithEachProxy(slots, (slotID + 1));
+        if (nil == inv)
+        {
+            expansion->call.arguments[argument->slot - 2] = element;
+        }
+        else
+        {
+            [inv setArgument: &element atIndex: argument->slot];
+        }
+    }
+}
 
+/*
+ * Puts the proxies back into the invocation, so that it can be expanded again
+ * and still looks like the message the HOM proxy received.
+ */
+static inline void ETEachExpansionRestoreProxies(ETEachExpansion *expansion,
+                                                 NSInvocation *inv)
+{
+    for (NSUInteger i = 0; i < expansion->argumentCount; i++)
+    {
+        ETEachArgument *argument = &expansion->arguments[i];
 
-    id eachProxy = nil;
-    if (slotID < MAX_ARGS)
+        [inv setArgument: &argument->proxy atIndex: argument->slot];
+    }
+}
+
+/*
+ * Sends the expanded invocation to anObject once per combination, through imp
+ * if it is not NULL, and places the results in the target.
+ */
+static void ETHOMMapElementWithExpansion(id anObject,
+                                         IMP imp,
+                                         NSInvocation *inv,
+                                         SEL selector,
+                                         BOOL hasObjectReturnType,
+                                         ETEachExpansion *expansion,
+                                         ETMapContext *ctx)
+{
+    if (NO == ETEachExpansionStart(expansion))
     {
-        [inv getArgument: &eachProxy atIndex: slotID];
+        return;
     }
-    id theObject;
-    int count = 0;
-    while (nil != (theObject = [eachProxy nextObjectFromContents]))
+    if (NULL == imp)
     {
-        // Set the present argument:
-        [inv setArgument: &theObject atIndex: slotID];
-        if (MAX_ARGS == nextSlotID)
+        [inv setTarget: anObject];
+    }
+
+    BOOL isFirstRun = YES;
+    do
+    {
+        id mapped = nil;
+
+        if (imp != NULL)
         {
-            // If there are no more arguments to be set, the invocation is
-            // properly set up, otherwise there are proxies left in the
-            // invocation that need to be replaced first.
-            id mapped = nil;
+            ETEachExpansionSetArguments(expansion, nil);
+            mapped = ETHOMCallObjectIMP(imp, anObject, selector, &expansion->call);
+        }
+        else
+        {
+            ETEachExpansionSetArguments(expansion, inv);
             [inv invoke];
-            [inv getReturnValue: &mapped];
-
-            if (nil == mapped)
+            if (hasObjectReturnType)
             {
-                mapped = ctx->theNull;
-            }
-            if (ctx->modifiesSelf)
-            {
-                [ctx->alreadyMapped addObject: mapped];
+                [inv getReturnValue: &mapped];
             }
+        }
 
-            // We only want to use the handler the first time we run for this
-            // target element. Otherwise it might overwrite the result from the
-            // previous run(s).
-            BOOL isFirstRun = (0 == count);
+        if (nil == mapped)
+        {
+            mapped = ctx->theNull;
+        }
+        if (ctx->modifiesSelf)
+        {
+            [ctx->alreadyMapped addObject: mapped];
+        }
 
-            if ((ctx->elementHandler != NULL) && isFirstRun)
-            {
-                // The elementHandler is an IMP for the -placeObject:... method
-                // of the collection class. Hence the first to arguments are
-                // receiver and selector.
-                ctx->elementHandler(ctx->source, ctx->handlerSelector, mapped,
-                                    &ctx->target, [inv target], ctx->objIndex,
-                                    ctx->alreadyMapped, ctx->mapInfo);
-            }
-            else
-            {
-                // Also check the count, cf. note above.
-                if (ctx->modifiesSelf && isFirstRun)
-                {
-                    [(NSMutableArray*)ctx->target replaceObjectAtIndex: ctx->objIndex
-                                                            withObject: mapped];
-                }
-                else
-                {
-                    [ctx->target addObject: mapped];
-                }
-            }
-            count++;
+        // We only want to use the handler the first time we run for this
+        // target element. Otherwise it might overwrite the result from the
+        // previous run(s).
+        if ((ctx->elementHandler != NULL) && isFirstRun)
+        {
+            // The elementHandler is an IMP for the -placeObject:... method
+            // of the collection class. Hence the first to arguments are
+            // receiver and selector.
+            ctx->elementHandler(ctx->source, ctx->handlerSelector, mapped,
+                                &ctx->target, anObject, ctx->objIndex,
+                                ctx->alreadyMapped, ctx->mapInfo);
+        }
+        else if (ctx->modifiesSelf && isFirstRun)
+        {
+            [(NSMutableArray*)ctx->target replaceObjectAtIndex: ctx->objIndex
+                                                    withObject: mapped];
         }
         else
         {
-            recursiveMapWithInvocationAndContext(inv, slots, nextSlotID, ctx);
+            [ctx->target addObject: mapped];
         }
+        isFirstRun = NO;
+    } while (ETEachExpansionAdvance(expansion));
 
+    if (NULL == imp)
+    {
+        ETEachExpansionRestoreProxies(expansion, inv);
     }
-    // Before we return, we must put the proxy back into the invocation so that
-    // it can be used again when the invocation is invoked again with a
-    // different combination of target and arguments.
-    [inv setArgument: &eachProxy atIndex: slotID];
 }
 
-
 /*
- * Recursively evaluating the predicate is easier because the handling of
- * adding/removing elements can be done in the caller.
+ * Evaluates the expanded predicate on anObject once per combination, through
+ * imp if it is not NULL.
  * NOTE: The results are ORed.
  */
-static BOOL recursiveFilterWithInvocation(NSInvocation *inv, // The invocation, target and arguments < slotID set
-                                          argField_t *slots, // A bitfield marking the argument-slots to be replaced
-                                          NSUInteger slotID) // The slotId for the present level of recursion
+static BOOL ETHOMFilterElementWithExpansion(id anObject,
+                                            IMP imp,
+                                            NSInvocation *inv,
+                                            SEL selector,
+                                            ETEachExpansion *expansion)
 {
-    // Scan the slots array for the next slot that has a proxy. 127 marks the
-    // end of the array.
-    slotID = nextSlotIDWithEachProxy(slots, slotID);
-
-    // Repeat to find the next slot (we need this to determine whether we should
-    // fire the invocation.)
-    NSUInteger nextSlotID = nextSlotIDWithEachProxy(slots, (slotID + 1));
-
-    id eachProxy = nil;
-    if (slotID < MAX_ARGS)
+    if (NO == ETEachExpansionStart(expansion))
+    {
+        return NO;
+    }
+    if (NULL == imp)
     {
-        [inv getArgument: &eachProxy atIndex: slotID];
+        [inv setTarget: anObject];
     }
+
     BOOL result = NO;
-    id theObject;
-    while (nil != (theObject = [eachProxy nextObjectFromContents]))
+    do
     {
-        // Set the present argument:
-        [inv setArgument: &theObject atIndex: slotID];
-        if (MAX_ARGS == nextSlotID)
+        long long filterResult = (long long)NO;
+
+        if (imp != NULL)
         {
-            // Now the invocation is set up properly. (127 is no "real" slot)
-            long long filterResult = (long long)NO;
-            [inv invoke];
-            [inv getReturnValue: &filterResult];
-            result = (result || (BOOL)filterResult);
-            // In theory, we could escape the loop once the we get a positive
-            // result, but the application might rely on the side-effects of the
-            // invocation.
+            ETEachExpansionSetArguments(expansion, nil);
+            filterResult = ETHOMCallPredicateIMP(imp, anObject, selector, &expansion->call);
         }
         else
         {
-            result = (result || recursiveFilterWithInvocation(inv, slots, nextSlotID));
+            ETEachExpansionSetArguments(expansion, inv);
+            [inv invoke];
+            [inv getReturnValue: &filterResult];
         }
+        // In theory, we could escape the loop once the we get a positive
+        // result, but the application might rely on the side-effects of the
+        // invocation.
+        result = (result || (BOOL)filterResult);
+    } while (ETEachExpansionAdvance(expansion));
 
+    if (NULL == imp)
+    {
+        ETEachExpansionRestoreProxies(expansion, inv);
     }
-    [inv setArgument: &eachProxy atIndex: slotID];
     return result;
 }
 
+/*
+ * Returns an object to fast enumerate the elements of a collection in the
+ * same way as -collectionArray, without copying them into an array when the
+ * collection can enumerate its elements itself. Dictionaries enumerate their
+ * keys and counted sets do not repeat their elements, so the former are
+ * enumerated through their values and the latter through their array.
+ */
+static inline id<NSFastEnumeration> ETHOMElementsOfCollection(id<ETCollectionObject> aCollection)
+{
+    if ([(NSObject *)aCollection isKindOfClass: [NSDictionary class]])
+    {
+        return [aCollection objectEnumerator];
+    }
+    if ([(NSObject *)aCollection isKindOfClass: [NSCountedSet class]]
+     || NO == ([(NSObject *)aCollection isKindOfClass: [NSArray class]]
+            || [(NSObject *)aCollection isKindOfClass: [NSSet class]]
+            || [(NSObject *)aCollection isKindOfClass: [NSIndexSet class]]))
+    {
+        return [(NSObject *)aCollection collectionArray];
+    }
+    return aCollection;
+}
+
 /*
  * The following functions will be used by both the ETCollectionHOM categories
  * and the corresponding proxies.
@@ -432,10 +803,9 @@ static inline void ETHOMMapCollectionWithBlockOrInvocationToTargetAsArray(
     SEL handlerSelector =
      @selector(placeObject:inCollection:insteadOfObject:atIndex:havingAlreadyMapped:info:);
     MapPlaceObjectFunction elementHandler = NULL;
-    if ([theCollection respondsToSelector:handlerSelector]
-      && (NO == isArrayTarget))
+    if (NO == isArrayTarget)
     {
-        elementHandler = (MapPlaceObjectFunction)[(NSObject *)theCollection methodForSelector: handlerSelector];
+        elementHandler = (MapPlaceObjectFunction)ETHOMHandlerForCollection(theCollection, handlerSelector);
     }
 
     SEL valueSelector = @selector(value:);
@@ -463,9 +833,23 @@ static inline void ETHOMMapCollectionWithBlockOrInvocationToTargetAsArray(
     unsigned int objectIndex = 0;
     NSNull *nullObject = [NSNull null];
     id mapInfo = nil;
-    NSArray *collectionArray = [(NSObject*)theCollection collectionArrayAndInfo: &mapInfo];
+    id<NSFastEnumeration> elements = nil;
     NSMutableArray *alreadyMapped = nil;
 
+    /*
+     * The collection is snapshotted when it is mapped in place, or when the
+     * placement needs the original state (e.g. the keys of a dictionary).
+     * Otherwise the elements are enumerated directly.
+     */
+    if (modifiesSelf || [theCollection isKeyed])
+    {
+        elements = [(NSObject*)theCollection collectionArrayAndInfo: &mapInfo];
+    }
+    else
+    {
+        elements = ETHOMElementsOfCollection(theCollection);
+    }
+
     if (modifiesSelf)
     {
         /*
@@ -477,17 +861,14 @@ static inline void ETHOMMapCollectionWithBlockOrInvocationToTargetAsArray(
         alreadyMapped = [[NSMutableArray alloc] init];
     }
 
-    // If we are using an invocation, fetch a table of the argument slots that
-    // contain proxy created with -each and create a context to be passed to
-    // the function that will setup and fire the invocation.
-    argField_t eachedSlots;
-    // Zeroing out the first byte of the field is enough to indicate that it has
-    // not been filled.
-    eachedSlots.fields[0] = '\0';
+    // If we are using an invocation, snapshot the arguments that contain a
+    // proxy created with -each and create a context to be passed to the
+    // function that will expand and send the invocation.
+    ETEachExpansion *expansion = NULL;
     ETMapContext ctx;
     if (NO == useBlock)
     {
-        eachedSlots = eachedArgumentsFromInvocation(blockOrInvocation);
+        expansion = ETEachExpansionCreate(anInvocation);
         ctx.source = theCollection;
         ctx.target = theTarget;
         ctx.alreadyMapped = alreadyMapped;
@@ -498,34 +879,57 @@ static inline void ETHOMMapCollectionWithBlockOrInvocationToTargetAsArray(
         ctx.handlerSelector = handlerSelector;
         ctx.objIndex = objectIndex;
     }
-    FOREACHI(collectionArray, object)
+    // The elements whose class has a compiled plan are sent the message
+    // through the method IMP.
+    ETHOMCall invocationCall = { 0, 0, NO };
+    ETHOMCall *call = &invocationCall;
+    if (expansion != NULL)
+    {
+        call = &expansion->call;
+    }
+    else if (NO == useBlock)
+    {
+        invocationCall = ETHOMCallFromInvocation(anInvocation);
+    }
+    call->isCallable = (call->isCallable && call->returnKind != @encode(BOOL)[0]);
+    Class lastClass = Nil;
+    IMP imp = NULL;
+
+    for (id object in elements)
     {
         id mapped = nil;
-        if (NO == useBlock)
+        if (call->isCallable && object_getClass(object) != lastClass)
         {
-            if (NO == [object respondsToSelector: selector])
+            lastClass = object_getClass(object);
+            imp = ETHOMImpForCall(call, lastClass, selector);
+        }
+        if (expansion != NULL)
+        {
+            if (imp != NULL || [object respondsToSelector: selector])
             {
-                // Don't operate on this element:
-                objectIndex++;
-                continue;
+                ctx.objIndex = objectIndex;
+                ETHOMMapElementWithExpansion(object, imp, anInvocation, selector,
+                    invocationHasObjectReturnType, expansion, &ctx);
             }
-            BOOL useEachProxy = (eachedSlots.fields[0] & 1);
-            if (useEachProxy)
+            objectIndex++;
+            continue;
+        }
+        else if (imp != NULL)
+        {
+            mapped = ETHOMCallObjectIMP(imp, object, selector, call);
+        }
+        else if (NO == useBlock)
+        {
+            if (NO == [object respondsToSelector: selector])
             {
-                ctx.objIndex = objectIndex;
-                [anInvocation setTarget: object];
-                recursiveMapWithInvocationAndContext(anInvocation, &eachedSlots,
-                                                     2, &ctx);
+                // Don't operate on this element:
                 objectIndex++;
                 continue;
             }
-            else
+            [anInvocation invokeWithTarget: object];
+            if (invocationHasObjectReturnType)
             {
-                [anInvocation invokeWithTarget: object];
-                if (invocationHasObjectReturnType)
-                {
-                    [anInvocation getReturnValue: &mapped];
-                }
+                [anInvocation getReturnValue: &mapped];
             }
         }
         else
@@ -562,6 +966,7 @@ static inline void ETHOMMapCollectionWithBlockOrInvocationToTargetAsArray(
     }
 
     // Cleanup:
+    ETEachExpansionFree(expansion);
     if (modifiesSelf)
     {
         [alreadyMapped release];
@@ -617,20 +1022,32 @@ static inline id ETHOMFoldCollectionWithBlockOrInvocationAndInitialValueAndInver
     }
 
     /*
-     * For folding we can safely consider only the content as an array.
+     * For folding we can safely consider only the content as an array, which
+     * is needed to enumerate the elements in reverse order.
      */
-    NSArray *content = [[(NSObject*)*aCollection collectionArray] retain];
-    NSEnumerator *contentEnumerator;
+    NSArray *content = nil;
+    id<NSFastEnumeration> elements;
     if (NO == shallInvert)
     {
-        contentEnumerator = [content objectEnumerator];
+        elements = ETHOMElementsOfCollection(*aCollection);
     }
     else
     {
-        contentEnumerator = [content reverseObjectEnumerator];
+        content = [[(NSObject*)*aCollection collectionArray] retain];
+        elements = [content reverseObjectEnumerator];
+    }
+
+    ETHOMCall call = { 0, 0, NO };
+    if (NO == useBlock)
+    {
+        call = ETHOMCallFromInvocation(anInvocation);
+        call.isCallable = (call.isCallable && call.returnKind == '@'
+            && call.argumentCount == 1);
     }
+    Class lastClass = Nil;
+    IMP imp = NULL;
 
-    FOREACHE(content, element, id, contentEnumerator)
+    for (id element in elements)
     {
         id target;
         id argument;
@@ -645,7 +1062,16 @@ static inline id ETHOMFoldCollectionWithBlockOrInvocationAndInitialValueAndInver
             argument = accumulator;
         }
 
-        if (NO == useBlock)
+        if (call.isCallable && object_getClass(target) != lastClass)
+        {
+            lastClass = object_getClass(target);
+            imp = ETHOMImpForCall(&call, lastClass, selector);
+        }
+        if (imp != NULL)
+        {
+            accumulator = ((Value1Function)imp)(target, selector, argument);
+        }
+        else if (NO == useBlock)
         {
             if ([target respondsToSelector:selector])
             {
@@ -681,16 +1107,13 @@ static inline void ETHOMFilterCollectionWithBlockOrInvocationAndTargetAndOrigina
     id<ETMutableCollectionObject> theTarget = (id<ETMutableCollectionObject>)*target;
     NSInvocation *anInvocation = nil;
     SEL selector = NULL;
-    argField_t eachedSlots;
-    // Zeroing out the first byte of the field is enough to indicate that the
-    // field has not been filled.
-    eachedSlots.fields[0] = '\0';
+    ETEachExpansion *expansion = NULL;
 
     if (NO == useBlock)
     {
         anInvocation = (NSInvocation*)blockOrInvocation;
         selector = [anInvocation selector];
-        eachedSlots = eachedArgumentsFromInvocation(blockOrInvocation);
+        expansion = ETEachExpansionCreate(anInvocation);
     }
 
     /*
@@ -704,7 +1127,18 @@ static inline void ETHOMFilterCollectionWithBlockOrInvocationAndTargetAndOrigina
     id info = nil;
     NSArray *content = nil;
     NSEnumerator *originalEnum = nil;
-    if (*original == nil)
+    id<NSFastEnumeration> elements = nil;
+    /*
+     * When filtering into another collection, the elements of collections
+     * that don't need the snapshot are enumerated directly.
+     */
+    BOOL enumeratesDirectly = ((id)*original == (id)theCollection
+        && (id)theTarget != (id)theCollection && NO == [theCollection isKeyed]);
+    if (enumeratesDirectly)
+    {
+        elements = ETHOMElementsOfCollection(theCollection);
+    }
+    else if (*original == nil)
     {
         content = [[(NSObject*)theCollection collectionArrayAndInfo: &info] retain];
     }
@@ -713,34 +1147,58 @@ static inline void ETHOMFilterCollectionWithBlockOrInvocationAndTargetAndOrigina
         content = [[(NSObject*)theCollection collectionArray] retain];
         originalEnum = [[(NSObject*)*original collectionArrayAndInfo: &info] objectEnumerator];
     }
+    if (NO == enumeratesDirectly)
+    {
+        elements = content;
+    }
 
     SEL handlerSelector =
        @selector(placeObject:atIndex:inCollection:basedOnFilter:info:);
     FilterPlaceObjectFunction elementHandler = NULL;
     unsigned int objectIndex = 0;
-    FOREACHI(content, object)
+    ETHOMCall invocationCall = { 0, 0, NO };
+    ETHOMCall *call = &invocationCall;
+    if (expansion != NULL)
+    {
+        call = &expansion->call;
+    }
+    else if (NO == useBlock)
+    {
+        invocationCall = ETHOMCallFromInvocation(anInvocation);
+    }
+    call->isCallable = (call->isCallable && call->returnKind == @encode(BOOL)[0]);
+    Class lastClass = Nil;
+    IMP imp = NULL;
+
+    for (id object in elements)
     {
-        id originalObject = [originalEnum nextObject];
+        id originalObject = (enumeratesDirectly ? object : [originalEnum nextObject]);
         long long filterResult = (long long)NO;
-        if (NO == useBlock)
+        if (call->isCallable && object_getClass(object) != lastClass)
         {
-            if (NO == [object respondsToSelector: selector])
-            {
-                // Don't operate on this element:
-                objectIndex++;
-                continue;
-            }
-            BOOL usesEachProxy = (eachedSlots.fields[0] & 1);
-            if (usesEachProxy)
-            {
-                [anInvocation setTarget: object];
-                filterResult = recursiveFilterWithInvocation(anInvocation, &eachedSlots, 2);
-            }
-            else
-            {
-                [anInvocation invokeWithTarget: object];
-                [anInvocation getReturnValue: &filterResult];
-            }
+            lastClass = object_getClass(object);
+            imp = ETHOMImpForCall(call, lastClass, selector);
+        }
+        if (NO == useBlock && imp == NULL
+         && NO == [object respondsToSelector: selector])
+        {
+            // Don't operate on this element:
+            objectIndex++;
+            continue;
+        }
+        if (expansion != NULL)
+        {
+            filterResult = ETHOMFilterElementWithExpansion(object, imp,
+                anInvocation, selector, expansion);
+        }
+        else if (imp != NULL)
+        {
+            filterResult = ETHOMCallPredicateIMP(imp, object, selector, call);
+        }
+        else if (NO == useBlock)
+        {
+            [anInvocation invokeWithTarget: object];
+            [anInvocation getReturnValue: &filterResult];
         }
         #if __has_feature(blocks)
         else
@@ -772,6 +1230,7 @@ static inline void ETHOMFilterCollectionWithBlockOrInvocationAndTargetAndOrigina
         objectIndex++;
     }
     [content release];
+    ETEachExpansionFree(expansion);
     if (info != nil)
     {
         [info release];
@@ -851,12 +1310,8 @@ static inline void ETHOMZipCollectionsWithBlockOrInvocationAndTarget(
 
     SEL handlerSelector =
      @selector(placeObject:inCollection:insteadOfObject:atIndex:havingAlreadyMapped:info:);
-    MapPlaceObjectFunction elementHandler = NULL;
-
-    if ([*firstCollection respondsToSelector: handlerSelector])
-    {
-        elementHandler = (MapPlaceObjectFunction)[(NSObject *)*firstCollection methodForSelector: handlerSelector];
-    }
+    MapPlaceObjectFunction elementHandler =
+        (MapPlaceObjectFunction)ETHOMHandlerForCollection(*firstCollection, handlerSelector);
 
     SEL valueSelector = @selector(value:value:);
     Value2Function invokeBlock = NULL;
@@ -871,6 +1326,15 @@ static inline void ETHOMZipCollectionsWithBlockOrInvocationAndTarget(
     NSUInteger objectIndex = 0;
     NSUInteger objectMax = MIN([contentsFirst count], [contentsSecond count]);
     NSNull *nullObject = [NSNull null];
+    ETHOMCall call = { 0, 0, NO };
+    if (NO == useBlock)
+    {
+        call = ETHOMCallFromInvocation(invocation);
+        call.isCallable = (call.isCallable && call.returnKind == '@'
+            && call.argumentCount == 1);
+    }
+    Class lastClass = Nil;
+    IMP imp = NULL;
 
     FOREACHI(contentsFirst, firstObject)
     {
@@ -880,7 +1344,16 @@ static inline void ETHOMZipCollectionsWithBlockOrInvocationAndTarget(
         }
         id secondObject = [contentsSecond objectAtIndex: objectIndex];
         id mapped = nil;
-        if (NO == useBlock)
+        if (call.isCallable && object_getClass(firstObject) != lastClass)
+        {
+            lastClass = object_getClass(firstObject);
+            imp = ETHOMImpForCall(&call, lastClass, selector);
+        }
+        if (imp != NULL)
+        {
+            mapped = ((Value1Function)imp)(firstObject, selector, secondObject);
+        }
+        else if (NO == useBlock)
         {
             if (NO == [firstObject respondsToSelector: selector])
             {
@@ -939,6 +1412,344 @@ static inline void ETHOMZipCollectionsWithBlockOrInvocationAndTarget(
     }
 }
 
+/* Concurrent Map, Filter and Reduce */
+
+/*
+ * The concurrent HOM methods split the collection array into chunks, which
+ * are processed by the calling thread and a pool of worker threads created on
+ * first use. Only one concurrent operation runs on the pool at a time; an
+ * operation started while another one runs, or from inside a chunk, is
+ * processed by the calling thread alone.
+ */
+
+/* Minimum number of elements per chunk, below which the work is not split. */
+#define CONCURRENT_MIN_CHUNK_SIZE 512
+/* Number of chunks per thread, so that threads finishing early can help. */
+#define CONCURRENT_CHUNKS_PER_THREAD 4
+
+typedef void (*ETHOMChunkFunction)(void *context, NSUInteger start, NSUInteger end);
+
+typedef struct
+{
+    ETHOMChunkFunction function;
+    void *context;
+    NSUInteger elementCount;
+    NSUInteger chunkSize;
+    NSUInteger chunkCount;
+    volatile NSUInteger nextChunk;
+    /* Number of workers which can still join the job */
+    NSUInteger freeSlots;
+    /* Number of workers processing chunks, protected by workerLock */
+    NSUInteger activeWorkers;
+} ETHOMJob;
+
+static pthread_mutex_t workerLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t jobAvailable = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t jobDone = PTHREAD_COND_INITIALIZER;
+/* Held while a job runs, tried by the threads submitting one */
+static pthread_mutex_t jobLock = PTHREAD_MUTEX_INITIALIZER;
+static ETHOMJob *currentJob;
+static unsigned long jobGeneration;
+static NSUInteger workerThreadCount;
+static NSUInteger concurrentThreadCount;
+
+NSUInteger ETConcurrentHOMThreadCount(void)
+{
+    NSUInteger count = concurrentThreadCount;
+    return (0 == count) ? [[NSProcessInfo processInfo] activeProcessorCount] : count;
+}
+
+void ETSetConcurrentHOMThreadCount(NSUInteger aCount)
+{
+    concurrentThreadCount = aCount;
+}
+
+static void ETHOMRunChunks(ETHOMJob *job)
+{
+    NSUInteger chunk;
+
+    while ((chunk = __sync_fetch_and_add(&job->nextChunk, 1)) < job->chunkCount)
+    {
+        NSAutoreleasePool *pool = [NSAutoreleasePool new];
+        NSUInteger start = chunk * job->chunkSize;
+
+        job->function(job->context, start, MIN(start + job->chunkSize, job->elementCount));
+        [pool release];
+    }
+}
+
+@interface ETHOMWorker : NSObject
+@end
+
+@implementation ETHOMWorker
++ (void)runWorker: (id)sender
+{
+    unsigned long generation = 0;
+
+    pthread_mutex_lock(&workerLock);
+    while (YES)
+    {
+        while (NULL == currentJob || generation == jobGeneration
+            || 0 == currentJob->freeSlots)
+        {
+            pthread_cond_wait(&jobAvailable, &workerLock);
+        }
+        ETHOMJob *job = currentJob;
+
+        generation = jobGeneration;
+        job->freeSlots--;
+        job->activeWorkers++;
+        pthread_mutex_unlock(&workerLock);
+
+        ETHOMRunChunks(job);
+
+        pthread_mutex_lock(&workerLock);
+        job->activeWorkers--;
+        if (0 == job->activeWorkers)
+        {
+            pthread_cond_broadcast(&jobDone);
+        }
+    }
+}
+@end
+
+/*
+ * Calls aFunction on consecutive ranges covering [0, count), concurrently if
+ * count is large enough, and returns once all the ranges have been processed.
+ */
+static void ETHOMApplyConcurrently(NSUInteger count,
+                                   ETHOMChunkFunction aFunction,
+                                   void *aContext)
+{
+    NSUInteger threadCount = ETConcurrentHOMThreadCount();
+    NSUInteger chunkCount = MIN(threadCount * CONCURRENT_CHUNKS_PER_THREAD,
+                                count / CONCURRENT_MIN_CHUNK_SIZE);
+
+    if (chunkCount < 2 || threadCount < 2 || 0 != pthread_mutex_trylock(&jobLock))
+    {
+        aFunction(aContext, 0, count);
+        return;
+    }
+
+    ETHOMJob job;
+
+    job.function = aFunction;
+    job.context = aContext;
+    job.elementCount = count;
+    job.chunkSize = (count + chunkCount - 1) / chunkCount;
+    job.chunkCount = (count + job.chunkSize - 1) / job.chunkSize;
+    job.nextChunk = 0;
+    job.freeSlots = threadCount - 1;
+    job.activeWorkers = 0;
+
+    pthread_mutex_lock(&workerLock);
+    while (workerThreadCount < threadCount - 1)
+    {
+        [NSThread detachNewThreadSelector: @selector(runWorker:)
+                                 toTarget: [ETHOMWorker class]
+                               withObject: nil];
+        workerThreadCount++;
+    }
+    currentJob = &job;
+    jobGeneration++;
+    pthread_cond_broadcast(&jobAvailable);
+    pthread_mutex_unlock(&workerLock);
+
+    ETHOMRunChunks(&job);
+
+    /* No worker can join once the job is withdrawn */
+    pthread_mutex_lock(&workerLock);
+    currentJob = NULL;
+    while (job.activeWorkers > 0)
+    {
+        pthread_cond_wait(&jobDone, &workerLock);
+    }
+    pthread_mutex_unlock(&workerLock);
+    pthread_mutex_unlock(&jobLock);
+}
+
+#if __has_feature(blocks)
+
+typedef struct
+{
+    __unsafe_unretained NSArray *content;
+    __unsafe_unretained id block;
+    /* Retained results, since the chunk autorelease pools are drained */
+    id *results;
+    BOOL *flags;
+    __unsafe_unretained id initialValue;
+} ETHOMConcurrentContext;
+
+static void ETHOMMapChunk(void *context, NSUInteger start, NSUInteger end)
+{
+    ETHOMConcurrentContext *ctx = context;
+    id (^block)(id) = ctx->block;
+
+    for (NSUInteger i = start; i < end; i++)
+    {
+        id mapped = block([ctx->content objectAtIndex: i]);
+        ctx->results[i] = [(nil == mapped ? [NSNull null] : mapped) retain];
+    }
+}
+
+static void ETHOMFilterChunk(void *context, NSUInteger start, NSUInteger end)
+{
+    ETHOMConcurrentContext *ctx = context;
+    BOOL (^block)(id) = ctx->block;
+
+    for (NSUInteger i = start; i < end; i++)
+    {
+        ctx->flags[i] = block([ctx->content objectAtIndex: i]);
+    }
+}
+
+/*
+ * Folds each chunk from the initial value, and stores the result in the slot
+ * of the chunk's first element.
+ */
+static void ETHOMReduceChunk(void *context, NSUInteger start, NSUInteger end)
+{
+    ETHOMConcurrentContext *ctx = context;
+    id (^block)(id, id) = ctx->block;
+    id accumulator = ctx->initialValue;
+
+    for (NSUInteger i = start; i < end; i++)
+    {
+        accumulator = block(accumulator, [ctx->content objectAtIndex: i]);
+    }
+    ctx->results[start] = [accumulator retain];
+    ctx->flags[start] = YES;
+}
+
+static inline id ETHOMConcurrentMappedCollection(id<ETCollectionObject> aCollection,
+                                                 id (^aBlock)(id))
+{
+    id<ETMutableCollectionObject> target =
+        [[[[(NSObject *)aCollection class] mutableClass] alloc] init];
+    id info = nil;
+    NSArray *content = [(NSObject *)aCollection collectionArrayAndInfo: &info];
+    NSUInteger count = [content count];
+    ETHOMConcurrentContext ctx = { content, aBlock, NULL, NULL, nil };
+
+    ctx.results = calloc(MAX(count, 1), sizeof(id));
+    ETHOMApplyConcurrently(count, ETHOMMapChunk, &ctx);
+
+    /* Merge in order, through the map hook if the collection has one */
+    SEL handlerSelector =
+     @selector(placeObject:inCollection:insteadOfObject:atIndex:havingAlreadyMapped:info:);
+    MapPlaceObjectFunction elementHandler =
+        (MapPlaceObjectFunction)ETHOMHandlerForCollection(aCollection, handlerSelector);
+
+    for (NSUInteger i = 0; i < count; i++)
+    {
+        if (elementHandler != NULL)
+        {
+            elementHandler(aCollection, handlerSelector, ctx.results[i],
+                           (id<ETCollectionMutation> *)&target,
+                           [content objectAtIndex: i], i, nil, info);
+        }
+        else
+        {
+            [target addObject: ctx.results[i]];
+        }
+        [ctx.results[i] release];
+    }
+    free(ctx.results);
+    [info release];
+    return [target autorelease];
+}
+
+static inline id ETHOMConcurrentFilteredCollection(id<ETCollectionObject> aCollection,
+                                                   BOOL (^aBlock)(id))
+{
+    id<ETMutableCollectionObject> target =
+        [[[[(NSObject *)aCollection class] mutableClass] alloc] init];
+    id info = nil;
+    NSArray *content = [(NSObject *)aCollection collectionArrayAndInfo: &info];
+    NSUInteger count = [content count];
+    ETHOMConcurrentContext ctx = { content, aBlock, NULL, NULL, nil };
+
+    ctx.flags = calloc(MAX(count, 1), sizeof(BOOL));
+    ETHOMApplyConcurrently(count, ETHOMFilterChunk, &ctx);
+
+    /* Merge in order, through the filter hook if the collection has one */
+    SEL handlerSelector =
+       @selector(placeObject:atIndex:inCollection:basedOnFilter:info:);
+    FilterPlaceObjectFunction elementHandler =
+        (FilterPlaceObjectFunction)ETHOMHandlerForCollection(aCollection, handlerSelector);
+
+    for (NSUInteger i = 0; i < count; i++)
+    {
+        if (elementHandler != NULL)
+        {
+            elementHandler(aCollection, handlerSelector, [content objectAtIndex: i], i,
+                           (id<ETCollectionMutation> *)&target, ctx.flags[i], info);
+        }
+        else if (ctx.flags[i])
+        {
+            [target addObject: [content objectAtIndex: i]];
+        }
+    }
+    free(ctx.flags);
+    [info release];
+    return [target autorelease];
+}
+
+static inline id ETHOMConcurrentReduce(id<ETCollectionObject> aCollection,
+                                       id initialValue,
+                                       id (^aBlock)(id, id),
+                                       id (^aCombiner)(id, id))
+{
+    NSArray *content = [(NSObject *)aCollection collectionArray];
+    NSUInteger count = [content count];
+
+    if (0 == count)
+    {
+        return initialValue;
+    }
+
+    ETHOMConcurrentContext ctx = { content, aBlock, NULL, NULL, initialValue };
+
+    ctx.results = calloc(count, sizeof(id));
+    ctx.flags = calloc(count, sizeof(BOOL));
+    ETHOMApplyConcurrently(count, ETHOMReduceChunk, &ctx);
+
+    /* Gather the partial results in order, then combine neighbours pairwise */
+    NSUInteger partialCount = 0;
+    for (NSUInteger i = 0; i < count; i++)
+    {
+        if (ctx.flags[i])
+        {
+            ctx.results[partialCount++] = ctx.results[i];
+        }
+    }
+    while (partialCount > 1)
+    {
+        NSUInteger combinedCount = 0;
+
+        for (NSUInteger i = 0; i < partialCount; i += 2)
+        {
+            id combined = ctx.results[i];
+
+            if (i + 1 < partialCount)
+            {
+                combined = [aCombiner(ctx.results[i], ctx.results[i + 1]) retain];
+                [ctx.results[i] release];
+                [ctx.results[i + 1] release];
+            }
+            ctx.results[combinedCount++] = combined;
+        }
+        partialCount = combinedCount;
+    }
+
+    id result = [ctx.results[0] autorelease];
+    free(ctx.results);
+    free(ctx.flags);
+    return result;
+}
+
+#endif
+
 /*
  * Proxies for higher-order messaging via forwardInvocation.
  */
@@ -1044,6 +1855,15 @@ not -[super methodSignatureForSelector:]. */
     NSEnumerator *collectionEnumerator = [(NSArray*)collection objectEnumerator];
     FOREACHE(collection, object, id, collectionEnumerator)
     {
+        // The plan signature saves building one per message for the usual
+        // case where the element class implements the method.
+        NSMethodSignature *sig =
+            ETHOMPlanForClassAndSelector(object_getClass(object), aSelector)->signature;
+
+        if (sig != nil)
+        {
+            return sig;
+        }
         if ([object respondsToSelector:aSelector])
         {
             return [object methodSignatureForSelector:aSelector];
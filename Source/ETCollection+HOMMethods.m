@@ -96,4 +96,21 @@
     return [self filteredCollectionWithBlock: aBlock
                                    andInvert: YES];
 }
+
+- (id)concurrentMappedCollectionWithBlock: (id(^)(id))aBlock
+{
+    return ETHOMConcurrentMappedCollection(self, aBlock);
+}
+
+- (id)concurrentFilteredCollectionWithBlock: (BOOL(^)(id))aBlock
+{
+    return ETHOMConcurrentFilteredCollection(self, aBlock);
+}
+
+- (id)reduceWithInitialValue: (id)initialValue
+                   intoBlock: (id(^)(id, id))aBlock
+                    combiner: (id(^)(id, id))aCombiner
+{
+    return ETHOMConcurrentReduce(self, initialValue, aBlock, aCombiner);
+}
 #endif
@@ -107,6 +107,10 @@ See -content. */
 
 /** Forwards the message to the content.
 
+When the content is a keyed collection such as a dictionary, the target class 
+must override this method to enumerate the values rather than the keys (see 
+-[NSDictionary(ETCollection) countByEnumeratingValuesWithState:objects:count:]).
+
 See -content. */
 - (NSUInteger) countByEnumeratingWithState: (NSFastEnumerationState *)state 
                                    objects: (id *)objects
@@ -201,28 +205,70 @@ The constraints to respect are detailed in -[(ETCollectionMutation) removeObject
                   hints: (hint != nil ? A(hint) : [NSArray array])];
 }
 
+/** Validates the mutation once, then calls -insertObject:atIndex:hint: for 
+each object by increasing index.
+
+When the indexes are empty, each object is inserted at ETUndeterminedIndex.
+
+Collection classes that support batch insertion should override this method 
+to apply the whole batch at once. */
 - (void) insertObjects: (NSArray *)objects atIndexes: (NSIndexSet *)indexes hints: (NSArray *)hints
 {
-#if 0
-    [self doesNotRecognizeSelector: _cmd];
-#else
-    for (int i = 0; i < [objects count]; i++)
+    [self validateMutationForObjects: objects atIndexes: indexes hints: hints isRemoval: NO];
+
+    BOOL hasIndexes = ([indexes isEmpty] == NO);
+    NSUInteger index = (hasIndexes ? [indexes firstIndex] : ETUndeterminedIndex);
+    NSUInteger nbOfHints = [hints count];
+    NSUInteger i = 0;
+
+    for (id object in objects)
     {
-        [self insertObject: [objects objectAtIndex: i] atIndex: i hint: (hints != nil ? [hints objectAtIndex: i] : nil)];
+        [self insertObject: object
+                   atIndex: index
+                      hint: (i < nbOfHints ? [hints objectAtIndex: i] : nil)];
+        if (hasIndexes)
+        {
+            index = [indexes indexGreaterThanIndex: index];
+        }
+        i++;
     }
-#endif
 }
 
+/** Validates the mutation once, then calls -removeObject:atIndex:hint: for 
+each index by decreasing index, so the remaining indexes stay valid.
+
+When the indexes are empty, each object is removed at ETUndeterminedIndex.
+
+Collection classes that support batch removal should override this method 
+to apply the whole batch at once. */
 - (void) removeObjects: (NSArray *)objects atIndexes: (NSIndexSet *)indexes hints: (NSArray *)hints
 {
-#if 0
-    [self doesNotRecognizeSelector: _cmd];
-#else
-    for (int i = 0; i < [objects count]; i++)
+    [self validateMutationForObjects: objects atIndexes: indexes hints: hints isRemoval: YES];
+
+    NSUInteger nbOfObjects = [objects count];
+    NSUInteger nbOfHints = [hints count];
+
+    if ([indexes isEmpty])
     {
-        [self removeObject: [objects objectAtIndex: i] atIndex: i hint: (hints != nil ? [hints objectAtIndex: i] : nil)];
+        for (NSUInteger i = 0; i < nbOfObjects; i++)
+        {
+            [self removeObject: [objects objectAtIndex: i]
+                       atIndex: ETUndeterminedIndex
+                          hint: (i < nbOfHints ? [hints objectAtIndex: i] : nil)];
+        }
+        return;
+    }
+
+    NSUInteger i = [indexes count];
+
+    for (NSUInteger index = [indexes lastIndex]; index != NSNotFound;
+         index = [indexes indexLessThanIndex: index])
+    {
+        i--;
+        [self removeObject: (i < nbOfObjects ? [objects objectAtIndex: i] : nil)
+                   atIndex: index
+                      hint: (i < nbOfHints ? [hints objectAtIndex: i] : nil)];
     }
-#endif
 }
 
 - (void) validateMutationForObjects: (NSArray *)objects
@@ -263,6 +309,77 @@ The constraints to respect are detailed in -[(ETCollectionMutation) removeObject
 @end
 
 
+#ifndef GNUSTEP
+/* Returns the objects that inserting the given ones would add to the set, in 
+insertion order, without the objects already present or repeated. */
+static NSOrderedSet *ETObjectsAddedToOrderedSet(NSOrderedSet *set, NSArray *objects)
+{
+    NSMutableOrderedSet *addedObjects = [NSMutableOrderedSet orderedSetWithArray: objects];
+    [addedObjects minusOrderedSet: set];
+    return addedObjects;
+}
+
+/* Raises an NSInvalidArgumentException when the objects to insert at the given 
+indexes include objects already present or repeated, since these objects are 
+skipped and the remaining ones would end up at other indexes. */
+static void ETValidateOrderedSetInsertion(NSOrderedSet *set, NSArray *objects, NSIndexSet *indexes)
+{
+    if ([indexes isEmpty])
+        return;
+
+    if ([ETObjectsAddedToOrderedSet(set, objects) count] != [indexes count])
+    {
+        [NSException raise: NSInvalidArgumentException
+                    format: @"Mismatched mutation objects and indexes, some "
+                             "objects are already in the ordered set or repeated"];
+    }
+}
+#endif
+
+/* Returns the indexes to report for a batch mutation on an ordered collection. 
+For an unordered collection, returns an empty index set.
+
+For an ordered set, raises an NSInvalidArgumentException if the insertion 
+cannot happen at the given indexes, and reports only the appended objects 
+otherwise. */
+static NSIndexSet *ETChangedIndexesForMutation(id collection,
+                                               NSArray *objects,
+                                               NSIndexSet *indexes,
+                                               BOOL isRemoval)
+{
+    if ([collection isOrdered] == NO)
+    {
+        return [NSIndexSet indexSet];
+    }
+#ifndef GNUSTEP
+    if (isRemoval == NO && [collection isKindOfClass: [NSOrderedSet class]])
+    {
+        ETValidateOrderedSetInsertion(collection, objects, indexes);
+
+        if ([indexes isEmpty])
+        {
+            NSUInteger nbOfAddedObjects = [ETObjectsAddedToOrderedSet(collection, objects) count];
+            return [NSIndexSet indexSetWithIndexesInRange: NSMakeRange([collection count], nbOfAddedObjects)];
+        }
+    }
+#endif
+    if ([indexes isEmpty] == NO)
+    {
+        return indexes;
+    }
+    if (isRemoval == NO)
+    {
+        return [NSIndexSet indexSetWithIndexesInRange: NSMakeRange([collection count], [objects count])];
+    }
+
+    NSSet *removedObjects = [NSSet setWithArray: objects];
+
+    return [(NSArray *)collection indexesOfObjectsPassingTest: ^(id object, NSUInteger index, BOOL *stop)
+    {
+        return [removedObjects containsObject: object];
+    }];
+}
+
 @implementation NSObject (ETCollectionMutationKVOSupport)
 
 /*
@@ -381,6 +498,50 @@ The constraints to respect are detailed in -[(ETCollectionMutation) removeObject
     }
 }
 
+- (void) insertObjects: (NSArray *)objects
+             atIndexes: (NSIndexSet *)indexes
+                 hints: (NSArray *)hints
+  intoCollectionForKey: (NSString *)key
+{
+    id collection = [self valueForKey: key];
+    NSIndexSet *changedIndexes = ETChangedIndexesForMutation(collection, objects, indexes, NO);
+
+    [self willChangeValueForKey: key
+                      atIndexes: changedIndexes
+                    withObjects: objects
+                   mutationKind: ETCollectionMutationKindInsertion];
+    [collection insertObjects: objects atIndexes: indexes hints: hints];
+    [self didChangeValueForKey: key
+                     atIndexes: changedIndexes
+                   withObjects: objects
+                  mutationKind: ETCollectionMutationKindInsertion];
+}
+
+- (void) removeObjects: (NSArray *)objects
+             atIndexes: (NSIndexSet *)indexes
+                 hints: (NSArray *)hints
+  fromCollectionForKey: (NSString *)key
+{
+    id collection = [self valueForKey: key];
+    NSIndexSet *changedIndexes = ETChangedIndexesForMutation(collection, objects, indexes, YES);
+    NSArray *removedObjects = objects;
+
+    if ([objects isEmpty] && [collection isOrdered])
+    {
+        removedObjects = [collection objectsAtIndexes: indexes];
+    }
+
+    [self willChangeValueForKey: key
+                      atIndexes: changedIndexes
+                    withObjects: removedObjects
+                   mutationKind: ETCollectionMutationKindRemoval];
+    [collection removeObjects: objects atIndexes: indexes hints: hints];
+    [self didChangeValueForKey: key
+                     atIndexes: changedIndexes
+                   withObjects: removedObjects
+                  mutationKind: ETCollectionMutationKindRemoval];
+}
+
 @end
 
 
@@ -566,6 +727,37 @@ The constraints to respect are detailed in -[(ETCollectionMutation) removeObject
     return viewpoints;
 }
 
+/** Returns the dictionary values through <var>objects</var>, in chunks of 
+at most <var>count</var> values, unlike -countByEnumeratingWithState:objects:count: 
+which returns the keys.
+
+This lets keyed collections be iterated over their values as 
+-contentArray would, without copying the values into an array.
+
+The keys are enumerated with -countByEnumeratingWithState:objects:count:, 
+and each chunk is translated to values, so the enumeration state holds no 
+object and draining an autorelease pool in the loop is safe. */
+- (NSUInteger) countByEnumeratingValuesWithState: (NSFastEnumerationState *)state
+                                         objects: (id *)objects
+                                           count: (NSUInteger)count
+{
+    NSUInteger n = [self countByEnumeratingWithState: state objects: objects count: count];
+    id *keys = state->itemsPtr;
+
+    if (n > count)
+    {
+        [NSException raise: NSInternalInconsistencyException
+                    format: @"%@ returned more keys than objects can hold", [self class]];
+    }
+    /* The keys can be in objects, so each one is read before being replaced */
+    for (NSUInteger i = 0; i < n; i++)
+    {
+        objects[i] = [self objectForKey: keys[i]];
+    }
+    state->itemsPtr = objects;
+    return n;
+}
+
 @end
 
 @implementation NSSet (ETCollection)
@@ -727,6 +919,36 @@ NSCountedSet is always mutable and has not immutable equivalent. */
     return [[self contentArray] objectEnumerator];
 }
 
+/* The maximum number of indexes fetched per -countByEnumeratingWithState:objects:count: */
+#define INDEX_BATCH_SIZE 64
+
+/** Returns the indexes as NSNumber objects through <var>objects</var>, in 
+chunks of at most <var>count</var> indexes.
+
+Each chunk is fetched as a batch of index ranges with 
+-getIndexes:maxCount:inIndexRange:, so no array of the whole content is 
+created unlike with -contentArray. */
+- (NSUInteger) countByEnumeratingWithState: (NSFastEnumerationState *)state 
+                                   objects: (id *)objects
+                                     count: (NSUInteger)count
+{
+    /* state->state is the first index that remains to be enumerated */
+    NSRange range = NSMakeRange(state->state, NSNotFound - state->state);
+    NSUInteger indexes[INDEX_BATCH_SIZE];
+    NSUInteger n = [self getIndexes: indexes
+                           maxCount: MIN(count, INDEX_BATCH_SIZE)
+                       inIndexRange: &range];
+
+    for (NSUInteger i = 0; i < n; i++)
+    {
+        objects[i] = [NSNumber numberWithUnsignedInteger: indexes[i]];
+    }
+    state->state = range.location;
+    state->itemsPtr = objects;
+    state->mutationsPtr = &state->extra[0];
+    return n;
+}
+
 @end
 
 @implementation NSMutableArray (ETCollectionMutation)
@@ -819,6 +1041,50 @@ See also -[ETCollectionMutation removeObject:atIndex:hint:]. */
     }
 }
 
+/** Inserts the objects at the given indexes in the ordered set.
+
+If the indexes are empty, the objects are added, and the objects already 
+present are skipped.
+
+Raises an NSInvalidArgumentException if the indexes are not empty and some 
+objects are already in the ordered set or repeated, since the remaining objects 
+would end up at other indexes than the given ones.
+
+See also -[ETCollectionMutation insertObjects:atIndexes:hints:]. */
+- (void) insertObjects: (NSArray *)objects atIndexes: (NSIndexSet *)indexes hints: (NSArray *)hints
+{
+    [self validateMutationForObjects: objects atIndexes: indexes hints: hints isRemoval: NO];
+
+    if ([indexes isEmpty] == NO)
+    {
+        ETValidateOrderedSetInsertion(self, objects, indexes);
+        [self insertObjects: objects atIndexes: indexes];
+    }
+    else
+    {
+        [self addObjectsFromArray: objects];
+    }
+}
+
+/** Removes the objects at the given indexes from the ordered set.
+
+If the indexes are empty, the objects are removed wherever they are.
+
+See also -[ETCollectionMutation removeObjects:atIndexes:hints:]. */
+- (void) removeObjects: (NSArray *)objects atIndexes: (NSIndexSet *)indexes hints: (NSArray *)hints
+{
+    [self validateMutationForObjects: objects atIndexes: indexes hints: hints isRemoval: YES];
+
+    if ([objects isEmpty] || [objects count] == [indexes count])
+    {
+        [self removeObjectsAtIndexes: indexes];
+    }
+    else
+    {
+        [self removeObjectsInArray: objects];
+    }
+}
+
 @end
 #endif
 
@@ -932,11 +1198,26 @@ See also -[ETCollectionMutation removeObject:atIndex:hint:]. */
 
 @end
 
-// TODO: Both batch insertion and removal into NSMutableIndexSet can become fast,
-// if we provide a NSArray class cluster subclass wrapping a NSIndexSet.
-// [NSArray initWithIndexSet:] would return it and we would have a private
-// method to access the underlying index set (and a special case in each
-// primitive batch insertion and removal method).
+/* Returns the index set corresponding to the number objects, or raises an 
+NSInvalidArgumentException if an object is not a number. */
+static NSIndexSet *ETIndexSetWithNumbers(NSArray *objects, NSMutableIndexSet *collection)
+{
+    NSMutableIndexSet *numbers = [NSMutableIndexSet indexSet];
+
+    for (id object in objects)
+    {
+        if ([object isNumber] == NO)
+        {
+            [NSException raise: NSInvalidArgumentException
+                        format: @"Object %@ must be an NSNumber instance to be "
+                                 "inserted into or removed from %@ collection",
+                                object, collection];
+        }
+        [numbers addIndex: [object unsignedIntegerValue]];
+    }
+    return numbers;
+}
+
 @implementation NSMutableIndexSet (ETCollectionMutation)
 
 + (void) load
@@ -965,14 +1246,16 @@ See also -[ETCollectionMutation insertObject:atIndex:hint:]. */
     }
 }
 
+/** Adds the number objects to the set with a single -addIndexes:.
+
+The indexes are ignored in all case.
+
+If an object is not a number, raises an NSInvalidArgumentException and leaves 
+the receiver unchanged. */
 - (void) insertObjects: (NSArray *)objects atIndexes: (NSIndexSet *)indexes hints: (NSArray *)hints
 {
     [self validateMutationForObjects: objects atIndexes: indexes hints: hints isRemoval: NO];
-
-    for (id number in objects)
-    {
-        [self insertObject:  number atIndex: ETUndeterminedIndex hint: nil];
-    }
+    [self addIndexes: ETIndexSetWithNumbers(objects, self)];
 }
 
 /** Removes the number object from the set.
@@ -996,14 +1279,16 @@ See also -[ETCollectionMutation removeObject:atIndex:hint:]. */
     }
 }
 
+/** Removes the number objects from the set with a single -removeIndexes:.
+
+The indexes are ignored in all case.
+
+If an object is not a number, raises an NSInvalidArgumentException and leaves 
+the receiver unchanged. */
 - (void) removeObjects: (NSArray *)objects atIndexes: (NSIndexSet *)indexes hints: (NSArray *)hints
 {
     [self validateMutationForObjects: objects atIndexes: indexes hints: hints isRemoval: YES];
-
-    for (id number in objects)
-    {
-        [self removeObject:  number atIndex: ETUndeterminedIndex hint: nil];
-    }
+    [self removeIndexes: ETIndexSetWithNumbers(objects, self)];
 }
 
 @end
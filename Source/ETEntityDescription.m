@@ -7,6 +7,7 @@
 
 #import <Foundation/Foundation.h>
 #import "ETEntityDescription.h"
+#import "ETModelDescriptionRepository.h"
 #import "ETPackageDescription.h"
 #import "ETCollection.h"
 #import "ETCollection+HOM.h"
@@ -18,6 +19,10 @@
 #import "Macros.h"
 #import "EtoileCompatibility.h"
 
+@interface ETModelDescriptionRepository (ETResolvedLookups)
++ (void) invalidateResolvedLookups;
+@end
+
 
 @implementation ETEntityDescription
 
@@ -102,6 +107,7 @@
     DESTROY(_cachedAllPropertyDescriptionsByName);
     DESTROY(_cachedAllPropertyDescriptionNames);
     DESTROY(_cachedAllPersistentPropertyDescriptions);
+    ETInvalidatePropertyAccessors();
     
     for (ETEntityDescription *child in [_children allObjects])
     {
@@ -294,6 +300,9 @@ static void CacheAllPropertyDescriptionsRecursive(ETEntityDescription *entity, N
     [self removeFromParentChildrenArray];
     ASSIGN(_parent, parentDescription);
     [self addToParentChildrenArray];
+    /* -[ETModelDescriptionRepository classForEntityDescription:] results 
+       depend on the parent chain */
+    [ETModelDescriptionRepository invalidateResolvedLookups];
 }
 
 - (BOOL) isKindOfEntity: (ETEntityDescription *)anEntityDesc
@@ -479,6 +488,16 @@ static void CacheAllPropertyDescriptionsRecursive(ETEntityDescription *entity, N
     return [_propertyDescriptions allValues];
 }
 
+/* Enumerates the property descriptions rather than the keys of -content */
+- (NSUInteger) countByEnumeratingWithState: (NSFastEnumerationState *)state 
+                                   objects: (id *)objects
+                                     count: (NSUInteger)count
+{
+    return [_propertyDescriptions countByEnumeratingValuesWithState: state
+                                                            objects: objects
+                                                              count: count];
+}
+
 - (void) insertObject: (id)object atIndex: (NSUInteger)index hint: (id)hint
 {
     [self addPropertyDescription: object];
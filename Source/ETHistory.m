@@ -203,4 +203,11 @@
     return [NSArray arrayWithArray: history];
 }
 
+- (NSUInteger) countByEnumeratingWithState: (NSFastEnumerationState *)state 
+                                   objects: (id *)objects
+                                     count: (NSUInteger)count
+{
+    return [history countByEnumeratingWithState: state objects: objects count: count];
+}
+
 @end
@@ -0,0 +1,196 @@
+/*
+    Copyright (C) 2026 The Etoile Project
+
+    Date:  October 2026
+    License:  Modified BSD (see COPYING)
+ */
+
+#import "ETIdentityMap.h"
+#import "ETCollection.h"
+#import "NSObject+Trait.h"
+#import "EtoileCompatibility.h"
+#import "Macros.h"
+
+static void *ETIdentityMapRetainObject(void *value)
+{
+    return (void *)RETAIN((id)value);
+}
+
+static void ETIdentityMapReleaseObject(void *value)
+{
+    RELEASE((id)value);
+}
+
+static const ETCIdentityMapValueCallBacks ETIdentityMapObjectCallBacks =
+    { ETIdentityMapRetainObject, ETIdentityMapReleaseObject };
+
+@implementation ETIdentityMap
+
++ (void) initialize
+{
+    if (self != [ETIdentityMap class])
+        return;
+
+    [self applyTraitFromClass: [ETCollectionTrait class]];
+}
+
++ (id) identityMap
+{
+    return AUTORELEASE([[self alloc] init]);
+}
+
+- (id) initWithCapacity: (NSUInteger)capacity retainsObjects: (BOOL)retainsObjects
+{
+    SUPERINIT;
+    _map = ETCIdentityMapNewWithCallBacks(capacity,
+        (retainsObjects ? &ETIdentityMapObjectCallBacks : NULL));
+    if (_map == NULL)
+    {
+        DESTROY(self);
+        return nil;
+    }
+    return self;
+}
+
+- (id) init
+{
+    return [self initWithCapacity: 0 retainsObjects: YES];
+}
+
+- (void) dealloc
+{
+    if (_map != NULL)
+    {
+        ETCIdentityMapFree(_map);
+    }
+    [super dealloc];
+}
+
+- (id) objectForKey: (id)aKey
+{
+    return (id)ETCIdentityMapGet(_map, (const void *)aKey);
+}
+
+- (void) setObject: (id)anObject forKey: (id)aKey
+{
+    NILARG_EXCEPTION_TEST(aKey);
+    NILARG_EXCEPTION_TEST(anObject);
+
+    if (ETCIdentityMapSet(_map, (const void *)aKey, (void *)anObject) != 0)
+    {
+        [NSException raise: NSMallocException
+                    format: @"Failed to grow %@ for a new key", self];
+    }
+    _mutationCount++;
+}
+
+- (void) removeObjectForKey: (id)aKey
+{
+    if (aKey == nil)
+        return;
+
+    if (ETCIdentityMapRemove(_map, (const void *)aKey) == 0)
+    {
+        _mutationCount++;
+    }
+}
+
+- (void) removeAllObjects
+{
+    ETCIdentityMapRemoveAll(_map);
+    _mutationCount++;
+}
+
+- (NSArray *) allKeys
+{
+    NSMutableArray *keys = [NSMutableArray arrayWithCapacity: ETCIdentityMapCount(_map)];
+    size_t cursor = 0;
+    const void *key = NULL;
+
+    while (ETCIdentityMapNextEntry(_map, &cursor, &key, NULL))
+    {
+        [keys addObject: (id)key];
+    }
+    return keys;
+}
+
+- (NSArray *) allValues
+{
+    NSMutableArray *values = [NSMutableArray arrayWithCapacity: ETCIdentityMapCount(_map)];
+    size_t cursor = 0;
+    void *value = NULL;
+
+    while (ETCIdentityMapNextEntry(_map, &cursor, NULL, &value))
+    {
+        [values addObject: (id)value];
+    }
+    return values;
+}
+
+#if __has_feature(blocks)
+- (void) enumerateKeysAndObjectsUsingBlock: (void (^)(id key, id obj, BOOL *stop))aBlock
+{
+    size_t cursor = 0;
+    const void *key = NULL;
+    void *value = NULL;
+    BOOL stop = NO;
+
+    while (stop == NO && ETCIdentityMapNextEntry(_map, &cursor, &key, &value))
+    {
+        aBlock((id)key, (id)value, &stop);
+    }
+}
+#endif
+
+- (BOOL) isKeyed
+{
+    return YES;
+}
+
+- (NSUInteger) count
+{
+    return ETCIdentityMapCount(_map);
+}
+
+- (BOOL) isEmpty
+{
+    return (ETCIdentityMapCount(_map) == 0);
+}
+
+- (id) content
+{
+    return [self allValues];
+}
+
+- (NSArray *) contentArray
+{
+    return [self allValues];
+}
+
+- (NSEnumerator *) objectEnumerator
+{
+    return [[self allValues] objectEnumerator];
+}
+
+/* The slot cursor is kept in state->state, so the values are returned without
+   building an intermediate array. */
+- (NSUInteger) countByEnumeratingWithState: (NSFastEnumerationState *)state
+                                   objects: (id *)objects
+                                     count: (NSUInteger)count
+{
+    size_t cursor = state->state;
+    NSUInteger batchCount = 0;
+    void *value = NULL;
+
+    state->mutationsPtr = &_mutationCount;
+    state->itemsPtr = objects;
+
+    while (batchCount < count && ETCIdentityMapNextEntry(_map, &cursor, NULL, &value))
+    {
+        objects[batchCount++] = (id)value;
+    }
+    state->state = cursor;
+    return batchCount;
+}
+
+@end
@@ -24,11 +24,14 @@
 
 @synthesize representedObject = _representedObject, index = _index;
 
+static ETPropertyID valuePropertyID = NULL;
+
 + (void) initialize
 {
     if (self != [ETIndexValuePair class])
         return;
-    
+
+    valuePropertyID = ETPropertyIDForName(@"value");
     [self applyTraitFromClass: [ETViewpointTrait class]];
     // FIXME: Method aliasing is broken
     /*[self applyTraitFromClass: [ETViewpointTrait class]
@@ -162,6 +165,12 @@ given object value. */
 #pragma mark Property Value Coding
 #pragma mark -
 
+/** Returns YES, since the property names are those of -value. */
++ (BOOL) hasInstanceSpecificPropertyNames
+{
+    return YES;
+}
+
 - (NSArray *) propertyNames
 {
     // FIXME: See +intialize
@@ -185,11 +194,14 @@ given object value. */
 This method accesses properties of the represented element. */
 - (id) valueForProperty: (NSString *)aProperty
 {
-    if ([aProperty isEqualToString: @"value"] && [[self value] isViewpoint] == NO)
+    ETPropertyID propertyID = ETDeclaredPropertyIDForName(self, aProperty);
+
+    /* The value can accept property names we don't know about */
+    if (NULL == propertyID)
     {
-        return [super valueForProperty: aProperty];
+        return [[self value] valueForProperty: aProperty];
     }
-    return [[self value] valueForProperty: aProperty];
+    return [self valueForPropertyID: propertyID];
 }
 
 /** Sets the value bound to the given property of -value.
@@ -197,18 +209,38 @@ This method accesses properties of the represented element. */
 This method accesses properties of the represented property or element. */
 - (BOOL) setValue: (id)aValue forProperty: (NSString *)aProperty
 {
-    if ([aProperty isEqualToString: @"value"] && [[self value] isViewpoint] == NO)
+    ETPropertyID propertyID = ETDeclaredPropertyIDForName(self, aProperty);
+
+    if (NULL == propertyID)
     {
-        return [super setValue: aValue forProperty: aProperty];
+        return [[self value] setValue: aValue forProperty: aProperty];
+    }
+    return [self setValue: aValue forPropertyID: propertyID];
+}
+
+- (id) valueForPropertyID: (ETPropertyID)aPropertyID
+{
+    if (aPropertyID == valuePropertyID && [[self value] isViewpoint] == NO)
+    {
+        return [super valueForPropertyID: aPropertyID];
+    }
+    return [[self value] valueForPropertyID: aPropertyID];
+}
+
+- (BOOL) setValue: (id)aValue forPropertyID: (ETPropertyID)aPropertyID
+{
+    if (aPropertyID == valuePropertyID && [[self value] isViewpoint] == NO)
+    {
+        return [super setValue: aValue forPropertyID: aPropertyID];
     }
 
     if ([self isMutableValue])
     {
-        return [[self value] setValue: aValue forProperty: aProperty];
+        return [[self value] setValue: aValue forPropertyID: aPropertyID];
     }
     else
     {
-        return [super setValue: aValue forProperty: aProperty];
+        return [super setValue: aValue forPropertyID: aPropertyID];
     }
 }
 
@@ -18,11 +18,19 @@
 
 @implementation ETKeyValuePair
 
+static ETPropertyID valuePropertyID = NULL;
+static ETPropertyID keyPropertyID = NULL;
+static ETPropertyID displayNamePropertyID = NULL;
+
 + (void) initialize
 {
     if (self != [ETKeyValuePair class])
         return;
 
+    valuePropertyID = ETPropertyIDForName(@"value");
+    keyPropertyID = ETPropertyIDForName(@"key");
+    displayNamePropertyID = ETPropertyIDForName(@"displayName");
+
     [self applyTraitFromClass: [ETViewpointTrait class]];
     // FIXME: Method aliasing is broken
     /*[self applyTraitFromClass: [ETViewpointTrait class]
@@ -201,6 +209,12 @@ and <em>representedObject</em>. */
 #pragma mark Property Value Coding
 #pragma mark -
 
+/** Returns YES, since the property names are those of -value. */
++ (BOOL) hasInstanceSpecificPropertyNames
+{
+    return YES;
+}
+
 /** Exposes <em>key</em> and <em>value</em> in addition to the inherited properties. */
 - (NSArray *) propertyNames
 {
@@ -221,6 +235,29 @@ and <em>representedObject</em>. */
 }
 
 - (id) valueForProperty: (NSString *)aProperty
+{
+    ETPropertyID propertyID = ETDeclaredPropertyIDForName(self, aProperty);
+
+    /* The value can accept property names we don't know about */
+    if (NULL == propertyID)
+    {
+        return [[self value] valueForProperty: aProperty];
+    }
+    return [self valueForPropertyID: propertyID];
+}
+
+- (BOOL) setValue: (id)aValue forProperty: (NSString *)aProperty
+{
+    ETPropertyID propertyID = ETDeclaredPropertyIDForName(self, aProperty);
+
+    if (NULL == propertyID)
+    {
+        return [[self value] setValue: aValue forProperty: aProperty];
+    }
+    return [self setValue: aValue forPropertyID: propertyID];
+}
+
+- (id) valueForPropertyID: (ETPropertyID)aPropertyID
 {
     /* For key-value pairs that belong to an heterogen collection, the
        UI presentation uses a 'displayName' column in many cases. It is important 
@@ -228,31 +265,31 @@ and <em>representedObject</em>. */
        with a name when presented. For example, objects in an ETAspectCategory
        have their names determined by -[ETKeyValuePair key].
        -name and -setName: can still be used to access the value object name. */
-    if (([aProperty isEqualToString: @"value"] && [[self value] isViewpoint] == NO)
-     || [aProperty isEqualToString: @"key"]
-     || [aProperty isEqualToString: @"displayName"])
+    if ((aPropertyID == valuePropertyID && [[self value] isViewpoint] == NO)
+     || aPropertyID == keyPropertyID
+     || aPropertyID == displayNamePropertyID)
     {
-        return [super valueForProperty: aProperty];
+        return [super valueForPropertyID: aPropertyID];
     }
-    return [[self value] valueForProperty: aProperty];
+    return [[self value] valueForPropertyID: aPropertyID];
 }
 
-- (BOOL) setValue: (id)aValue forProperty: (NSString *)aProperty
+- (BOOL) setValue: (id)aValue forPropertyID: (ETPropertyID)aPropertyID
 {
-    if (([aProperty isEqualToString: @"value"] && [[self value] isViewpoint] == NO)
-     || [aProperty isEqualToString: @"key"]
-     || [aProperty isEqualToString: @"displayName"])
+    if ((aPropertyID == valuePropertyID && [[self value] isViewpoint] == NO)
+     || aPropertyID == keyPropertyID
+     || aPropertyID == displayNamePropertyID)
     {
-        return [super setValue: aValue forProperty: aProperty];
+        return [super setValue: aValue forPropertyID: aPropertyID];
     }
 
     if ([self isMutableValue])
     {
-        return [[self value] setValue: aValue forProperty: aProperty];
+        return [[self value] setValue: aValue forPropertyID: aPropertyID];
     }
     else
     {
-        return [super setValue: aValue forProperty: aProperty];
+        return [super setValue: aValue forPropertyID: aPropertyID];
     }
 }
 
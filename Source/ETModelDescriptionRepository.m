@@ -10,6 +10,7 @@
 #import "ETCollection.h"
 #import "ETCollection+HOM.h"
 #import "ETEntityDescription.h"
+#import "ETIdentityMap.h"
 #import "ETPackageDescription.h"
 #import "ETPropertyDescription.h"
 #import "ETReflection.h"
@@ -19,6 +20,111 @@
 #import "Macros.h"
 #import "EtoileCompatibility.h"
 
+/* Resolved Lookups
+
+-entityDescriptionForClass: and -classForEntityDescription: cache their 
+results in direct-mapped slot arrays, indexed by the class or entity pointer 
+hash. Each slot is a sequence lock, so a lookup reads it without taking a lock: 
+the sequence is odd while a thread updates the slot, and a reader falls back 
+on the uncached lookup if the sequence changed while it was copying the slot.
+
+Slots are tagged with the generation that was current when the result was 
+resolved, the sum of the repository generation and the global one. 
+Incrementing the repository generation discards all its cached results at 
+once, and incrementing the global one discards them in every repository (e.g. 
+when an entity description parent changes). Entity descriptions are not 
+retained as values, since removing a description increments the generation. As keys, they are retained 
+until the slot is reused, because -classForEntityDescription: also accepts 
+descriptions that don't belong to the repository, and a deallocated key could 
+otherwise match a new object allocated at the same address. */
+
+#define ETResolvedLookupSlotCount 1024
+
+struct _ETResolvedLookupSlot
+{
+    volatile unsigned long sequence;
+    const void *key;
+    unsigned long generation;
+    id value;
+};
+
+typedef struct _ETResolvedLookupSlot ETResolvedLookupSlot;
+
+static volatile unsigned long resolvedLookupGeneration = 0;
+
+static void ETInvalidateResolvedLookups(void)
+{
+    __sync_fetch_and_add(&resolvedLookupGeneration, 1);
+}
+
+static inline ETResolvedLookupSlot *ETResolvedLookupSlotForKey(ETResolvedLookupSlot *slots,
+                                                               const void *key)
+{
+    uint64_t hash = (uint64_t)(uintptr_t)key * 0x9E3779B97F4A7C15ULL;
+
+    return &slots[(hash >> 32) & (ETResolvedLookupSlotCount - 1)];
+}
+
+static inline BOOL ETResolvedLookupGet(ETResolvedLookupSlot *slots, const void *key,
+                                       unsigned long generation, id *value)
+{
+    ETResolvedLookupSlot *slot = ETResolvedLookupSlotForKey(slots, key);
+    unsigned long sequence = slot->sequence;
+
+    __sync_synchronize();
+
+    if ((sequence & 1) != 0)
+        return NO;
+
+    const void *slotKey = slot->key;
+    unsigned long slotGeneration = slot->generation;
+    id slotValue = slot->value;
+
+    __sync_synchronize();
+
+    if (slot->sequence != sequence || slotKey != key || slotGeneration != generation)
+        return NO;
+
+    *value = slotValue;
+    return YES;
+}
+
+static inline void ETResolvedLookupSet(ETResolvedLookupSlot *slots, const void *key,
+                                       unsigned long generation, id value,
+                                       BOOL retainsKey)
+{
+    ETResolvedLookupSlot *slot = ETResolvedLookupSlotForKey(slots, key);
+    unsigned long sequence = slot->sequence;
+
+    /* If another thread is updating the slot, we just don't cache */
+    if ((sequence & 1) != 0
+     || __sync_bool_compare_and_swap(&slot->sequence, sequence, sequence + 1) == NO)
+    {
+        return;
+    }
+    const void *oldKey = slot->key;
+
+    slot->key = (retainsKey ? [(id)key retain] : key);
+    slot->generation = generation;
+    slot->value = value;
+    __sync_synchronize();
+    slot->sequence = sequence + 2;
+
+    /* Readers compare the old key without dereferencing it */
+    if (retainsKey)
+    {
+        [(id)oldKey release];
+    }
+}
+
+static void ETResolvedLookupReleaseKeys(ETResolvedLookupSlot *slots)
+{
+    for (NSUInteger i = 0; i < ETResolvedLookupSlotCount; i++)
+    {
+        [(id)slots[i].key release];
+    }
+}
+
 @implementation ETModelDescriptionRepository
 
 + (void) initialize
@@ -42,6 +148,72 @@
     return selfDesc;
 }
 
+/* Registration Batches
+
+Binding an entity description to a class changes the property names of its 
+instances, so the property accessors must be invalidated. 
+ETInvalidatePropertyAccessors() discards every cached accessor, so while 
+entity descriptions are registered in a batch, it is called once when the 
+outermost batch ends. The receiver resolved lookups are discarded on each 
+change, since the batch can look up the entity descriptions it registers. */
+
+- (void) beginRegistration
+{
+    [_pendingLock lock];
+    _registrationDepth++;
+    [_pendingLock unlock];
+}
+
+- (void) endRegistration
+{
+    BOOL invalidatesAccessors = NO;
+
+    [_pendingLock lock];
+    ETAssert(_registrationDepth > 0);
+    _registrationDepth--;
+    if (_registrationDepth == 0)
+    {
+        invalidatesAccessors = _needsPropertyAccessorInvalidation;
+        _needsPropertyAccessorInvalidation = NO;
+    }
+    [_pendingLock unlock];
+
+    if (invalidatesAccessors)
+    {
+        ETInvalidatePropertyAccessors();
+    }
+}
+
+- (void) discardResolvedLookups
+{
+    __sync_fetch_and_add(&_resolvedLookupGeneration, 1);
+}
+
+/* Discards the resolved lookups, and invalidates the property accessors once 
+the current registration batch ends. */
+- (void) discardResolvedLookupsAndPropertyAccessors
+{
+    BOOL invalidatesAccessors = NO;
+
+    [self discardResolvedLookups];
+
+    [_pendingLock lock];
+    if (_registrationDepth > 0)
+    {
+        _needsPropertyAccessorInvalidation = YES;
+    }
+    else
+    {
+        invalidatesAccessors = YES;
+    }
+    [_pendingLock unlock];
+
+    if (invalidatesAccessors)
+    {
+        ETInvalidatePropertyAccessors();
+    }
+}
+
 - (ETEntityDescription *) addUnresolvedEntityDescriptionForClass: (Class)aClass
 {
     NSParameterAssert([_entityDescriptionsByClass objectForKey: aClass] == nil);
@@ -49,8 +221,15 @@
     // 600 ms are spent in -addUnresolvedEntityDescriptionForClass: for EtoileUI
     // examples, and this assertion accounts for 80%). So it makes us lose
     // almost half a second at launch even on a recent machine.
-    ETDebugAssert([[[_classesByEntityDescription objectEnumerator] allObjects] containsObject: aClass] == NO);
+    ETDebugAssert([[_classesByEntityDescription allValues] containsObject: aClass] == NO);
+    /* Prevent -addUnresolvedDescription: from creating it again on lookup */
+    [self removePendingClass: aClass];
+
+    NSTimeInterval startTime = [NSDate timeIntervalSinceReferenceDate];
     ETEntityDescription *entityDesc = [aClass newEntityDescription];
+
+    _entityDescriptionCreationTime += [NSDate timeIntervalSinceReferenceDate] - startTime;
+    _createdEntityDescriptionCount++;
     [self addUnresolvedDescription: entityDesc];
     [self setEntityDescription: entityDesc forClass: aClass];
     RELEASE(entityDesc);
@@ -63,10 +242,12 @@
 {
     NSArray *objectPrimitiveNames = (id)[[[self newObjectPrimitives] mappedCollection] name];
 
+    [self beginRegistration];
+
     /* Don't overwrite existing entity descriptions such as primitives e.g. NSObject/Object */
     if ([_entityDescriptionsByClass objectForKey: aClass] == nil)
     {
-        [self addUnresolvedEntityDescriptionForClass: aClass];
+        [self addUnresolvedOrPendingEntityDescriptionForClass: aClass];
     }
 
     FOREACH([[ETReflection reflectClass: aClass] allSubclassMirrors], mirror, ETClassMirror *)
@@ -77,25 +258,160 @@
         if ([objectPrimitiveNames containsObject: [mirror name]])
              continue;
 
-        [self addUnresolvedEntityDescriptionForClass: [mirror representedClass]];
+        [self addUnresolvedOrPendingEntityDescriptionForClass: [mirror representedClass]];
     }
     if (resolve)
     {
         [self resolveNamedObjectReferences];
     }
+    [self endRegistration];
 }
 
 - (void) registerEntityDescriptionsForClasses: (NSSet *)classes
                                    resolveNow: (BOOL)resolve
 {
+    [self beginRegistration];
     for (Class class in classes)
     {
-        [self addUnresolvedEntityDescriptionForClass: class];
+        [self addUnresolvedOrPendingEntityDescriptionForClass: class];
     }
     if (resolve)
     {
         [self resolveNamedObjectReferences];
     }
+    [self endRegistration];
+}
+
+/* Lazy Registration */
+
+- (BOOL) registersEntityDescriptionsLazily
+{
+    return (_pendingClassesByName != nil);
+}
+
+- (void) setRegistersEntityDescriptionsLazily: (BOOL)lazily
+{
+    if (lazily == [self registersEntityDescriptionsLazily])
+        return;
+
+    if (lazily)
+    {
+        _pendingClassesByName = [[NSMutableDictionary alloc] init];
+    }
+    else
+    {
+        [self resolvePendingEntityDescriptions];
+        DESTROY(_pendingClassesByName);
+    }
+}
+
+- (void) addUnresolvedOrPendingEntityDescriptionForClass: (Class)aClass
+{
+    if (_pendingClassesByName == nil)
+    {
+        [self addUnresolvedEntityDescriptionForClass: aClass];
+    }
+    else
+    {
+        [_pendingLock lock];
+        [_pendingClassesByName setObject: aClass forKey: NSStringFromClass(aClass)];
+        [_pendingLock unlock];
+        /* Cached lookups could return the superclass entity description */
+        [self discardResolvedLookupsAndPropertyAccessors];
+    }
+}
+
+- (void) removePendingClass: (Class)aClass
+{
+    if (_pendingClassesByName == nil)
+        return;
+
+    NSString *className = NSStringFromClass(aClass);
+
+    [_pendingLock lock];
+    if ([_pendingClassesByName objectForKey: className] == aClass)
+    {
+        [_pendingClassesByName removeObjectForKey: className];
+    }
+    [_pendingLock unlock];
+}
+
+/* Creates and resolves the entity description of the given pending class, and 
+returns whether the class was pending.
+
+The referenced entity descriptions are created by -collectUnknownTypes, so 
+nothing is created while the references are being resolved. */
+- (BOOL) resolvePendingEntityDescriptionForClass: (Class)aClass
+{
+    if (_pendingClassesByName == nil)
+        return NO;
+
+    BOOL isPending = NO;
+
+    [_pendingLock lock];
+    if (_isResolving == NO
+     && [_pendingClassesByName objectForKey: NSStringFromClass(aClass)] == aClass)
+    {
+        [self beginRegistration];
+        [self addUnresolvedEntityDescriptionForClass: aClass];
+        [self resolveNamedObjectReferences];
+        [self endRegistration];
+        isPending = YES;
+    }
+    [_pendingLock unlock];
+    return isPending;
+}
+
+/* Creates and resolves the pending entity descriptions whose class name is a 
+component of the given description name (e.g. 'Anonymous.NSString' or 
+'NSString.length'). */
+- (BOOL) resolvePendingEntityDescriptionForName: (NSString *)aName
+{
+    if (_pendingClassesByName == nil)
+        return NO;
+
+    BOOL isPending = NO;
+
+    [_pendingLock lock];
+    if (_isResolving || [_pendingClassesByName count] == 0)
+    {
+        [_pendingLock unlock];
+        return NO;
+    }
+    [self beginRegistration];
+    for (NSString *component in [aName componentsSeparatedByString: @"."])
+    {
+        Class class = [_pendingClassesByName objectForKey: component];
+
+        if (class == Nil)
+            continue;
+
+        [self addUnresolvedEntityDescriptionForClass: class];
+        isPending = YES;
+    }
+    if (isPending)
+    {
+        [self resolveNamedObjectReferences];
+    }
+    [self endRegistration];
+    [_pendingLock unlock];
+    return isPending;
+}
+
+- (void) resolvePendingEntityDescriptions
+{
+    [_pendingLock lock];
+    if ([_pendingClassesByName count] > 0)
+    {
+        [self beginRegistration];
+        for (Class class in [_pendingClassesByName allValues])
+        {
+            [self addUnresolvedEntityDescriptionForClass: class];
+        }
+        [self resolveNamedObjectReferences];
+        [self endRegistration];
+    }
+    [_pendingLock unlock];
 }
 
 - (void) registerMetaMetamodel
@@ -175,6 +491,7 @@ static ETModelDescriptionRepository *mainRepo = nil;
 {
     NSArray *primitives = [objcPrimitives arrayByAddingObjectsFromArray: cPrimitives];
 
+    [self beginRegistration];
     FOREACH(primitives, cDesc, ETEntityDescription *)
     {
         [self addUnresolvedDescription: cDesc];
@@ -197,6 +514,12 @@ static ETModelDescriptionRepository *mainRepo = nil;
     [self setUpFM3BooleanPrimitive];
 
     [self resolveNamedObjectReferences];
+    [self endRegistration];
+}
+
++ (void) invalidateResolvedLookups
+{
+    ETInvalidateResolvedLookups();
 }
 
 static NSString *anonymousPackageName = @"Anonymous";
@@ -206,13 +529,18 @@ static NSString *anonymousPackageName = @"Anonymous";
     SUPERINIT;
     _unresolvedDescriptions = [[NSMutableSet alloc] init];
     _descriptionsByName = [[NSMutableDictionary alloc] init];
-#ifdef GNUSTEP
-    ASSIGN(_entityDescriptionsByClass, [NSMapTable mapTableWithStrongToStrongObjects]);
-    ASSIGN(_classesByEntityDescription, [NSMapTable mapTableWithStrongToStrongObjects]);
-#else
-    ASSIGN(_entityDescriptionsByClass, [NSMapTable strongToStrongObjectsMapTable]);
-    ASSIGN(_classesByEntityDescription, [NSMapTable strongToStrongObjectsMapTable]);
-#endif
+    _entityDescriptionsByClass = [[ETIdentityMap alloc] init];
+    _classesByEntityDescription = [[ETIdentityMap alloc] init];
+    _resolvedEntityDescriptionSlots =
+        calloc(ETResolvedLookupSlotCount, sizeof(ETResolvedLookupSlot));
+    _resolvedClassSlots = calloc(ETResolvedLookupSlotCount, sizeof(ETResolvedLookupSlot));
+
+    if (_resolvedEntityDescriptionSlots == NULL || _resolvedClassSlots == NULL)
+    {
+        [self release];
+        return nil;
+    }
+    _pendingLock = [[NSRecursiveLock alloc] init];
     [self setUpWithCPrimitives: [self newCPrimitives]
               objectPrimitives: [self newObjectPrimitives]];
     
@@ -233,6 +561,14 @@ static NSString *anonymousPackageName = @"Anonymous";
     DESTROY(_descriptionsByName);
     DESTROY(_entityDescriptionsByClass);
     DESTROY(_classesByEntityDescription);
+    free(_resolvedEntityDescriptionSlots);
+    if (_resolvedClassSlots != NULL)
+    {
+        ETResolvedLookupReleaseKeys(_resolvedClassSlots);
+    }
+    free(_resolvedClassSlots);
+    DESTROY(_pendingClassesByName);
+    DESTROY(_pendingLock);
     [super dealloc];
 }
 
@@ -287,6 +623,7 @@ static NSString *anonymousPackageName = @"Anonymous";
         [_descriptionsByName setObject: aDescription forKey: fullName];
     }
     [_descriptionsByName setObject: aDescription forKey: [aDescription fullName]];
+    [self discardResolvedLookups];
 }
 
 - (void) removeDescription: (ETModelElementDescription *)aDescription
@@ -309,6 +646,7 @@ static NSString *anonymousPackageName = @"Anonymous";
     }
     [_descriptionsByName removeObjectForKey: [aDescription fullName]];
     ETAssert([[_descriptionsByName allKeysForObject: aDescription] isEmpty]);
+    [self discardResolvedLookups];
 }
 
 - (NSArray *) packageDescriptions
@@ -344,19 +682,59 @@ static NSString *anonymousPackageName = @"Anonymous";
 
 - (id) descriptionForName: (NSString *)aFullName
 {
+    /* Lazy registration mutates the repository, so lookups must not run while 
+       another thread creates entity descriptions */
+    BOOL isLazy = (_pendingClassesByName != nil);
+
+    if (isLazy)
+    {
+        [_pendingLock lock];
+    }
+
     ETModelElementDescription *description = [_descriptionsByName objectForKey: aFullName];
     
-    if (description!= nil)
-        return description;
+    if (description == nil)
+    {
+        description = [_descriptionsByName objectForKey:
+            [self nameInAnonymousPackageForPartialName: aFullName]];
+    }
+    if (description == nil && [self resolvePendingEntityDescriptionForName: aFullName])
+    {
+        description = [self descriptionForName: aFullName];
+    }
 
-    return [_descriptionsByName objectForKey: [self nameInAnonymousPackageForPartialName: aFullName]];
+    if (isLazy)
+    {
+        [_pendingLock unlock];
+    }
+    return description;
 }
 
 /* Binding Descriptions to Class Instances and Prototypes */
 
 - (ETEntityDescription *) entityDescriptionForClass: (Class)aClass
 {
-    ETEntityDescription *entityDescription = [_entityDescriptionsByClass objectForKey: aClass];
+    if (aClass == Nil)
+        return nil;
+
+    /* Read before resolving, so a concurrent invalidation discards the result */
+    unsigned long generation = resolvedLookupGeneration + _resolvedLookupGeneration;
+    ETEntityDescription *entityDescription = nil;
+
+    if (ETResolvedLookupGet(_resolvedEntityDescriptionSlots, aClass, generation, &entityDescription))
+        return entityDescription;
+
+    /* Lazy registration mutates the repository, so lookups that miss must not 
+       run while another thread creates entity descriptions */
+    BOOL isLazy = (_pendingClassesByName != nil);
+
+    if (isLazy)
+    {
+        [_pendingLock lock];
+        [self resolvePendingEntityDescriptionForClass: aClass];
+    }
+
+    entityDescription = [_entityDescriptionsByClass objectForKey: aClass];
 
     if (entityDescription == nil)
     {
@@ -375,21 +753,42 @@ static NSString *anonymousPackageName = @"Anonymous";
         entityDescription = [_entityDescriptionsByClass objectForKey: usedClass];
     }
 
+    /* The superclass lookup caches the inherited entity description too */
     if (entityDescription == nil && [aClass superclass] != Nil)
     {
         entityDescription = [self entityDescriptionForClass: [aClass superclass]];
     }
+
+    if (isLazy)
+    {
+        [_pendingLock unlock];
+    }
+
+    ETResolvedLookupSet(_resolvedEntityDescriptionSlots, aClass, generation,
+        entityDescription, NO);
     return entityDescription;
 }
 
 - (Class) classForEntityDescription: (ETEntityDescription*)anEntityDescription
 {
-       Class cls = [_classesByEntityDescription objectForKey: anEntityDescription];
-       if (cls == Nil && [anEntityDescription parent] != nil)
-       {
-               cls = [self classForEntityDescription: [anEntityDescription parent]];
-       }
-       return cls;
+    if (anEntityDescription == nil)
+        return Nil;
+
+    unsigned long generation = resolvedLookupGeneration + _resolvedLookupGeneration;
+    Class cls = Nil;
+
+    if (ETResolvedLookupGet(_resolvedClassSlots, anEntityDescription, generation, &cls))
+        return cls;
+
+    cls = [_classesByEntityDescription objectForKey: anEntityDescription];
+
+    if (cls == Nil && [anEntityDescription parent] != nil)
+    {
+        cls = [self classForEntityDescription: [anEntityDescription parent]];
+    }
+
+    ETResolvedLookupSet(_resolvedClassSlots, anEntityDescription, generation, cls, YES);
+    return cls;
 }
 
 
@@ -403,8 +802,10 @@ static NSString *anonymousPackageName = @"Anonymous";
                     format: @"The entity description must have been previously "
                              "added to the repository"];
     }
+    [self removePendingClass: aClass];
     [_entityDescriptionsByClass setObject: anEntityDescription forKey: aClass];
     [_classesByEntityDescription setObject: aClass forKey: anEntityDescription];
+    [self discardResolvedLookupsAndPropertyAccessors];
 }
 
 - (void) addUnresolvedDescription: (ETModelElementDescription *)aDescription
@@ -662,6 +1063,10 @@ entity, which means examining their entity is enough to collect the package name
 
 - (void) resolveNamedObjectReferences
 {
+    NSTimeInterval startTime = [NSDate timeIntervalSinceReferenceDate];
+    BOOL wasResolving = _isResolving;
+
+    _isResolving = YES;
     [self collectUnknownTypes];
 
     NSMutableSet *unresolvedPackageDescs = [NSMutableSet setWithSet: _unresolvedDescriptions];
@@ -682,6 +1087,373 @@ entity, which means examining their entity is enough to collect the package name
     [self resolveAndAddPropertyDescriptions: unresolvedPropertyDescs];
 
     ASSIGN(_unresolvedDescriptions, [NSMutableSet set]);
+    _isResolving = wasResolving;
+
+    if (_isResolving == NO)
+    {
+        _resolutionTime += [NSDate timeIntervalSinceReferenceDate] - startTime;
+    }
+}
+
+/* Metamodel Snapshots */
+
+#define ETModelDescriptionSnapshotVersion 1
+
+static inline uint64_t ETFNV1aHashString(uint64_t hash, NSString *aString)
+{
+    for (const unsigned char *c = (const unsigned char *)[aString UTF8String]; *c != '\0'; c++)
+    {
+        hash = (hash ^ *c) * 0x100000001B3ULL;
+    }
+    return hash;
+}
+
++ (NSString *) snapshotFingerprint
+{
+    NSMutableArray *names = [NSMutableArray array];
+    NSMutableSet *bundles = [NSMutableSet setWithObject: [NSBundle mainBundle]];
+    NSFileManager *fileManager = [NSFileManager defaultManager];
+
+    [bundles addObjectsFromArray: [NSBundle allBundles]];
+    [bundles addObjectsFromArray: [NSBundle allFrameworks]];
+
+    for (NSBundle *bundle in bundles)
+    {
+        NSString *path = [bundle executablePath];
+
+        if (path == nil)
+            continue;
+
+        NSDictionary *attributes = [fileManager attributesOfItemAtPath: path error: NULL];
+
+        [names addObject: [NSString stringWithFormat: @"%@ %f %llu", path,
+            [[attributes fileModificationDate] timeIntervalSinceReferenceDate],
+            [attributes fileSize]]];
+    }
+    [names sortUsingSelector: @selector(compare:)];
+
+    uint64_t hash = 0xCBF29CE484222325ULL;
+
+    for (NSString *name in names)
+    {
+        hash = ETFNV1aHashString(hash, name);
+        hash = (hash ^ '\n') * 0x100000001B3ULL;
+    }
+    return [NSString stringWithFormat: @"%016llx-%lu",
+        (unsigned long long)hash, (unsigned long)[names count]];
+}
+
+/* Returns whether a description referencing the given entity description can 
+be written to a snapshot.
+
+Primitives exist in every repository, other entity descriptions must be 
+written to the snapshot too. */
+- (BOOL) isSnapshotReference: (ETEntityDescription *)anEntityDesc
+{
+    return (anEntityDesc == nil || [anEntityDesc isPrimitive]
+        || [_classesByEntityDescription objectForKey: anEntityDesc] != Nil);
+}
+
+- (NSDictionary *) snapshotPropertyListForPropertyDescription: (ETPropertyDescription *)aPropertyDesc
+{
+    if ([aPropertyDesc role] != nil || [aPropertyDesc commitDescriptor] != nil)
+        return nil;
+
+    if ([self isSnapshotReference: [aPropertyDesc type]] == NO
+     || [self isSnapshotReference: [aPropertyDesc persistentType]] == NO
+     || [self isSnapshotReference: [[aPropertyDesc opposite] owner]] == NO)
+    {
+        return nil;
+    }
+
+    NSMutableDictionary *plist = [NSMutableDictionary dictionary];
+
+    [plist setObject: NSStringFromClass([aPropertyDesc class]) forKey: @"descriptionClass"];
+    [plist setObject: [aPropertyDesc name] forKey: @"name"];
+    [plist setValue: [[aPropertyDesc type] fullName] forKey: @"typeName"];
+    [plist setValue: [[aPropertyDesc persistentType] fullName] forKey: @"persistentTypeName"];
+    [plist setValue: [[aPropertyDesc opposite] fullName] forKey: @"oppositeName"];
+    [plist setValue: [[aPropertyDesc package] name] forKey: @"packageName"];
+    [plist setValue: [aPropertyDesc valueTransformerName] forKey: @"valueTransformerName"];
+    [plist setValue: [aPropertyDesc detailedPropertyNames] forKey: @"detailedPropertyNames"];
+    [plist setValue: [aPropertyDesc displayName] forKey: @"displayName"];
+    [plist setValue: [aPropertyDesc itemIdentifier] forKey: @"itemIdentifier"];
+    [plist setObject: [NSNumber numberWithBool: [aPropertyDesc isDerived]] forKey: @"derived"];
+    [plist setObject: [NSNumber numberWithBool: [aPropertyDesc isMultivalued]] forKey: @"multivalued"];
+    [plist setObject: [NSNumber numberWithBool: [aPropertyDesc isOrdered]] forKey: @"ordered"];
+    [plist setObject: [NSNumber numberWithBool: [aPropertyDesc isKeyed]] forKey: @"keyed"];
+    [plist setObject: [NSNumber numberWithBool: [aPropertyDesc isReadOnly]] forKey: @"readOnly"];
+    [plist setObject: [NSNumber numberWithBool: [aPropertyDesc isPersistent]] forKey: @"persistent"];
+    [plist setObject: [NSNumber numberWithBool: [aPropertyDesc isIndexed]] forKey: @"indexed"];
+    [plist setObject: [NSNumber numberWithBool: [aPropertyDesc showsItemDetails]] forKey: @"showsItemDetails"];
+    [plist setObject: [NSNumber numberWithBool: [aPropertyDesc isMetaMetamodel]] forKey: @"isMetaMetamodel"];
+    return plist;
+}
+
+/* Returns nil when the entity description must be rebuilt with 
++newEntityDescription when loading the snapshot. */
+- (NSDictionary *) snapshotPropertyListForEntityDescription: (ETEntityDescription *)anEntityDesc
+                                                   forClass: (Class)aClass
+{
+    if ([self isSnapshotReference: [anEntityDesc parent]] == NO)
+        return nil;
+
+    NSMutableArray *propertyPlists = [NSMutableArray array];
+
+    for (ETPropertyDescription *propertyDesc in [anEntityDesc propertyDescriptions])
+    {
+        NSDictionary *propertyPlist =
+            [self snapshotPropertyListForPropertyDescription: propertyDesc];
+
+        if (propertyPlist == nil)
+            return nil;
+
+        [propertyPlists addObject: propertyPlist];
+    }
+
+    NSMutableDictionary *plist = [NSMutableDictionary dictionary];
+
+    [plist setObject: NSStringFromClass(aClass) forKey: @"className"];
+    [plist setObject: NSStringFromClass([anEntityDesc class]) forKey: @"descriptionClass"];
+    [plist setObject: [anEntityDesc name] forKey: @"name"];
+    [plist setObject: [anEntityDesc fullName] forKey: @"fullName"];
+    [plist setValue: [[anEntityDesc owner] name] forKey: @"ownerName"];
+    [plist setValue: [[anEntityDesc parent] fullName] forKey: @"parentName"];
+    [plist setValue: [anEntityDesc localizedDescription] forKey: @"localizedDescription"];
+    [plist setValue: [anEntityDesc UIBuilderPropertyNames] forKey: @"UIBuilderPropertyNames"];
+    [plist setValue: [anEntityDesc diffAlgorithm] forKey: @"diffAlgorithm"];
+    [plist setValue: [anEntityDesc displayName] forKey: @"displayName"];
+    [plist setValue: [anEntityDesc itemIdentifier] forKey: @"itemIdentifier"];
+    [plist setObject: [NSNumber numberWithBool: [anEntityDesc isAbstract]] forKey: @"abstract"];
+    [plist setObject: [NSNumber numberWithBool: [anEntityDesc isMetaMetamodel]] forKey: @"isMetaMetamodel"];
+    [plist setObject: propertyPlists forKey: @"properties"];
+    return plist;
+}
+
+- (NSDictionary *) snapshotPropertyListForPackageDescription: (ETPackageDescription *)aPackageDesc
+{
+    return D([aPackageDesc name], @"name",
+             [NSNumber numberWithUnsignedInteger: [aPackageDesc version]], @"version",
+             [NSNumber numberWithBool: [aPackageDesc supportsNamespace]], @"supportsNamespace");
+}
+
+- (BOOL) writeSnapshotToFile: (NSString *)aPath
+{
+    NILARG_EXCEPTION_TEST(aPath);
+    [self resolvePendingEntityDescriptions];
+
+    NSMutableArray *entityPlists = [NSMutableArray array];
+    NSMutableArray *rebuiltClassNames = [NSMutableArray array];
+    NSMutableDictionary *packagePlists = [NSMutableDictionary dictionary];
+
+    [_entityDescriptionsByClass enumerateKeysAndObjectsUsingBlock: ^(id class, id entityDesc, BOOL *stop)
+    {
+        if ([entityDesc isPrimitive])
+            return;
+
+        NSDictionary *entityPlist =
+            [self snapshotPropertyListForEntityDescription: entityDesc forClass: class];
+
+        if (entityPlist == nil)
+        {
+            [rebuiltClassNames addObject: NSStringFromClass(class)];
+            return;
+        }
+        [entityPlists addObject: entityPlist];
+
+        NSMutableSet *packageDescs = [NSMutableSet set];
+
+        if ([entityDesc owner] != nil)
+        {
+            [packageDescs addObject: [entityDesc owner]];
+        }
+        for (ETPropertyDescription *propertyDesc in [entityDesc propertyDescriptions])
+        {
+            if ([propertyDesc package] != nil)
+            {
+                [packageDescs addObject: [propertyDesc package]];
+            }
+        }
+        for (ETPackageDescription *packageDesc in packageDescs)
+        {
+            [packagePlists setObject: [self snapshotPropertyListForPackageDescription: packageDesc]
+                              forKey: [packageDesc name]];
+        }
+    }];
+
+    NSDictionary *snapshot = D([NSNumber numberWithInt: ETModelDescriptionSnapshotVersion], @"version",
+        [[self class] snapshotFingerprint], @"fingerprint",
+        [packagePlists allValues], @"packages",
+        entityPlists, @"entities",
+        rebuiltClassNames, @"rebuiltClassNames");
+    NSData *data = [NSPropertyListSerialization dataFromPropertyList: snapshot
+                                                              format: NSPropertyListBinaryFormat_v1_0
+                                                    errorDescription: NULL];
+
+    return [data writeToFile: aPath atomically: YES];
+}
+
+- (NSDictionary *) loadableSnapshotFromFile: (NSString *)aPath
+{
+    NSData *data = [NSData dataWithContentsOfMappedFile: aPath];
+
+    if (data == nil)
+        return nil;
+
+    NSDictionary *snapshot = [NSPropertyListSerialization propertyListFromData: data
+                                                              mutabilityOption: NSPropertyListImmutable
+                                                                        format: NULL
+                                                              errorDescription: NULL];
+
+    if ([snapshot isKindOfClass: [NSDictionary class]] == NO
+     || [[snapshot objectForKey: @"version"] isEqual:
+            [NSNumber numberWithInt: ETModelDescriptionSnapshotVersion]] == NO
+     || [[snapshot objectForKey: @"fingerprint"] isEqual: [[self class] snapshotFingerprint]] == NO)
+    {
+        return nil;
+    }
+    return snapshot;
+}
+
+- (ETPropertyDescription *) propertyDescriptionWithSnapshotPropertyList: (NSDictionary *)plist
+{
+    Class descriptionClass = NSClassFromString([plist objectForKey: @"descriptionClass"]);
+    ETPropertyDescription *propertyDesc =
+        AUTORELEASE([[descriptionClass alloc] initWithName: [plist objectForKey: @"name"]]);
+
+    [propertyDesc setTypeName: [plist objectForKey: @"typeName"]];
+    [propertyDesc setPersistentTypeName: [plist objectForKey: @"persistentTypeName"]];
+    [propertyDesc setOppositeName: [plist objectForKey: @"oppositeName"]];
+    [propertyDesc setPackageName: [plist objectForKey: @"packageName"]];
+    [propertyDesc setValueTransformerName: [plist objectForKey: @"valueTransformerName"]];
+    [propertyDesc setDisplayName: [plist objectForKey: @"displayName"]];
+    [propertyDesc setItemIdentifier: [plist objectForKey: @"itemIdentifier"]];
+    [propertyDesc setDerived: [[plist objectForKey: @"derived"] boolValue]];
+    [propertyDesc setMultivalued: [[plist objectForKey: @"multivalued"] boolValue]];
+    [propertyDesc setOrdered: [[plist objectForKey: @"ordered"] boolValue]];
+    [propertyDesc setKeyed: [[plist objectForKey: @"keyed"] boolValue]];
+    [propertyDesc setReadOnly: [[plist objectForKey: @"readOnly"] boolValue]];
+    [propertyDesc setPersistent: [[plist objectForKey: @"persistent"] boolValue]];
+    [propertyDesc setIndexed: [[plist objectForKey: @"indexed"] boolValue]];
+    [propertyDesc setShowsItemDetails: [[plist objectForKey: @"showsItemDetails"] boolValue]];
+    [propertyDesc setIsMetaMetamodel: [[plist objectForKey: @"isMetaMetamodel"] boolValue]];
+
+    if ([plist objectForKey: @"detailedPropertyNames"] != nil)
+    {
+        [propertyDesc setDetailedPropertyNames: [plist objectForKey: @"detailedPropertyNames"]];
+    }
+    return propertyDesc;
+}
+
+- (ETEntityDescription *) entityDescriptionWithSnapshotPropertyList: (NSDictionary *)plist
+{
+    Class descriptionClass = NSClassFromString([plist objectForKey: @"descriptionClass"]);
+    ETEntityDescription *entityDesc =
+        AUTORELEASE([[descriptionClass alloc] initWithName: [plist objectForKey: @"name"]]);
+    NSMutableArray *propertyDescs = [NSMutableArray array];
+
+    for (NSDictionary *propertyPlist in [plist objectForKey: @"properties"])
+    {
+        [propertyDescs addObject: [self propertyDescriptionWithSnapshotPropertyList: propertyPlist]];
+    }
+
+    [entityDesc setOwnerName: [plist objectForKey: @"ownerName"]];
+    [entityDesc setParentName: [plist objectForKey: @"parentName"]];
+    [entityDesc setLocalizedDescription: [plist objectForKey: @"localizedDescription"]];
+    [entityDesc setDiffAlgorithm: [plist objectForKey: @"diffAlgorithm"]];
+    [entityDesc setDisplayName: [plist objectForKey: @"displayName"]];
+    [entityDesc setItemIdentifier: [plist objectForKey: @"itemIdentifier"]];
+    [entityDesc setAbstract: [[plist objectForKey: @"abstract"] boolValue]];
+    [entityDesc setIsMetaMetamodel: [[plist objectForKey: @"isMetaMetamodel"] boolValue]];
+    [entityDesc setPropertyDescriptions: propertyDescs];
+
+    if ([plist objectForKey: @"UIBuilderPropertyNames"] != nil)
+    {
+        [entityDesc setUIBuilderPropertyNames: [plist objectForKey: @"UIBuilderPropertyNames"]];
+    }
+    return entityDesc;
+}
+
+- (BOOL) loadSnapshotFromFile: (NSString *)aPath
+{
+    NILARG_EXCEPTION_TEST(aPath);
+    NSTimeInterval startTime = [NSDate timeIntervalSinceReferenceDate];
+    NSDictionary *snapshot = [self loadableSnapshotFromFile: aPath];
+
+    if (snapshot == nil)
+        return NO;
+
+    [_pendingLock lock];
+    [self beginRegistration];
+
+    for (NSDictionary *packagePlist in [snapshot objectForKey: @"packages"])
+    {
+        NSString *name = [packagePlist objectForKey: @"name"];
+
+        if ([self descriptionForName: name] != nil)
+            continue;
+
+        ETPackageDescription *packageDesc = [ETPackageDescription descriptionWithName: name];
+
+        [packageDesc setVersion: [[packagePlist objectForKey: @"version"] unsignedIntegerValue]];
+        [packageDesc setSupportsNamespace: [[packagePlist objectForKey: @"supportsNamespace"] boolValue]];
+        [self addDescription: packageDesc];
+    }
+
+    for (NSDictionary *entityPlist in [snapshot objectForKey: @"entities"])
+    {
+        Class class = NSClassFromString([entityPlist objectForKey: @"className"]);
+
+        /* Skip classes no longer linked, and don't replace entity descriptions 
+           bound in the receiver */
+        if (class == Nil
+         || [_entityDescriptionsByClass objectForKey: class] != nil
+         || [_descriptionsByName objectForKey: [entityPlist objectForKey: @"fullName"]] != nil)
+        {
+            continue;
+        }
+
+        ETEntityDescription *entityDesc =
+            [self entityDescriptionWithSnapshotPropertyList: entityPlist];
+
+        [self removePendingClass: class];
+        [self addUnresolvedDescription: entityDesc];
+        [self setEntityDescription: entityDesc forClass: class];
+        _snapshotEntityDescriptionCount++;
+    }
+
+    for (NSString *className in [snapshot objectForKey: @"rebuiltClassNames"])
+    {
+        Class class = NSClassFromString(className);
+
+        if (class == Nil || [_entityDescriptionsByClass objectForKey: class] != nil)
+            continue;
+
+        [self addUnresolvedEntityDescriptionForClass: class];
+    }
+
+    [self resolveNamedObjectReferences];
+    [self endRegistration];
+    [_pendingLock unlock];
+
+    _snapshotLoadTime += [NSDate timeIntervalSinceReferenceDate] - startTime;
+    return YES;
+}
+
+/* Startup Instrumentation */
+
+- (NSDictionary *) startupStatistics
+{
+    [_pendingLock lock];
+    NSUInteger pendingCount = [_pendingClassesByName count];
+    [_pendingLock unlock];
+
+    return D([NSNumber numberWithUnsignedInteger: _createdEntityDescriptionCount], @"createdEntityDescriptionCount",
+             [NSNumber numberWithDouble: _entityDescriptionCreationTime], @"entityDescriptionCreationTime",
+             [NSNumber numberWithDouble: _resolutionTime], @"resolutionTime",
+             [NSNumber numberWithUnsignedInteger: _snapshotEntityDescriptionCount], @"snapshotEntityDescriptionCount",
+             [NSNumber numberWithDouble: _snapshotLoadTime], @"snapshotLoadTime",
+             [NSNumber numberWithUnsignedInteger: pendingCount], @"pendingEntityDescriptionCount");
 }
 
 - (void) checkConstraints: (NSMutableArray *)warnings
@@ -700,7 +1472,7 @@ By default, returns NO since an anonymous package descriptions is registered in
 any new repository. */
 - (BOOL) isEmpty
 {
-    return ([[self packageDescriptions] count] == 0);
+    return ([self count] == 0);
 }
 
 /** Returns a dictionary containing all the registered descriptions keyed by
@@ -722,7 +1494,13 @@ You must assume that <code>[[self content] count] != [[self contentArray] count]
 /** Returns the number of registered package descriptions. */
 - (NSUInteger) count
 {
-    return [[self packageDescriptions] count];
+    NSUInteger count = 0;
+
+    for (ETModelElementDescription *description in self)
+    {
+        count++;
+    }
+    return count;
 }
 
 /** Returns an object to enumerate the registered package descriptions. */
@@ -731,6 +1509,38 @@ You must assume that <code>[[self content] count] != [[self contentArray] count]
     return [[self packageDescriptions] objectEnumerator];
 }
 
+/** Returns the registered package descriptions through <var>objects</var>, 
+in chunks of at most <var>count</var> descriptions.
+
+The descriptions are read from -content as the enumeration goes, so no array 
+is created unlike with -contentArray. */
+- (NSUInteger) countByEnumeratingWithState: (NSFastEnumerationState *)state 
+                                   objects: (id *)objects
+                                     count: (NSUInteger)count
+{
+    NSUInteger n = 0;
+
+    while ((n = [_descriptionsByName countByEnumeratingValuesWithState: state
+                                                               objects: objects
+                                                                 count: count]) > 0)
+    {
+        NSUInteger packageCount = 0;
+
+        for (NSUInteger i = 0; i < n; i++)
+        {
+            if ([objects[i] isPackageDescription])
+            {
+                objects[packageCount++] = objects[i];
+            }
+        }
+        if (packageCount > 0)
+        {
+            return packageCount;
+        }
+    }
+    return 0;
+}
+
 - (void) insertObject: (id)object atIndex: (NSUInteger)index hint: (id)hint
 {
     [self addDescription: object];
@@ -19,11 +19,16 @@
 
 @synthesize representedObject = _representedObject, name = _name;
 
+static ETPropertyID valuePropertyID = NULL;
+static ETPropertyID selfPropertyID = NULL;
+
 + (void) initialize
 {
     if (self != [ETMutableObjectViewpoint class])
         return;
-    
+
+    valuePropertyID = ETPropertyIDForName(@"value");
+    selfPropertyID = ETPropertyIDForName(@"self");
     [self applyTraitFromClass: [ETViewpointTrait class]];
 }
 
@@ -109,9 +114,9 @@ identified by the given name in object. */
 {
     // TODO: We could support setting a custom observed key path, to control more precisely if we
     // observe all the objects in the path or not.
-    NSString *observedProperty = [[[self name] componentsSeparatedByString: @"."] firstObject];
+    ETPropertyID observedPropertyID = [[ETPropertyPath pathWithString: [self name]] firstPropertyID];
 
-    return ([observedProperty isEqualToString: @"self"] ? nil : observedProperty);
+    return (observedPropertyID == selfPropertyID ? nil : ETPropertyIDName(observedPropertyID));
 }
 
 - (BOOL) isObservableObject: (id)anObject
@@ -243,6 +248,12 @@ See -usesKeyValueCodingForAccessingValueProperties. */
     _isSettingValue = NO;
 }
 
+/** Returns YES, since the property names are those of -value. */
++ (BOOL) hasInstanceSpecificPropertyNames
+{
+    return YES;
+}
+
 - (NSArray *) propertyNames
 {
     // FIXME: See +intialize
@@ -266,11 +277,14 @@ See -usesKeyValueCodingForAccessingValueProperties. */
 This method accesses properties of the represented element. */
 - (id) valueForProperty: (NSString *)aProperty
 {
-    if ([aProperty isEqualToString: @"value"] && [[self value] isViewpoint] == NO)
+    ETPropertyID propertyID = ETDeclaredPropertyIDForName(self, aProperty);
+
+    /* The value can accept property names we don't know about */
+    if (NULL == propertyID)
     {
-        return [super valueForProperty: aProperty];
+        return [[self value] valueForProperty: aProperty];
     }
-    return [[self value] valueForProperty: aProperty];
+    return [self valueForPropertyID: propertyID];
 }
 
 /** Sets the value bound to the given property of -value.
@@ -278,18 +292,38 @@ This method accesses properties of the represented element. */
 This method accesses properties of the represented property or element. */
 - (BOOL) setValue: (id)aValue forProperty: (NSString *)aProperty
 {
-    if ([aProperty isEqualToString: @"value"] && [[self value] isViewpoint] == NO)
+    ETPropertyID propertyID = ETDeclaredPropertyIDForName(self, aProperty);
+
+    if (NULL == propertyID)
+    {
+        return [[self value] setValue: aValue forProperty: aProperty];
+    }
+    return [self setValue: aValue forPropertyID: propertyID];
+}
+
+- (id) valueForPropertyID: (ETPropertyID)aPropertyID
+{
+    if (aPropertyID == valuePropertyID && [[self value] isViewpoint] == NO)
+    {
+        return [super valueForPropertyID: aPropertyID];
+    }
+    return [[self value] valueForPropertyID: aPropertyID];
+}
+
+- (BOOL) setValue: (id)aValue forPropertyID: (ETPropertyID)aPropertyID
+{
+    if (aPropertyID == valuePropertyID && [[self value] isViewpoint] == NO)
     {
-        return [super setValue: aValue forProperty: aProperty];
+        return [super setValue: aValue forPropertyID: aPropertyID];
     }
 
     if ([self isMutableValue])
     {
-        return [[self value] setValue: aValue forProperty: aProperty];
+        return [[self value] setValue: aValue forPropertyID: aPropertyID];
     }
     else
     {
-        return [super setValue: aValue forProperty: aProperty];
+        return [super setValue: aValue forPropertyID: aPropertyID];
     }
 }
 
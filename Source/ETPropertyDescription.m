@@ -151,6 +151,11 @@
     }
 }
 
+- (ETPropertyID) propertyID
+{
+    return ETPropertyIDForName([self name]);
+}
+
 - (BOOL) isComposite
 {
     return [[self opposite] isContainer];
@@ -8,13 +8,652 @@
 #import "ETPropertyValueCoding.h"
 #import "ETEntityDescription.h"
 #import "ETModelDescriptionRepository.h"
+#import "ETCIdentityMap.h"
 #import "Macros.h"
 #import "NSObject+Model.h"
 #import "EtoileCompatibility.h"
+#include <objc/runtime.h>
+#include <pthread.h>
+#include <stdint.h>
 
 
+/* Property Identifiers
+
+The property IDs are interned in an open addressing hash table, which is read 
+without locking. Property IDs are only added, and are written before being 
+published in a slot, so a reader sees either an empty slot or a complete ID.
+
+When the table grows, it is replaced by a copy twice as large. The previous 
+tables are never freed, since readers may still be probing them, but they 
+take less memory than the current one. A reader probing a previous table can 
+miss a new ID, in which case it looks it up again under the lock. */
+
+struct _ETPropertyID
+{
+    NSString *name;
+    NSUInteger hash;
+};
+
+typedef struct
+{
+    NSUInteger count;
+    /* Power of two */
+    NSUInteger capacity;
+    struct _ETPropertyID * volatile slots[];
+} ETPropertyIDTable;
+
+#define ETPropertyIDTableInitialCapacity 256
+
+/* Statically initialized, so property IDs can be created before +load */
+static pthread_mutex_t propertyIDLock = PTHREAD_MUTEX_INITIALIZER;
+static ETPropertyIDTable * volatile propertyIDTable = NULL;
+
+static ETPropertyIDTable *ETPropertyIDTableNew(NSUInteger capacity)
+{
+    ETPropertyIDTable *table =
+        calloc(1, sizeof(ETPropertyIDTable) + capacity * sizeof(struct _ETPropertyID *));
+
+    table->capacity = capacity;
+    return table;
+}
+
+static ETPropertyID ETPropertyIDTableGet(ETPropertyIDTable *table, NSString *aName,
+                                         NSUInteger hash)
+{
+    if (table == NULL)
+        return NULL;
+
+    NSUInteger mask = table->capacity - 1;
+
+    for (NSUInteger i = hash & mask; table->slots[i] != NULL; i = (i + 1) & mask)
+    {
+        ETPropertyID propertyID = table->slots[i];
+
+        /* Read the ID after the slot */
+        __sync_synchronize();
+
+        if (propertyID->hash == hash && [propertyID->name isEqualToString: aName])
+            return propertyID;
+    }
+    return NULL;
+}
+
+static void ETPropertyIDTableInsert(ETPropertyIDTable *table, struct _ETPropertyID *propertyID)
+{
+    NSUInteger mask = table->capacity - 1;
+    NSUInteger i = propertyID->hash & mask;
+
+    while (table->slots[i] != NULL)
+    {
+        i = (i + 1) & mask;
+    }
+    /* Publish the ID once it is written */
+    __sync_synchronize();
+    table->slots[i] = propertyID;
+    table->count++;
+}
+
+/* Returns the property ID for an already interned name, or NULL. */
+static ETPropertyID ETInternedPropertyIDForName(NSString *aName, NSUInteger hash)
+{
+    ETPropertyIDTable *table = propertyIDTable;
+
+    __sync_synchronize();
+    return ETPropertyIDTableGet(table, aName, hash);
+}
+
+ETPropertyID ETPropertyIDForName(NSString *aName)
+{
+    if (aName == nil)
+        return NULL;
+
+    NSUInteger hash = [aName hash];
+    ETPropertyID propertyID = ETInternedPropertyIDForName(aName, hash);
+
+    if (propertyID != NULL)
+        return propertyID;
+
+    pthread_mutex_lock(&propertyIDLock);
+
+    ETPropertyIDTable *table = propertyIDTable;
+
+    propertyID = ETPropertyIDTableGet(table, aName, hash);
+
+    if (propertyID == NULL)
+    {
+        /* Keep the load factor under 1/2 */
+        if (table == NULL || (table->count + 1) * 2 > table->capacity)
+        {
+            ETPropertyIDTable *newTable = ETPropertyIDTableNew(table != NULL
+                ? table->capacity * 2 : ETPropertyIDTableInitialCapacity);
+
+            for (NSUInteger i = 0; table != NULL && i < table->capacity; i++)
+            {
+                if (table->slots[i] != NULL)
+                {
+                    ETPropertyIDTableInsert(newTable, table->slots[i]);
+                }
+            }
+            __sync_synchronize();
+            propertyIDTable = newTable;
+            table = newTable;
+        }
+
+        /* Property identifiers are never deallocated */
+        struct _ETPropertyID *newPropertyID = malloc(sizeof(struct _ETPropertyID));
+
+        newPropertyID->name = [aName copy];
+        newPropertyID->hash = hash;
+        ETPropertyIDTableInsert(table, newPropertyID);
+        propertyID = newPropertyID;
+    }
+
+    pthread_mutex_unlock(&propertyIDLock);
+    return propertyID;
+}
+
+NSString *ETPropertyIDName(ETPropertyID aPropertyID)
+{
+    return (aPropertyID != NULL ? aPropertyID->name : nil);
+}
+
+/* Compiled Property Accessors
+
+-valueForProperty: and -setValue:forProperty: resolve each property once per 
+class into an ETPropertyAccess, which records how to access it: an object 
+getter or setter IMP, an object ivar offset, or the basic Key Value Coding as 
+a fallback for the other cases (scalar types, undefined keys etc.).
+
+Whether the property is listed in -propertyNames is cached too, unless 
++hasInstanceSpecificPropertyNames returns YES (e.g. ETKeyValuePair, which 
+exposes the properties of its value), in which case -propertyNames is checked 
+on each access. Most classes overriding -propertyNames, such as model 
+descriptions or mirrors, return the same names for all their instances and 
+get the per class cache.
+
+The accessors are keyed by the runtime class rather than -class, so Key Value 
+Observing subclasses get their own accessors with the setters that post 
+notifications. For each class, the accessors are keyed by property ID.
+
+The accessors are created under a lock, but looked up through a direct-mapped 
+cache which is read without locking, using the same sequence lock as the 
+property path steps (see ETPropertyPathStepAccess()). */
+
+typedef enum
+{
+    ETPropertyAccessKVC,
+    ETPropertyAccessMethod,
+    ETPropertyAccessIvar
+} ETPropertyAccessKind;
+
+typedef struct
+{
+    /* Whether -valueForPropertyID: and -setValue:forPropertyID: must call 
+       -valueForProperty: and -setValue:forProperty: overriden in a subclass 
+       (this is per class, but copied into each access) */
+    BOOL forwardsGetter;
+    BOOL forwardsSetter;
+    /* Whether ETPropertyPath must send -valueForPropertyID: and 
+       -setValue:forPropertyID:, because the class overrides Property Value 
+       Coding */
+    BOOL sendsGetter;
+    BOOL sendsSetter;
+    /* Whether +hasInstanceSpecificPropertyNames returns YES, in which case 
+       isProperty is unset and must be checked for each object */
+    BOOL checksPropertyNames;
+    BOOL isProperty;
+    ETPropertyAccessKind getterKind;
+    SEL getterSelector;
+    IMP getter;
+    ptrdiff_t ivarOffset;
+    ETPropertyAccessKind setterKind;
+    SEL setterSelector;
+    IMP setter;
+} ETPropertyAccess;
+
+/* Statically initialized, so accessors can be resolved before +load */
+static pthread_mutex_t accessorLock = PTHREAD_MUTEX_INITIALIZER;
+/* Runtime classes mapped to ETCIdentityMap tables, which map property IDs to 
+   malloc'ed ETPropertyAccess structs */
+static ETCIdentityMap accessorsByClass = NULL;
+/* Incremented on invalidation, to discard accessors resolved meanwhile */
+static unsigned long accessorGeneration = 0;
+
+#define ETPropertyAccessCacheSize 512
+
+struct _ETPropertyAccessCacheSlot
+{
+    volatile unsigned long sequence;
+    Class cachedClass;
+    ETPropertyID propertyID;
+    unsigned long generation;
+    ETPropertyAccess access;
+};
+
+static struct _ETPropertyAccessCacheSlot accessCache[ETPropertyAccessCacheSize];
+
+static void ETFreePropertyAccesses(void *accesses)
+{
+    ETCIdentityMapFree(accesses);
+}
+
+static void ETFreePropertyAccess(void *access)
+{
+    free(access);
+}
+
+static const ETCIdentityMapValueCallBacks ETPropertyAccessesCallBacks =
+    { NULL, ETFreePropertyAccesses };
+static const ETCIdentityMapValueCallBacks ETPropertyAccessCallBacks =
+    { NULL, ETFreePropertyAccess };
+
+void ETInvalidatePropertyAccessors(void)
+{
+    pthread_mutex_lock(&accessorLock);
+    /* Traits can be applied before any accessor has been resolved */
+    if (accessorsByClass != NULL)
+    {
+        ETCIdentityMapRemoveAll(accessorsByClass);
+    }
+    /* Read without the lock by the accessor cache and ETPropertyPath */
+    __sync_fetch_and_add(&accessorGeneration, 1);
+    pthread_mutex_unlock(&accessorLock);
+}
+
+/* Undeclared Names
+
+ETDeclaredPropertyIDForName() doesn't intern the names missing from 
+-propertyNames, so without a cache, each lookup of such a name would call 
+-propertyNames again. For classes whose property names don't vary per 
+instance, the last undeclared name seen is remembered per slot of a small 
+direct-mapped cache, keyed by class and name hash. The names are copied, so 
+the cache size bounds the memory used by arbitrary strings. The slots are 
+discarded with the accessors by ETInvalidatePropertyAccessors(). */
+
+#define ETUndeclaredNameCacheSize 256
+
+struct _ETUndeclaredNameSlot
+{
+    Class cachedClass;
+    NSString *name;
+    unsigned long generation;
+};
+
+static pthread_mutex_t undeclaredNameLock = PTHREAD_MUTEX_INITIALIZER;
+static struct _ETUndeclaredNameSlot undeclaredNames[ETUndeclaredNameCacheSize];
+
+ETPropertyID ETDeclaredPropertyIDForName(id anObject, NSString *aName)
+{
+    if (aName == nil)
+        return NULL;
+
+    NSUInteger hash = [aName hash];
+    ETPropertyID propertyID = ETInternedPropertyIDForName(aName, hash);
+
+    if (propertyID != NULL || anObject == nil)
+        return propertyID;
+
+    Class cls = object_getClass(anObject);
+    BOOL isCacheable = ([cls hasInstanceSpecificPropertyNames] == NO);
+    struct _ETUndeclaredNameSlot *slot = &undeclaredNames[(((uintptr_t)cls >> 4) 
+        * 31 + hash) & (ETUndeclaredNameCacheSize - 1)];
+    unsigned long generation = accessorGeneration;
+
+    if (isCacheable)
+    {
+        pthread_mutex_lock(&undeclaredNameLock);
+        BOOL isUndeclared = (slot->cachedClass == cls && slot->generation == generation
+            && [slot->name isEqualToString: aName]);
+        pthread_mutex_unlock(&undeclaredNameLock);
+
+        if (isUndeclared)
+            return NULL;
+    }
+
+    if ([[anObject propertyNames] containsObject: aName])
+        return ETPropertyIDForName(aName);
+
+    if (isCacheable)
+    {
+        NSString *name = [aName copy];
+
+        pthread_mutex_lock(&undeclaredNameLock);
+        NSString *oldName = slot->name;
+        slot->cachedClass = cls;
+        slot->name = name;
+        slot->generation = generation;
+        pthread_mutex_unlock(&undeclaredNameLock);
+        [oldName release];
+    }
+    return NULL;
+}
+
+static char ETReturnOrArgumentType(const char *type)
+{
+    /* Skip type qualifiers such as const, in or out */
+    while (type != NULL && *type != '\0' && strchr("rnNoORV", *type) != NULL)
+    {
+        type++;
+    }
+    return (type != NULL ? *type : '\0');
+}
+
+static BOOL ETIsObjectType(char type)
+{
+    return (type == _C_ID || type == _C_CLASS);
+}
+
+/* Returns whether -valueForPropertyID: (or -setValue:forPropertyID:) is 
+   dispatched to NSObject, while the NSString-based method is overriden. In this 
+   case, NSObject must call the NSString-based method. If the property ID-based 
+   method is overriden, NSObject can only be reached through a call to super. */
+static BOOL ETOverridesOnlyNameBasedMethod(Class cls, SEL nameSelector, SEL propertyIDSelector)
+{
+    Class rootClass = [NSObject class];
+
+    return (class_getMethodImplementation(cls, propertyIDSelector)
+            == class_getMethodImplementation(rootClass, propertyIDSelector)
+         && class_getMethodImplementation(cls, nameSelector)
+            != class_getMethodImplementation(rootClass, nameSelector));
+}
+
+static void ETResolvePropertyGetter(Class cls, NSString *key, NSString *capitalizedKey,
+                                    ETPropertyAccess *access)
+{
+    /* Key Value Coding search order for accessors, then ivars */
+    NSArray *getterNames = A([@"get" stringByAppendingString: capitalizedKey], key,
+        [@"is" stringByAppendingString: capitalizedKey],
+        [@"_get" stringByAppendingString: capitalizedKey],
+        [@"_" stringByAppendingString: key]);
+
+    for (NSString *getterName in getterNames)
+    {
+        SEL selector = NSSelectorFromString(getterName);
+        Method method = class_getInstanceMethod(cls, selector);
+
+        if (method == NULL)
+            continue;
+
+        NSMethodSignature *sig = [cls instanceMethodSignatureForSelector: selector];
+
+        if ([sig numberOfArguments] == 2
+         && ETIsObjectType(ETReturnOrArgumentType([sig methodReturnType])))
+        {
+            access->getterKind = ETPropertyAccessMethod;
+            access->getterSelector = selector;
+            access->getter = method_getImplementation(method);
+        }
+        return;
+    }
+
+    if ([cls accessInstanceVariablesDirectly] == NO)
+        return;
+
+    NSArray *ivarNames = A([@"_" stringByAppendingString: key],
+        [@"_is" stringByAppendingString: capitalizedKey], key,
+        [@"is" stringByAppendingString: capitalizedKey]);
+
+    for (NSString *ivarName in ivarNames)
+    {
+        Ivar ivar = class_getInstanceVariable(cls, [ivarName UTF8String]);
+
+        if (ivar == NULL)
+            continue;
+
+        if (ETIsObjectType(ETReturnOrArgumentType(ivar_getTypeEncoding(ivar))))
+        {
+            access->getterKind = ETPropertyAccessIvar;
+            access->ivarOffset = ivar_getOffset(ivar);
+        }
+        return;
+    }
+}
+
+static void ETResolvePropertySetter(Class cls, NSString *capitalizedKey,
+                                    ETPropertyAccess *access)
+{
+    SEL selector = NSSelectorFromString(
+        [NSString stringWithFormat: @"set%@:", capitalizedKey]);
+    Method method = class_getInstanceMethod(cls, selector);
+
+    /* Setting ivars is left to Key Value Coding, which posts the Key Value 
+       Observing notifications in this case */
+    if (method == NULL)
+        return;
+
+    NSMethodSignature *sig = [cls instanceMethodSignatureForSelector: selector];
+
+    if ([sig numberOfArguments] == 3
+     && ETIsObjectType(ETReturnOrArgumentType([sig getArgumentTypeAtIndex: 2])))
+    {
+        access->setterKind = ETPropertyAccessMethod;
+        access->setterSelector = selector;
+        access->setter = method_getImplementation(method);
+    }
+}
+
+static ETPropertyAccess ETResolvePropertyAccess(id object, Class cls, NSString *key)
+{
+    ETPropertyAccess access;
+
+    memset(&access, 0, sizeof(ETPropertyAccess));
+    access.forwardsGetter = ETOverridesOnlyNameBasedMethod(cls,
+        @selector(valueForProperty:), @selector(valueForPropertyID:));
+    access.forwardsSetter = ETOverridesOnlyNameBasedMethod(cls,
+        @selector(setValue:forProperty:), @selector(setValue:forPropertyID:));
+    access.sendsGetter = (access.forwardsGetter
+        || class_getMethodImplementation(cls, @selector(valueForPropertyID:))
+           != class_getMethodImplementation([NSObject class], @selector(valueForPropertyID:)));
+    access.sendsSetter = (access.forwardsSetter
+        || class_getMethodImplementation(cls, @selector(setValue:forPropertyID:))
+           != class_getMethodImplementation([NSObject class], @selector(setValue:forPropertyID:)));
+    access.checksPropertyNames = [cls hasInstanceSpecificPropertyNames];
+
+    if (access.checksPropertyNames == NO)
+    {
+        access.isProperty = [[object propertyNames] containsObject: key];
+    }
+    if ((access.checksPropertyNames == NO && access.isProperty == NO) || [key length] == 0)
+        return access;
+
+    /* Accessing the property directly is only equivalent to -basicValueForKey: 
+       and -setBasicValue:forKey: if they are not overriden */
+    Class rootClass = [NSObject class];
+    NSString *capitalizedKey = [[[key substringToIndex: 1] uppercaseString]
+        stringByAppendingString: [key substringFromIndex: 1]];
+
+    if (class_getMethodImplementation(cls, @selector(basicValueForKey:))
+        == class_getMethodImplementation(rootClass, @selector(basicValueForKey:)))
+    {
+        ETResolvePropertyGetter(cls, key, capitalizedKey, &access);
+    }
+    if (class_getMethodImplementation(cls, @selector(setBasicValue:forKey:))
+        == class_getMethodImplementation(rootClass, @selector(setBasicValue:forKey:)))
+    {
+        ETResolvePropertySetter(cls, capitalizedKey, &access);
+    }
+    return access;
+}
+
+/* Returns a copy of the access in accessorsByClass, resolving it first if 
+   needed. */
+static ETPropertyAccess ETLockedPropertyAccessForID(id object, Class cls, ETPropertyID propertyID)
+{
+    ETPropertyAccess access;
+
+    pthread_mutex_lock(&accessorLock);
+
+    if (accessorsByClass == NULL)
+    {
+        accessorsByClass = ETCIdentityMapNewWithCallBacks(0, &ETPropertyAccessesCallBacks);
+    }
+
+    ETCIdentityMap accesses = ETCIdentityMapGet(accessorsByClass, cls);
+    ETPropertyAccess *cachedAccess =
+        (accesses != NULL ? ETCIdentityMapGet(accesses, propertyID) : NULL);
+    unsigned long generation = accessorGeneration;
+
+    if (cachedAccess != NULL)
+    {
+        access = *cachedAccess;
+        pthread_mutex_unlock(&accessorLock);
+        return access;
+    }
+
+    pthread_mutex_unlock(&accessorLock);
+
+    /* -propertyNames can run arbitrary code, so we resolve outside the lock */
+    access = ETResolvePropertyAccess(object, cls, propertyID->name);
+
+    pthread_mutex_lock(&accessorLock);
+
+    if (generation == accessorGeneration)
+    {
+        accesses = ETCIdentityMapGet(accessorsByClass, cls);
+
+        if (accesses == NULL)
+        {
+            accesses = ETCIdentityMapNewWithCallBacks(0, &ETPropertyAccessCallBacks);
+            ETCIdentityMapSet(accessorsByClass, cls, accesses);
+        }
+        cachedAccess = malloc(sizeof(ETPropertyAccess));
+        *cachedAccess = access;
+        ETCIdentityMapSet(accesses, propertyID, cachedAccess);
+    }
+
+    pthread_mutex_unlock(&accessorLock);
+    return access;
+}
+
+/* Returns a copy of the cached access, so it remains valid if the accessors 
+   are invalidated by another thread. */
+static ETPropertyAccess ETPropertyAccessForID(id object, ETPropertyID propertyID)
+{
+    ETPropertyAccess access;
+
+    if (propertyID == NULL)
+    {
+        memset(&access, 0, sizeof(ETPropertyAccess));
+        return access;
+    }
+
+    Class cls = object_getClass(object);
+    struct _ETPropertyAccessCacheSlot *slot = &accessCache[(((uintptr_t)cls >> 4) 
+        * 31 + ((uintptr_t)propertyID >> 4)) & (ETPropertyAccessCacheSize - 1)];
+    unsigned long generation = accessorGeneration;
+    unsigned long sequence = slot->sequence;
+
+    __sync_synchronize();
+
+    if ((sequence & 1) == 0)
+    {
+        Class cachedClass = slot->cachedClass;
+        ETPropertyID cachedPropertyID = slot->propertyID;
+        unsigned long cachedGeneration = slot->generation;
+
+        access = slot->access;
+        __sync_synchronize();
+
+        if (slot->sequence == sequence && cachedClass == cls
+         && cachedPropertyID == propertyID && cachedGeneration == generation)
+        {
+            return access;
+        }
+    }
+
+    access = ETLockedPropertyAccessForID(object, cls, propertyID);
+
+    /* If another thread is updating the slot, we just don't cache */
+    if ((sequence & 1) == 0
+     && __sync_bool_compare_and_swap(&slot->sequence, sequence, sequence + 1))
+    {
+        slot->cachedClass = cls;
+        slot->propertyID = propertyID;
+        slot->generation = generation;
+        slot->access = access;
+        __sync_synchronize();
+        slot->sequence = sequence + 2;
+    }
+    return access;
+}
+
+/* The access for a NULL property ID is zeroed, so propertyID is valid when 
+   checksPropertyNames is set. */
+static inline BOOL ETAccessIsProperty(id object, ETPropertyID propertyID,
+                                      ETPropertyAccess *access)
+{
+    if (access->checksPropertyNames)
+    {
+        return [[object propertyNames] containsObject: propertyID->name];
+    }
+    return access->isProperty;
+}
+
+static BOOL ETIsPropertyName(id object, NSString *key)
+{
+    ETPropertyID propertyID = ETDeclaredPropertyIDForName(object, key);
+    ETPropertyAccess access = ETPropertyAccessForID(object, propertyID);
+
+    return ETAccessIsProperty(object, propertyID, &access);
+}
+
+static id ETGetPropertyValue(id object, ETPropertyID propertyID, ETPropertyAccess *access)
+{
+    if (ETAccessIsProperty(object, propertyID, access) == NO)
+    {
+        // TODO: Turn into an ETDebugLog which takes an object (or a class) to
+        // to limit the logging to a particular object or set of instances.
+        #ifdef DEBUG_PVC
+        ETLog(@"WARNING: Found no value for property %@ in %@",
+            ETPropertyIDName(propertyID), object);
+        #endif
+        return nil;
+    }
+
+    switch (access->getterKind)
+    {
+        case ETPropertyAccessMethod:
+            return ((id (*)(id, SEL))access->getter)(object, access->getterSelector);
+        case ETPropertyAccessIvar:
+            return *(id *)((char *)object + access->ivarOffset);
+        default:
+            return [object basicValueForKey: propertyID->name];
+    }
+}
+
+static BOOL ETSetPropertyValue(id object, id value, ETPropertyID propertyID,
+                               ETPropertyAccess *access)
+{
+    if (ETAccessIsProperty(object, propertyID, access) == NO)
+    {
+        // TODO: Turn into an ETDebugLog which takes an object (or a class) to
+        // to limit the logging to a particular object or set of instances.
+        #ifdef DEBUG_PVC
+        ETLog(@"WARNING: Trying to set value %@ for property %@ missing in "
+            @"immutable property collection of %@", value,
+            ETPropertyIDName(propertyID), object);
+        #endif
+        return NO;
+    }
+
+    if (access->setterKind == ETPropertyAccessMethod)
+    {
+        ((void (*)(id, SEL, id))access->setter)(object, access->setterSelector, value);
+    }
+    else
+    {
+        [object setBasicValue: value forKey: propertyID->name];
+    }
+    return YES;
+}
+
 @implementation NSObject (ETPropertyValueCoding)
 
++ (BOOL) hasInstanceSpecificPropertyNames
+{
+    return NO;
+}
+
 - (BOOL) requiresKeyValueCodingForAccessingProperties
 {
     return NO;
@@ -51,75 +690,50 @@ See -propertyNames. */
 
 - (id) valueForProperty: (NSString *)key
 {
-    id value = nil;
-    
-    if ([[self propertyNames] containsObject: key])
-    {
-        value = [self basicValueForKey: key];
-    }
-    else
-    {
-        // TODO: Turn into an ETDebugLog which takes an object (or a class) to
-        // to limit the logging to a particular object or set of instances.
-        #ifdef DEBUG_PVC
-        ETLog(@"WARNING: Found no value for property %@ in %@", key, self);
-        #endif
-    }
-    
-    return value;
+    ETPropertyID propertyID = ETDeclaredPropertyIDForName(self, key);
+    ETPropertyAccess access = ETPropertyAccessForID(self, propertyID);
+
+    return ETGetPropertyValue(self, propertyID, &access);
 }
 
 - (BOOL) setValue: (id)value forProperty: (NSString *)key
 {
-    BOOL result = NO;
-    
-    if ([[self propertyNames] containsObject: key])
-    {
-        [self setBasicValue: value forKey: key];
-        result = YES;
-    }
-    else
-    {
-        // TODO: Turn into an ETDebugLog which takes an object (or a class) to
-        // to limit the logging to a particular object or set of instances.
-        #ifdef DEBUG_PVC
-        ETLog(@"WARNING: Trying to set value %@ for property %@ missing in "
-            @"immutable property collection of %@", value, key, self);
-        #endif
-    }
-    
-    return result;
+    ETPropertyID propertyID = ETDeclaredPropertyIDForName(self, key);
+    ETPropertyAccess access = ETPropertyAccessForID(self, propertyID);
+
+    return ETSetPropertyValue(self, value, propertyID, &access);
 }
 
-- (id) valueForPropertyPath: (NSString *)aPropertyPath
+- (id) valueForPropertyID: (ETPropertyID)aPropertyID
 {
-    id value = self;
+    ETPropertyAccess access = ETPropertyAccessForID(self, aPropertyID);
 
-    for (NSString *property in [aPropertyPath componentsSeparatedByString: @"."])
+    if (access.forwardsGetter)
     {
-        value = [value valueForProperty: property];
+        return [self valueForProperty: ETPropertyIDName(aPropertyID)];
     }
-    return value;
+    return ETGetPropertyValue(self, aPropertyID, &access);
 }
 
-- (BOOL) setValue: (id)aValue forPropertyPath: (NSString *)aPropertyPath
+- (BOOL) setValue: (id)value forPropertyID: (ETPropertyID)aPropertyID
 {
-    NSArray *components = [aPropertyPath componentsSeparatedByString: @"."];
+    ETPropertyAccess access = ETPropertyAccessForID(self, aPropertyID);
 
-    if ([components count] > 1)
+    if (access.forwardsSetter)
     {
-        NSString *property = [components lastObject];
+        return [self setValue: value forProperty: ETPropertyIDName(aPropertyID)];
+    }
+    return ETSetPropertyValue(self, value, aPropertyID, &access);
+}
 
-        components = [components subarrayWithRange: NSMakeRange(0, [components count] - 1)];
+- (id) valueForPropertyPath: (NSString *)aPropertyPath
+{
+    return [[ETPropertyPath pathWithString: aPropertyPath] valueForObject: self];
+}
 
-        NSString *basePath = [components componentsJoinedByString: @"."];
-        
-        return [[self valueForPropertyPath: basePath] setValue: aValue forProperty: property];
-    }
-    else
-    {
-        return [self setValue: aValue forProperty: aPropertyPath];
-    }
+- (BOOL) setValue: (id)aValue forPropertyPath: (NSString *)aPropertyPath
+{
+    return [[ETPropertyPath pathWithString: aPropertyPath] setValue: aValue forObject: self];
 }
 
 static id (*valueForKeyIMP)(id, SEL, NSString *) = NULL;
@@ -133,8 +747,11 @@ This method allows to use basic KVC access (through ivars and accessors) from
 implemented in subclasses for -valueForKey:. */
 - (id) basicValueForKey: (NSString *)key
 {
-    valueForKeyIMP = (id (*)(id, SEL, NSString *))[[NSObject class] 
-        instanceMethodForSelector: @selector(valueForKey:)];
+    if (valueForKeyIMP == NULL)
+    {
+        valueForKeyIMP = (id (*)(id, SEL, NSString *))[[NSObject class] 
+            instanceMethodForSelector: @selector(valueForKey:)];
+    }
     return valueForKeyIMP(self, @selector(valueForKey:), key);
 }
 
@@ -146,14 +763,335 @@ This method allows to use basic KVC access (through ivars and accessors) from
 strategy is implemented in subclasses for -setValue:forKey:. */
 - (void) setBasicValue: (id)value forKey: (NSString *)key
 {
-    setValueForKeyIMP = (void (*)(id, SEL, id, NSString *))[[NSObject class] 
-        instanceMethodForSelector: @selector(setValue:forKey:)];
+    if (setValueForKeyIMP == NULL)
+    {
+        setValueForKeyIMP = (void (*)(id, SEL, id, NSString *))[[NSObject class] 
+            instanceMethodForSelector: @selector(setValue:forKey:)];
+    }
     setValueForKeyIMP(self, @selector(setValue:forKey:), value, key);
 }
 
 @end
 
 
+/* Property Paths
+
+Each path step keeps its property name, and resolves its property ID with 
+ETDeclaredPropertyIDForName() the first time it is evaluated on an object that 
+declares the name, so paths built from arbitrary strings don't intern them. 
+Until then, the step sends -valueForProperty: or -setValue:forProperty: with 
+the name. Property IDs are unique, so threads resolving the same step store 
+the same ID.
+
+Each path step caches the access resolved for the last class it was evaluated 
+on. The cache is a sequence lock, so reading it takes no lock: the sequence is 
+odd while a thread updates the cache, and readers retry the lookup through 
+ETPropertyAccessForID() if the sequence changed while they were copying the 
+cache. The cache is also discarded when the accessor generation changes. */
+
+struct _ETPropertyPathStep
+{
+    NSString *name;
+    /* NULL until resolved */
+    ETPropertyID propertyID;
+    volatile unsigned long sequence;
+    Class cachedClass;
+    unsigned long generation;
+    ETPropertyAccess access;
+};
+
+typedef struct _ETPropertyPathStep ETPropertyPathStep;
+
+static ETPropertyAccess ETPropertyPathStepAccess(ETPropertyPathStep *step, id object)
+{
+    Class cls = object_getClass(object);
+    unsigned long generation = accessorGeneration;
+    unsigned long sequence = step->sequence;
+    ETPropertyAccess access;
+
+    __sync_synchronize();
+
+    if ((sequence & 1) == 0)
+    {
+        Class cachedClass = step->cachedClass;
+        unsigned long cachedGeneration = step->generation;
+
+        access = step->access;
+        __sync_synchronize();
+
+        if (step->sequence == sequence && cachedClass == cls
+         && cachedGeneration == generation)
+        {
+            return access;
+        }
+    }
+
+    access = ETPropertyAccessForID(object, step->propertyID);
+
+    /* If another thread is updating the cache, we just don't cache */
+    if ((sequence & 1) == 0
+     && __sync_bool_compare_and_swap(&step->sequence, sequence, sequence + 1))
+    {
+        step->cachedClass = cls;
+        step->generation = generation;
+        step->access = access;
+        __sync_synchronize();
+        step->sequence = sequence + 2;
+    }
+    return access;
+}
+
+/* Returns the step property ID, or NULL if the name is neither interned nor 
+   declared by the object. */
+static inline ETPropertyID ETPropertyPathStepPropertyID(ETPropertyPathStep *step, id object)
+{
+    if (step->propertyID == NULL)
+    {
+        step->propertyID = ETDeclaredPropertyIDForName(object, step->name);
+    }
+    return step->propertyID;
+}
+
+static inline id ETPropertyPathStepValue(ETPropertyPathStep *step, id object)
+{
+    if (object == nil)
+        return nil;
+
+    /* The object can still accept a name it doesn't declare (e.g. ETKeyValuePair) */
+    if (ETPropertyPathStepPropertyID(step, object) == NULL)
+        return [object valueForProperty: step->name];
+
+    ETPropertyAccess access = ETPropertyPathStepAccess(step, object);
+
+    if (access.sendsGetter)
+    {
+        return [object valueForPropertyID: step->propertyID];
+    }
+    return ETGetPropertyValue(object, step->propertyID, &access);
+}
+
+static inline BOOL ETPropertyPathStepSetValue(ETPropertyPathStep *step, id object, id value)
+{
+    if (object == nil)
+        return NO;
+
+    if (ETPropertyPathStepPropertyID(step, object) == NULL)
+        return [object setValue: value forProperty: step->name];
+
+    ETPropertyAccess access = ETPropertyPathStepAccess(step, object);
+
+    if (access.sendsSetter)
+    {
+        return [object setValue: value forPropertyID: step->propertyID];
+    }
+    return ETSetPropertyValue(object, value, step->propertyID, &access);
+}
+
+/* Bounds the shared paths, when paths are built from arbitrary strings */
+#define ETPropertyPathCacheLimit 4096
+
+static NSLock *propertyPathLock = nil;
+static NSMutableDictionary *propertyPathsByString = nil;
+
+@implementation ETPropertyPath
+
+@synthesize string = _string, count = _count;
+
++ (void) initialize
+{
+    if (self != [ETPropertyPath class])
+        return;
+
+    propertyPathLock = [[NSLock alloc] init];
+    propertyPathsByString = [[NSMutableDictionary alloc] init];
+}
+
++ (ETPropertyPath *) pathWithString: (NSString *)aPath
+{
+    if (aPath == nil)
+        return nil;
+
+    [propertyPathLock lock];
+    ETPropertyPath *path = RETAIN([propertyPathsByString objectForKey: aPath]);
+    [propertyPathLock unlock];
+
+    if (path != nil)
+        return AUTORELEASE(path);
+
+    path = AUTORELEASE([[self alloc] initWithString: aPath]);
+
+    [propertyPathLock lock];
+    if ([propertyPathsByString count] >= ETPropertyPathCacheLimit)
+    {
+        [propertyPathsByString removeAllObjects];
+    }
+    [propertyPathsByString setObject: path forKey: [path string]];
+    [propertyPathLock unlock];
+
+    return path;
+}
+
+- (id) initWithString: (NSString *)aPath
+{
+    NILARG_EXCEPTION_TEST(aPath);
+    SUPERINIT;
+    _string = [aPath copy];
+
+    NSArray *components = [_string componentsSeparatedByString: @"."];
+
+    _count = [components count];
+    _steps = calloc(_count, sizeof(ETPropertyPathStep));
+
+    if (_steps == NULL)
+    {
+        [self release];
+        return nil;
+    }
+
+    for (NSUInteger i = 0; i < _count; i++)
+    {
+        NSString *name = [components objectAtIndex: i];
+
+        _steps[i].name = [name copy];
+        _steps[i].propertyID = ETInternedPropertyIDForName(name, [name hash]);
+    }
+    return self;
+}
+
+- (void) dealloc
+{
+    for (NSUInteger i = 0; _steps != NULL && i < _count; i++)
+    {
+        [_steps[i].name release];
+    }
+    free(_steps);
+    DESTROY(_string);
+    [super dealloc];
+}
+
+- (id) copyWithZone: (NSZone *)aZone
+{
+    return RETAIN(self);
+}
+
+- (BOOL) isEqual: (id)anObject
+{
+    if (anObject == self)
+        return YES;
+
+    return ([anObject isKindOfClass: [ETPropertyPath class]]
+        && [_string isEqualToString: [anObject string]]);
+}
+
+- (NSUInteger) hash
+{
+    return [_string hash];
+}
+
+- (NSString *) description
+{
+    return _string;
+}
+
+/* Returns the step property ID, interning the name if needed. */
+static ETPropertyID ETPropertyPathStepInternedPropertyID(ETPropertyPathStep *step)
+{
+    if (step->propertyID == NULL)
+    {
+        step->propertyID = ETPropertyIDForName(step->name);
+    }
+    return step->propertyID;
+}
+
+- (ETPropertyID) propertyIDAtIndex: (NSUInteger)anIndex
+{
+    if (anIndex >= _count)
+    {
+        [NSException raise: NSRangeException
+                    format: @"Index %lu is out of bounds of property path %@",
+                            (unsigned long)anIndex, _string];
+    }
+    return ETPropertyPathStepInternedPropertyID(&_steps[anIndex]);
+}
+
+- (ETPropertyID) firstPropertyID
+{
+    return ETPropertyPathStepInternedPropertyID(&_steps[0]);
+}
+
+- (ETPropertyID) lastPropertyID
+{
+    return ETPropertyPathStepInternedPropertyID(&_steps[_count - 1]);
+}
+
+- (id) valueForObject: (id)anObject
+{
+    id value = anObject;
+
+    for (NSUInteger i = 0; i < _count && value != nil; i++)
+    {
+        value = ETPropertyPathStepValue(&_steps[i], value);
+    }
+    return value;
+}
+
+- (BOOL) setValue: (id)aValue forObject: (id)anObject
+{
+    id object = anObject;
+
+    for (NSUInteger i = 0; i < _count - 1 && object != nil; i++)
+    {
+        object = ETPropertyPathStepValue(&_steps[i], object);
+    }
+    return ETPropertyPathStepSetValue(&_steps[_count - 1], object, aValue);
+}
+
+- (void) getValues: (id *)values forObjects: (const id *)objects count: (NSUInteger)count
+{
+    for (NSUInteger i = 0; i < count; i++)
+    {
+        values[i] = [self valueForObject: objects[i]];
+    }
+}
+
+- (NSArray *) valuesForObjects: (NSArray *)objects
+{
+    NSUInteger count = [objects count];
+
+    if (count == 0)
+        return [NSArray array];
+
+    id *buffer = malloc(2 * count * sizeof(id));
+    id *values = buffer + count;
+    NSNull *null = [NSNull null];
+
+    if (buffer == NULL)
+    {
+        [NSException raise: NSMallocException
+                    format: @"Failed to allocate the values of %lu objects for %@",
+                            (unsigned long)count, self];
+    }
+
+    [objects getObjects: buffer range: NSMakeRange(0, count)];
+    [self getValues: values forObjects: buffer count: count];
+
+    for (NSUInteger i = 0; i < count; i++)
+    {
+        if (values[i] == nil)
+        {
+            values[i] = null;
+        }
+    }
+
+    NSArray *result = [NSArray arrayWithObjects: values count: count];
+
+    free(buffer);
+    return result;
+}
+
+@end
+
+
 @implementation NSDictionary (ETPropertyValueCoding)
 #if 0
 - (NSArray *) propertyNames
@@ -184,7 +1122,7 @@ strategy is implemented in subclasses for -setValue:forKey:. */
 {
     id value = nil;
     
-    if ([[self propertyNames] containsObject: key])
+    if (ETIsPropertyName(self, key))
     {
         id (*NSObjectValueForKeyIMP)(id, SEL, id) = NULL;
         
@@ -208,7 +1146,7 @@ strategy is implemented in subclasses for -setValue:forKey:. */
 {
     BOOL result = YES;
     
-    if ([[self propertyNames] containsObject: key])
+    if (ETIsPropertyName(self, key))
     {
         void (*NSObjectSetValueForKeyIMP)(id, SEL, id, id) = NULL;
         
@@ -267,7 +1205,7 @@ strategy is implemented in subclasses for -setValue:forKey:. */
 
 - (id) valueForProperty: (NSString *)key
 {
-    if ([[self propertyNames] containsObject: key])
+    if (ETIsPropertyName(self, key))
     {
         id (*NSObjectValueForKeyIMP)(id, SEL, id) = NULL;
         
@@ -300,7 +1238,7 @@ strategy is implemented in subclasses for -setValue:forKey:. */
 {
     BOOL result = YES;
 
-    if ([[self propertyNames] containsObject: key])
+    if (ETIsPropertyName(self, key))
     {
         void (*NSObjectSetValueForKeyIMP)(id, SEL, id, id) = NULL;
         
@@ -0,0 +1,233 @@
+/*
+    Copyright (C) 2026 The Etoile Project
+
+    Date:  October 2026
+    License:  Modified BSD (see COPYING)
+ */
+
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ETSegmentBuffer.h"
+
+/** Smallest block of scratch memory allocated at a time. */
+#define SCRATCH_BLOCK_SIZE 16384
+
+/**
+ * Block of scratch memory.  Blocks are never moved, so segments can point into
+ * them, and are kept across resets for reuse.
+ */
+struct ETScratchBlock
+{
+    struct ETScratchBlock *next;
+    size_t size;
+    size_t used;
+    char bytes[];
+};
+
+struct _ETSegmentBuffer
+{
+    struct iovec *segments;
+    /** Whether each segment may be modified in place. */
+    char *mutable;
+    int count;
+    int space;
+    size_t length;
+    struct ETScratchBlock *firstBlock;
+    /** Block that the next scratch allocation comes from. */
+    struct ETScratchBlock *currentBlock;
+    /** Memory returned by the last ETSegmentBufferReserve() call. */
+    char *reserved;
+    /** Set when memory could not be allocated since the last reset. */
+    int failed;
+};
+
+ETSegmentBuffer ETSegmentBufferNew(void)
+{
+    return calloc(1, sizeof(struct _ETSegmentBuffer));
+}
+
+static void appendSegment(ETSegmentBuffer buffer, void *bytes, size_t length, char isMutable)
+{
+    if (0 == length)
+    {
+        return;
+    }
+    if (buffer->count == buffer->space)
+    {
+        if (buffer->space > INT_MAX / 2)
+        {
+            buffer->failed = 1;
+            return;
+        }
+        int space = (0 == buffer->space) ? 8 : buffer->space * 2;
+        struct iovec *segments = realloc(buffer->segments, space * sizeof(struct iovec));
+
+        if (NULL == segments)
+        {
+            buffer->failed = 1;
+            return;
+        }
+        buffer->segments = segments;
+
+        char *mutable = realloc(buffer->mutable, space);
+
+        if (NULL == mutable)
+        {
+            buffer->failed = 1;
+            return;
+        }
+        buffer->mutable = mutable;
+        buffer->space = space;
+    }
+    buffer->segments[buffer->count].iov_base = bytes;
+    buffer->segments[buffer->count].iov_len = length;
+    buffer->mutable[buffer->count] = isMutable;
+    buffer->count++;
+    buffer->length += length;
+}
+
+void ETSegmentBufferAppend(ETSegmentBuffer buffer, const void *bytes, size_t length)
+{
+    appendSegment(buffer, (void*)bytes, length, 0);
+}
+
+void ETSegmentBufferAppendMutable(ETSegmentBuffer buffer, void *bytes, size_t length)
+{
+    appendSegment(buffer, bytes, length, 1);
+}
+
+void ETSegmentBufferAppendCopy(ETSegmentBuffer buffer, const void *bytes, size_t length)
+{
+    if (0 == length)
+    {
+        return;
+    }
+    void *copy = ETSegmentBufferReserve(buffer, length);
+
+    if (NULL == copy)
+    {
+        return;
+    }
+    memcpy(copy, bytes, length);
+    ETSegmentBufferCommit(buffer, length);
+}
+
+void ETSegmentBufferAppendBuffer(ETSegmentBuffer buffer, ETSegmentBuffer other)
+{
+    for (int i=0 ; i<other->count ; i++)
+    {
+        appendSegment(buffer, other->segments[i].iov_base,
+                      other->segments[i].iov_len, other->mutable[i]);
+    }
+}
+
+void *ETSegmentBufferReserve(ETSegmentBuffer buffer, size_t capacity)
+{
+    struct ETScratchBlock *block = buffer->currentBlock;
+
+    // Find a block with enough room, reusing the ones kept from before the
+    // last reset.
+    while (NULL != block && block->size - block->used < capacity)
+    {
+        block = block->next;
+    }
+    if (NULL == block)
+    {
+        size_t size = (capacity > SCRATCH_BLOCK_SIZE) ? capacity : SCRATCH_BLOCK_SIZE;
+
+        if (size > SIZE_MAX - sizeof(struct ETScratchBlock)
+            || NULL == (block = malloc(sizeof(struct ETScratchBlock) + size)))
+        {
+            buffer->failed = 1;
+            buffer->reserved = NULL;
+            return NULL;
+        }
+        block->size = size;
+        block->used = 0;
+        // Insert after the current block, so that the unused blocks after it
+        // are still found next time.
+        if (NULL == buffer->currentBlock)
+        {
+            block->next = buffer->firstBlock;
+            buffer->firstBlock = block;
+        }
+        else
+        {
+            block->next = buffer->currentBlock->next;
+            buffer->currentBlock->next = block;
+        }
+    }
+    buffer->currentBlock = block;
+    buffer->reserved = block->bytes + block->used;
+    return buffer->reserved;
+}
+
+void ETSegmentBufferCommit(ETSegmentBuffer buffer, size_t length)
+{
+    if (NULL == buffer->reserved)
+    {
+        return;
+    }
+    buffer->currentBlock->used += length;
+    appendSegment(buffer, buffer->reserved, length, 1);
+    buffer->reserved += length;
+}
+
+int ETSegmentBufferCount(ETSegmentBuffer buffer)
+{
+    return buffer->count;
+}
+
+const struct iovec *ETSegmentBufferSegments(ETSegmentBuffer buffer)
+{
+    return buffer->segments;
+}
+
+void *ETSegmentBufferMutableBytesAtIndex(ETSegmentBuffer buffer, int anIndex)
+{
+    if (anIndex < 0 || anIndex >= buffer->count || !buffer->mutable[anIndex])
+    {
+        return NULL;
+    }
+    return buffer->segments[anIndex].iov_base;
+}
+
+size_t ETSegmentBufferLength(ETSegmentBuffer buffer)
+{
+    return buffer->length;
+}
+
+int ETSegmentBufferFailed(ETSegmentBuffer buffer)
+{
+    return buffer->failed;
+}
+
+void ETSegmentBufferReset(ETSegmentBuffer buffer)
+{
+    for (struct ETScratchBlock *block = buffer->firstBlock ; NULL != block ; block = block->next)
+    {
+        block->used = 0;
+    }
+    buffer->currentBlock = buffer->firstBlock;
+    buffer->reserved = NULL;
+    buffer->count = 0;
+    buffer->length = 0;
+    buffer->failed = 0;
+}
+
+void ETSegmentBufferFree(ETSegmentBuffer buffer)
+{
+    struct ETScratchBlock *block = buffer->firstBlock;
+
+    while (NULL != block)
+    {
+        struct ETScratchBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+    free(buffer->segments);
+    free(buffer->mutable);
+    free(buffer);
+}
@@ -0,0 +1,525 @@
+/*
+    Copyright (C) 2026 The Etoile Project
+
+    Date:  October 2026
+    License:  Modified BSD (see COPYING)
+ */
+
+#import "ETSequence.h"
+#import "ETCollection.h"
+#import "EtoileCompatibility.h"
+#import "Macros.h"
+
+#if __has_feature(blocks)
+
+typedef enum
+{
+    ETSequenceStageMap,
+    ETSequenceStageFilter,
+    ETSequenceStageTake,
+    ETSequenceStageFlatMap,
+    ETSequenceStageZip
+} ETSequenceStageKind;
+
+struct ETSequenceStage
+{
+    ETSequenceStageKind kind;
+    /* Copied block */
+    id block;
+    /* Collection zipped with the elements */
+    id collection;
+    /* Maximum number of elements to take */
+    NSUInteger limit;
+};
+
+#define SOURCE_BUFFER_SIZE 16
+
+/*
+ * Reads the elements of a collection one by one, with fast enumeration.
+ */
+struct ETSequenceSource
+{
+    id enumerable;
+    NSFastEnumerationState state;
+    id buffer[SOURCE_BUFFER_SIZE];
+    NSUInteger index;
+    NSUInteger count;
+    BOOL exhausted;
+};
+
+typedef void (*ETSequenceSink)(id object, void *context);
+
+/*
+ * The state of one evaluation of the stages over the source.
+ */
+struct ETSequencePass
+{
+    struct ETSequenceStage *stages;
+    NSUInteger stageCount;
+    struct ETSequenceSource source;
+    /* Per stage, the number of elements taken by take stages */
+    NSUInteger *taken;
+    /* Per stage, the zipped collection reader of zip stages */
+    struct ETSequenceSource *zipped;
+    ETSequenceSink sink;
+    void *sinkContext;
+    BOOL finished;
+};
+
+/*
+ * The state of a fast enumeration over the sequence. The pass emits the
+ * elements into a buffer returned to the enumerating code.
+ *
+ * Each enumeration has its own state, referenced by the extra field of its
+ * NSFastEnumerationState and owned by the sequence, so that draining an
+ * autorelease pool in the loop doesn't free it. The sequence releases the
+ * state when the enumeration ends, or in -dealloc for an enumeration left
+ * early.
+ */
+@interface ETSequenceEnumerationState : NSObject
+{
+    @public
+    struct ETSequencePass pass;
+    BOOL passing;
+    id *items;
+    NSUInteger capacity;
+    NSUInteger count;
+}
+- (id)initWithCapacity: (NSUInteger)aCapacity;
+- (void)finishPass;
+@end
+
+/*
+ * Returns an object to enumerate the collection elements with fast
+ * enumeration, without copying its content when possible.
+ */
+static inline id enumerableForCollection(id aCollection)
+{
+    if ([aCollection isKindOfClass: [NSArray class]]
+     || [aCollection isKindOfClass: [NSSet class]])
+    {
+        return aCollection;
+    }
+    /* For NSDictionary, fast enumeration would return the keys */
+    return [aCollection objectEnumerator];
+}
+
+static void sourceInit(struct ETSequenceSource *src, id aCollection)
+{
+    memset(src, 0, sizeof(struct ETSequenceSource));
+    src->enumerable = [enumerableForCollection(aCollection) retain];
+}
+
+static void sourceDestroy(struct ETSequenceSource *src)
+{
+    [src->enumerable release];
+    src->enumerable = nil;
+}
+
+/* Returns the next element, or nil once the collection has been read. */
+static inline id sourceNext(struct ETSequenceSource *src)
+{
+    if (src->index == src->count)
+    {
+        if (src->exhausted)
+        {
+            return nil;
+        }
+        src->count = [src->enumerable countByEnumeratingWithState: &src->state
+                                                          objects: src->buffer
+                                                            count: SOURCE_BUFFER_SIZE];
+        src->index = 0;
+        if (0 == src->count)
+        {
+            src->exhausted = YES;
+            return nil;
+        }
+    }
+    return src->state.itemsPtr[src->index++];
+}
+
+static void passInit(struct ETSequencePass *pass, id source,
+                     struct ETSequenceStage *stages, NSUInteger stageCount,
+                     ETSequenceSink sink, void *sinkContext)
+{
+    pass->stages = stages;
+    pass->stageCount = stageCount;
+    sourceInit(&pass->source, source);
+    pass->taken = calloc(MAX(stageCount, 1), sizeof(NSUInteger));
+    pass->zipped = calloc(MAX(stageCount, 1), sizeof(struct ETSequenceSource));
+    for (NSUInteger i = 0; i < stageCount; i++)
+    {
+        if (ETSequenceStageZip == stages[i].kind)
+        {
+            sourceInit(&pass->zipped[i], stages[i].collection);
+        }
+    }
+    pass->sink = sink;
+    pass->sinkContext = sinkContext;
+    pass->finished = NO;
+}
+
+static void passDestroy(struct ETSequencePass *pass)
+{
+    sourceDestroy(&pass->source);
+    for (NSUInteger i = 0; i < pass->stageCount; i++)
+    {
+        sourceDestroy(&pass->zipped[i]);
+    }
+    free(pass->taken);
+    free(pass->zipped);
+}
+
+/*
+ * Passes the object through the stages from stageIndex on, then to the sink.
+ * Returns NO when no more elements can be emitted, e.g. once a take stage has
+ * reached its limit.
+ */
+static BOOL emit(struct ETSequencePass *pass, NSUInteger stageIndex, id object)
+{
+    for (NSUInteger i = stageIndex; i < pass->stageCount; i++)
+    {
+        struct ETSequenceStage *stage = &pass->stages[i];
+
+        switch (stage->kind)
+        {
+            case ETSequenceStageMap:
+            {
+                object = ((id (^)(id))stage->block)(object);
+                if (nil == object)
+                {
+                    object = [NSNull null];
+                }
+                break;
+            }
+            case ETSequenceStageFilter:
+            {
+                if (NO == ((BOOL (^)(id))stage->block)(object))
+                {
+                    return YES;
+                }
+                break;
+            }
+            case ETSequenceStageTake:
+            {
+                if (pass->taken[i] >= stage->limit)
+                {
+                    return NO;
+                }
+                pass->taken[i]++;
+                if (pass->taken[i] == stage->limit)
+                {
+                    /* Stop without reading the next element */
+                    emit(pass, i + 1, object);
+                    return NO;
+                }
+                break;
+            }
+            case ETSequenceStageFlatMap:
+            {
+                id collection = ((id (^)(id))stage->block)(object);
+
+                if (nil == collection)
+                {
+                    return YES;
+                }
+                for (id element in enumerableForCollection(collection))
+                {
+                    if (NO == emit(pass, i + 1, element))
+                    {
+                        return NO;
+                    }
+                }
+                return YES;
+            }
+            case ETSequenceStageZip:
+            {
+                id other = sourceNext(&pass->zipped[i]);
+
+                if (nil == other)
+                {
+                    return NO;
+                }
+                object = ((id (^)(id, id))stage->block)(object, other);
+                if (nil == object)
+                {
+                    object = [NSNull null];
+                }
+                break;
+            }
+        }
+    }
+    pass->sink(object, pass->sinkContext);
+    return YES;
+}
+
+/* Emits the next source element, and returns NO once the pass is finished. */
+static inline BOOL passStep(struct ETSequencePass *pass)
+{
+    id object = (pass->finished ? nil : sourceNext(&pass->source));
+
+    if (nil == object || NO == emit(pass, 0, object))
+    {
+        pass->finished = YES;
+    }
+    return (NO == pass->finished);
+}
+
+/* Sinks */
+
+typedef void (*AddObjectFunction)(id, SEL, id);
+
+typedef struct
+{
+    id target;
+    AddObjectFunction addObject;
+} ETCollectionSinkContext;
+
+static void collectionSink(id object, void *context)
+{
+    ETCollectionSinkContext *ctx = context;
+    ctx->addObject(ctx->target, @selector(addObject:), object);
+}
+
+typedef struct
+{
+    id (^block)(id, id);
+    id accumulator;
+} ETFoldSinkContext;
+
+static void foldSink(id object, void *context)
+{
+    ETFoldSinkContext *ctx = context;
+    ctx->accumulator = ctx->block(ctx->accumulator, object);
+}
+
+static void enumerationSink(id object, void *context)
+{
+    ETSequenceEnumerationState *enumeration = context;
+
+    if (enumeration->count == enumeration->capacity)
+    {
+        id *items = realloc(enumeration->items, 2 * enumeration->capacity * sizeof(id));
+
+        if (NULL == items)
+        {
+            [NSException raise: NSMallocException
+                        format: @"Failed to grow the sequence enumeration buffer"];
+        }
+        enumeration->items = items;
+        enumeration->capacity *= 2;
+    }
+    enumeration->items[enumeration->count++] = object;
+}
+
+@implementation ETSequence
+
++ (ETSequence *)sequenceWithCollection: (id <ETCollection>)aCollection
+{
+    return AUTORELEASE([[self alloc] initWithCollection: aCollection]);
+}
+
+- (id)initWithCollection: (id <ETCollection>)aCollection
+{
+    NILARG_EXCEPTION_TEST(aCollection);
+    SUPERINIT;
+    _source = RETAIN(aCollection);
+    return self;
+}
+
+- (void)dealloc
+{
+    for (NSUInteger i = 0; i < _stageCount; i++)
+    {
+        DESTROY(_stages[i].block);
+        DESTROY(_stages[i].collection);
+    }
+    free(_stages);
+    DESTROY(_source);
+    DESTROY(_enumerations);
+    [super dealloc];
+}
+
+/* Returns a new sequence with the receiver stages followed by aStage. */
+- (ETSequence *)sequenceByAddingStage: (struct ETSequenceStage)aStage
+{
+    ETSequence *sequence = [[[self class] alloc] initWithCollection: _source];
+
+    sequence->_stageCount = _stageCount + 1;
+    sequence->_stages = malloc(sequence->_stageCount * sizeof(struct ETSequenceStage));
+    for (NSUInteger i = 0; i < _stageCount; i++)
+    {
+        sequence->_stages[i] = _stages[i];
+        RETAIN(_stages[i].block);
+        RETAIN(_stages[i].collection);
+    }
+    sequence->_stages[_stageCount] = aStage;
+    return AUTORELEASE(sequence);
+}
+
+- (ETSequence *)mappedSequenceWithBlock: (id (^)(id))aBlock
+{
+    NILARG_EXCEPTION_TEST(aBlock);
+    struct ETSequenceStage stage = { ETSequenceStageMap, [aBlock copy], nil, 0 };
+    return [self sequenceByAddingStage: stage];
+}
+
+- (ETSequence *)filteredSequenceWithBlock: (BOOL (^)(id))aBlock
+{
+    NILARG_EXCEPTION_TEST(aBlock);
+    struct ETSequenceStage stage = { ETSequenceStageFilter, [aBlock copy], nil, 0 };
+    return [self sequenceByAddingStage: stage];
+}
+
+- (ETSequence *)sequenceLimitedToCount: (NSUInteger)aCount
+{
+    struct ETSequenceStage stage = { ETSequenceStageTake, nil, nil, aCount };
+    return [self sequenceByAddingStage: stage];
+}
+
+- (ETSequence *)flatMappedSequenceWithBlock: (id <ETCollection> (^)(id))aBlock
+{
+    NILARG_EXCEPTION_TEST(aBlock);
+    struct ETSequenceStage stage = { ETSequenceStageFlatMap, [aBlock copy], nil, 0 };
+    return [self sequenceByAddingStage: stage];
+}
+
+- (ETSequence *)zippedSequenceWithCollection: (id <ETCollection>)aCollection
+                                    andBlock: (id (^)(id, id))aBlock
+{
+    NILARG_EXCEPTION_TEST(aCollection);
+    NILARG_EXCEPTION_TEST(aBlock);
+    struct ETSequenceStage stage =
+        { ETSequenceStageZip, [aBlock copy], RETAIN(aCollection), 0 };
+    return [self sequenceByAddingStage: stage];
+}
+
+- (void)runWithSink: (ETSequenceSink)aSink context: (void *)aContext
+{
+    struct ETSequencePass pass;
+
+    passInit(&pass, _source, _stages, _stageCount, aSink, aContext);
+    while (passStep(&pass)) { }
+    passDestroy(&pass);
+}
+
+- (id)collection
+{
+    Class collectionClass =
+        ([_source isKeyed] ? [NSMutableArray class] : [[_source class] mutableClass]);
+    id target = AUTORELEASE([[collectionClass alloc] init]);
+    ETCollectionSinkContext ctx = { target,
+        (AddObjectFunction)[target methodForSelector: @selector(addObject:)] };
+
+    [self runWithSink: collectionSink context: &ctx];
+    return target;
+}
+
+- (id)leftFoldWithInitialValue: (id)initialValue
+                     intoBlock: (id (^)(id, id))aBlock
+{
+    NILARG_EXCEPTION_TEST(aBlock);
+    ETFoldSinkContext ctx = { aBlock, initialValue };
+
+    [self runWithSink: foldSink context: &ctx];
+    return ctx.accumulator;
+}
+
+- (NSUInteger)countByEnumeratingWithState: (NSFastEnumerationState *)state
+                                  objects: (__unsafe_unretained id *)stackbuf
+                                    count: (NSUInteger)len
+{
+    ETSequenceEnumerationState *enumeration;
+
+    if (0 == state->state)
+    {
+        enumeration = [[ETSequenceEnumerationState alloc]
+            initWithCapacity: MAX(len, SOURCE_BUFFER_SIZE)];
+        if (nil == enumeration)
+        {
+            [NSException raise: NSMallocException
+                        format: @"Failed to allocate the sequence enumeration buffer"];
+        }
+        @synchronized(self)
+        {
+            if (nil == _enumerations)
+            {
+                _enumerations = [NSMutableArray new];
+            }
+            [_enumerations addObject: enumeration];
+        }
+        [enumeration release];
+        passInit(&enumeration->pass, _source, _stages, _stageCount,
+                 enumerationSink, enumeration);
+        enumeration->passing = YES;
+        state->state = 1;
+        state->extra[0] = (unsigned long)enumeration;
+        /* The stages see the source as it is at each step */
+        state->mutationsPtr = (unsigned long *)&_stageCount;
+    }
+    else
+    {
+        enumeration = (ETSequenceEnumerationState *)state->extra[0];
+    }
+
+    if (nil == enumeration)
+    {
+        state->itemsPtr = stackbuf;
+        return 0;
+    }
+
+    /* Fill the buffer with at least len elements, or until the pass ends */
+    enumeration->count = 0;
+    while (enumeration->count < len && passStep(&enumeration->pass)) { }
+
+    NSUInteger count = enumeration->count;
+
+    state->itemsPtr = enumeration->items;
+    if (0 == count)
+    {
+        state->itemsPtr = stackbuf;
+        state->extra[0] = 0;
+        @synchronized(self)
+        {
+            [_enumerations removeObjectIdenticalTo: enumeration];
+        }
+    }
+    return count;
+}
+
+@end
+
+@implementation ETSequenceEnumerationState
+
+- (id)initWithCapacity: (NSUInteger)aCapacity
+{
+    SUPERINIT;
+    capacity = aCapacity;
+    items = malloc(capacity * sizeof(id));
+    if (NULL == items)
+    {
+        [self release];
+        return nil;
+    }
+    return self;
+}
+
+- (void)finishPass
+{
+    if (passing)
+    {
+        passDestroy(&pass);
+        passing = NO;
+    }
+}
+
+- (void)dealloc
+{
+    [self finishPass];
+    free(items);
+    [super dealloc];
+}
+
+@end
+
+#endif
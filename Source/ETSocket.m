@@ -13,13 +13,111 @@
 #include <openssl/ssl.h>
 #include <openssl/err.h>
 #include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
 #include "glibc_hack_unistd.h"
 #include <arpa/inet.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <netdb.h>
 #include <objc/runtime.h>
+#ifdef __linux__
+#   include <sys/epoll.h>
+#   define ET_USE_EPOLL 1
+#endif
 
 NSString *ETSocketException = @"ETSocketException";
+
+/** Readiness events watched by the event loop. */
+enum
+{
+    ETSocketReadable = 1 << 0,
+    ETSocketWritable = 1 << 1
+};
+
+/** Initial size of the read buffer. */
+static const NSUInteger ETSocketMinimumReadCapacity = 4096;
+/** Largest size the read buffer grows to. */
+static const NSUInteger ETSocketMaximumReadCapacity = 1024 * 1024;
+
+/**
+ * Private class that multiplexes the sockets with a delegate on a thread, and
+ * calls them back from the run loop of that thread when they become readable
+ * or writable.
+ *
+ * On Linux, the sockets are registered with an epoll descriptor, and only
+ * that descriptor is watched by the run loop, which gathers all the ready
+ * sockets with a single epoll_wait() call.  Elsewhere, each socket
+ * descriptor is watched by the run loop directly, which polls them.
+ */
+@interface ETSocketEventLoop : NSObject <RunLoopEvents>
+{
+    NSThread *thread;
+    /** Run loop of thread, where the descriptors are registered. */
+    NSRunLoop *runLoop;
+    /**
+     * Guards the socket registrations and the pending events, since sockets
+     * released on other threads are unregistered from there.
+     */
+    NSRecursiveLock *lock;
+#ifdef ET_USE_EPOLL
+    int epollDescriptor;
+    /** Events returned by the last epoll_wait() call. */
+    struct epoll_event events[64];
+    /** Number of entries in events still to be dispatched. */
+    int eventCount;
+    /** Index of the next entry in events to dispatch. */
+    int nextEvent;
+#else
+    /** Sockets indexed by their descriptors. */
+    NSMapTable *sockets;
+#endif
+    NSUInteger socketCount;
+}
+/**
+ * Returns the event loop of the current thread.
+ */
++ (ETSocketEventLoop*)currentEventLoop;
+/**
+ * Returns whether the receiver belongs to the current thread.
+ */
+- (BOOL)isCurrent;
+/**
+ * Changes the events watched for aSocket from oldEvents to newEvents.
+ */
+- (void)watchSocket: (ETSocket*)aSocket
+         descriptor: (int)aDescriptor
+         fromEvents: (int)oldEvents
+           toEvents: (int)newEvents;
+/**
+ * Stops watching aSocket, which is being deallocated, for the given events.
+ * When called from another thread, no event is dispatched to aSocket once
+ * this method returns, but its descriptor is removed from the run loop later
+ * on the thread of the receiver, since run loops are not thread-safe, and
+ * aHandle is kept open until then so that its descriptor is not reused.
+ */
+- (void)unwatchSocket: (ETSocket*)aSocket
+               handle: (NSFileHandle*)aHandle
+               events: (int)events;
+/**
+ * Stops dispatching events to aSocket.  This can be called from any thread.
+ */
+- (void)forgetSocket: (ETSocket*)aSocket descriptor: (int)aDescriptor;
+/**
+ * Removes aDescriptor, watched for oldEvents, from the run loop.
+ */
+- (void)unwatchDescriptor: (int)aDescriptor events: (int)oldEvents;
+/**
+ * Acquires the lock under which the receiver retains the sockets it
+ * dispatches events to.
+ */
+- (void)lock;
+/**
+ * Relinquishes the lock acquired with -lock.
+ */
+- (void)unlock;
+@end
+
 /**
  * Private subclass handling sockets with SSL enabled.
  */
@@ -27,7 +125,10 @@ NSString *ETSocketException = @"ETSocketException";
 @end
 
 @interface ETSocket (Private)
-- (void)receiveData: (NSNotification*)aNotification;
+- (id)initWithFileHandle: (NSFileHandle*)anHandle nonBlocking: (BOOL)isNonBlocking;
+- (BOOL)growReadBuffer;
+- (void)socketDidBecomeReadable;
+- (void)socketDidBecomeWritable;
 @end
 
 @implementation ETSocket
@@ -39,23 +140,36 @@ NSString *ETSocketException = @"ETSocketException";
     SSL_library_init();
 }
 
-- (id)initWithFileHandle: (NSFileHandle*)anHandle
+- (id)initWithFileHandle: (NSFileHandle*)anHandle nonBlocking: (BOOL)isNonBlocking
 {
     SUPERINIT;
     handle = [anHandle retain];
+    readCapacity = ETSocketMinimumReadCapacity;
+    outputQueue = [NSMutableArray new];
+    outputHighWaterMark = 1024 * 1024;
+    if (isNonBlocking)
+    {
+        int s = [handle fileDescriptor];
+        fcntl(s, F_SETFL, fcntl(s, F_GETFL) | O_NONBLOCK);
+    }
     return self;
 }
 
+- (id)initWithFileHandle: (NSFileHandle*)anHandle
+{
+    return [self initWithFileHandle: anHandle nonBlocking: YES];
+}
+
 - (id)initConnectedToRemoteHost: (NSString*)aHost
                      forService: (NSString*)aService
 {
     NSFileHandle *theHandle = [NSFileHandle fileHandleConnectedToRemoteHost: aHost
                                                                  forService: aService];
-    eofCounter = 0;
     self.connectionIsBroken = NO;
     
     if (nil == theHandle)
     {
+        [self release];
         return nil;
     }
     
@@ -74,6 +188,9 @@ NSString *ETSocketException = @"ETSocketException";
     fcntl([handle fileDescriptor], F_SETFL, 0);
     sslContext = SSL_CTX_new(SSLv23_client_method());
     ssl = SSL_new(sslContext);
+    // Queued output is retried from a copy, possibly in smaller pieces.
+    SSL_set_mode(ssl, SSL_MODE_ENABLE_PARTIAL_WRITE | 
+                      SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
     SSL_set_fd(ssl, [handle fileDescriptor]);
     int ret = SSL_connect(ssl);
     fcntl([handle fileDescriptor], F_SETFL, O_NONBLOCK);
@@ -81,103 +198,573 @@ NSString *ETSocketException = @"ETSocketException";
     return ret == 1;
 }
 
+/**
+ * Asks the event loop to watch for the given events, or stops watching the
+ * socket if events is 0.
+ */
+- (void)watchEvents: (int)events
+{
+    if (events == watchedEvents || nil == eventLoop)
+    {
+        return;
+    }
+    [eventLoop watchSocket: self
+                descriptor: [handle fileDescriptor]
+                fromEvents: watchedEvents
+                  toEvents: events];
+    watchedEvents = events;
+}
+/**
+ * Returns the events the socket needs to watch for in its current state.
+ */
+- (int)neededEvents
+{
+    int events = (nil != delegate) ? ETSocketReadable : 0;
+
+    if (queuedByteCount > 0)
+    {
+        events |= writeWantsRead ? ETSocketReadable : ETSocketWritable;
+    }
+    return events;
+}
+
 - (void)setDelegate: (id)aDelegate
 {
     delegate = aDelegate;
-    NSNotificationCenter *center = [NSNotificationCenter defaultCenter];
-    if (nil != delegate)
+    if (nil != delegate && nil == eventLoop)
     {
-        [center addObserver: self
-                   selector: @selector(receiveData:)
-                       name: NSFileHandleDataAvailableNotification
-                     object: handle];
-        [handle waitForDataInBackgroundAndNotify];
+        eventLoop = [[ETSocketEventLoop currentEventLoop] retain];
     }
-    else
+    [self watchEvents: [self neededEvents]];
+}
+/**
+ * Grows the read buffer, up to ETSocketMaximumReadCapacity, and returns NO if
+ * it is already that large.
+ */
+- (BOOL)growReadBuffer
+{
+    if (readCapacity >= ETSocketMaximumReadCapacity)
     {
-        [center removeObserver: self];
+        return NO;
     }
+    readCapacity = MIN(2 * readCapacity, ETSocketMaximumReadCapacity);
+    [readBuffer setLength: readCapacity];
+    return YES;
 }
+/**
+ * Reads whatever is available and returns it in a new object sized to the
+ * bytes read, empty if nothing could be read.  Returns nil at the end of the
+ * stream.
+ *
+ * Bytes are read into a buffer kept for the lifetime of the socket, which
+ * grows while reads fill it.  Anything left once it is as large as
+ * ETSocketMaximumReadCapacity is read when the event loop reports the socket
+ * as readable again.
+ */
 - (NSMutableData*)readDataFromSocket
 {
-    NSMutableData *data = [NSMutableData dataWithData: [handle availableData]];
-    return data;
+    if (nil == readBuffer)
+    {
+        readBuffer = [[NSMutableData alloc] initWithLength: readCapacity];
+    }
+    NSUInteger length = 0;
+
+    for (;;)
+    {
+        ssize_t count = read([handle fileDescriptor],
+                             (char*)[readBuffer mutableBytes] + length,
+                             readCapacity - length);
+
+        if (count > 0)
+        {
+            length += count;
+            if (length < readCapacity || ![self growReadBuffer])
+            {
+                break;
+            }
+            continue;
+        }
+        if (count < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+            break;
+        }
+        // End of the stream or failure, reported once the bytes read so far
+        // have been delivered.
+        if (0 == length)
+        {
+            return nil;
+        }
+        break;
+    }
+    return [NSMutableData dataWithBytes: [readBuffer mutableBytes]
+                                 length: length];
 }
-- (void)receiveData: (NSNotification*)aNotification
+- (void)socketDidBecomeReadable
 {
+    if (writeWantsRead)
+    {
+        [self socketDidBecomeWritable];
+    }
+    if (nil == delegate)
+    {
+        return;
+    }
+
     NSMutableData *data = [self readDataFromSocket];
+    if (nil == data)
+    {
+        self.connectionIsBroken = YES;
+        [self watchEvents: 0];
+        [delegate receivedData:nil fromSocket:nil];
+        return;
+    }
     if ([data length] == 0)
     {
-        eofCounter += 1;
-        
-        if (eofCounter == 100)
+        return;
+    }
+    self.connectionIsBroken = NO;
+
+    if ([inFilters count] > 0 
+        || [delegate respondsToSelector: @selector(receivedSegments:fromSocket:)])
+    {
+        [self deliverSegmentsFromData: data];
+    }
+    else
+    {
+        [delegate receivedData: data fromSocket: self];
+    }
+}
+- (void)sendData: (NSData*)data
+{
+    struct iovec chunk = { (void*)[data bytes], [data length] };
+    [self sendChunks: &chunk count: 1];
+}
+/**
+ * Writes as much of the chunks as the socket accepts with a single system
+ * call and returns the number of bytes written, or 0 if the socket would
+ * block.  Throws ETSocketException if the connection failed.
+ */
+- (size_t)writeChunks: (const struct iovec*)chunks count: (int)count
+{
+    for (;;)
+    {
+        ssize_t sent = writev([handle fileDescriptor], chunks, MIN(count, IOV_MAX));
+        sendCallCount++;
+        if (sent >= 0)
+        {
+            sentByteCount += sent;
+            return sent;
+        }
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+        {
+            return 0;
+        }
+        if (errno != EINTR)
+        {
+            [NSException raise: ETSocketException
+                        format: @"Sending failed"];
+        }
+    }
+}
+/**
+ * Writes as much of the queued output as the socket accepts.  Tells the
+ * delegate when the queue drains after exceeding the high water mark.
+ */
+- (void)writeQueuedOutput
+{
+    while (queuedByteCount > 0)
+    {
+        int count = MIN([outputQueue count], 64);
+        struct iovec chunks[count];
+
+        for (int i=0 ; i<count ; i++)
+        {
+            NSData *data = [outputQueue objectAtIndex: i];
+            NSUInteger offset = (0 == i) ? outputOffset : 0;
+            chunks[i].iov_base = (char*)[data bytes] + offset;
+            chunks[i].iov_len = [data length] - offset;
+        }
+
+        size_t sent = [self writeChunks: chunks count: count];
+        if (0 == sent)
+        {
+            break;
+        }
+        queuedByteCount -= sent;
+        sent += outputOffset;
+        while ([outputQueue count] > 0 && sent >= [[outputQueue objectAtIndex: 0] length])
+        {
+            sent -= [[outputQueue objectAtIndex: 0] length];
+            [outputQueue removeObjectAtIndex: 0];
+        }
+        outputOffset = sent;
+    }
+    if (0 == queuedByteCount && outputAboveHighWaterMark)
+    {
+        outputAboveHighWaterMark = NO;
+        if ([delegate respondsToSelector: @selector(socketOutputDidDrain:)])
+        {
+            [delegate socketOutputDidDrain: self];
+        }
+    }
+}
+/**
+ * Waits with poll() until the queued output has been written.
+ */
+- (void)drainQueuedOutput
+{
+    while (queuedByteCount > 0)
+    {
+        struct pollfd descriptor = 
+            { [handle fileDescriptor], writeWantsRead ? POLLIN : POLLOUT, 0 };
+        if (poll(&descriptor, 1, -1) < 0 && errno != EINTR)
+        {
+            [NSException raise: ETSocketException
+                        format: @"Sending failed"];
+        }
+        [self writeQueuedOutput];
+    }
+}
+- (void)socketDidBecomeWritable
+{
+    [self writeQueuedOutput];
+    [self watchEvents: [self neededEvents]];
+}
+- (void)sendChunksToSocket: (const struct iovec*)chunks count: (int)count
+{
+    struct iovec pending[count];
+    int first = 0;
+
+    memcpy(pending, chunks, count * sizeof(struct iovec));
+    // Preserve the ordering: anything already queued goes out first.
+    while (0 == queuedByteCount && first < count)
+    {
+        size_t sent = [self writeChunks: pending + first count: count - first];
+        if (0 == sent)
+        {
+            break;
+        }
+        // Skip the chunks that were sent completely, and advance into the
+        // first one that was not.
+        while (first < count && sent >= pending[first].iov_len)
         {
-            eofCounter = 0;
-            self.connectionIsBroken = YES;
-            [delegate receivedData:nil fromSocket:nil];
-            return;
+            sent -= pending[first].iov_len;
+            first++;
         }
+        if (first < count)
+        {
+            pending[first].iov_base = (char*)pending[first].iov_base + sent;
+            pending[first].iov_len -= sent;
+        }
+    }
+    if (first == count)
+    {
+        return;
+    }
+
+    NSMutableData *rest = [NSMutableData data];
+    for (int i=first ; i<count ; i++)
+    {
+        [rest appendBytes: pending[i].iov_base length: pending[i].iov_len];
+    }
+    [outputQueue addObject: rest];
+    queuedByteCount += [rest length];
+
+    if (queuedByteCount > outputHighWaterMark && !outputAboveHighWaterMark)
+    {
+        outputAboveHighWaterMark = YES;
+        if ([delegate respondsToSelector: @selector(socketOutputDidExceedHighWaterMark:)])
+        {
+            [delegate socketOutputDidExceedHighWaterMark: self];
+        }
+    }
+    // The queue can only be written in the background by the event loop of
+    // this thread.
+    if (sendsInBackground && [eventLoop isCurrent])
+    {
+        [self watchEvents: [self neededEvents]];
     }
     else
     {
-        self.connectionIsBroken = NO;
-        eofCounter = 0;
+        [self drainQueuedOutput];
     }
-    
-    FOREACH(inFilters, filter, id<ETSocketFilter>)
+}
+/**
+ * Returns the chunks concatenated in a new buffer.
+ */
+static NSMutableData *coalesceChunks(const struct iovec *chunks, int count)
+{
+    size_t length = 0;
+    for (int i=0 ; i<count ; i++)
     {
-        data = [filter filterData: data];
+        length += chunks[i].iov_len;
     }
-    if (nil != data)
+    NSMutableData *data = [NSMutableData dataWithCapacity: length];
+    for (int i=0 ; i<count ; i++)
     {
-        [delegate receivedData: data fromSocket: self];
+        [data appendBytes: chunks[i].iov_base length: chunks[i].iov_len];
     }
-    [handle waitForDataInBackgroundAndNotify];
+    return data;
 }
-- (void)sendDataToSocket: (NSData*)data
+/**
+ * Resizes the buffers of a filter chain from oldFilterCount to
+ * newFilterCount filters.  There is a buffer for the input of the chain, and
+ * one for the output of each filter.  buffers may be NULL.
+ */
+static ETSegmentBuffer *resizeFilterBuffers(ETSegmentBuffer *buffers,
+                                            NSUInteger oldFilterCount,
+                                            NSUInteger newFilterCount)
 {
-    int s = [handle fileDescriptor];
-    const char *bytes = [data bytes];
-    unsigned len = [data length];
+    NSUInteger i = (NULL == buffers) ? 0 : oldFilterCount + 1;
 
-    int sent;
-    while(len > 0)
+    buffers = realloc(buffers, (newFilterCount + 1) * sizeof(ETSegmentBuffer));
+    for (; i<=newFilterCount ; i++)
     {
-        sent = write(s, bytes, len);
-        if (sent < 0)
+        buffers[i] = ETSegmentBufferNew();
+    }
+    return buffers;
+}
+/**
+ * Resets the buffers of a filter chain.
+ */
+static void resetFilterBuffers(ETSegmentBuffer *buffers, NSUInteger filterCount)
+{
+    for (NSUInteger i=0 ; i<=filterCount ; i++)
+    {
+        ETSegmentBufferReset(buffers[i]);
+    }
+}
+/**
+ * Raises NSMallocException if segments could not be added to buffer.
+ */
+static void checkFilterBuffer(ETSegmentBuffer buffer)
+{
+    if (ETSegmentBufferFailed(buffer))
+    {
+        [NSException raise: NSMallocException
+                    format: @"Failed to allocate memory for filtered data"];
+    }
+}
+/**
+ * Runs the filters over the data in buffers[0], and returns the buffer that
+ * holds the result.
+ *
+ * Filters that only implement ETSocketFilter get a copy of their input in an
+ * NSMutableData object, and the data they return is kept alive by the current
+ * autorelease pool.
+ */
+static ETSegmentBuffer runFilters(NSArray *filters, ETSegmentBuffer *buffers)
+{
+    ETSegmentBuffer input = buffers[0];
+    NSUInteger i = 1;
+
+    checkFilterBuffer(input);
+    FOREACH(filters, filter, id)
+    {
+        ETSegmentBuffer output = buffers[i++];
+
+        if ([filter respondsToSelector: @selector(filterSegments:into:)])
         {
-            if (errno != EAGAIN && 
-                errno != EINTR && 
-                errno != EAGAIN && 
-                errno != EWOULDBLOCK)
+            [filter filterSegments: input into: output];
+        }
+        else
+        {
+            NSMutableData *data = coalesceChunks(ETSegmentBufferSegments(input),
+                                                 ETSegmentBufferCount(input));
+            data = [filter filterData: data];
+            if (nil != data)
             {
-                [NSException raise: ETSocketException
-                            format: @"Sending failed"];
+                ETSegmentBufferAppendMutable(output, [data mutableBytes], [data length]);
             }
-            sent = 0;
         }
-        len -= sent;
-        bytes += sent;
+        checkFilterBuffer(output);
+        input = output;
     }
+    return input;
 }
-- (void)sendData: (NSData*)data
+- (void)addOutFilter: (id)aFilter
+{
+    if (nil == outFilters)
+    {
+        outFilters = [NSMutableArray new];
+    }
+    outFilterBuffers = resizeFilterBuffers(outFilterBuffers, [outFilters count],
+                                           [outFilters count] + 1);
+    [outFilters addObject: aFilter];
+}
+- (void)addInFilter: (id)aFilter
 {
-    if ([outFilters count] > 0)
+    if (nil == inFilters)
     {
-        data = [data mutableCopy];
-        FOREACH(outFilters, filter, id<ETSocketFilter>)
+        inFilters = [NSMutableArray new];
+    }
+    inFilterBuffers = resizeFilterBuffers(inFilterBuffers, [inFilters count],
+                                          [inFilters count] + 1);
+    [inFilters addObject: aFilter];
+}
+/**
+ * Passes data (the read buffer) through the input filters, and hands the
+ * result to the delegate.
+ */
+- (void)deliverSegmentsFromData: (NSMutableData*)data
+{
+    NSUInteger filterCount = [inFilters count];
+
+    if (NULL == inFilterBuffers)
+    {
+        inFilterBuffers = resizeFilterBuffers(NULL, 0, 0);
+    }
+    resetFilterBuffers(inFilterBuffers, filterCount);
+    ETSegmentBufferAppendMutable(inFilterBuffers[0], [data mutableBytes], [data length]);
+
+    ETSegmentBuffer output = runFilters(inFilters, inFilterBuffers);
+    const struct iovec *segments = ETSegmentBufferSegments(output);
+    int count = ETSegmentBufferCount(output);
+
+    if ([delegate respondsToSelector: @selector(receivedSegments:fromSocket:)])
+    {
+        [delegate receivedSegments: output fromSocket: self];
+    }
+    else if (1 == count && segments[0].iov_base == [data mutableBytes])
+    {
+        // Filtered in place (or not at all), so deliver the read buffer.
+        [data setLength: segments[0].iov_len];
+        [delegate receivedData: data fromSocket: self];
+    }
+    else if (count > 0)
+    {
+        [delegate receivedData: coalesceChunks(segments, count) fromSocket: self];
+    }
+    resetFilterBuffers(inFilterBuffers, filterCount);
+}
+- (void)sendChunks: (const struct iovec*)chunks count: (int)count
+{
+    if (count <= 0)
+    {
+        return;
+    }
+    NSUInteger filterCount = [outFilters count];
+    if (filterCount > 0)
+    {
+        resetFilterBuffers(outFilterBuffers, filterCount);
+        for (int i=0 ; i<count ; i++)
         {
-            data = [filter filterData: (NSMutableData*)data];
+            ETSegmentBufferAppend(outFilterBuffers[0], chunks[i].iov_base, chunks[i].iov_len);
         }
+        ETSegmentBuffer output = runFilters(outFilters, outFilterBuffers);
+        // Anything that can't be written immediately is copied into the
+        // output queue, so the buffers can be reset afterwards.
+        [self sendChunksToSocket: ETSegmentBufferSegments(output)
+                           count: ETSegmentBufferCount(output)];
+        resetFilterBuffers(outFilterBuffers, filterCount);
+        return;
+    }
+    [self sendChunksToSocket: chunks count: count];
+}
+- (void)setCorked: (BOOL)aFlag
+{
+    if (aFlag == corked)
+    {
+        return;
+    }
+    corked = aFlag;
+#if defined(TCP_CORK) || defined(TCP_NOPUSH)
+    int value = aFlag;
+#   ifdef TCP_CORK
+    int option = TCP_CORK;
+#   else
+    int option = TCP_NOPUSH;
+#   endif
+    if (0 != setsockopt([handle fileDescriptor], IPPROTO_TCP, option, 
+                        &value, sizeof(value)))
+    {
+        NSDebugLog(@"Failed to %@ socket %@", aFlag ? @"cork" : @"uncork", self);
     }
-    [self sendDataToSocket: data];
+#endif
+}
+- (BOOL)isCorked
+{
+    return corked;
+}
+- (unsigned long long)sentByteCount
+{
+    return sentByteCount;
+}
+- (NSUInteger)sendCallCount
+{
+    return sendCallCount;
+}
+- (void)setOutputHighWaterMark: (NSUInteger)aByteCount
+{
+    outputHighWaterMark = aByteCount;
+}
+- (NSUInteger)outputHighWaterMark
+{
+    return outputHighWaterMark;
+}
+- (NSUInteger)queuedByteCount
+{
+    return queuedByteCount;
+}
+- (void)setSendsInBackground: (BOOL)aFlag
+{
+    sendsInBackground = aFlag;
+}
+- (BOOL)sendsInBackground
+{
+    return sendsInBackground;
+}
+/**
+ * The event loop retains a socket under its lock before dispatching an event
+ * to it, so the last reference is released under the same lock when the
+ * event loop runs on another thread.  Otherwise the event loop could retain
+ * a socket being deallocated.
+ */
+- (oneway void)release
+{
+    if (nil == eventLoop || [eventLoop isCurrent])
+    {
+        [super release];
+        return;
+    }
+    ETSocketEventLoop *loop = [eventLoop retain];
+
+    [loop lock];
+    [super release];
+    [loop unlock];
+    [loop release];
 }
 - (void)dealloc
 {
-    NSNotificationCenter *center = [NSNotificationCenter defaultCenter];
-    [center removeObserver: self name:NSFileHandleDataAvailableNotification object:handle];
+    if (0 != watchedEvents)
+    {
+        [eventLoop unwatchSocket: self handle: handle events: watchedEvents];
+    }
+    [eventLoop release];
+    if (NULL != inFilterBuffers)
+    {
+        for (NSUInteger i=0 ; i<=[inFilters count] ; i++)
+        {
+            ETSegmentBufferFree(inFilterBuffers[i]);
+        }
+        free(inFilterBuffers);
+    }
+    if (NULL != outFilterBuffers)
+    {
+        for (NSUInteger i=0 ; i<=[outFilters count] ; i++)
+        {
+            ETSegmentBufferFree(outFilterBuffers[i]);
+        }
+        free(outFilterBuffers);
+    }
     [inFilters release];
     [outFilters release];
+    [outputQueue release];
+    [readBuffer release];
     [handle release];
     [super dealloc];
 }
@@ -186,48 +773,79 @@ NSString *ETSocketException = @"ETSocketException";
 @implementation ETSSLSocket
 - (NSMutableData*)readDataFromSocket
 {
-    NSMutableData *data = [NSMutableData data];
-    int count = 0;
-    while (0 < (count = SSL_read(ssl, buffer, 512)))
+    if (nil == readBuffer)
     {
-        [data appendBytes: buffer length: count];
+        readBuffer = [[NSMutableData alloc] initWithLength: readCapacity];
     }
-    return data;
-}
-- (void)sendDataToSocket: (NSData*)data
-{
-    const char *bytes = [data bytes];
-    unsigned len = [data length];
+    NSUInteger length = 0;
 
-    int sent;
-    int error;
-    while(len > 0)
+    for (;;)
     {
-        sent = SSL_write(ssl, bytes, len);
-        if (sent <= 0)
+        int count = SSL_read(ssl, (char*)[readBuffer mutableBytes] + length,
+                             readCapacity - length);
+
+        if (count > 0)
         {
-            error = SSL_get_error(ssl, sent);
-            while(error == SSL_ERROR_WANT_WRITE || error == SSL_ERROR_WANT_READ)
-            {
-                sent = SSL_write(ssl, bytes, len);
-                if(sent <= 0)
-                {
-                    error = SSL_get_error(ssl, sent);
-                }
-                else
-                {
-                    error = SSL_ERROR_NONE;
-                }
-            }
-            if(error != SSL_ERROR_NONE)
+            length += count;
+            if (length < readCapacity || ![self growReadBuffer])
             {
-                [NSException raise: ETSocketException
-                            format: @"Sending failed"];
+                break;
             }
+            continue;
         }
-        len -= sent;
-        bytes += sent;
+
+        int error = SSL_get_error(ssl, count);
+        if (error == SSL_ERROR_WANT_READ || error == SSL_ERROR_WANT_WRITE)
+        {
+            break;
+        }
+        if (0 == length)
+        {
+            return nil;
+        }
+        break;
     }
+    return [NSMutableData dataWithBytes: [readBuffer mutableBytes]
+                                 length: length];
+}
+- (size_t)writeChunks: (const struct iovec*)chunks count: (int)count
+{
+    // Each SSL_write() produces at least one record, so only the first chunk
+    // is written at a time.
+    int sent = SSL_write(ssl, chunks[0].iov_base, chunks[0].iov_len);
+    sendCallCount++;
+    writeWantsRead = NO;
+    if (sent > 0)
+    {
+        sentByteCount += sent;
+        return sent;
+    }
+
+    int error = SSL_get_error(ssl, sent);
+    if (error == SSL_ERROR_WANT_READ)
+    {
+        writeWantsRead = YES;
+        return 0;
+    }
+    if (error != SSL_ERROR_WANT_WRITE)
+    {
+        [NSException raise: ETSocketException
+                    format: @"Sending failed"];
+    }
+    return 0;
+}
+- (void)sendChunksToSocket: (const struct iovec*)chunks count: (int)count
+{
+    // Send the chunks as a single buffer, to avoid producing a record for
+    // each.
+    if (count > 1)
+    {
+        NSData *data = coalesceChunks(chunks, count);
+        struct iovec chunk = { (void*)[data bytes], [data length] };
+        [super sendChunksToSocket: &chunk count: 1];
+        return;
+    }
+    [super sendChunksToSocket: chunks count: count];
 }
 - (void)dealloc
 {
@@ -237,6 +855,284 @@ NSString *ETSocketException = @"ETSocketException";
 }
 @end
 
+@implementation ETSocketEventLoop
+
+static NSString *ETSocketEventLoopKey = @"ETSocketEventLoop";
+
++ (ETSocketEventLoop*)currentEventLoop
+{
+    NSMutableDictionary *threadDictionary = [[NSThread currentThread] threadDictionary];
+    ETSocketEventLoop *loop = [threadDictionary objectForKey: ETSocketEventLoopKey];
+
+    if (nil == loop)
+    {
+        loop = [[self new] autorelease];
+        [threadDictionary setObject: loop forKey: ETSocketEventLoopKey];
+    }
+    return loop;
+}
+- (id)init
+{
+    SUPERINIT;
+    thread = [NSThread currentThread];
+    runLoop = [[NSRunLoop currentRunLoop] retain];
+    lock = [NSRecursiveLock new];
+#ifdef ET_USE_EPOLL
+    epollDescriptor = epoll_create(64);
+    if (epollDescriptor < 0)
+    {
+        [self release];
+        [NSException raise: ETSocketException
+                    format: @"Failed to create the epoll descriptor"];
+    }
+    fcntl(epollDescriptor, F_SETFD, FD_CLOEXEC);
+#else
+    sockets = NSCreateMapTable(NSIntegerMapKeyCallBacks, 
+                               NSNonOwnedPointerMapValueCallBacks, 16);
+#endif
+    return self;
+}
+- (void)dealloc
+{
+#ifdef ET_USE_EPOLL
+    close(epollDescriptor);
+#else
+    NSFreeMapTable(sockets);
+#endif
+    [lock release];
+    [runLoop release];
+    [super dealloc];
+}
+- (BOOL)isCurrent
+{
+    return [NSThread currentThread] == thread;
+}
+- (void)lock
+{
+    [lock lock];
+}
+- (void)unlock
+{
+    [lock unlock];
+}
+- (void)unwatchRegistration: (NSArray*)aRegistration
+{
+    [self unwatchDescriptor: [[aRegistration objectAtIndex: 0] fileDescriptor]
+                     events: [[aRegistration objectAtIndex: 1] intValue]];
+}
+- (void)unwatchSocket: (ETSocket*)aSocket
+               handle: (NSFileHandle*)aHandle
+               events: (int)events
+{
+    if ([self isCurrent])
+    {
+        [self watchSocket: aSocket
+               descriptor: [aHandle fileDescriptor]
+               fromEvents: events
+                 toEvents: 0];
+        return;
+    }
+    [self forgetSocket: aSocket descriptor: [aHandle fileDescriptor]];
+    [self performSelector: @selector(unwatchRegistration:)
+                 onThread: thread
+               withObject: A(aHandle, [NSNumber numberWithInt: events])
+            waitUntilDone: NO];
+}
+#ifdef ET_USE_EPOLL
+- (void)watchSocket: (ETSocket*)aSocket
+         descriptor: (int)aDescriptor
+         fromEvents: (int)oldEvents
+           toEvents: (int)newEvents
+{
+    struct epoll_event event;
+    int operation = EPOLL_CTL_MOD;
+
+    event.events = ((newEvents & ETSocketReadable) ? EPOLLIN : 0) |
+                   ((newEvents & ETSocketWritable) ? EPOLLOUT : 0);
+    event.data.ptr = aSocket;
+    if (0 == newEvents)
+    {
+        [self forgetSocket: aSocket descriptor: aDescriptor];
+        [self unwatchDescriptor: aDescriptor events: oldEvents];
+        return;
+    }
+    if (0 == oldEvents)
+    {
+        operation = EPOLL_CTL_ADD;
+    }
+    if (0 != epoll_ctl(epollDescriptor, operation, aDescriptor, &event))
+    {
+        NSDebugLog(@"epoll_ctl failed for %@: %d", aSocket, errno);
+        return;
+    }
+    if (0 == oldEvents && 0 == socketCount++)
+    {
+        [runLoop addEvent: (void*)(intptr_t)epollDescriptor
+                                        type: ET_RDESC
+                                     watcher: self
+                                     forMode: NSDefaultRunLoopMode];
+    }
+}
+/**
+ * Removes aSocket from the epoll descriptor and from the pending events.
+ * epoll_ctl() is thread-safe, so this can be called from any thread.
+ */
+- (void)forgetSocket: (ETSocket*)aSocket descriptor: (int)aDescriptor
+{
+    struct epoll_event event = { 0 };
+
+    [lock lock];
+    if (0 != epoll_ctl(epollDescriptor, EPOLL_CTL_DEL, aDescriptor, &event))
+    {
+        NSDebugLog(@"epoll_ctl failed for %@: %d", aSocket, errno);
+    }
+    // Don't dispatch pending events to a socket that may be gone.
+    for (int i=0 ; i<eventCount ; i++)
+    {
+        if (events[i].data.ptr == aSocket)
+        {
+            events[i].data.ptr = NULL;
+        }
+    }
+    [lock unlock];
+}
+/**
+ * Stops watching the epoll descriptor once no socket is registered anymore.
+ */
+- (void)unwatchDescriptor: (int)aDescriptor events: (int)oldEvents
+{
+    if (0 == --socketCount)
+    {
+        [runLoop removeEvent: (void*)(intptr_t)epollDescriptor
+                                           type: ET_RDESC
+                                        forMode: NSDefaultRunLoopMode
+                                            all: YES];
+    }
+}
+- (void)receivedEvent: (void*)data
+                 type: (RunLoopEventType)type
+                extra: (void*)extra
+              forMode: (NSString*)mode
+{
+    do
+    {
+        [lock lock];
+        eventCount = epoll_wait(epollDescriptor, events, 64, 0);
+        [lock unlock];
+        for (nextEvent=0 ; nextEvent<eventCount ; nextEvent++)
+        {
+            [lock lock];
+            ETSocket *socket = [(id)events[nextEvent].data.ptr retain];
+            [lock unlock];
+            uint32_t ready = events[nextEvent].events;
+
+            if (nil == socket)
+            {
+                continue;
+            }
+            if (ready & (EPOLLIN | EPOLLHUP | EPOLLERR))
+            {
+                [socket socketDidBecomeReadable];
+            }
+            // The socket may have been removed while reading.
+            if ((ready & EPOLLOUT) && NULL != events[nextEvent].data.ptr)
+            {
+                [socket socketDidBecomeWritable];
+            }
+            [socket release];
+        }
+    } while (eventCount == 64);
+    [lock lock];
+    eventCount = 0;
+    [lock unlock];
+}
+#else
+- (void)watchSocket: (ETSocket*)aSocket
+         descriptor: (int)aDescriptor
+         fromEvents: (int)oldEvents
+           toEvents: (int)newEvents
+{
+    void *descriptor = (void*)(intptr_t)aDescriptor;
+    int added = newEvents & ~oldEvents;
+    int removed = oldEvents & ~newEvents;
+
+    if (0 == oldEvents)
+    {
+        [lock lock];
+        NSMapInsert(sockets, descriptor, aSocket);
+        [lock unlock];
+    }
+    if (added & ETSocketReadable)
+    {
+        [runLoop addEvent: descriptor type: ET_RDESC watcher: self forMode: NSDefaultRunLoopMode];
+    }
+    if (added & ETSocketWritable)
+    {
+        [runLoop addEvent: descriptor type: ET_WDESC watcher: self forMode: NSDefaultRunLoopMode];
+    }
+    if (0 == newEvents)
+    {
+        [self forgetSocket: aSocket descriptor: aDescriptor];
+        [self unwatchDescriptor: aDescriptor events: oldEvents];
+        return;
+    }
+    if (removed & ETSocketReadable)
+    {
+        [runLoop removeEvent: descriptor type: ET_RDESC forMode: NSDefaultRunLoopMode all: YES];
+    }
+    if (removed & ETSocketWritable)
+    {
+        [runLoop removeEvent: descriptor type: ET_WDESC forMode: NSDefaultRunLoopMode all: YES];
+    }
+}
+/**
+ * Removes aSocket from the sockets dispatched by descriptor.  This can be
+ * called from any thread.
+ */
+- (void)forgetSocket: (ETSocket*)aSocket descriptor: (int)aDescriptor
+{
+    [lock lock];
+    NSMapRemove(sockets, (void*)(intptr_t)aDescriptor);
+    [lock unlock];
+}
+/**
+ * Removes the descriptor watched for the given events from the run loop.
+ */
+- (void)unwatchDescriptor: (int)aDescriptor events: (int)oldEvents
+{
+    void *descriptor = (void*)(intptr_t)aDescriptor;
+
+    if (oldEvents & ETSocketReadable)
+    {
+        [runLoop removeEvent: descriptor type: ET_RDESC forMode: NSDefaultRunLoopMode all: YES];
+    }
+    if (oldEvents & ETSocketWritable)
+    {
+        [runLoop removeEvent: descriptor type: ET_WDESC forMode: NSDefaultRunLoopMode all: YES];
+    }
+}
+- (void)receivedEvent: (void*)data
+                 type: (RunLoopEventType)type
+                extra: (void*)extra
+              forMode: (NSString*)mode
+{
+    [lock lock];
+    ETSocket *socket = [(id)NSMapGet(sockets, data) retain];
+    [lock unlock];
+
+    if (type == ET_RDESC)
+    {
+        [socket socketDidBecomeReadable];
+    }
+    else if (type == ET_WDESC)
+    {
+        [socket socketDidBecomeWritable];
+    }
+    [socket release];
+}
+#endif
+@end
+
 
 @implementation ETListenSocket
 + (id)listenSocketOnPort: (unsigned short)aPort
@@ -291,7 +1187,8 @@ NSString *ETSocketException = @"ETSocketException";
         return nil;
     }
 
-    if (nil == (self = [super initWithFileHandle: descriptor]))
+    // Accepting is left to the file handle, which expects a blocking socket.
+    if (nil == (self = [super initWithFileHandle: descriptor nonBlocking: NO]))
     {
         return nil;
     }
@@ -395,6 +1292,11 @@ NSString *ETSocketException = @"ETSocketException";
     NSDebugLog(@"Attempt to send data via socket (%@) in listening mode", self);
 }
 
+- (void)sendChunks: (const struct iovec*)chunks count: (int)count
+{
+    NSDebugLog(@"Attempt to send data via socket (%@) in listening mode", self);
+}
+
 - (void)makeHandleSafelyAcceptConnectionInBackgroundAndNotify
 {
     if (NO == hasAccept)
@@ -0,0 +1,268 @@
+/*
+    Copyright (C) 2026 The Etoile Project
+
+    Date:  October 2026
+    License:  Modified BSD (see COPYING)
+ */
+
+#import "ETSocketFilters.h"
+#if !(TARGET_OS_IPHONE) && !(TARGET_OS_MAC)
+#import "Macros.h"
+#import "EtoileCompatibility.h"
+#include <stdint.h>
+#include <zlib.h>
+
+/** Scratch memory requested from the output buffer at a time. */
+static const size_t ETFilterOutputChunkSize = 16384;
+
+/**
+ * Returns capacity bytes of scratch memory from output, or raises
+ * NSMallocException if they cannot be allocated.
+ */
+static void *reserveOutput(ETSegmentBuffer output, size_t capacity)
+{
+    void *bytes = ETSegmentBufferReserve(output, capacity);
+
+    if (NULL == bytes)
+    {
+        [NSException raise: NSMallocException
+                    format: @"Failed to allocate %lu bytes of filter output",
+                            (unsigned long)capacity];
+    }
+    return bytes;
+}
+
+@implementation ETDeflateFilter
+- (id)initWithCompressionLevel: (int)aLevel
+{
+    SUPERINIT;
+    stream = calloc(1, sizeof(z_stream));
+    if (Z_OK != deflateInit(stream, aLevel))
+    {
+        [self release];
+        return nil;
+    }
+    return self;
+}
+- (id)init
+{
+    return [self initWithCompressionLevel: Z_DEFAULT_COMPRESSION];
+}
+- (void)dealloc
+{
+    if (NULL != stream)
+    {
+        deflateEnd(stream);
+        free(stream);
+    }
+    [super dealloc];
+}
+/**
+ * Compresses the input of the stream into scratch memory of output until all
+ * of it is consumed (and flushed, if requested).
+ */
+static void deflateInto(z_stream *s, int flush, ETSegmentBuffer output)
+{
+    do
+    {
+        s->next_out = reserveOutput(output, ETFilterOutputChunkSize);
+        s->avail_out = ETFilterOutputChunkSize;
+        deflate(s, flush);
+        ETSegmentBufferCommit(output, ETFilterOutputChunkSize - s->avail_out);
+    } while (0 == s->avail_out);
+}
+- (void)filterSegments: (ETSegmentBuffer)input into: (ETSegmentBuffer)output
+{
+    z_stream *s = stream;
+    const struct iovec *segments = ETSegmentBufferSegments(input);
+    int count = ETSegmentBufferCount(input);
+
+    for (int i=0 ; i<count ; i++)
+    {
+        s->next_in = segments[i].iov_base;
+        s->avail_in = segments[i].iov_len;
+        // Flush at the end of the send, so that it can be decompressed on
+        // its own.
+        deflateInto(s, (i == count - 1) ? Z_SYNC_FLUSH : Z_NO_FLUSH, output);
+    }
+}
+@end
+
+@implementation ETInflateFilter
+- (id)init
+{
+    SUPERINIT;
+    stream = calloc(1, sizeof(z_stream));
+    if (Z_OK != inflateInit(stream))
+    {
+        [self release];
+        return nil;
+    }
+    return self;
+}
+- (void)dealloc
+{
+    if (NULL != stream)
+    {
+        inflateEnd(stream);
+        free(stream);
+    }
+    [super dealloc];
+}
+- (void)filterSegments: (ETSegmentBuffer)input into: (ETSegmentBuffer)output
+{
+    z_stream *s = stream;
+    const struct iovec *segments = ETSegmentBufferSegments(input);
+    int count = ETSegmentBufferCount(input);
+
+    for (int i=0 ; i<count ; i++)
+    {
+        s->next_in = segments[i].iov_base;
+        s->avail_in = segments[i].iov_len;
+        do
+        {
+            s->next_out = reserveOutput(output, ETFilterOutputChunkSize);
+            s->avail_out = ETFilterOutputChunkSize;
+            int status = inflate(s, Z_SYNC_FLUSH);
+            ETSegmentBufferCommit(output, ETFilterOutputChunkSize - s->avail_out);
+            if (Z_STREAM_END == status)
+            {
+                inflateReset(s);
+            }
+            else if (Z_BUF_ERROR == status)
+            {
+                break;
+            }
+            else if (Z_OK != status)
+            {
+                [NSException raise: ETSocketException
+                            format: @"Invalid compressed data received"];
+            }
+        } while (s->avail_in > 0 || 0 == s->avail_out);
+    }
+}
+@end
+
+@implementation ETFrameEncoder
+- (void)filterSegments: (ETSegmentBuffer)input into: (ETSegmentBuffer)output
+{
+    size_t length = ETSegmentBufferLength(input);
+
+    if (0 == length)
+    {
+        return;
+    }
+    if (length > UINT32_MAX)
+    {
+        [NSException raise: ETSocketException
+                    format: @"Frame of %llu bytes does not fit a 32-bit length prefix",
+                            (unsigned long long)length];
+    }
+    unsigned char *header = reserveOutput(output, 4);
+
+    header[0] = (length >> 24) & 0xFF;
+    header[1] = (length >> 16) & 0xFF;
+    header[2] = (length >> 8) & 0xFF;
+    header[3] = length & 0xFF;
+    ETSegmentBufferCommit(output, 4);
+    ETSegmentBufferAppendBuffer(output, input);
+}
+@end
+
+@implementation ETFrameDecoder
+- (id)init
+{
+    SUPERINIT;
+    partialFrame = [NSMutableData new];
+    maximumFrameLength = 16 * 1024 * 1024;
+    return self;
+}
+- (void)dealloc
+{
+    [partialFrame release];
+    [super dealloc];
+}
+- (void)setMaximumFrameLength: (NSUInteger)aLength
+{
+    maximumFrameLength = aLength;
+}
+- (NSUInteger)maximumFrameLength
+{
+    return maximumFrameLength;
+}
+- (void)filterSegments: (ETSegmentBuffer)input into: (ETSegmentBuffer)output
+{
+    const struct iovec *segments = ETSegmentBufferSegments(input);
+    int count = ETSegmentBufferCount(input);
+
+    for (int i=0 ; i<count ; i++)
+    {
+        char *bytes = segments[i].iov_base;
+        size_t length = segments[i].iov_len;
+        BOOL isMutable = (NULL != ETSegmentBufferMutableBytesAtIndex(input, i));
+
+        while (length > 0)
+        {
+            if (headerLength < 4)
+            {
+                size_t used = MIN(4 - headerLength, length);
+
+                memcpy(header + headerLength, bytes, used);
+                headerLength += used;
+                bytes += used;
+                length -= used;
+                if (headerLength < 4)
+                {
+                    break;
+                }
+                frameLength = ((NSUInteger)header[0] << 24) | (header[1] << 16) | 
+                              (header[2] << 8) | header[3];
+                if (0 == frameLength)
+                {
+                    [NSException raise: ETSocketException
+                                format: @"Received an empty frame"];
+                }
+                if (frameLength > maximumFrameLength)
+                {
+                    [NSException raise: ETSocketException
+                                format: @"Received frame of %lu bytes exceeds the "
+                                         "maximum of %lu bytes",
+                                        (unsigned long)frameLength,
+                                        (unsigned long)maximumFrameLength];
+                }
+            }
+
+            NSUInteger received = [partialFrame length];
+            size_t used = MIN(frameLength - received, length);
+
+            if (0 == received && used == frameLength)
+            {
+                // The whole frame is here, so pass it on as it is.
+                if (isMutable)
+                {
+                    ETSegmentBufferAppendMutable(output, bytes, used);
+                }
+                else
+                {
+                    ETSegmentBufferAppend(output, bytes, used);
+                }
+            }
+            else
+            {
+                [partialFrame appendBytes: bytes length: used];
+                if ([partialFrame length] < frameLength)
+                {
+                    break;
+                }
+                ETSegmentBufferAppendCopy(output, [partialFrame bytes], frameLength);
+                [partialFrame setLength: 0];
+            }
+            bytes += used;
+            length -= used;
+            headerLength = 0;
+        }
+    }
+}
+@end
+
+#endif
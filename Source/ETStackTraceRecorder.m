@@ -7,6 +7,7 @@
 
 #import "ETStackTraceRecorder.h"
 #import "ETCollection.h"
+#import "ETIdentityMap.h"
 #import "EtoileCompatibility.h"
 #import "Macros.h"
 
@@ -54,17 +55,9 @@ Initializes and returns a new stack trace recorder. */
     SUPERINIT;
 
     /* To prevent any message to be sent to an object (which might be partially 
-       deallocated or might not implement it e.g. -hash), we treat each object 
-       as a raw pointer in its key role for the map table.
-       NOTE: For keyFuncs, NSPointerFunctionsZeroingWeakMemory could be better */
-    NSPointerFunctions *keyFuncs = [NSPointerFunctions pointerFunctionsWithOptions: 
-        NSPointerFunctionsOpaqueMemory | NSPointerFunctionsOpaquePersonality];
-    NSPointerFunctions *valueFuncs = [NSPointerFunctions pointerFunctionsWithOptions: 
-        NSPointerFunctionsStrongMemory | NSPointerFunctionsObjectPersonality];
-
-    _tracesByObject = [[NSMapTable alloc] initWithKeyPointerFunctions: keyFuncs 
-                                                valuePointerFunctions: valueFuncs
-                                                             capacity: 50000];
+       deallocated or might not implement it e.g. -hash), each object is a raw 
+       pointer in its key role for the identity map. */
+    _tracesByObject = [[ETIdentityMap alloc] initWithCapacity: 50000 retainsObjects: YES];
     _lock = [[NSLock alloc] init];
     _allocMonitoredClasses = [[NSMutableSet alloc] init];
     return self;
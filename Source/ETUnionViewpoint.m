@@ -16,6 +16,16 @@
 
 @synthesize contentKeyPath = _contentKeyPath;
 
+static ETPropertyID valuePropertyID = NULL;
+
++ (void) initialize
+{
+    if (self != [ETUnionViewpoint class])
+        return;
+
+    valuePropertyID = ETPropertyIDForName(@"value");
+}
+
 - (id) initWithName: (NSString *)key representedObject: (id)object
 {
     _observations = [NSMutableDictionary new];
@@ -117,13 +127,14 @@
             NSAssert([intermediateObject isKeyed] == NO,
                 @"Observing keyed collections is not supported yet");
 
-            NSArray *content = [intermediateObject contentArray];
+            NSMutableSet *content = [NSMutableSet setWithCapacity: [intermediateObject count]];
 
-            for (id element in content)
+            for (id element in intermediateObject)
             {
                 [element addObserver: self forKeyPath: component options: options context: NULL];
+                [content addObject: element];
             }
-            [_observations setObject: [NSSet setWithArray: content] forKey: intermediateKeyPath];
+            [_observations setObject: content forKey: intermediateKeyPath];
         }
         else
         {
@@ -323,7 +334,7 @@
     }
 }
 
-- (BOOL) setValue: (id)aValue forProperty: (NSString *)aProperty onObject: (id)accessedObject
+- (BOOL) setValue: (id)aValue forPropertyID: (ETPropertyID)aPropertyID onObject: (id)accessedObject
 {
     _isSettingValue = YES;
     NSParameterAssert([aValue isEqual: [[self class] mixedValueMarker]] == NO);
@@ -332,22 +343,22 @@
 
     for (id object in accessedObject)
     {
-        result &= [object setValue: aValue forProperty: aProperty];
+        result &= [object setValue: aValue forPropertyID: aPropertyID];
     }
     _isSettingValue = NO;
     return result;
 }
 
-- (id) valueForProperty: (NSString *)aProperty onObject: (id)accessedObject
+- (id) valueForPropertyID: (ETPropertyID)aPropertyID onObject: (id)accessedObject
 {
-    NSParameterAssert(aProperty != nil && [aProperty length] > 0);
+    NSParameterAssert(aPropertyID != NULL && [ETPropertyIDName(aPropertyID) length] > 0);
 
     id lastValue = nil;
     BOOL isFirstValue = YES;
     
     for (id object in accessedObject)
     {
-        id value = [object valueForProperty: aProperty];
+        id value = [object valueForPropertyID: aPropertyID];
         
         if (isFirstValue == NO && value != lastValue && [value isEqual: lastValue] == NO)
         {
@@ -366,7 +377,8 @@
         return nil;
 
     NSString *component = [[[self contentKeyPath] componentsSeparatedByString: @"."] lastObject];
-    return [self valueForProperty: component onObject: [self accessedObjectForMutation]];
+    return [self valueForPropertyID: ETPropertyIDForName(component)
+                           onObject: [self accessedObjectForMutation]];
 }
 
 - (void) setValue: (id)aValue
@@ -375,7 +387,9 @@
         return;
 
     NSString *component = [[[self contentKeyPath] componentsSeparatedByString: @"."] lastObject];
-    [self setValue: aValue forProperty: component onObject: [self accessedObjectForMutation]];
+    [self setValue: aValue
+     forPropertyID: ETPropertyIDForName(component)
+          onObject: [self accessedObjectForMutation]];
 }
 
 + (id) mixedValueMarker
@@ -383,23 +397,23 @@
     return [NSNumber numberWithInteger: -1];
 }
 
-- (id) valueForProperty: (NSString *)aProperty
+- (id) valueForPropertyID: (ETPropertyID)aPropertyID
 {
-    if ([aProperty isEqualToString: @"value"] && [[self value] isViewpoint] == NO)
+    if (aPropertyID == valuePropertyID && [[self value] isViewpoint] == NO)
     {
         return [self value];
     }
-    return [self valueForProperty: aProperty onObject: [self content]];
+    return [self valueForPropertyID: aPropertyID onObject: [self content]];
 }
 
-- (BOOL) setValue: (id)aValue forProperty: (NSString *)aProperty
+- (BOOL) setValue: (id)aValue forPropertyID: (ETPropertyID)aPropertyID
 {
-    if ([aProperty isEqualToString: @"value"] && [[self value] isViewpoint] == NO)
+    if (aPropertyID == valuePropertyID && [[self value] isViewpoint] == NO)
     {
         [self setValue: aValue];
         return YES;
     }
-    return [self setValue: aValue forProperty: aProperty onObject: [self content]];
+    return [self setValue: aValue forPropertyID: aPropertyID onObject: [self content]];
 }
 
 #pragma mark Collection Protocol
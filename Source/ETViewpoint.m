@@ -153,16 +153,16 @@
     }
 }
 
-- (id) valueForContentKeyPath: (NSString *)aKeyPath
+/* Evaluates the first count components of the given path, skipping the 
+   collection operators such as @count. */
+static id ETValueForContentPathComponents(id anObject, ETPropertyPath *aPath, NSUInteger count)
 {
-    NILARG_EXCEPTION_TEST(aKeyPath);
-    INVALIDARG_EXCEPTION_TEST(aKeyPath, [aKeyPath length] != 0);
-
-    id intermediateObject = self;
+    id intermediateObject = anObject;
 
-    for (NSString *key in [aKeyPath componentsSeparatedByString: @"."])
+    for (NSUInteger i = 0; i < count; i++)
     {
-        BOOL isOperator = [key hasPrefix: @"@"];
+        NSString *key = ETPropertyIDName([aPath propertyIDAtIndex: i]);
+        BOOL isOperator = ([key length] > 0 && [key characterAtIndex: 0] == '@');
         
         if (isOperator)
             continue;
@@ -172,16 +172,23 @@
     return intermediateObject;
 }
 
+- (id) valueForContentKeyPath: (NSString *)aKeyPath
+{
+    NILARG_EXCEPTION_TEST(aKeyPath);
+    INVALIDARG_EXCEPTION_TEST(aKeyPath, [aKeyPath length] != 0);
+
+    ETPropertyPath *path = [ETPropertyPath pathWithString: aKeyPath];
+
+    return ETValueForContentPathComponents(self, path, [path count]);
+}
+
 - (void) setValue: (id)aValue forContentKeyPath: (NSString *)aKeyPath
 {
-    NSArray *keyPathComponents = [aKeyPath componentsSeparatedByString: @"."];
-    NSArray *baseKeyPathComponents =
-        [keyPathComponents subarrayWithRange: NSMakeRange(0, [keyPathComponents count] - 1)];
-    NSString *baseKeyPath = [baseKeyPathComponents componentsJoinedByString: @"."];
-        
-    id intermediateObject = [self valueForContentKeyPath: baseKeyPath];
+    ETPropertyPath *path = [ETPropertyPath pathWithString: aKeyPath];
+    id intermediateObject = ETValueForContentPathComponents(self, path, [path count] - 1);
 
-    [intermediateObject setValue: aValue forContentKey: [keyPathComponents lastObject]];
+    [intermediateObject setValue: aValue
+                   forContentKey: ETPropertyIDName([path lastPropertyID])];
 }
 
 @end
@@ -191,6 +198,13 @@
 @interface ETCollectionTrait (ETViewpointAdditions)
 @end
 
+/* Keyed collections enumerate their keys, so their values are enumerated
+   with -objectEnumerator */
+static inline id <NSFastEnumeration> ETViewpointElementsOfCollection(id <ETCollection> aCollection)
+{
+    return ([aCollection isKeyed] ? (id)[aCollection objectEnumerator] : (id)aCollection);
+}
+
 @implementation  ETCollectionTrait (ETViewpointAdditions)
 
 - (id) valueForContentKey: (NSString *)key
@@ -200,9 +214,7 @@
 
     NSMutableArray *content = [NSMutableArray arrayWithCapacity: [self count]];
 
-    /* For returning content of keyed collections such as dictionaries, we 
-       must use -objectEnumerator */
-    for (id element in [self objectEnumerator])
+    for (id element in ETViewpointElementsOfCollection(self))
     {
         id value = [element valueForContentKey: key];
 
@@ -222,9 +234,7 @@
         return;
     }
 
-    /* For accessing content of keyed collections such as dictionaries, we 
-       must use -objectEnumerator */    
-    for (id element in [self objectEnumerator])
+    for (id element in ETViewpointElementsOfCollection(self))
     {
         [element setValue: aValue forContentKey: key];
     }
@@ -10,6 +10,8 @@
 #undef DEFINE_STRINGS
 #import "ETCollection.h"
 #import "ETCollection+HOM.h"
+#import "ETCIdentityMap.h"
+#import "ETPropertyValueCoding.h"
 #import "Macros.h"
 #import "EtoileCompatibility.h"
 #include <objc/runtime.h>
@@ -483,17 +485,15 @@ static void checkTraitApplication(Class aClass, ETTraitApplication *aTraitApplic
 
 @implementation NSObject (ETTrait)
 
-static NSMapTable *traitApplicationsByClass = nil;
+/* Classes are never deallocated, and the trait applications are never 
+   removed, so the map holds an implicit retain on each array. */
+static ETCIdentityMap traitApplicationsByClass = NULL;
 static NSRecursiveLock *lock = nil;
 
 + (void) load
 {
     CREATE_AUTORELEASE_POOL(pool);
-#ifdef GNUSTEP
-    ASSIGN(traitApplicationsByClass, [NSMapTable mapTableWithWeakToStrongObjects]);
-#else
-    ASSIGN(traitApplicationsByClass, [NSMapTable weakToStrongObjectsMapTable]);
-#endif
+    traitApplicationsByClass = ETCIdentityMapNew();
     lock = [[NSRecursiveLock alloc] init];
     DESTROY(pool);
 }
@@ -502,12 +502,12 @@ static NSRecursiveLock *lock = nil;
 {
     [lock lock];
 
-    NSMutableArray *traitApplications = [traitApplicationsByClass objectForKey: self];
+    NSMutableArray *traitApplications = ETCIdentityMapGet(traitApplicationsByClass, self);
 
     if (traitApplications == nil)
     {
-        traitApplications = [NSMutableArray array];
-        [traitApplicationsByClass setObject: traitApplications forKey: self];
+        traitApplications = [[NSMutableArray alloc] init];
+        ETCIdentityMapSet(traitApplicationsByClass, self, traitApplications);
     }
 
     [lock unlock];
@@ -536,6 +536,7 @@ static NSRecursiveLock *lock = nil;
     [[self traitApplications] addObject: traitApplication];
 
     [lock unlock];
+    ETInvalidatePropertyAccessors();
     DESTROY(pool);
 }
 
@@ -0,0 +1,199 @@
+/*
+    Copyright (C) 2026 The Etoile Project
+
+    Date:  October 2026
+    License: Modified BSD (see COPYING)
+ */
+
+#import <Foundation/Foundation.h>
+#import <UnitKit/UnitKit.h>
+#import "ETCArray.h"
+#import "EtoileCompatibility.h"
+
+@interface TestCArray : NSObject <UKTest>
+@end
+
+@implementation TestCArray
+
+static void *pointer(uintptr_t value)
+{
+    return (void *)value;
+}
+
+- (void) testQueueAcrossWrapAround
+{
+    ETCArray array = ETCArrayNewWithInitialSize(8);
+    uintptr_t next = 1;
+    uintptr_t expected = 1;
+
+    /* Keeps between 4 and 6 elements, so the head wraps around many times
+       without the array ever growing */
+    for (int i = 0; i < 100; i++)
+    {
+        while (ETCArrayCount(array) < 6)
+        {
+            ETCArrayAdd(array, pointer(next++));
+        }
+        while (ETCArrayCount(array) > 4)
+        {
+            UKTrue(ETCArrayFirstObject(array) == pointer(expected++));
+            UKIntsEqual(0, ETCArrayRemoveFirstObject(array));
+        }
+    }
+
+    UKIntsEqual(8, ETCArrayCapacity(array));
+    UKTrue(ETCArrayLastObject(array) == pointer(next - 1));
+    ETCArrayFree(array);
+}
+
+- (void) testAddAtBothEndsAndGrow
+{
+    ETCArray array = ETCArrayNew();
+
+    for (uintptr_t i = 1; i <= 50; i++)
+    {
+        ETCArrayAdd(array, pointer(i));
+        ETCArrayAddFirst(array, pointer(i + 100));
+    }
+
+    UKIntsEqual(100, ETCArrayCount(array));
+    UKTrue(ETCArrayObjectAtIndex(array, 0) == pointer(150));
+    UKTrue(ETCArrayObjectAtIndex(array, 49) == pointer(101));
+    UKTrue(ETCArrayObjectAtIndex(array, 50) == pointer(1));
+    UKTrue(ETCArrayObjectAtIndex(array, 99) == pointer(50));
+    UKTrue(ETCArrayObjectAtIndex(array, 100) == NULL);
+    UKIntsEqual(49, ETCArrayIndexOfObjectIdenticalTo(array, pointer(101)));
+    UKTrue(ETCArrayIndexOfObjectIdenticalTo(array, pointer(1000)) == ETCArrayNotFound);
+    ETCArrayFree(array);
+}
+
+- (void) testInsertAndRemoveRanges
+{
+    ETCArray array = ETCArrayNew();
+    void *objects[] = { pointer(1), pointer(2), pointer(5), pointer(6) };
+    void *inserted[] = { pointer(3), pointer(4) };
+    void *result[6];
+
+    UKIntsEqual(0, ETCArrayAddObjects(array, objects, 4));
+    UKIntsEqual(0, ETCArrayInsertObjectsAtIndex(array, inserted, 2, 2));
+    UKIntsEqual(-2, ETCArrayInsertObjectsAtIndex(array, inserted, 2, 7));
+    UKIntsEqual(0, ETCArrayGetObjectsInRange(array, result, 0, 6));
+
+    for (uintptr_t i = 0; i < 6; i++)
+    {
+        UKTrue(result[i] == pointer(i + 1));
+    }
+
+    UKIntsEqual(0, ETCArrayRemoveObjectsInRange(array, 1, 3));
+    UKIntsEqual(-2, ETCArrayRemoveObjectsInRange(array, 2, 2));
+    UKIntsEqual(3, ETCArrayCount(array));
+    UKTrue(ETCArrayObjectAtIndex(array, 1) == pointer(5));
+    UKIntsEqual(-1, ETCArrayRemoveObjectAtIndex(array, 3));
+    ETCArrayFree(array);
+}
+
+- (void) testInsertAndRemoveRangesAcrossWrapAround
+{
+    ETCArray array = ETCArrayNewWithInitialSize(16);
+    void *inserted[3] = { pointer(100), pointer(101), pointer(102) };
+    uintptr_t expected[9] = { 10, 12, 13, 14, 15, 16, 100, 101, 19 };
+
+    /* Elements 10 to 19 start near the end of the storage and wrap around */
+    for (uintptr_t i = 0; i < 12; i++)
+    {
+        ETCArrayAdd(array, pointer(i));
+    }
+    for (uintptr_t i = 0; i < 10; i++)
+    {
+        ETCArrayRemoveFirstObject(array);
+    }
+    for (uintptr_t i = 12; i < 20; i++)
+    {
+        ETCArrayAdd(array, pointer(i));
+    }
+
+    /* Moves the elements after and before the ranges across the wrap */
+    UKIntsEqual(0, ETCArrayInsertObjectsAtIndex(array, inserted, 3, 7));
+    UKIntsEqual(0, ETCArrayInsertObjectsAtIndex(array, inserted, 3, 2));
+    UKIntsEqual(16, ETCArrayCapacity(array));
+    UKIntsEqual(0, ETCArrayRemoveObjectsInRange(array, 1, 4));
+    UKIntsEqual(0, ETCArrayRemoveObjectsInRange(array, 8, 3));
+
+    UKIntsEqual(9, ETCArrayCount(array));
+    for (size_t i = 0; i < 9; i++)
+    {
+        UKTrue(ETCArrayObjectAtIndex(array, i) == pointer(expected[i]));
+    }
+    ETCArrayFree(array);
+}
+
+- (void) testAppendArray
+{
+    ETCArray array = ETCArrayNew();
+    ETCArray otherArray = ETCArrayNew();
+
+    for (uintptr_t i = 1; i <= 20; i++)
+    {
+        ETCArrayAdd(array, pointer(i));
+        ETCArrayAddFirst(otherArray, pointer(i + 20));
+    }
+    UKIntsEqual(0, ETCArrayAppendArray(array, otherArray));
+
+    UKIntsEqual(40, ETCArrayCount(array));
+    UKTrue(ETCArrayObjectAtIndex(array, 19) == pointer(20));
+    UKTrue(ETCArrayObjectAtIndex(array, 20) == pointer(40));
+    UKTrue(ETCArrayObjectAtIndex(array, 39) == pointer(21));
+
+    UKIntsEqual(0, ETCArrayAppendArray(array, array));
+    UKIntsEqual(80, ETCArrayCount(array));
+    UKTrue(ETCArrayObjectAtIndex(array, 40) == pointer(1));
+    ETCArrayFree(otherArray);
+    ETCArrayFree(array);
+}
+
+- (void) testReserveAndShrink
+{
+    ETCArray array = ETCArrayNew();
+
+    UKIntsEqual(0, ETCArrayReserve(array, 1000));
+    UKTrue(ETCArrayCapacity(array) >= 1000);
+
+    for (uintptr_t i = 1; i <= 10; i++)
+    {
+        ETCArrayAddFirst(array, pointer(i));
+    }
+    UKIntsEqual(0, ETCArrayShrink(array));
+
+    UKTrue(ETCArrayCapacity(array) < 1000);
+    UKTrue(ETCArrayFirstObject(array) == pointer(10));
+    UKTrue(ETCArrayLastObject(array) == pointer(1));
+    ETCArrayFree(array);
+}
+
+- (void) testValueArray
+{
+    ETCValueArray array = ETCValueArrayNew(sizeof(NSRange));
+    NSRange range;
+
+    for (NSUInteger i = 0; i < 100; i++)
+    {
+        range = NSMakeRange(i, i * 2);
+        ETCValueArrayAdd(array, &range);
+    }
+
+    UKIntsEqual(sizeof(NSRange), ETCValueArrayElementSize(array));
+    UKIntsEqual(100, ETCValueArrayCount(array));
+    UKIntsEqual(0, ETCValueArrayRemoveFirstElement(array, &range));
+    UKIntsEqual(0, range.location);
+    UKIntsEqual(0, ETCValueArrayRemoveLastElement(array, &range));
+    UKIntsEqual(198, range.length);
+    UKIntsEqual(50, ((NSRange *)ETCValueArrayElementAtIndex(array, 49))->location);
+    UKTrue(ETCValueArrayElementAtIndex(array, 98) == NULL);
+
+    ETCValueArrayRemoveAllElements(array);
+
+    UKIntsEqual(-1, ETCValueArrayRemoveFirstElement(array, NULL));
+    ETCValueArrayFree(array);
+}
+
+@end
@@ -22,6 +22,10 @@
 @end
 
 @interface TestMutableCollectionTrait : AbstractTestCollection <ETCollection, ETCollectionMutation>
+{
+    NSUInteger notificationCount;
+    NSDictionary *lastChange;
+}
 @end
 
 
@@ -193,6 +197,21 @@
     }
 }
 
+- (void) dealloc
+{
+    DESTROY(lastChange);
+    [super dealloc];
+}
+
+- (void) observeValueForKeyPath: (NSString *)keyPath
+                       ofObject: (id)object
+                         change: (NSDictionary *)change
+                        context: (void *)context
+{
+    notificationCount++;
+    ASSIGN(lastChange, change);
+}
+
 - (id) init
 {
     SUPERINIT;
@@ -235,5 +254,80 @@
 
 }
 
+- (void) testBatchInsertAndRemove
+{
+    NSMutableIndexSet *indexes = [NSMutableIndexSet indexSetWithIndex: 0];
+    [indexes addIndex: 2];
+
+    [self insertObjects: A(@"Anchorage", @"Swansea") atIndexes: indexes hints: [NSArray array]];
+
+    UKObjectsEqual(A(@"Anchorage", @"Kyoto", @"Swansea", @"Paris", @"London"), collection);
+
+    /* Removing by increasing index would shift the second index */
+    [self removeObjects: [NSArray array] atIndexes: indexes hints: [NSArray array]];
+
+    UKObjectsEqual(A(@"Kyoto", @"Paris", @"London"), collection);
+}
+
+- (void) testBatchMutationPostsSingleNotification
+{
+    NSMutableArray *numbers = [NSMutableArray array];
+
+    for (int i = 0; i < 1000; i++)
+    {
+        [numbers addObject: [NSNumber numberWithInt: i]];
+    }
+
+    [self addObserver: self forKeyPath: @"collection" options: 0 context: NULL];
+
+    [self insertObjects: numbers
+              atIndexes: [NSIndexSet indexSet]
+                  hints: [NSArray array]
+   intoCollectionForKey: @"collection"];
+
+    UKIntsEqual(1, notificationCount);
+    UKIntsEqual(NSKeyValueChangeInsertion, [[lastChange objectForKey: NSKeyValueChangeKindKey] intValue]);
+    UKObjectsEqual([NSIndexSet indexSetWithIndexesInRange: NSMakeRange(3, 1000)],
+        [lastChange objectForKey: NSKeyValueChangeIndexesKey]);
+    UKIntsEqual(1003, [collection count]);
+
+    [self removeObjects: numbers
+              atIndexes: [NSIndexSet indexSet]
+                  hints: [NSArray array]
+   fromCollectionForKey: @"collection"];
+
+    UKIntsEqual(2, notificationCount);
+    UKIntsEqual(NSKeyValueChangeRemoval, [[lastChange objectForKey: NSKeyValueChangeKindKey] intValue]);
+    UKObjectsEqual([NSIndexSet indexSetWithIndexesInRange: NSMakeRange(3, 1000)],
+        [lastChange objectForKey: NSKeyValueChangeIndexesKey]);
+    UKObjectsEqual(A(@"Kyoto", @"Paris", @"London"), collection);
+
+    [self removeObserver: self forKeyPath: @"collection"];
+}
+
+#ifndef GNUSTEP
+- (void) testOrderedSetBatchInsertWithObjectsAlreadyPresent
+{
+    NSMutableOrderedSet *set =
+        [NSMutableOrderedSet orderedSetWithArray: A(@"Kyoto", @"Paris", @"London")];
+    NSMutableIndexSet *indexes = [NSMutableIndexSet indexSetWithIndex: 0];
+    [indexes addIndex: 1];
+
+    UKRaisesException([set insertObjects: A(@"Paris", @"Swansea")
+                               atIndexes: indexes
+                                   hints: [NSArray array]]);
+    UKRaisesException([set insertObjects: A(@"Swansea", @"Swansea")
+                               atIndexes: indexes
+                                   hints: [NSArray array]]);
+    UKIntsEqual(3, [set count]);
+
+    [set insertObjects: A(@"Paris", @"Swansea", @"Swansea")
+             atIndexes: [NSIndexSet indexSet]
+                 hints: [NSArray array]];
+
+    UKObjectsEqual(A(@"Kyoto", @"Paris", @"London", @"Swansea"), [set array]);
+}
+#endif
+
 @end
 
@@ -181,6 +181,34 @@
     UKTrue([mappedSet containsObject: [NSNull class]]);
 }
 
+/* Elements of different classes are sent the message through the plan of
+   their own class, or the invocation when the class has no matching plan */
+- (void)testMappedArrayWithMixedClasses
+{
+    NSArray *inputArray = A(@"foo", [NSNumber numberWithInt: 5], @"bar",
+        [NSNumber numberWithInt: 6]);
+    NSArray *mappedArray = (NSArray *)[[inputArray mappedCollection] description];
+
+    UKObjectsEqual(A(@"foo", @"5", @"bar", @"6"), mappedArray);
+}
+
+- (void)testIndexSetFastEnumeration
+{
+    NSMutableIndexSet *indexSet = [NSMutableIndexSet indexSetWithIndexesInRange: NSMakeRange(0, 100)];
+    [indexSet addIndexesInRange: NSMakeRange(1000, 100)];
+    NSUInteger count = 0;
+    NSUInteger previous = 0;
+
+    for (NSNumber *index in indexSet)
+    {
+        UKTrue([indexSet containsIndex: [index unsignedIntegerValue]]);
+        UKTrue(0 == count || [index unsignedIntegerValue] > previous);
+        previous = [index unsignedIntegerValue];
+        count++;
+    }
+    UKIntsEqual(200, count);
+}
+
 - (void)testMappedEmptyCollection
 {
     UKTrue([(id)[[[NSArray array] mappedCollection] uppercaseString] isEmpty]);
@@ -889,6 +917,47 @@
     }
 }
 
+- (void)testMappedArrayWithZippedEach
+{
+    NSArray *first = A(@"foo",@"bar");
+    NSArray *second = A(@"Foo",@"Bar",@"Baz");
+    NSArray *third = A(@"FOO",@"BAR");
+    NSArray *result = (NSArray*)[[first mappedCollection] stringByAppendingString: [second eachZipped]
+                                                                        andString: [third eachZipped]];
+
+    UKObjectsEqual(A(@"fooFooFOO", @"fooBarBAR", @"barFooFOO", @"barBarBAR"), result);
+}
+
+- (void)testMappedArrayWithZippedAndCrossedEach
+{
+    NSArray *first = A(@"foo");
+    NSArray *second = A(@"Foo",@"Bar");
+    NSArray *third = A(@"FOO",@"BAR");
+    NSArray *result = (NSArray*)[[first mappedCollection] stringByAppendingString: [second each]
+                                                                        andString: [third eachZipped]];
+
+    UKObjectsEqual(A(@"fooFooFOO", @"fooFooBAR", @"fooBarFOO", @"fooBarBAR"), result);
+}
+
+- (void)testMappedArrayWithEmptyEach
+{
+    NSArray *first = A(@"foo",@"bar");
+    NSArray *result = (NSArray*)[[first mappedCollection] stringByAppendingString: [[NSArray array] each]];
+
+    UKTrue([result isEmpty]);
+}
+
+- (void)testFilterArrayWithZippedEach
+{
+    NSMutableArray *first = [NSMutableArray arrayWithObjects: @"foo",@"bar",@"Foo",@"fOO", nil];
+    NSArray *second = A(@"f",@"F");
+    NSArray *third = A(@"OO",@"oo");
+    [[first filter] isEqualToString: [second eachZipped]
+                          andString: [third eachZipped]];
+
+    UKObjectsEqual(A(@"Foo", @"fOO"), first);
+}
+
 - (void)testFilterArrayWithEach
 {
     NSMutableArray *first = [NSMutableArray arrayWithObjects: @"foo",@"bar",@"BAR",@"Foo", nil];
@@ -1002,5 +1071,73 @@
     UKFalse([array containsObject: @"foo"]);
     UKFalse([array containsObject: @"bar"]);
 }
+
+- (void)testConcurrentMappedArrayKeepsOrder
+{
+    NSMutableArray *numbers = [NSMutableArray array];
+    for (int i = 0; i < 10000; i++)
+    {
+        [numbers addObject: [NSNumber numberWithInt: i]];
+    }
+    NSArray *result = [numbers concurrentMappedCollectionWithBlock: ^(id number)
+    {
+        return (id)[NSNumber numberWithInt: [number intValue] * 2];
+    }];
+
+    UKIntsEqual(10000, [result count]);
+    for (int i = 0; i < 10000; i++)
+    {
+        UKIntsEqual(i * 2, [[result objectAtIndex: i] intValue]);
+    }
+}
+
+- (void)testConcurrentMappedDictionary
+{
+    INPUT_DICTIONARY
+    NSDictionary *result = [inputDictionary concurrentMappedCollectionWithBlock: ^(id string)
+    {
+        return (id)[string uppercaseString];
+    }];
+
+    UKObjectsEqual(@"FOO", [result objectForKey: @"one"]);
+    UKObjectsEqual(@"BAR", [result objectForKey: @"two"]);
+}
+
+- (void)testConcurrentFilteredArray
+{
+    NSMutableArray *numbers = [NSMutableArray array];
+    for (int i = 0; i < 10000; i++)
+    {
+        [numbers addObject: [NSNumber numberWithInt: i]];
+    }
+    NSArray *result = [numbers concurrentFilteredCollectionWithBlock: ^(id number)
+    {
+        return (BOOL)([number intValue] % 3 == 0);
+    }];
+
+    UKIntsEqual(3334, [result count]);
+    UKIntsEqual(9999, [[result lastObject] intValue]);
+}
+
+- (void)testReduce
+{
+    NSMutableArray *numbers = [NSMutableArray array];
+    for (int i = 1; i <= 10000; i++)
+    {
+        [numbers addObject: [NSNumber numberWithInt: i]];
+    }
+    id(^sum)(id, id) = ^(id x, id y)
+    {
+        return (id)[NSNumber numberWithInt: [x intValue] + [y intValue]];
+    };
+    NSNumber *result = [numbers reduceWithInitialValue: [NSNumber numberWithInt: 0]
+                                             intoBlock: sum
+                                              combiner: sum];
+
+    UKIntsEqual(50005000, [result intValue]);
+    UKObjectsEqual(@"foo", [[NSArray array] reduceWithInitialValue: @"foo"
+                                                         intoBlock: sum
+                                                          combiner: sum]);
+}
 #endif
 @end
@@ -296,6 +296,19 @@
     UKTrue([[other propertyDescriptions] isEmpty]);
 }
 
+- (void) testFastEnumeration
+{
+    NSMutableSet *enumerated = [NSMutableSet set];
+
+    [book setPropertyDescriptions: A(title, authors)];
+
+    for (ETPropertyDescription *propertyDesc in book)
+    {
+        [enumerated addObject: propertyDesc];
+    }
+    UKObjectsEqual(S(title, authors), enumerated);
+}
+
 - (void) testAllPropertyDescriptions
 {
     ETEntityDescription *other = [ETEntityDescription descriptionWithName: @"other"];
@@ -0,0 +1,142 @@
+/*
+    Copyright (C) 2026 The Etoile Project
+
+    Date:  October 2026
+    License: Modified BSD (see COPYING)
+ */
+
+#import <Foundation/Foundation.h>
+#import <UnitKit/UnitKit.h>
+#import "ETCIdentityMap.h"
+#import "ETIdentityMap.h"
+#import "ETCollection.h"
+#import "Macros.h"
+#import "EtoileCompatibility.h"
+
+@interface TestIdentityMap : NSObject <UKTest>
+@end
+
+@implementation TestIdentityMap
+
+- (void) testIdentityRatherThanEquality
+{
+    ETIdentityMap *map = [ETIdentityMap identityMap];
+    NSString *key1 = [NSMutableString stringWithString: @"key"];
+    NSString *key2 = [NSMutableString stringWithString: @"key"];
+
+    [map setObject: @"one" forKey: key1];
+    [map setObject: @"two" forKey: key2];
+
+    UKIntsEqual(2, [map count]);
+    UKObjectsEqual(@"one", [map objectForKey: key1]);
+    UKObjectsEqual(@"two", [map objectForKey: key2]);
+    UKNil([map objectForKey: @"key"]);
+
+    [map setObject: @"three" forKey: key1];
+
+    UKIntsEqual(2, [map count]);
+    UKObjectsEqual(@"three", [map objectForKey: key1]);
+}
+
+- (void) testRemoveAmongManyKeys
+{
+    ETIdentityMap *map = [ETIdentityMap identityMap];
+    NSMutableArray *keys = [NSMutableArray array];
+
+    for (int i = 0; i < 1000; i++)
+    {
+        NSNumber *value = [NSNumber numberWithInt: i];
+        id key = AUTORELEASE([[NSObject alloc] init]);
+
+        [keys addObject: key];
+        [map setObject: value forKey: key];
+    }
+    for (int i = 0; i < 1000; i += 2)
+    {
+        [map removeObjectForKey: [keys objectAtIndex: i]];
+    }
+
+    UKIntsEqual(500, [map count]);
+    for (int i = 0; i < 1000; i++)
+    {
+        id value = [map objectForKey: [keys objectAtIndex: i]];
+
+        if (i % 2 == 0)
+        {
+            UKNil(value);
+        }
+        else
+        {
+            UKIntsEqual(i, [value intValue]);
+        }
+    }
+
+    [map removeAllObjects];
+
+    UKTrue([map isEmpty]);
+    UKNil([map objectForKey: [keys lastObject]]);
+}
+
+- (void) testCollectionProtocol
+{
+    ETIdentityMap *map = [ETIdentityMap identityMap];
+    NSMutableSet *enumeratedValues = [NSMutableSet set];
+
+    [map setObject: @"a" forKey: [NSObject class]];
+    [map setObject: @"b" forKey: [NSString class]];
+    [map setObject: @"c" forKey: [NSArray class]];
+
+    for (id value in map)
+    {
+        [enumeratedValues addObject: value];
+    }
+
+    UKTrue([map isKeyed]);
+    UKObjectsEqual(S(@"a", @"b", @"c"), enumeratedValues);
+    UKObjectsEqual(S(@"a", @"b", @"c"), [NSSet setWithArray: [map contentArray]]);
+    UKObjectsEqual(S([NSObject class], [NSString class], [NSArray class]),
+        [NSSet setWithArray: [map allKeys]]);
+    UKTrue([map containsObject: @"b"]);
+}
+
+- (void) testValuesAreRetained
+{
+    ETIdentityMap *map = [ETIdentityMap identityMap];
+    id value = [[NSObject alloc] init];
+
+    [map setObject: value forKey: self];
+    UKIntsEqual(2, [value retainCount]);
+
+    [map removeObjectForKey: self];
+    UKIntsEqual(1, [value retainCount]);
+    RELEASE(value);
+}
+
+- (void) testSet
+{
+    ETCIdentitySet set = ETCIdentitySetNew();
+    size_t cursor = 0;
+    const void *member = NULL;
+    int memberCount = 0;
+
+    ETCIdentitySetAdd(set, self);
+    ETCIdentitySetAdd(set, self);
+    ETCIdentitySetAdd(set, [self class]);
+
+    UKIntsEqual(2, ETCIdentitySetCount(set));
+    UKTrue(ETCIdentitySetContains(set, self));
+    UKFalse(ETCIdentitySetContains(set, [NSObject class]));
+
+    while (ETCIdentitySetNextMember(set, &cursor, &member))
+    {
+        memberCount++;
+    }
+    UKIntsEqual(2, memberCount);
+
+    UKIntsEqual(0, ETCIdentitySetRemove(set, self));
+    UKIntsEqual(-1, ETCIdentitySetRemove(set, self));
+    UKFalse(ETCIdentitySetContains(set, self));
+    ETCIdentitySetFree(set);
+}
+
+@end
@@ -10,10 +10,114 @@
 #import "Macros.h"
 #import "NSObject+Model.h"
 #import "ETHistory.h"
+#import "ETKeyValuePair.h"
 #import "EtoileCompatibility.h"
 #include <objc/runtime.h>
 
 @interface TestModelAdditions : NSObject <UKTest>
+{
+    NSUInteger notificationCount;
+}
+@end
+
+static BOOL exposesTag = NO;
+
+@interface PVCObject : NSObject
+{
+    NSString *name;
+    NSString *_note;
+    BOOL enabled;
+    NSString *tag;
+    PVCObject *_parent;
+}
+- (NSString *) name;
+- (void) setName: (NSString *)aName;
+- (BOOL) isEnabled;
+- (void) setEnabled: (BOOL)isEnabled;
+@end
+
+@implementation PVCObject
+
+- (void) dealloc
+{
+    DESTROY(name);
+    DESTROY(_note);
+    DESTROY(tag);
+    DESTROY(_parent);
+    [super dealloc];
+}
+
+- (NSArray *) propertyNames
+{
+    NSArray *properties = A(@"name", @"note", @"enabled", @"parent");
+
+    if (exposesTag)
+    {
+        properties = [properties arrayByAddingObject: @"tag"];
+    }
+    return [[super propertyNames] arrayByAddingObjectsFromArray: properties];
+}
+
+- (NSString *) name
+{
+    return name;
+}
+
+- (void) setName: (NSString *)aName
+{
+    ASSIGN(name, aName);
+}
+
+- (BOOL) isEnabled
+{
+    return enabled;
+}
+
+- (void) setEnabled: (BOOL)isEnabled
+{
+    enabled = isEnabled;
+}
+
+@end
+
+/* Declares its property names can vary per instance */
+@interface PVCVaryingObject : PVCObject
+@end
+
+@implementation PVCVaryingObject
+
++ (BOOL) hasInstanceSpecificPropertyNames
+{
+    return YES;
+}
+
+@end
+
+/* Overrides only the NSString-based Property Value Coding methods */
+@interface PVCOverridingObject : PVCObject
+@end
+
+@implementation PVCOverridingObject
+
+- (id) valueForProperty: (NSString *)key
+{
+    if ([key isEqualToString: @"name"])
+    {
+        return @"Overriden";
+    }
+    /* Not declared in -propertyNames */
+    if ([key isEqualToString: @"computedName"])
+    {
+        return @"Computed";
+    }
+    return [super valueForProperty: key];
+}
+
+- (BOOL) setValue: (id)value forProperty: (NSString *)key
+{
+    return [super setValue: [value uppercaseString] forProperty: key];
+}
+
 @end
 
 @implementation TestModelAdditions
@@ -45,4 +149,225 @@
     UKFalse([[ETHistory history] isPrimitiveCollection]);
 }
 
+- (void) testPropertyValueCoding
+{
+    PVCObject *object = AUTORELEASE([PVCObject new]);
+
+    UKTrue([object setValue: @"Nobody" forProperty: @"name"]);
+    UKTrue([object setValue: @"Hello" forProperty: @"note"]);
+    UKTrue([object setValue: [NSNumber numberWithBool: YES] forProperty: @"enabled"]);
+    UKFalse([object setValue: @"Home" forProperty: @"tag"]);
+
+    UKObjectsEqual(@"Nobody", [object name]);
+    UKObjectsEqual(@"Nobody", [object valueForProperty: @"name"]);
+    UKObjectsEqual(@"Hello", [object valueForProperty: @"note"]);
+    UKTrue([object isEnabled]);
+    UKTrue([[object valueForProperty: @"enabled"] boolValue]);
+    UKNil([object valueForProperty: @"tag"]);
+    UKObjectsEqual(@"PVCObject", [object valueForProperty: @"className"]);
+    UKNil([object valueForProperty: nil]);
+}
+
+- (void) testPropertyAccessorInvalidation
+{
+    PVCObject *object = AUTORELEASE([PVCObject new]);
+
+    UKFalse([object setValue: @"Home" forProperty: @"tag"]);
+
+    exposesTag = YES;
+    ETInvalidatePropertyAccessors();
+
+    UKTrue([object setValue: @"Home" forProperty: @"tag"]);
+    UKObjectsEqual(@"Home", [object valueForProperty: @"tag"]);
+
+    exposesTag = NO;
+    ETInvalidatePropertyAccessors();
+}
+
+- (void) testInstanceSpecificPropertyNamesAreCheckedForEachAccess
+{
+    PVCVaryingObject *object = AUTORELEASE([PVCVaryingObject new]);
+
+    UKFalse([object setValue: @"Home" forProperty: @"tag"]);
+
+    /* -propertyNames can vary without invalidation */
+    exposesTag = YES;
+    UKTrue([object setValue: @"Home" forProperty: @"tag"]);
+    UKObjectsEqual(@"Home", [object valueForProperty: @"tag"]);
+
+    exposesTag = NO;
+    UKNil([object valueForProperty: @"tag"]);
+}
+
+- (void) observeValueForKeyPath: (NSString *)keyPath
+                       ofObject: (id)object
+                         change: (NSDictionary *)change
+                        context: (void *)context
+{
+    notificationCount++;
+}
+
+- (void) testPropertySetterPostsKeyValueObservingNotification
+{
+    PVCObject *object = AUTORELEASE([PVCObject new]);
+
+    /* Resolve the accessors before the object is observed */
+    [object setValue: @"Nobody" forProperty: @"name"];
+    [object addObserver: self forKeyPath: @"name" options: 0 context: NULL];
+    [object setValue: @"Somebody" forProperty: @"name"];
+    [object removeObserver: self forKeyPath: @"name"];
+
+    UKIntsEqual(1, notificationCount);
+    UKObjectsEqual(@"Somebody", [object valueForProperty: @"name"]);
+}
+
+- (void) testPropertyIDInterning
+{
+    ETPropertyID propertyID = ETPropertyIDForName(@"name");
+
+    UKTrue(propertyID != NULL);
+    UKTrue(propertyID == ETPropertyIDForName([NSMutableString stringWithString: @"name"]));
+    UKTrue(propertyID != ETPropertyIDForName(@"note"));
+    UKObjectsEqual(@"name", ETPropertyIDName(propertyID));
+    UKTrue(ETPropertyIDForName(nil) == NULL);
+    UKNil(ETPropertyIDName(NULL));
+}
+
+- (void) testPropertyIDTableGrowth
+{
+    NSMutableArray *propertyIDs = [NSMutableArray array];
+
+    for (int i = 0; i < 1000; i++)
+    {
+        NSString *name = [NSString stringWithFormat: @"growthTestProperty%d", i];
+        [propertyIDs addObject: [NSValue valueWithPointer: ETPropertyIDForName(name)]];
+    }
+    for (int i = 0; i < 1000; i++)
+    {
+        NSString *name = [NSString stringWithFormat: @"growthTestProperty%d", i];
+        ETPropertyID propertyID = [[propertyIDs objectAtIndex: i] pointerValue];
+
+        UKTrue(propertyID == ETPropertyIDForName(name));
+        UKObjectsEqual(name, ETPropertyIDName(propertyID));
+    }
+}
+
+- (void) testUndeclaredPropertyNamesAreNotInterned
+{
+    PVCObject *object = AUTORELEASE([PVCObject new]);
+    NSString *name = @"undeclaredPropertyOfPVCObject";
+
+    UKNil([object valueForProperty: name]);
+    UKFalse([object setValue: @"Home" forProperty: name]);
+    UKTrue(ETDeclaredPropertyIDForName(object, name) == NULL);
+
+    UKTrue(ETDeclaredPropertyIDForName(object, @"note") == ETPropertyIDForName(@"note"));
+    UKTrue(ETDeclaredPropertyIDForName(object, nil) == NULL);
+}
+
+- (void) testPropertyValueCodingWithPropertyIDs
+{
+    PVCObject *object = AUTORELEASE([PVCObject new]);
+    ETPropertyID nameID = ETPropertyIDForName(@"name");
+    ETPropertyID tagID = ETPropertyIDForName(@"tag");
+
+    UKTrue([object setValue: @"Nobody" forPropertyID: nameID]);
+    UKFalse([object setValue: @"Home" forPropertyID: tagID]);
+
+    UKObjectsEqual(@"Nobody", [object valueForPropertyID: nameID]);
+    UKObjectsEqual(@"Nobody", [object valueForProperty: @"name"]);
+    UKNil([object valueForPropertyID: tagID]);
+    UKNil([object valueForPropertyID: NULL]);
+}
+
+- (void) testPropertyIDMethodsCallOverridenNameBasedMethods
+{
+    PVCOverridingObject *object = AUTORELEASE([PVCOverridingObject new]);
+    ETPropertyID nameID = ETPropertyIDForName(@"name");
+
+    UKTrue([object setValue: @"nobody" forPropertyID: nameID]);
+
+    UKObjectsEqual(@"NOBODY", [object name]);
+    UKObjectsEqual(@"Overriden", [object valueForPropertyID: nameID]);
+    UKObjectsEqual(@"Overriden", [object valueForProperty: @"name"]);
+}
+
+- (void) testKeyValuePairWithPropertyIDs
+{
+    ETKeyValuePair *pair = [ETKeyValuePair pairWithKey: @"Tree" value: @"Green"];
+
+    UKObjectsEqual(@"Tree", [pair valueForPropertyID: ETPropertyIDForName(@"key")]);
+    UKObjectsEqual(@"Green", [pair valueForPropertyID: ETPropertyIDForName(@"value")]);
+    UKObjectsEqual(@"Tree", [pair valueForProperty: @"displayName"]);
+}
+
+- (void) testKeyValuePairForwardsUndeclaredPropertyNames
+{
+    ETKeyValuePair *pair = [ETKeyValuePair pairWithKey: @"Tree"
+                                                 value: AUTORELEASE([PVCOverridingObject new])];
+
+    UKObjectsEqual(@"Computed", [pair valueForProperty: @"computedName"]);
+    UKTrue(ETDeclaredPropertyIDForName(pair, @"computedName") == NULL);
+}
+
+- (void) testPropertyPath
+{
+    ETPropertyPath *path = [ETPropertyPath pathWithString: @"parent.parent.name"];
+
+    UKIntsEqual(3, [path count]);
+    UKTrue([path firstPropertyID] == ETPropertyIDForName(@"parent"));
+    UKTrue([path lastPropertyID] == ETPropertyIDForName(@"name"));
+    UKTrue([path propertyIDAtIndex: 1] == ETPropertyIDForName(@"parent"));
+    UKRaisesException([path propertyIDAtIndex: 3]);
+    UKTrue(path == [ETPropertyPath pathWithString: @"parent.parent.name"]);
+    UKObjectsEqual(path, AUTORELEASE([[ETPropertyPath alloc] initWithString: @"parent.parent.name"]));
+    UKNil([ETPropertyPath pathWithString: nil]);
+}
+
+- (void) testPropertyPathEvaluation
+{
+    PVCObject *object = AUTORELEASE([PVCObject new]);
+    PVCObject *parent = AUTORELEASE([PVCObject new]);
+    ETPropertyPath *path = [ETPropertyPath pathWithString: @"parent.name"];
+
+    UKNil([path valueForObject: object]);
+    UKFalse([path setValue: @"Nobody" forObject: object]);
+
+    [object setValue: parent forProperty: @"parent"];
+
+    UKTrue([path setValue: @"Nobody" forObject: object]);
+    UKObjectsEqual(@"Nobody", [parent name]);
+    UKObjectsEqual(@"Nobody", [path valueForObject: object]);
+    UKObjectsEqual(@"Nobody", [object valueForPropertyPath: @"parent.name"]);
+    UKTrue([object setValue: @"Somebody" forPropertyPath: @"parent.name"]);
+    UKObjectsEqual(@"Somebody", [parent name]);
+    UKNil([path valueForObject: nil]);
+}
+
+- (void) testPropertyPathEvaluationHonorsOverridenPropertyValueCoding
+{
+    PVCObject *object = AUTORELEASE([PVCObject new]);
+    PVCOverridingObject *parent = AUTORELEASE([PVCOverridingObject new]);
+
+    [object setValue: parent forProperty: @"parent"];
+
+    UKObjectsEqual(@"Overriden", [object valueForPropertyPath: @"parent.name"]);
+    UKTrue([object setValue: @"nobody" forPropertyPath: @"parent.name"]);
+    UKObjectsEqual(@"NOBODY", [parent name]);
+}
+
+- (void) testPropertyPathBulkEvaluation
+{
+    PVCObject *object = AUTORELEASE([PVCObject new]);
+    PVCOverridingObject *otherObject = AUTORELEASE([PVCOverridingObject new]);
+    ETPropertyPath *path = [ETPropertyPath pathWithString: @"name"];
+
+    [object setName: @"Nobody"];
+
+    NSArray *values = [path valuesForObjects: A(object, otherObject, [NSNull null], object)];
+
+    UKObjectsEqual(A(@"Nobody", @"Overriden", [NSNull null], @"Nobody"), values);
+    UKObjectsEqual([NSArray array], [path valuesForObjects: [NSArray array]]);
+}
+
 @end
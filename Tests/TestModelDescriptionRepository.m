@@ -17,6 +17,18 @@
 
 @end
 
+@interface RepositoryTestObject : NSObject
+@end
+
+@interface RepositoryTestSubobject : RepositoryTestObject
+@end
+
+@implementation RepositoryTestObject
+@end
+
+@implementation RepositoryTestSubobject
+@end
+
 @implementation TestModelDescriptionRepository
 
 - (id) init
@@ -44,6 +56,18 @@
     UKObjectsSame(packageProperty, [repo descriptionForName: @"ETPackageDescription.entityDescriptions"]);
 }
 
+- (void) testFastEnumeration
+{
+    NSMutableSet *enumerated = [NSMutableSet set];
+
+    for (ETPackageDescription *packageDesc in repo)
+    {
+        [enumerated addObject: packageDesc];
+    }
+    UKObjectsEqual(SA([repo packageDescriptions]), enumerated);
+    UKIntsEqual([[repo packageDescriptions] count], [repo count]);
+}
+
 - (void) testEntityDescriptionForClass
 {
     /* We use a pristine repository to collect the entity descriptions
@@ -96,6 +120,108 @@
     UKObjectsSame([NSString class], [repo classForEntityDescription: customString]);
 }
 
+- (void) testResolvedLookupsAreDiscardedOnBindingChanges
+{
+    ASSIGN(repo, [[[ETModelDescriptionRepository alloc] init] autorelease]);
+
+    ETEntityDescription *root = [repo descriptionForName: @"NSObject"];
+    ETEntityDescription *object = [ETEntityDescription descriptionWithName: @"RepositoryTestObject"];
+    ETEntityDescription *subobject = [ETEntityDescription descriptionWithName: @"RepositoryTestSubobject"];
+
+    [object setParent: root];
+    [subobject setParent: root];
+
+    UKObjectsSame(root, [repo entityDescriptionForClass: [RepositoryTestSubobject class]]);
+    UKObjectsSame([NSObject class], [repo classForEntityDescription: subobject]);
+
+    [repo addDescription: object];
+    [repo setEntityDescription: object forClass: [RepositoryTestObject class]];
+
+    UKObjectsSame(object, [repo entityDescriptionForClass: [RepositoryTestSubobject class]]);
+    UKObjectsSame(object, [repo entityDescriptionForClass: [RepositoryTestObject class]]);
+
+    [subobject setParent: object];
+
+    UKObjectsSame([RepositoryTestObject class], [repo classForEntityDescription: subobject]);
+    UKNil([repo entityDescriptionForClass: Nil]);
+}
+
+- (void) testLazyEntityDescriptionRegistration
+{
+    ASSIGN(repo, [[[ETModelDescriptionRepository alloc] init] autorelease]);
+    [repo setRegistersEntityDescriptionsLazily: YES];
+
+    NSSet *excludedClasses = [S([NSCountedSet class])
+        setByAddingObjectsFromArray: [NSCountedSet allSubclasses]];
+    [repo collectEntityDescriptionsFromClass: [NSSet class]
+                             excludedClasses: excludedClasses
+                                  resolveNow: YES];
+
+    UKNil([[repo content] objectForKey: @"Anonymous.NSMutableSet"]);
+    UKIntsEqual(0, [[[repo startupStatistics] objectForKey: @"createdEntityDescriptionCount"] intValue]);
+    UKTrue([[[repo startupStatistics] objectForKey: @"pendingEntityDescriptionCount"] intValue] > 0);
+
+    ETEntityDescription *mutableSet = [repo descriptionForName: @"NSMutableSet"];
+
+    UKStringsEqual(@"NSMutableSet", [mutableSet name]);
+    UKObjectsSame(mutableSet, [repo entityDescriptionForClass: [NSMutableSet class]]);
+    UKObjectsSame(mutableSet, [repo entityDescriptionForClass: [NSCountedSet class]]);
+    /* The parent entity description is created along its subclass one */
+    UKObjectsSame([repo entityDescriptionForClass: [NSSet class]], [mutableSet parent]);
+
+    [repo resolvePendingEntityDescriptions];
+
+    UKIntsEqual(0, [[[repo startupStatistics] objectForKey: @"pendingEntityDescriptionCount"] intValue]);
+    UKObjectsSame(mutableSet, [repo descriptionForName: @"NSMutableSet"]);
+}
+
+- (void) testSnapshotRoundTrip
+{
+    NSString *path = [NSTemporaryDirectory()
+        stringByAppendingPathComponent: @"TestModelDescriptionRepository.snapshot"];
+    ETModelDescriptionRepository *loadedRepo =
+        [[[ETModelDescriptionRepository alloc] init] autorelease];
+
+    UKTrue([repo writeSnapshotToFile: path]);
+    UKTrue([loadedRepo loadSnapshotFromFile: path]);
+
+    ETEntityDescription *package = [loadedRepo descriptionForName: @"ETPackageDescription"];
+    ETPropertyDescription *entityDescriptions =
+        [package propertyDescriptionForName: @"entityDescriptions"];
+
+    UKNotNil(package);
+    UKObjectsNotSame([repo descriptionForName: @"ETPackageDescription"], package);
+    UKObjectsSame(package, [loadedRepo entityDescriptionForClass: [ETPackageDescription class]]);
+    UKObjectsSame([loadedRepo descriptionForName: @"ETEntityDescription"], [entityDescriptions type]);
+    UKObjectsSame([loadedRepo descriptionForName: @"ETEntityDescription.owner"],
+                  [entityDescriptions opposite]);
+    UKTrue([entityDescriptions isMultivalued]);
+    UKTrue([[[loadedRepo startupStatistics] objectForKey: @"snapshotEntityDescriptionCount"] intValue] > 0);
+
+    [[NSFileManager defaultManager] removeItemAtPath: path error: NULL];
+}
+
+- (void) testSnapshotFingerprintMismatch
+{
+    NSString *path = [NSTemporaryDirectory()
+        stringByAppendingPathComponent: @"TestModelDescriptionRepository.snapshot"];
+    ETModelDescriptionRepository *loadedRepo =
+        [[[ETModelDescriptionRepository alloc] init] autorelease];
+    NSDictionary *snapshot = D([NSNumber numberWithInt: 1], @"version",
+        @"0000000000000000-0", @"fingerprint", [NSArray array], @"entities");
+
+    UKStringsEqual([ETModelDescriptionRepository snapshotFingerprint],
+                   [ETModelDescriptionRepository snapshotFingerprint]);
+
+    [snapshot writeToFile: path atomically: YES];
+
+    UKFalse([loadedRepo loadSnapshotFromFile: path]);
+    UKFalse([loadedRepo loadSnapshotFromFile: [path stringByAppendingPathExtension: @"missing"]]);
+    UKIntsEqual(0, [[[loadedRepo startupStatistics] objectForKey: @"snapshotEntityDescriptionCount"] intValue]);
+
+    [[NSFileManager defaultManager] removeItemAtPath: path error: NULL];
+}
+
 - (void) testResolveObjectRefsWithMetaMetaModel
 {
     /* We use a pristine repository to collect the entity descriptions 
@@ -0,0 +1,133 @@
+/*
+    Copyright (C) 2026 The Etoile Project
+
+    Date:  October 2026
+    License: Modified BSD (see COPYING)
+ */
+
+#import <Foundation/Foundation.h>
+#import <UnitKit/UnitKit.h>
+#import "ETCollection.h"
+#import "ETSequence.h"
+#import "Macros.h"
+#import "EtoileCompatibility.h"
+
+#if __has_feature(blocks)
+
+@interface TestSequence : NSObject <UKTest>
+@end
+
+@implementation TestSequence
+
+static NSArray *numbersUpTo(int max)
+{
+    NSMutableArray *numbers = [NSMutableArray array];
+
+    for (int i = 1; i <= max; i++)
+    {
+        [numbers addObject: [NSNumber numberWithInt: i]];
+    }
+    return numbers;
+}
+
+- (void) testFilterThenMap
+{
+    ETSequence *sequence = [[[ETSequence sequenceWithCollection: numbersUpTo(10)]
+        filteredSequenceWithBlock: ^ (id number) { return (BOOL)([number intValue] % 2 == 0); }]
+        mappedSequenceWithBlock: ^ (id number) { return (id)[number stringValue]; }];
+
+    UKObjectsEqual(A(@"2", @"4", @"6", @"8", @"10"), [sequence collection]);
+    /* Sequences can be consumed again */
+    UKObjectsEqual(A(@"2", @"4", @"6", @"8", @"10"), [sequence collection]);
+}
+
+- (void) testTakeStopsReadingTheSource
+{
+    __block int evaluated = 0;
+    ETSequence *sequence = [[[ETSequence sequenceWithCollection: numbersUpTo(100)]
+        mappedSequenceWithBlock: ^ (id number) { evaluated++; return number; }]
+        sequenceLimitedToCount: 3];
+
+    UKObjectsEqual(numbersUpTo(3), [sequence collection]);
+    UKIntsEqual(3, evaluated);
+}
+
+- (void) testFlatMapAndZip
+{
+    ETSequence *sequence = [[[ETSequence sequenceWithCollection: A(@"a", @"b")]
+        flatMappedSequenceWithBlock: ^ (id string) { return (id)A(string, [string uppercaseString]); }]
+        zippedSequenceWithCollection: numbersUpTo(3)
+                            andBlock: ^ (id string, id number)
+    {
+        return (id)[string stringByAppendingString: [number stringValue]];
+    }];
+
+    UKObjectsEqual(A(@"a1", @"A2", @"b3"), [sequence collection]);
+}
+
+- (void) testFold
+{
+    ETSequence *sequence = [ETSequence sequenceWithCollection: numbersUpTo(100)];
+    id sum = [sequence leftFoldWithInitialValue: [NSNumber numberWithInt: 0]
+                                      intoBlock: ^ (id total, id number)
+    {
+        return (id)[NSNumber numberWithInt: [total intValue] + [number intValue]];
+    }];
+
+    UKIntsEqual(5050, [sum intValue]);
+}
+
+- (void) testFastEnumeration
+{
+    ETSequence *sequence = [[ETSequence sequenceWithCollection: numbersUpTo(1000)]
+        filteredSequenceWithBlock: ^ (id number) { return (BOOL)([number intValue] % 10 == 0); }];
+    int count = 0;
+
+    for (NSNumber *number in sequence)
+    {
+        count++;
+        UKIntsEqual(count * 10, [number intValue]);
+    }
+    UKIntsEqual(100, count);
+
+    /* Leaving early, then enumerating again */
+    for (NSNumber *number in sequence)
+    {
+        break;
+    }
+    count = 0;
+    for (NSNumber *number in sequence)
+    {
+        count++;
+    }
+    UKIntsEqual(100, count);
+}
+
+- (void) testNestedFastEnumeration
+{
+    ETSequence *sequence = [[ETSequence sequenceWithCollection: numbersUpTo(40)]
+        mappedSequenceWithBlock: ^ (id number) { return number; }];
+    int sum = 0;
+
+    for (NSNumber *outer in sequence)
+    {
+        for (NSNumber *inner in sequence)
+        {
+            sum += [inner intValue];
+        }
+        sum += [outer intValue];
+    }
+    UKIntsEqual(41 * 820, sum);
+}
+
+- (void) testDictionaryValues
+{
+    ETSequence *sequence = [[ETSequence sequenceWithCollection: D(@"foo", @"one")]
+        mappedSequenceWithBlock: ^ (id string) { return (id)[string uppercaseString]; }];
+
+    UKObjectsEqual(A(@"FOO"), [sequence collection]);
+}
+
+@end
+
+#endif